@@ -20,6 +20,8 @@
 #include <utils/Log.h>
 #include <utils/Errors.h>
 
+#include <algorithm>
+
 #include <binder/Parcel.h>
 #include <camera/CameraMetadata.h>
 #include <camera_metadata_hidden.h>
@@ -33,21 +35,22 @@ typedef Parcel::WritableBlob WritableBlob;
 typedef Parcel::ReadableBlob ReadableBlob;
 
 CameraMetadata::CameraMetadata() :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false), mTagIndexEnabled(false), mTagIndexValid(false) {
 }
 
 CameraMetadata::CameraMetadata(size_t entryCapacity, size_t dataCapacity) :
-        mLocked(false)
+        mLocked(false), mTagIndexEnabled(false), mTagIndexValid(false)
 {
     mBuffer = allocate_camera_metadata(entryCapacity, dataCapacity);
 }
 
 CameraMetadata::CameraMetadata(const CameraMetadata &other) :
-        mLocked(false) {
+        mLocked(false), mTagIndexEnabled(false), mTagIndexValid(false) {
     mBuffer = clone_camera_metadata(other.mBuffer);
 }
 
-CameraMetadata::CameraMetadata(CameraMetadata &&other) :mBuffer(NULL),  mLocked(false) {
+CameraMetadata::CameraMetadata(CameraMetadata &&other) :mBuffer(NULL),  mLocked(false),
+        mTagIndexEnabled(false), mTagIndexValid(false) {
     acquire(other);
 }
 
@@ -57,7 +60,7 @@ CameraMetadata &CameraMetadata::operator=(CameraMetadata &&other) {
 }
 
 CameraMetadata::CameraMetadata(camera_metadata_t *buffer) :
-        mBuffer(NULL), mLocked(false) {
+        mBuffer(NULL), mLocked(false), mTagIndexEnabled(false), mTagIndexValid(false) {
     acquire(buffer);
 }
 
@@ -110,6 +113,7 @@ camera_metadata_t* CameraMetadata::release() {
     }
     camera_metadata_t *released = mBuffer;
     mBuffer = NULL;
+    invalidateTagIndex();
     return released;
 }
 
@@ -118,6 +122,7 @@ void CameraMetadata::clear() {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return;
     }
+    invalidateTagIndex();
     if (mBuffer) {
         free_camera_metadata(mBuffer);
         mBuffer = NULL;
@@ -158,7 +163,21 @@ status_t CameraMetadata::append(const camera_metadata_t* other) {
     size_t extraData = get_camera_metadata_data_count(other);
     resizeIfNeeded(extraEntries, extraData);
 
-    return append_camera_metadata(mBuffer, other);
+    size_t oldEntryCount = entryCount();
+    status_t res = append_camera_metadata(mBuffer, other);
+    if (res != OK) {
+        invalidateTagIndex();
+    } else if (mTagIndexValid) {
+        // Appended entries go to the end of the buffer; duplicated tags keep
+        // pointing to the first entry, as find_camera_metadata_entry does.
+        size_t newEntryCount = entryCount();
+        for (size_t i = oldEntryCount; i < newEntryCount; i++) {
+            camera_metadata_ro_entry_t entry;
+            get_camera_metadata_ro_entry(mBuffer, i, &entry);
+            mTagIndex.emplace(entry.tag, i);
+        }
+    }
+    return res;
 }
 
 size_t CameraMetadata::entryCount() const {
@@ -175,12 +194,106 @@ size_t CameraMetadata::bufferSize() const {
             get_camera_metadata_size(mBuffer);
 }
 
+size_t CameraMetadata::dataCount() const {
+    return (mBuffer == NULL) ? 0 :
+            get_camera_metadata_data_count(mBuffer);
+}
+
+status_t CameraMetadata::reserve(size_t entryCapacity, size_t dataCapacity) {
+    if (mLocked) {
+        ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
+        return INVALID_OPERATION;
+    }
+    if (mBuffer == NULL) {
+        mBuffer = allocate_camera_metadata(entryCapacity, dataCapacity);
+        if (mBuffer == NULL) {
+            ALOGE("%s: Can't allocate metadata buffer", __FUNCTION__);
+            return NO_MEMORY;
+        }
+        return OK;
+    }
+    size_t entryCap = get_camera_metadata_entry_capacity(mBuffer);
+    size_t dataCap = get_camera_metadata_data_capacity(mBuffer);
+    if (entryCapacity <= entryCap && dataCapacity <= dataCap) {
+        return OK;
+    }
+    // Appending keeps the entry order, so the tag index stays valid.
+    camera_metadata_t *newBuffer = allocate_camera_metadata(
+            std::max(entryCapacity, entryCap), std::max(dataCapacity, dataCap));
+    if (newBuffer == NULL) {
+        ALOGE("%s: Can't allocate larger metadata buffer", __FUNCTION__);
+        return NO_MEMORY;
+    }
+    append_camera_metadata(newBuffer, mBuffer);
+    free_camera_metadata(mBuffer);
+    mBuffer = newBuffer;
+    return OK;
+}
+
 status_t CameraMetadata::sort() {
     if (mLocked) {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
-    return sort_camera_metadata(mBuffer);
+    status_t res = sort_camera_metadata(mBuffer);
+    invalidateTagIndex();
+    updateTagIndex();
+    return res;
+}
+
+void CameraMetadata::enableTagIndex() {
+    mTagIndexEnabled = true;
+    updateTagIndex();
+}
+
+void CameraMetadata::invalidateTagIndex() {
+    mTagIndexValid = false;
+    mTagIndex.clear();
+}
+
+void CameraMetadata::updateTagIndex() {
+    if (!mTagIndexEnabled || mTagIndexValid || mBuffer == NULL) {
+        return;
+    }
+    size_t count = get_camera_metadata_entry_count(mBuffer);
+    mTagIndex.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        camera_metadata_ro_entry_t entry;
+        get_camera_metadata_ro_entry(mBuffer, i, &entry);
+        mTagIndex.emplace(entry.tag, i);
+    }
+    mTagIndexValid = true;
+}
+
+status_t CameraMetadata::findEntry(uint32_t tag, camera_metadata_entry_t *entry) {
+    updateTagIndex();
+    if (mTagIndexValid) {
+        auto it = mTagIndex.find(tag);
+        if (it == mTagIndex.end()) {
+            return NAME_NOT_FOUND;
+        }
+        if (get_camera_metadata_entry(mBuffer, it->second, entry) == OK && entry->tag == tag) {
+            return OK;
+        }
+        ALOGE("%s: Tag index is out of date for tag %x", __FUNCTION__, tag);
+        invalidateTagIndex();
+    }
+    return find_camera_metadata_entry(mBuffer, tag, entry);
+}
+
+status_t CameraMetadata::findEntry(uint32_t tag, camera_metadata_ro_entry_t *entry) const {
+    if (mTagIndexValid) {
+        auto it = mTagIndex.find(tag);
+        if (it == mTagIndex.end()) {
+            return NAME_NOT_FOUND;
+        }
+        if (get_camera_metadata_ro_entry(mBuffer, it->second, entry) == OK &&
+                entry->tag == tag) {
+            return OK;
+        }
+        ALOGE("%s: Tag index is out of date for tag %x", __FUNCTION__, tag);
+    }
+    return find_camera_metadata_ro_entry(mBuffer, tag, entry);
 }
 
 status_t CameraMetadata::checkType(uint32_t tag, uint8_t expectedType) {
@@ -334,10 +447,13 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
 
     if (res == OK) {
         camera_metadata_entry_t entry;
-        res = find_camera_metadata_entry(mBuffer, tag, &entry);
+        res = findEntry(tag, &entry);
         if (res == NAME_NOT_FOUND) {
             res = add_camera_metadata_entry(mBuffer,
                     tag, data, data_count);
+            if (res == OK && mTagIndexValid) {
+                mTagIndex.emplace(tag, get_camera_metadata_entry_count(mBuffer) - 1);
+            }
         } else if (res == OK) {
             res = update_camera_metadata_entry(mBuffer,
                     entry.index, data, data_count, NULL);
@@ -364,7 +480,7 @@ status_t CameraMetadata::updateImpl(uint32_t tag, const void *data,
 
 bool CameraMetadata::exists(uint32_t tag) const {
     camera_metadata_ro_entry entry;
-    return find_camera_metadata_ro_entry(mBuffer, tag, &entry) == 0;
+    return findEntry(tag, &entry) == 0;
 }
 
 camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
@@ -375,7 +491,7 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
         entry.count = 0;
         return entry;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
+    res = findEntry(tag, &entry);
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -386,7 +502,7 @@ camera_metadata_entry_t CameraMetadata::find(uint32_t tag) {
 camera_metadata_ro_entry_t CameraMetadata::find(uint32_t tag) const {
     status_t res;
     camera_metadata_ro_entry entry;
-    res = find_camera_metadata_ro_entry(mBuffer, tag, &entry);
+    res = findEntry(tag, &entry);
     if (CC_UNLIKELY( res != OK )) {
         entry.count = 0;
         entry.data.u8 = NULL;
@@ -401,7 +517,7 @@ status_t CameraMetadata::erase(uint32_t tag) {
         ALOGE("%s: CameraMetadata is locked", __FUNCTION__);
         return INVALID_OPERATION;
     }
-    res = find_camera_metadata_entry(mBuffer, tag, &entry);
+    res = findEntry(tag, &entry);
     if (res == NAME_NOT_FOUND) {
         return OK;
     } else if (res != OK) {
@@ -420,6 +536,9 @@ status_t CameraMetadata::erase(uint32_t tag) {
                 get_local_camera_metadata_tag_name(tag, mBuffer),
                 tag, strerror(-res), res);
     }
+    // Deletion shifts the later entries, and can expose a duplicated tag.
+    invalidateTagIndex();
+    updateTagIndex();
     return res;
 }
 
@@ -784,6 +903,10 @@ void CameraMetadata::swap(CameraMetadata& other) {
 
     other.mBuffer = thisBuf;
     mBuffer = otherBuf;
+
+    std::swap(mTagIndexEnabled, other.mTagIndexEnabled);
+    std::swap(mTagIndexValid, other.mTagIndexValid);
+    mTagIndex.swap(other.mTagIndex);
 }
 
 status_t CameraMetadata::getTagFromName(const char *name,
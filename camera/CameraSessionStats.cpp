@@ -253,6 +253,137 @@ status_t CameraStreamStats::writeToParcel(android::Parcel* parcel) const {
     return OK;
 }
 
+status_t CameraLatencyStats::readFromParcel(const android::Parcel* parcel) {
+    if (parcel == NULL) {
+        ALOGE("%s: Null parcel", __FUNCTION__);
+        return BAD_VALUE;
+    }
+
+    status_t err = OK;
+
+    int stage = 0;
+    if ((err = parcel->readInt32(&stage)) != OK) {
+        ALOGE("%s: Failed to read stage from parcel", __FUNCTION__);
+        return err;
+    }
+
+    int64_t count = 0;
+    if ((err = parcel->readInt64(&count)) != OK) {
+        ALOGE("%s: Failed to read sample count from parcel", __FUNCTION__);
+        return err;
+    }
+
+    float p50Ms = -1;
+    if ((err = parcel->readFloat(&p50Ms)) != OK) {
+        ALOGE("%s: Failed to read p50 latency from parcel", __FUNCTION__);
+        return err;
+    }
+
+    float p90Ms = -1;
+    if ((err = parcel->readFloat(&p90Ms)) != OK) {
+        ALOGE("%s: Failed to read p90 latency from parcel", __FUNCTION__);
+        return err;
+    }
+
+    float p95Ms = -1;
+    if ((err = parcel->readFloat(&p95Ms)) != OK) {
+        ALOGE("%s: Failed to read p95 latency from parcel", __FUNCTION__);
+        return err;
+    }
+
+    float p99Ms = -1;
+    if ((err = parcel->readFloat(&p99Ms)) != OK) {
+        ALOGE("%s: Failed to read p99 latency from parcel", __FUNCTION__);
+        return err;
+    }
+
+    float maxMs = -1;
+    if ((err = parcel->readFloat(&maxMs)) != OK) {
+        ALOGE("%s: Failed to read max latency from parcel", __FUNCTION__);
+        return err;
+    }
+
+    std::vector<float> histogramBins;
+    if ((err = parcel->readFloatVector(&histogramBins)) != OK) {
+        ALOGE("%s: Failed to read histogram bins from parcel", __FUNCTION__);
+        return err;
+    }
+
+    std::vector<int64_t> histogramCounts;
+    if ((err = parcel->readInt64Vector(&histogramCounts)) != OK) {
+        ALOGE("%s: Failed to read histogram counts from parcel", __FUNCTION__);
+        return err;
+    }
+
+    mStage = stage;
+    mCount = count;
+    mP50Ms = p50Ms;
+    mP90Ms = p90Ms;
+    mP95Ms = p95Ms;
+    mP99Ms = p99Ms;
+    mMaxMs = maxMs;
+    mHistogramBins = std::move(histogramBins);
+    mHistogramCounts = std::move(histogramCounts);
+
+    return OK;
+}
+
+status_t CameraLatencyStats::writeToParcel(android::Parcel* parcel) const {
+    if (parcel == NULL) {
+        ALOGE("%s: Null parcel", __FUNCTION__);
+        return BAD_VALUE;
+    }
+
+    status_t err = OK;
+
+    if ((err = parcel->writeInt32(mStage)) != OK) {
+        ALOGE("%s: Failed to write latency stage!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeInt64(mCount)) != OK) {
+        ALOGE("%s: Failed to write latency sample count!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeFloat(mP50Ms)) != OK) {
+        ALOGE("%s: Failed to write p50 latency!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeFloat(mP90Ms)) != OK) {
+        ALOGE("%s: Failed to write p90 latency!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeFloat(mP95Ms)) != OK) {
+        ALOGE("%s: Failed to write p95 latency!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeFloat(mP99Ms)) != OK) {
+        ALOGE("%s: Failed to write p99 latency!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeFloat(mMaxMs)) != OK) {
+        ALOGE("%s: Failed to write max latency!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeFloatVector(mHistogramBins)) != OK) {
+        ALOGE("%s: Failed to write histogram bins!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeInt64Vector(mHistogramCounts)) != OK) {
+        ALOGE("%s: Failed to write histogram counts!", __FUNCTION__);
+        return err;
+    }
+
+    return OK;
+}
+
 const int CameraSessionStats::CAMERA_STATE_OPEN = 0;
 const int CameraSessionStats::CAMERA_STATE_ACTIVE = 1;
 const int CameraSessionStats::CAMERA_STATE_IDLE = 2;
@@ -280,7 +411,10 @@ CameraSessionStats::CameraSessionStats() :
         mDeviceError(false),
         mVideoStabilizationMode(-1),
         mSessionIndex(0),
-        mCameraExtensionSessionStats() {}
+        mCameraExtensionSessionStats(),
+        mConfigureStreamSetupLatencyMs(-1),
+        mConfigureHalLatencyMs(-1),
+        mConfigureStreamFinishLatencyMs(-1) {}
 
 CameraSessionStats::CameraSessionStats(const String16& cameraId,
         int facing, int newCameraState, const String16& clientName,
@@ -301,7 +435,10 @@ CameraSessionStats::CameraSessionStats(const String16& cameraId,
                 mDeviceError(0),
                 mVideoStabilizationMode(-1),
                 mSessionIndex(0),
-                mCameraExtensionSessionStats() {}
+                mCameraExtensionSessionStats(),
+                mConfigureStreamSetupLatencyMs(-1),
+                mConfigureHalLatencyMs(-1),
+                mConfigureStreamFinishLatencyMs(-1) {}
 
 status_t CameraSessionStats::readFromParcel(const android::Parcel* parcel) {
     if (parcel == NULL) {
@@ -425,6 +562,30 @@ status_t CameraSessionStats::readFromParcel(const android::Parcel* parcel) {
         return err;
     }
 
+    int32_t configureStreamSetupLatencyMs;
+    if ((err = parcel->readInt32(&configureStreamSetupLatencyMs)) != OK) {
+        ALOGE("%s: Failed to read stream setup latency from parcel", __FUNCTION__);
+        return err;
+    }
+
+    int32_t configureHalLatencyMs;
+    if ((err = parcel->readInt32(&configureHalLatencyMs)) != OK) {
+        ALOGE("%s: Failed to read HAL configure latency from parcel", __FUNCTION__);
+        return err;
+    }
+
+    int32_t configureStreamFinishLatencyMs;
+    if ((err = parcel->readInt32(&configureStreamFinishLatencyMs)) != OK) {
+        ALOGE("%s: Failed to read stream finish latency from parcel", __FUNCTION__);
+        return err;
+    }
+
+    std::vector<CameraLatencyStats> latencyStats;
+    if ((err = parcel->readParcelableVector(&latencyStats)) != OK) {
+        ALOGE("%s: Failed to read latency stats from parcel", __FUNCTION__);
+        return err;
+    }
+
     mCameraId = id;
     mFacing = facing;
     mNewCameraState = newCameraState;
@@ -444,6 +605,10 @@ status_t CameraSessionStats::readFromParcel(const android::Parcel* parcel) {
     mVideoStabilizationMode = videoStabilizationMode;
     mSessionIndex = sessionIdx;
     mCameraExtensionSessionStats = extStats;
+    mConfigureStreamSetupLatencyMs = configureStreamSetupLatencyMs;
+    mConfigureHalLatencyMs = configureHalLatencyMs;
+    mConfigureStreamFinishLatencyMs = configureStreamFinishLatencyMs;
+    mLatencyStats = std::move(latencyStats);
 
     return OK;
 }
@@ -551,6 +716,26 @@ status_t CameraSessionStats::writeToParcel(android::Parcel* parcel) const {
         return err;
     }
 
+    if ((err = parcel->writeInt32(mConfigureStreamSetupLatencyMs)) != OK) {
+        ALOGE("%s: Failed to write stream setup latency!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeInt32(mConfigureHalLatencyMs)) != OK) {
+        ALOGE("%s: Failed to write HAL configure latency!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeInt32(mConfigureStreamFinishLatencyMs)) != OK) {
+        ALOGE("%s: Failed to write stream finish latency!", __FUNCTION__);
+        return err;
+    }
+
+    if ((err = parcel->writeParcelableVector(mLatencyStats)) != OK) {
+        ALOGE("%s: Failed to write latency stats!", __FUNCTION__);
+        return err;
+    }
+
     return OK;
 }
 
@@ -19,6 +19,8 @@
 
 #include "system/camera_metadata.h"
 
+#include <unordered_map>
+
 #include <utils/String8.h>
 #include <utils/Vector.h>
 #include <binder/Parcelable.h>
@@ -132,11 +134,31 @@ class CameraMetadata: public Parcelable {
      */
     size_t bufferSize() const;
 
+    /**
+     * Return the number of bytes of entry data in the metadata buffer.
+     */
+    size_t dataCount() const;
+
+    /**
+     * Make sure the metadata buffer has space for at least entryCapacity
+     * entries and dataCapacity bytes of data, so that updates and appends up
+     * to that size do not reallocate the buffer.
+     */
+    status_t reserve(size_t entryCapacity, size_t dataCapacity);
+
     /**
      * Sort metadata buffer for faster find
      */
     status_t sort();
 
+    /**
+     * Maintain an index from tag to entry position alongside the metadata
+     * buffer, so that find, update and erase do not search the buffer. Best
+     * used for metadata that is looked up and modified many times, such as
+     * capture results. The index is not carried over to copies.
+     */
+    void enableTagIndex();
+
     /**
      * Update metadata entry. Will create entry if it doesn't exist already, and
      * will reallocate the buffer if insufficient space exists. Overloaded for
@@ -251,6 +273,28 @@ class CameraMetadata: public Parcelable {
     camera_metadata_t *mBuffer;
     mutable bool       mLocked;
 
+    // Tag to entry position of mBuffer, only maintained if mTagIndexEnabled.
+    // Rebuilt lazily by non-const methods after the buffer is replaced.
+    bool               mTagIndexEnabled;
+    bool               mTagIndexValid;
+    std::unordered_map<uint32_t, size_t> mTagIndex;
+
+    /**
+     * Drop the tag index, after the metadata buffer is replaced or reordered
+     */
+    void invalidateTagIndex();
+
+    /**
+     * Build the tag index if it is enabled and not up to date
+     */
+    void updateTagIndex();
+
+    /**
+     * Find an entry by tag, with the tag index if it is valid
+     */
+    status_t findEntry(uint32_t tag, camera_metadata_entry_t *entry);
+    status_t findEntry(uint32_t tag, camera_metadata_ro_entry_t *entry) const;
+
     /**
      * Check if tag has a given type
      */
@@ -93,6 +93,54 @@ public:
     virtual status_t writeToParcel(android::Parcel* parcel) const override;
 };
 
+/**
+ * Latency statistics of one capture pipeline stage
+ */
+class CameraLatencyStats : public android::Parcelable {
+public:
+    enum LatencyStage {
+        // From the capture request submission to the shutter notification
+        LATENCY_STAGE_SUBMIT_TO_SHUTTER = 0,
+        // From the shutter notification to the final capture result
+        LATENCY_STAGE_SHUTTER_TO_RESULT = 1,
+        // Getting an output buffer from its stream
+        LATENCY_STAGE_DEQUEUE_BUFFER = 2,
+        // Returning a filled output buffer to its stream
+        LATENCY_STAGE_QUEUE_BUFFER = 3,
+        // Correcting the capture result metadata with the coordinate mappers
+        LATENCY_STAGE_RESULT_MAPPER = 4,
+        // Producing the output image of a composite stream
+        LATENCY_STAGE_COMPOSITE_STREAM = 5,
+        LATENCY_STAGE_COUNT
+    };
+
+    int mStage;
+    // The number of samples
+    int64_t mCount;
+
+    // Latency percentiles in ms, or -1 if there are no samples. The percentiles
+    // are the upper bounds of the histogram bins they fall in, capped by the
+    // maximum latency.
+    float mP50Ms;
+    float mP90Ms;
+    float mP95Ms;
+    float mP99Ms;
+    float mMaxMs;
+
+    // Latency histogram, with the same layout as CameraStreamStats: the
+    // boundary values in ms separating adjacent bins, and the counts for all
+    // bins. size(mHistogramBins) + 1 = size(mHistogramCounts)
+    std::vector<float> mHistogramBins;
+    std::vector<int64_t> mHistogramCounts;
+
+    CameraLatencyStats() :
+            mStage(LATENCY_STAGE_SUBMIT_TO_SHUTTER), mCount(0), mP50Ms(-1), mP90Ms(-1),
+            mP95Ms(-1), mP99Ms(-1), mMaxMs(-1) {}
+
+    virtual status_t readFromParcel(const android::Parcel* parcel) override;
+    virtual status_t writeToParcel(android::Parcel* parcel) const override;
+};
+
 /**
  * Camera session statistics
  *
@@ -163,6 +211,16 @@ public:
 
     CameraExtensionSessionStats mCameraExtensionSessionStats;
 
+    // Breakdown of the session creation latency in ms, or -1 if not available: setting up the
+    // streams before the HAL call, the HAL stream configuration call, and finishing the stream
+    // configuration after the HAL call (e.g. connecting the consumers).
+    int mConfigureStreamSetupLatencyMs;
+    int mConfigureHalLatencyMs;
+    int mConfigureStreamFinishLatencyMs;
+
+    // Latency of the capture pipeline stages while the session was active
+    std::vector<CameraLatencyStats> mLatencyStats;
+
     // Constructors
     CameraSessionStats();
     CameraSessionStats(const String16& cameraId, int facing, int newCameraState,
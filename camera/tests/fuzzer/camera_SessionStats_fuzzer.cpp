@@ -23,6 +23,8 @@ using namespace std;
 using namespace android;
 using namespace android::hardware;
 
+constexpr size_t kMaxHistogramBins = 64;
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
     FuzzedDataProvider fdp = FuzzedDataProvider(data, size);
     CameraStreamStats* cameraStreamStats = nullptr;
@@ -94,6 +96,40 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
     invokeReadWriteNullParcel<CameraStreamStats>(cameraStreamStats);
     invokeReadWriteParcel<CameraStreamStats>(cameraStreamStats);
 
+    CameraLatencyStats cameraLatencyStats;
+    Parcel parcelCamLatencyStats;
+    if (fdp.ConsumeBool()) {
+        parcelCamLatencyStats.writeInt32(fdp.ConsumeIntegral<int32_t>());
+    }
+    if (fdp.ConsumeBool()) {
+        parcelCamLatencyStats.writeInt64(fdp.ConsumeIntegral<int64_t>());
+    }
+    // p50, p90, p95, p99 and max
+    for (int i = 0; i < 5; ++i) {
+        if (fdp.ConsumeBool()) {
+            parcelCamLatencyStats.writeFloat(fdp.ConsumeFloatingPoint<float>());
+        }
+    }
+    if (fdp.ConsumeBool()) {
+        vector<float> histogramBins(fdp.ConsumeIntegralInRange<size_t>(0, kMaxHistogramBins));
+        for (float& bin : histogramBins) {
+            bin = fdp.ConsumeFloatingPoint<float>();
+        }
+        parcelCamLatencyStats.writeFloatVector(histogramBins);
+    }
+    if (fdp.ConsumeBool()) {
+        vector<int64_t> histogramCounts(
+                fdp.ConsumeIntegralInRange<size_t>(0, kMaxHistogramBins + 1));
+        for (int64_t& count : histogramCounts) {
+            count = fdp.ConsumeIntegral<int64_t>();
+        }
+        parcelCamLatencyStats.writeInt64Vector(histogramCounts);
+    }
+    parcelCamLatencyStats.setDataPosition(0);
+    cameraLatencyStats.readFromParcel(&parcelCamLatencyStats);
+    invokeReadWriteNullParcel<CameraLatencyStats>(&cameraLatencyStats);
+    invokeReadWriteParcel<CameraLatencyStats>(&cameraLatencyStats);
+
     CameraSessionStats* cameraSessionStats = nullptr;
     Parcel parcelCamSessionStats;
 
@@ -162,6 +198,19 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
 
     parcelCamSessionStats.setDataPosition(0);
     cameraSessionStats->readFromParcel(&parcelCamSessionStats);
+
+    // The trailing fields are only reached by a parcel holding all the fields before them, so
+    // they are also set directly for the write and read back below.
+    cameraSessionStats->mConfigureStreamSetupLatencyMs = fdp.ConsumeIntegral<int32_t>();
+    cameraSessionStats->mConfigureHalLatencyMs = fdp.ConsumeIntegral<int32_t>();
+    cameraSessionStats->mConfigureStreamFinishLatencyMs = fdp.ConsumeIntegral<int32_t>();
+    size_t numLatencyStats =
+            fdp.ConsumeIntegralInRange<size_t>(0, CameraLatencyStats::LATENCY_STAGE_COUNT);
+    for (size_t i = 0; i < numLatencyStats; ++i) {
+        cameraSessionStats->mLatencyStats.push_back(
+                fdp.ConsumeBool() ? cameraLatencyStats : CameraLatencyStats());
+        cameraSessionStats->mLatencyStats.back().mStage = fdp.ConsumeIntegral<int32_t>();
+    }
     invokeReadWriteNullParcel<CameraSessionStats>(cameraSessionStats);
     invokeReadWriteParcel<CameraSessionStats>(cameraSessionStats);
 
@@ -45,6 +45,7 @@ class C2SoftAomDec::IntfImpl : public SimpleInterface<void>::BaseParams {
         noOutputReferences();
         noInputLatency();
         noTimeStretch();
+        addSoftwareThreadCount();
 
         addParameter(DefineParam(mAttrib, C2_PARAMKEY_COMPONENT_ATTRIBUTES)
                          .withConstValue(new C2ComponentAttributesSetting(
@@ -225,6 +226,7 @@ class C2SoftAomDec::IntfImpl : public SimpleInterface<void>::BaseParams {
     std::shared_ptr<C2StreamColorAspectsTuning::output> getDefaultColorAspects_l() {
         return mDefaultColorAspects;
     }
+    uint32_t getSoftwareThreadCount_l() const { return mSoftwareThreadCount->value; }
 
     static C2R Hdr10PlusInfoInputSetter(bool mayBlock, C2P<C2StreamHdr10PlusInfo::input> &me) {
         (void)mayBlock;
@@ -309,19 +311,6 @@ c2_status_t C2SoftAomDec::onFlush_sm() {
     return C2_OK;
 }
 
-static int GetCPUCoreCount() {
-    int cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %d", cpuCoreCount);
-    return cpuCoreCount;
-}
-
 status_t C2SoftAomDec::initDecoder() {
     mSignalledError = false;
     mSignalledOutputEos = false;
@@ -336,7 +325,12 @@ status_t C2SoftAomDec::initDecoder() {
 
     aom_codec_dec_cfg_t cfg;
     memset(&cfg, 0, sizeof(aom_codec_dec_cfg_t));
-    cfg.threads = GetCPUCoreCount();
+    {
+        IntfImpl::Lock lock = mIntf->lock();
+        cfg.threads = GetSoftwareThreadCount(
+                mIntf->getSoftwareThreadCount_l(),
+                0 /* width */, 0 /* height */, 0 /* maxThreads */);
+    }
     cfg.allow_lowbitdepth = 1;
 
     aom_codec_flags_t flags;
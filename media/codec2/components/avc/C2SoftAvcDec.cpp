@@ -55,6 +55,7 @@ public:
         noOutputReferences();
         noInputLatency();
         noTimeStretch();
+        addSoftwareThreadCount();
 
         // TODO: Proper support for reorder depth.
         addParameter(
@@ -296,6 +297,8 @@ public:
         return mColorAspects;
     }
 
+    uint32_t getSoftwareThreadCount_l() const { return mSoftwareThreadCount->value; }
+
 private:
     std::shared_ptr<C2StreamProfileLevelInfo::input> mProfileLevel;
     std::shared_ptr<C2StreamPictureSizeInfo::output> mSize;
@@ -308,19 +311,6 @@ private:
     std::shared_ptr<C2StreamPixelFormatInfo::output> mPixelFormat;
 };
 
-static size_t getCpuCoreCount() {
-    long cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
-    return (size_t)cpuCoreCount;
-}
-
 static void *ivd_aligned_malloc(void *ctxt, WORD32 alignment, WORD32 size) {
     (void) ctxt;
     return memalign(alignment, size);
@@ -510,7 +500,14 @@ void C2SoftAvcDec::getVersion() {
 
 status_t C2SoftAvcDec::initDecoder() {
     if (OK != createDecoder()) return UNKNOWN_ERROR;
-    mNumCores = MIN(getCpuCoreCount(), MAX_NUM_CORES);
+    {
+        IntfImpl::Lock lock = mIntf->lock();
+        // The decoder does not support changing the number of cores once decoding has
+        // started, and the stream may grow up to the maximum supported size, so use all the
+        // cores up to MAX_NUM_CORES unless a count is configured.
+        mNumCores = GetSoftwareThreadCount(mIntf->getSoftwareThreadCount_l(),
+                0 /* width */, 0 /* height */, MAX_NUM_CORES);
+    }
     mStride = ALIGN128(mWidth);
     mSignalledError = false;
     resetPlugin();
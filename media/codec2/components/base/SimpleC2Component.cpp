@@ -24,6 +24,8 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include <C2Config.h>
 #include <C2Debug.h>
 #include <C2PlatformSupport.h>
@@ -587,12 +589,14 @@ void SimpleC2Component::WorkHandler::onMessageReceived(const sp<AMessage> &msg)
         case kWhatStop: {
             int32_t err = thiz->onStop();
             thiz->mOutputBlockPool.reset();
+            thiz->discardOutputs();
             Reply(msg, &err);
             break;
         }
         case kWhatReset: {
             thiz->onReset();
             thiz->mOutputBlockPool.reset();
+            thiz->discardOutputs();
             mRunning = false;
             Reply(msg);
             break;
@@ -600,6 +604,7 @@ void SimpleC2Component::WorkHandler::onMessageReceived(const sp<AMessage> &msg)
         case kWhatRelease: {
             thiz->onRelease();
             thiz->mOutputBlockPool.reset();
+            thiz->discardOutputs();
             mRunning = false;
             Reply(msg);
             break;
@@ -611,6 +616,30 @@ void SimpleC2Component::WorkHandler::onMessageReceived(const sp<AMessage> &msg)
     }
 }
 
+void SimpleC2Component::OutputHandler::setComponent(
+        const std::shared_ptr<SimpleC2Component> &thiz) {
+    mThiz = thiz;
+}
+
+void SimpleC2Component::OutputHandler::onMessageReceived(const sp<AMessage> &msg) {
+    std::shared_ptr<SimpleC2Component> thiz = mThiz.lock();
+    if (!thiz) {
+        ALOGD("component not yet set; msg = %s", msg->debugString().c_str());
+        return;
+    }
+
+    switch (msg->what()) {
+        case kWhatDeliver: {
+            thiz->deliverOutputs();
+            break;
+        }
+        default: {
+            ALOGD("Unrecognized msg: %d", msg->what());
+            break;
+        }
+    }
+}
+
 class SimpleC2Component::BlockingBlockPool : public C2BlockPool {
 public:
     BlockingBlockPool(const std::shared_ptr<C2BlockPool>& base): mBase{base} {}
@@ -676,20 +705,36 @@ SimpleC2Component::SimpleC2Component(
     : mDummyReadView(DummyReadView()),
       mIntf(intf),
       mLooper(new ALooper),
-      mHandler(new WorkHandler) {
+      mHandler(new WorkHandler),
+      mOutputQueueDepth(std::max(
+              property_get_int32("debug.stagefright.c2_output_queue_depth", 0), 0)) {
     mLooper->setName(intf->getName().c_str());
     (void)mLooper->registerHandler(mHandler);
     mLooper->start(false, false, ANDROID_PRIORITY_VIDEO);
+    if (mOutputQueueDepth > 0) {
+        mOutputLooper = new ALooper;
+        mOutputHandler = new OutputHandler;
+        mOutputLooper->setName((intf->getName() + "-output").c_str());
+        (void)mOutputLooper->registerHandler(mOutputHandler);
+        mOutputLooper->start(false, false, ANDROID_PRIORITY_VIDEO);
+    }
 }
 
 SimpleC2Component::~SimpleC2Component() {
     mLooper->unregisterHandler(mHandler->id());
     (void)mLooper->stop();
+    if (mOutputLooper != nullptr) {
+        mOutputLooper->unregisterHandler(mOutputHandler->id());
+        (void)mOutputLooper->stop();
+    }
 }
 
 c2_status_t SimpleC2Component::setListener_vb(
         const std::shared_ptr<C2Component::Listener> &listener, c2_blocking_t mayBlock) {
     mHandler->setComponent(shared_from_this());
+    if (mOutputHandler != nullptr) {
+        mOutputHandler->setComponent(shared_from_this());
+    }
 
     Mutexed<ExecState>::Locked state(mExecState);
     if (state->mState == RUNNING) {
@@ -741,6 +786,7 @@ c2_status_t SimpleC2Component::flush_sm(
             return C2_BAD_STATE;
         }
     }
+    size_t numFlushedBefore = flushedWork->size();
     {
         Mutexed<WorkQueue>::Locked queue(mWorkQueue);
         queue->incGeneration();
@@ -756,6 +802,29 @@ c2_status_t SimpleC2Component::flush_sm(
             queue->pending().erase(queue->pending().begin());
         }
     }
+    if (mOutputQueueDepth > 0) {
+        // Work that has not reached the listener yet is returned as flushed,
+        // ahead of the queued work that came after it.
+        std::list<std::unique_ptr<C2Work>> undelivered;
+        Mutexed<OutputQueue>::Locked outputs(mOutputQueue);
+        for (auto it = outputs->mEntries.begin(); it != outputs->mEntries.end(); ) {
+            if (it->error != C2_OK) {
+                ++it;
+                continue;
+            }
+            undelivered.splice(undelivered.end(), it->work);
+            it = outputs->mEntries.erase(it);
+        }
+        flushedWork->splice(
+                std::next(flushedWork->begin(), numFlushedBefore), undelivered);
+        outputs->mCondition.broadcast();
+        // Like stop, reset and release, wait for the callback in progress, so
+        // that the client does not get the flushed work while the listener is
+        // still returning earlier work.
+        while (outputs->mDelivering) {
+            outputs.waitForCondition(outputs->mCondition);
+        }
+    }
 
     return C2_OK;
 }
@@ -881,8 +950,7 @@ void SimpleC2Component::finish(
     }
     if (work) {
         fillWork(work);
-        std::shared_ptr<C2Component::Listener> listener = mExecState.lock()->mListener;
-        listener->onWorkDone_nb(shared_from_this(), vec(work));
+        sendWorkDone(vec(work));
         ALOGV("returning pending work");
     }
 }
@@ -907,8 +975,7 @@ void SimpleC2Component::cloneAndSend(
     work->worklets.emplace_back(new C2Worklet);
     if (work) {
         fillWork(work);
-        std::shared_ptr<C2Component::Listener> listener = mExecState.lock()->mListener;
-        listener->onWorkDone_nb(shared_from_this(), vec(work));
+        sendWorkDone(vec(work));
         ALOGV("cloned and sending work");
     }
 }
@@ -979,10 +1046,7 @@ bool SimpleC2Component::processQueue() {
             return err;
         }();
         if (err != C2_OK) {
-            Mutexed<ExecState>::Locked state(mExecState);
-            std::shared_ptr<C2Component::Listener> listener = state->mListener;
-            state.unlock();
-            listener->onError_nb(shared_from_this(), err);
+            sendError(err);
             return hasQueuedWork;
         }
     }
@@ -990,10 +1054,7 @@ bool SimpleC2Component::processQueue() {
     if (!work) {
         c2_status_t err = drain(drainMode, mOutputBlockPool);
         if (err != C2_OK) {
-            Mutexed<ExecState>::Locked state(mExecState);
-            std::shared_ptr<C2Component::Listener> listener = state->mListener;
-            state.unlock();
-            listener->onError_nb(shared_from_this(), err);
+            sendError(err);
         }
         return hasQueuedWork;
     }
@@ -1029,19 +1090,13 @@ bool SimpleC2Component::processQueue() {
         work->result = C2_NOT_FOUND;
         queue.unlock();
 
-        Mutexed<ExecState>::Locked state(mExecState);
-        std::shared_ptr<C2Component::Listener> listener = state->mListener;
-        state.unlock();
-        listener->onWorkDone_nb(shared_from_this(), vec(work));
+        sendWorkDone(vec(work));
         return hasQueuedWork;
     }
     if (work->workletsProcessed != 0u) {
         queue.unlock();
-        Mutexed<ExecState>::Locked state(mExecState);
         ALOGV("returning this work");
-        std::shared_ptr<C2Component::Listener> listener = state->mListener;
-        state.unlock();
-        listener->onWorkDone_nb(shared_from_this(), vec(work));
+        sendWorkDone(vec(work));
     } else {
         ALOGV("queue pending work");
         work->input.buffers.clear();
@@ -1058,15 +1113,86 @@ bool SimpleC2Component::processQueue() {
         if (unexpected) {
             ALOGD("unexpected pending work");
             unexpected->result = C2_CORRUPTED;
-            Mutexed<ExecState>::Locked state(mExecState);
-            std::shared_ptr<C2Component::Listener> listener = state->mListener;
-            state.unlock();
-            listener->onWorkDone_nb(shared_from_this(), vec(unexpected));
+            sendWorkDone(vec(unexpected));
         }
     }
     return hasQueuedWork;
 }
 
+void SimpleC2Component::sendWorkDone(std::list<std::unique_ptr<C2Work>> work) {
+    if (mOutputQueueDepth == 0) {
+        std::shared_ptr<C2Component::Listener> listener = mExecState.lock()->mListener;
+        listener->onWorkDone_nb(shared_from_this(), std::move(work));
+        return;
+    }
+    queueOutput({ std::move(work), C2_OK });
+}
+
+void SimpleC2Component::sendError(c2_status_t err) {
+    if (mOutputQueueDepth == 0) {
+        std::shared_ptr<C2Component::Listener> listener = mExecState.lock()->mListener;
+        listener->onError_nb(shared_from_this(), err);
+        return;
+    }
+    queueOutput({ {}, err });
+}
+
+void SimpleC2Component::queueOutput(OutputQueue::Entry entry) {
+    Mutexed<OutputQueue>::Locked outputs(mOutputQueue);
+    // Block the work thread while the listener is behind, so that the number
+    // of outputs held by the component stays bounded.
+    while (outputs->mEntries.size() >= mOutputQueueDepth) {
+        outputs.waitForCondition(outputs->mCondition);
+    }
+    bool queueWasEmpty = outputs->mEntries.empty();
+    outputs->mEntries.push_back(std::move(entry));
+    outputs.unlock();
+    if (queueWasEmpty) {
+        (new AMessage(OutputHandler::kWhatDeliver, mOutputHandler))->post();
+    }
+}
+
+void SimpleC2Component::deliverOutputs() {
+    while (true) {
+        OutputQueue::Entry entry;
+        {
+            Mutexed<OutputQueue>::Locked outputs(mOutputQueue);
+            if (outputs->mEntries.empty()) {
+                return;
+            }
+            entry = std::move(outputs->mEntries.front());
+            outputs->mEntries.pop_front();
+            outputs->mDelivering = true;
+            outputs->mCondition.broadcast();
+        }
+        std::shared_ptr<C2Component::Listener> listener = mExecState.lock()->mListener;
+        if (entry.error != C2_OK) {
+            listener->onError_nb(shared_from_this(), entry.error);
+        } else {
+            listener->onWorkDone_nb(shared_from_this(), std::move(entry.work));
+        }
+        {
+            Mutexed<OutputQueue>::Locked outputs(mOutputQueue);
+            outputs->mDelivering = false;
+            outputs->mCondition.broadcast();
+        }
+    }
+}
+
+void SimpleC2Component::discardOutputs() {
+    if (mOutputQueueDepth == 0) {
+        return;
+    }
+    Mutexed<OutputQueue>::Locked outputs(mOutputQueue);
+    if (!outputs->mEntries.empty()) {
+        ALOGD("discarding %zu undelivered outputs", outputs->mEntries.size());
+        outputs->mEntries.clear();
+    }
+    while (outputs->mDelivering) {
+        outputs.waitForCondition(outputs->mCondition);
+    }
+}
+
 int SimpleC2Component::getHalPixelFormatForBitDepth10(bool allowRGBA1010102) {
     // Save supported hal pixel formats for bit depth of 10, the first time this is called
     if (!mBitDepth10HalPixelFormats.size()) {
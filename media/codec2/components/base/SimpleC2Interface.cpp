@@ -18,6 +18,10 @@
 #define LOG_TAG "SimpleC2Interface"
 #include <utils/Log.h>
 
+#include <unistd.h>
+
+#include <algorithm>
+
 // use MediaDefs here vs. MediaCodecConstants as this is not MediaCodec specific/dependent
 #include <media/stagefright/foundation/MediaDefs.h>
 
@@ -26,6 +30,17 @@
 
 namespace android {
 
+namespace {
+
+// Upper bound of C2SoftwareThreadCountTuning.
+constexpr uint32_t kMaxSoftwareThreadCount = 64;
+
+// Number of pixels per thread when the thread count is chosen automatically, about half of a
+// 360p picture. With less work per thread, synchronization costs more than threading gains.
+constexpr uint64_t kMinPixelsPerThread = 320 * 360;
+
+}  // namespace
+
 /* SimpleInterface */
 
 static C2R SubscribedParamIndicesSetter(
@@ -319,6 +334,35 @@ void SimpleInterface<void>::BaseParams::noTimeStretch() {
             .build());
 }
 
+void SimpleInterface<void>::BaseParams::addSoftwareThreadCount() {
+    addParameter(
+            DefineParam(mSoftwareThreadCount, C2_PARAMKEY_SOFTWARE_THREAD_COUNT)
+            .withDefault(new C2SoftwareThreadCountTuning(0u))
+            .withFields({C2F(mSoftwareThreadCount, value).inRange(0, kMaxSoftwareThreadCount)})
+            .withSetter(Setter<decltype(*mSoftwareThreadCount)>::NonStrictValueWithNoDeps)
+            .build());
+}
+
+uint32_t GetSoftwareThreadCount(
+        uint32_t requested, uint32_t width, uint32_t height, uint32_t maxThreads) {
+    if (requested > 0) {
+        return maxThreads > 0 ? std::min(requested, maxThreads) : requested;
+    }
+    long cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t limit = (uint32_t)std::max(cpuCoreCount, 1L);
+    if (maxThreads > 0) {
+        limit = std::min(limit, maxThreads);
+    }
+    uint32_t threads = limit;
+    if (width > 0 && height > 0) {
+        uint64_t pixels = (uint64_t)width * height;
+        threads = (uint32_t)std::clamp<uint64_t>(
+                (pixels + kMinPixelsPerThread - 1) / kMinPixelsPerThread, 1, limit);
+    }
+    ALOGV("using %u threads for %ux%u (limit %u)", threads, width, height, limit);
+    return threads;
+}
+
 /*
     Clients need to handle the following base params due to custom dependency.
 
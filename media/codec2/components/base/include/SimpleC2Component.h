@@ -92,6 +92,9 @@ public:
     // for handler
     bool processQueue();
 
+    // for output handler
+    void deliverOutputs();
+
 protected:
     /**
      * Initialize internal states of the component according to the config set
@@ -217,6 +220,29 @@ private:
         bool mRunning;
     };
 
+    /**
+     * Returns finished work and errors to the listener on a separate thread,
+     * so that the work thread can move on to the next input while the
+     * listener is called.
+     */
+    class OutputHandler : public AHandler {
+    public:
+        enum {
+            kWhatDeliver,
+        };
+
+        OutputHandler() = default;
+        ~OutputHandler() override = default;
+
+        void setComponent(const std::shared_ptr<SimpleC2Component> &thiz);
+
+    protected:
+        void onMessageReceived(const sp<AMessage> &msg) override;
+
+    private:
+        std::weak_ptr<SimpleC2Component> mThiz;
+    };
+
     enum {
         UNINITIALIZED,
         STOPPED,
@@ -269,6 +295,31 @@ private:
     };
     Mutexed<WorkQueue> mWorkQueue;
 
+    struct OutputQueue {
+        struct Entry {
+            std::list<std::unique_ptr<C2Work>> work;
+            c2_status_t error = C2_OK;
+        };
+
+        OutputQueue() : mDelivering(false) {}
+
+        std::list<Entry> mEntries;
+        bool mDelivering;
+        // signaled when an entry is taken or a delivery completes
+        Condition mCondition;
+    };
+    // maximum number of outputs waiting for delivery; 0 if outputs are
+    // returned to the listener synchronously from the work thread.
+    size_t mOutputQueueDepth;
+    Mutexed<OutputQueue> mOutputQueue;
+    sp<ALooper> mOutputLooper;
+    sp<OutputHandler> mOutputHandler;
+
+    void sendWorkDone(std::list<std::unique_ptr<C2Work>> work);
+    void sendError(c2_status_t err);
+    void queueOutput(OutputQueue::Entry entry);
+    void discardOutputs();
+
     class BlockingBlockPool;
     std::shared_ptr<BlockingBlockPool> mOutputBlockPool;
 
@@ -23,6 +23,36 @@
 
 namespace android {
 
+enum ExtendedC2ParamIndexKind : C2Param::type_index_t {
+    kParamIndexSoftwareThreadCount = C2Param::TYPE_INDEX_VENDOR_START,
+};
+
+/**
+ * Number of threads a software codec uses for decoding, or 0 to let the codec choose based on
+ * the picture size and the number of CPU cores.
+ *
+ * Exposed to MediaCodec clients as "vendor.sw-thread-count.value".
+ */
+typedef C2GlobalParam<C2Tuning, C2Uint32Value, kParamIndexSoftwareThreadCount>
+        C2SoftwareThreadCountTuning;
+constexpr char C2_PARAMKEY_SOFTWARE_THREAD_COUNT[] = "sw-thread-count";
+
+/**
+ * Returns the number of threads for a software codec to use on pictures of the given size.
+ *
+ * \param requested  the configured C2SoftwareThreadCountTuning value; if non-zero, it is used
+ *                   as is, up to |maxThreads|
+ * \param width      picture width, or 0 if the largest picture size is not known when the
+ *                   threads are started; a thread is then used per online CPU core
+ * \param height     picture height, or 0 if not known
+ * \param maxThreads the maximum number of threads the codec library supports, or 0 if it has
+ *                   no limit
+ * \return |requested| if non-zero, capped at |maxThreads|; otherwise a value between 1 and the
+ *         smaller of |maxThreads| and the number of online CPU cores
+ */
+uint32_t GetSoftwareThreadCount(
+        uint32_t requested, uint32_t width, uint32_t height, uint32_t maxThreads);
+
 /**
  * Wrap a common interface object (such as Codec2Client::Interface, or C2InterfaceHelper into
  * a C2ComponentInterface.
@@ -123,6 +153,10 @@ public:
         /// must add support for C2ComponentTimeStretchTuning.
         void noTimeStretch();
 
+        /// Adds support for C2SoftwareThreadCountTuning, for components that can decode with
+        /// multiple threads. See GetSoftwareThreadCount().
+        void addSoftwareThreadCount();
+
         std::shared_ptr<C2ApiLevelSetting> mApiLevel;
         std::shared_ptr<C2ApiFeaturesSetting> mApiFeatures;
 
@@ -178,6 +212,8 @@ public:
         std::shared_ptr<C2PortConfigCounterTuning::input> mInputConfigCounter;
         std::shared_ptr<C2PortConfigCounterTuning::output> mOutputConfigCounter;
         std::shared_ptr<C2ConfigCounterTuning> mDirectConfigCounter;
+
+        std::shared_ptr<C2SoftwareThreadCountTuning> mSoftwareThreadCount;
     };
 };
 
@@ -55,6 +55,7 @@ class C2SoftGav1Dec::IntfImpl : public SimpleInterface<void>::BaseParams {
     noOutputReferences();
     noInputLatency();
     noTimeStretch();
+    addSoftwareThreadCount();
 
     addParameter(DefineParam(mAttrib, C2_PARAMKEY_COMPONENT_ATTRIBUTES)
                      .withConstValue(new C2ComponentAttributesSetting(
@@ -362,6 +363,7 @@ class C2SoftGav1Dec::IntfImpl : public SimpleInterface<void>::BaseParams {
 
   // unsafe getters
   std::shared_ptr<C2StreamPixelFormatInfo::output> getPixelFormat_l() const { return mPixelFormat; }
+  uint32_t getSoftwareThreadCount_l() const { return mSoftwareThreadCount->value; }
 
   static C2R HdrStaticInfoSetter(bool mayBlock, C2P<C2StreamHdrStaticInfo::output> &me) {
     (void)mayBlock;
@@ -476,26 +478,17 @@ c2_status_t C2SoftGav1Dec::onFlush_sm() {
   return C2_OK;
 }
 
-static int GetCPUCoreCount() {
-  int cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-  cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-  // _SC_NPROC_ONLN must be defined...
-  cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-  CHECK(cpuCoreCount >= 1);
-  ALOGV("Number of CPU cores: %d", cpuCoreCount);
-  return cpuCoreCount;
-}
-
 bool C2SoftGav1Dec::initDecoder() {
   mSignalledError = false;
   mSignalledOutputEos = false;
   mHalPixelFormat = HAL_PIXEL_FORMAT_YV12;
+  uint32_t threads = 1;
   {
       IntfImpl::Lock lock = mIntf->lock();
       mPixelFormatInfo = mIntf->getPixelFormat_l();
+      threads = GetSoftwareThreadCount(
+          mIntf->getSoftwareThreadCount_l(),
+          0 /* width */, 0 /* height */, 0 /* maxThreads */);
   }
   mCodecCtx.reset(new libgav1::Decoder());
 
@@ -505,7 +498,7 @@ bool C2SoftGav1Dec::initDecoder() {
   }
 
   libgav1::DecoderSettings settings = {};
-  settings.threads = GetCPUCoreCount();
+  settings.threads = threads;
 
   ALOGV("Using libgav1 AV1 software decoder.");
   Libgav1StatusCode status = mCodecCtx->Init(&settings);
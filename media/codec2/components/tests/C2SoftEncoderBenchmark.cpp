@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2SoftEncoderBenchmark"
+#include <log/log.h>
+
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include <android-base/properties.h>
+#include <benchmark/benchmark.h>
+
+#include <C2Component.h>
+#include <C2ComponentFactory.h>
+#include <C2Config.h>
+#include <C2PlatformSupport.h>
+#include <system/graphics.h>
+
+using namespace android;
+using namespace std::chrono_literals;
+
+extern "C" ::C2ComponentFactory* CreateCodec2Factory();
+extern "C" void DestroyCodec2Factory(::C2ComponentFactory* factory);
+
+// Number of frames encoded per iteration.
+constexpr uint64_t kNumFrames = 480;
+// Maximum number of work items queued to the component at a time.
+constexpr size_t kMaxWorkInFlight = 16;
+constexpr std::chrono::seconds kTimeOut = 10s;
+
+constexpr uint32_t kVideoWidth = 320;
+constexpr uint32_t kVideoHeight = 240;
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kChannelCount = 2;
+constexpr uint32_t kSamplesPerFrame = 1024;
+
+/**
+ * Collects the finished work of an encoder, and optionally spends the given
+ * time in every callback to stand in for the marshalling done by the HAL
+ * service.
+ */
+class EncoderListener : public C2Component::Listener {
+ public:
+  explicit EncoderListener(std::chrono::microseconds callbackCost)
+      : mCallbackCost(callbackCost) {}
+
+  void onWorkDone_nb(std::weak_ptr<C2Component> comp,
+                     std::list<std::unique_ptr<C2Work>> workItems) override {
+    (void)comp;
+    if (mCallbackCost.count() > 0) {
+      // busy wait, as marshalling keeps the calling thread running
+      auto end = std::chrono::steady_clock::now() + mCallbackCost;
+      while (std::chrono::steady_clock::now() < end) {
+      }
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    for (const std::unique_ptr<C2Work>& work : workItems) {
+      if (work->result != C2_OK) {
+        mError = true;
+      }
+      if (work->worklets.empty() ||
+          (work->worklets.front()->output.flags & C2FrameData::FLAG_INCOMPLETE) == 0) {
+        --mNumInFlight;
+      }
+      if (!work->worklets.empty() &&
+          (work->worklets.front()->output.flags & C2FrameData::FLAG_END_OF_STREAM)) {
+        mEos = true;
+      }
+    }
+    mCondition.notify_all();
+  }
+
+  void onTripped_nb(std::weak_ptr<C2Component> comp,
+                    std::vector<std::shared_ptr<C2SettingResult>> settingResults) override {
+    (void)comp;
+    (void)settingResults;
+  }
+
+  void onError_nb(std::weak_ptr<C2Component> comp, uint32_t errorCode) override {
+    (void)comp;
+    ALOGE("component error %u", errorCode);
+    std::lock_guard<std::mutex> lock(mLock);
+    mError = true;
+    mCondition.notify_all();
+  }
+
+  // Waits until a work item can be queued; returns false on error or time out.
+  bool waitToQueue() {
+    std::unique_lock<std::mutex> lock(mLock);
+    if (!mCondition.wait_for(lock, kTimeOut,
+                             [this] { return mError || mNumInFlight < kMaxWorkInFlight; })) {
+      return false;
+    }
+    ++mNumInFlight;
+    return !mError;
+  }
+
+  // Waits for the end of stream; returns false on error or time out.
+  bool waitForEos() {
+    std::unique_lock<std::mutex> lock(mLock);
+    return mCondition.wait_for(lock, kTimeOut, [this] { return mError || mEos; }) && !mError;
+  }
+
+ private:
+  const std::chrono::microseconds mCallbackCost;
+  std::mutex mLock;
+  std::condition_variable mCondition;
+  size_t mNumInFlight = 0;
+  bool mEos = false;
+  bool mError = false;
+};
+
+// Creates the input buffer of the given domain with the configured frame size.
+static std::shared_ptr<C2Buffer> CreateInputBuffer(
+    C2Component::domain_t domain, const std::shared_ptr<C2BlockPool>& pool, uint64_t frameIndex) {
+  C2MemoryUsage usage = {C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE};
+  if (domain == C2Component::DOMAIN_VIDEO) {
+    std::shared_ptr<C2GraphicBlock> block;
+    if (pool->fetchGraphicBlock(kVideoWidth, kVideoHeight, HAL_PIXEL_FORMAT_YCBCR_420_888,
+                                usage, &block) != C2_OK) {
+      return nullptr;
+    }
+    return C2Buffer::CreateGraphicBuffer(
+        block->share(C2Rect(kVideoWidth, kVideoHeight), C2Fence()));
+  }
+  const size_t size = kSamplesPerFrame * kChannelCount * sizeof(int16_t);
+  std::shared_ptr<C2LinearBlock> block;
+  if (pool->fetchLinearBlock(size, usage, &block) != C2_OK) {
+    return nullptr;
+  }
+  C2WriteView view = block->map().get();
+  if (view.error() != C2_OK) {
+    return nullptr;
+  }
+  memset(view.base(), frameIndex & 0xFF, size);
+  return C2Buffer::CreateLinearBuffer(block->share(0, size, C2Fence()));
+}
+
+// Configures a stopped encoder for the input used by this benchmark.
+static c2_status_t ConfigureEncoder(const std::shared_ptr<C2Component>& component,
+                                    C2Component::domain_t domain) {
+  C2StreamPictureSizeInfo::input size(0u, kVideoWidth, kVideoHeight);
+  C2StreamFrameRateInfo::output frameRate(0u, 240.);
+  C2StreamSampleRateInfo::input sampleRate(0u, kSampleRate);
+  C2StreamChannelCountInfo::input channelCount(0u, kChannelCount);
+  std::vector<C2Param*> params;
+  if (domain == C2Component::DOMAIN_VIDEO) {
+    params = {&size, &frameRate};
+  } else {
+    params = {&sampleRate, &channelCount};
+  }
+  std::vector<std::unique_ptr<C2SettingResult>> failures;
+  return component->intf()->config_vb(params, C2_MAY_BLOCK, &failures);
+}
+
+// Queues kNumFrames frames and EOS, and waits for the encoder to return EOS.
+static bool EncodeFrames(const std::shared_ptr<C2Component>& component,
+                         const std::shared_ptr<EncoderListener>& listener,
+                         C2Component::domain_t domain,
+                         const std::shared_ptr<C2BlockPool>& pool) {
+  const uint64_t frameDurationUs = domain == C2Component::DOMAIN_VIDEO
+      ? 1000000ull / 240 : 1000000ull * kSamplesPerFrame / kSampleRate;
+  for (uint64_t frameIndex = 0; frameIndex <= kNumFrames; ++frameIndex) {
+    if (!listener->waitToQueue()) {
+      return false;
+    }
+    std::unique_ptr<C2Work> work(new C2Work);
+    work->input.ordinal.frameIndex = frameIndex;
+    work->input.ordinal.timestamp = frameIndex * frameDurationUs;
+    if (frameIndex == kNumFrames) {
+      work->input.flags = C2FrameData::FLAG_END_OF_STREAM;
+    } else {
+      work->input.flags = (C2FrameData::flags_t)0;
+      std::shared_ptr<C2Buffer> buffer = CreateInputBuffer(domain, pool, frameIndex);
+      if (!buffer) {
+        return false;
+      }
+      work->input.buffers.push_back(buffer);
+    }
+    work->worklets.emplace_back(new C2Worklet);
+    std::list<std::unique_ptr<C2Work>> items;
+    items.push_back(std::move(work));
+    if (component->queue_nb(&items) != C2_OK) {
+      return false;
+    }
+  }
+  return listener->waitForEos();
+}
+
+/*******************************************************************
+ * Encodes frames with the component of this binary, with the given output
+ * queue depth of SimpleC2Component (0: outputs are returned from the work
+ * thread) and the given cost of every listener callback in microseconds.
+ * Reports the number of frames encoded per second.
+ *******************************************************************/
+static void BM_Encode(benchmark::State& state) {
+  const int64_t outputQueueDepth = state.range(0);
+  const std::chrono::microseconds callbackCost(state.range(1));
+  if (!base::SetProperty("debug.stagefright.c2_output_queue_depth",
+                         std::to_string(outputQueueDepth))) {
+    state.SkipWithError("cannot set the output queue depth");
+    return;
+  }
+
+  ::C2ComponentFactory* factory = CreateCodec2Factory();
+  if (!factory) {
+    state.SkipWithError("cannot create the component factory");
+    return;
+  }
+  std::shared_ptr<C2ComponentInterface> intf;
+  C2ComponentDomainSetting domain;
+  if (factory->createInterface(0, &intf, std::default_delete<C2ComponentInterface>()) != C2_OK ||
+      intf->query_vb({&domain}, {}, C2_MAY_BLOCK, nullptr) != C2_OK) {
+    DestroyCodec2Factory(factory);
+    state.SkipWithError("cannot query the component domain");
+    return;
+  }
+  std::shared_ptr<C2BlockPool> pool;
+  if (GetCodec2BlockPool(domain.value == C2Component::DOMAIN_VIDEO
+                                 ? C2BlockPool::BASIC_GRAPHIC : C2BlockPool::BASIC_LINEAR,
+                         nullptr, &pool) != C2_OK) {
+    DestroyCodec2Factory(factory);
+    state.SkipWithError("cannot get the input block pool");
+    return;
+  }
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::shared_ptr<C2Component> component;
+    std::shared_ptr<EncoderListener> listener = std::make_shared<EncoderListener>(callbackCost);
+    if (factory->createComponent(0, &component, std::default_delete<C2Component>()) != C2_OK ||
+        component->setListener_vb(listener, C2_MAY_BLOCK) != C2_OK ||
+        ConfigureEncoder(component, domain.value) != C2_OK ||
+        component->start() != C2_OK) {
+      state.SkipWithError("cannot start the encoder");
+      break;
+    }
+    state.ResumeTiming();
+
+    bool success = EncodeFrames(component, listener, domain.value, pool);
+
+    state.PauseTiming();
+    component->stop();
+    component->reset();
+    component->release();
+    component.reset();
+    state.ResumeTiming();
+    if (!success) {
+      state.SkipWithError("encoding failed");
+      break;
+    }
+  }
+  state.counters["frames_per_sec"] = benchmark::Counter(
+      state.iterations() * kNumFrames, benchmark::Counter::kIsRate);
+
+  DestroyCodec2Factory(factory);
+  base::SetProperty("debug.stagefright.c2_output_queue_depth", "");
+}
+
+static void EncodeArgs(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"outputQueueDepth", "callbackCostUs"});
+  for (int64_t outputQueueDepth : {0, 4}) {
+    for (int64_t callbackCostUs : {0, 200, 1000}) {
+      b->Args({outputQueueDepth, callbackCostUs});
+    }
+  }
+}
+
+BENCHMARK(BM_Encode)->Apply(EncodeArgs)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
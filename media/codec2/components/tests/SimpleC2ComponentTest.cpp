@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SimpleC2ComponentTest"
+#include <log/log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include <android-base/properties.h>
+#include <gtest/gtest.h>
+
+#include <SimpleC2Component.h>
+
+using namespace android;
+using namespace std::chrono_literals;
+
+constexpr std::chrono::seconds kTimeOut = 5s;
+
+// An interface without parameters, enough for SimpleC2Component to run.
+class NullInterface : public C2ComponentInterface {
+ public:
+  C2String getName() const override { return "c2.android.test.null"; }
+  c2_node_id_t getId() const override { return 0; }
+  c2_status_t query_vb(const std::vector<C2Param*>& stackParams,
+                       const std::vector<C2Param::Index>& heapParamIndices,
+                       c2_blocking_t mayBlock,
+                       std::vector<std::unique_ptr<C2Param>>* const heapParams) const override {
+    (void)stackParams;
+    (void)heapParamIndices;
+    (void)mayBlock;
+    (void)heapParams;
+    return C2_BAD_INDEX;
+  }
+  c2_status_t config_vb(const std::vector<C2Param*>& params, c2_blocking_t mayBlock,
+                        std::vector<std::unique_ptr<C2SettingResult>>* const failures) override {
+    (void)params;
+    (void)mayBlock;
+    (void)failures;
+    return C2_BAD_INDEX;
+  }
+  c2_status_t createTunnel_sm(c2_node_id_t targetComponent) override {
+    (void)targetComponent;
+    return C2_OMITTED;
+  }
+  c2_status_t releaseTunnel_sm(c2_node_id_t targetComponent) override {
+    (void)targetComponent;
+    return C2_OMITTED;
+  }
+  c2_status_t querySupportedParams_nb(
+      std::vector<std::shared_ptr<C2ParamDescriptor>>* const params) const override {
+    (void)params;
+    return C2_OK;
+  }
+  c2_status_t querySupportedValues_vb(std::vector<C2FieldSupportedValuesQuery>& fields,
+                                      c2_blocking_t mayBlock) const override {
+    (void)fields;
+    (void)mayBlock;
+    return C2_OK;
+  }
+};
+
+// Finishes every work item as soon as it is processed, without output buffers.
+class PassThroughComponent : public SimpleC2Component {
+ public:
+  PassThroughComponent() : SimpleC2Component(std::make_shared<NullInterface>()) {}
+
+ protected:
+  c2_status_t onInit() override { return C2_OK; }
+  c2_status_t onStop() override { return C2_OK; }
+  void onReset() override {}
+  void onRelease() override {}
+  c2_status_t onFlush_sm() override { return C2_OK; }
+
+  void process(const std::unique_ptr<C2Work>& work,
+               const std::shared_ptr<C2BlockPool>& pool) override {
+    (void)pool;
+    work->result = C2_OK;
+    work->workletsProcessed = 1u;
+    work->worklets.front()->output.flags = work->input.flags;
+    work->worklets.front()->output.ordinal = work->input.ordinal;
+  }
+
+  c2_status_t drain(uint32_t drainMode, const std::shared_ptr<C2BlockPool>& pool) override {
+    (void)drainMode;
+    (void)pool;
+    return C2_OK;
+  }
+};
+
+// Records the frame indices of the returned work. The callback for the first
+// work item is held until release() is called.
+class HoldingListener : public C2Component::Listener {
+ public:
+  void onWorkDone_nb(std::weak_ptr<C2Component> comp,
+                     std::list<std::unique_ptr<C2Work>> workItems) override {
+    (void)comp;
+    std::unique_lock<std::mutex> lock(mLock);
+    if (!mHeld) {
+      mHeld = true;
+      mCondition.notify_all();
+      mCondition.wait(lock, [this] { return mReleased; });
+    }
+    for (const std::unique_ptr<C2Work>& work : workItems) {
+      mDelivered.push_back(work->input.ordinal.frameIndex.peeku());
+    }
+    mCondition.notify_all();
+  }
+
+  void onTripped_nb(std::weak_ptr<C2Component> comp,
+                    std::vector<std::shared_ptr<C2SettingResult>> settingResults) override {
+    (void)comp;
+    (void)settingResults;
+  }
+
+  void onError_nb(std::weak_ptr<C2Component> comp, uint32_t errorCode) override {
+    (void)comp;
+    ALOGE("component error %u", errorCode);
+  }
+
+  bool waitUntilHeld() {
+    std::unique_lock<std::mutex> lock(mLock);
+    return mCondition.wait_for(lock, kTimeOut, [this] { return mHeld; });
+  }
+
+  void release() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mReleased = true;
+    mCondition.notify_all();
+  }
+
+  // Waits until |count| work items have been delivered, or the time out.
+  std::vector<uint64_t> waitForDelivered(size_t count) {
+    std::unique_lock<std::mutex> lock(mLock);
+    mCondition.wait_for(lock, kTimeOut, [this, count] { return mDelivered.size() >= count; });
+    return mDelivered;
+  }
+
+  std::vector<uint64_t> delivered() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mDelivered;
+  }
+
+ private:
+  std::mutex mLock;
+  std::condition_variable mCondition;
+  bool mHeld = false;
+  bool mReleased = false;
+  std::vector<uint64_t> mDelivered;
+};
+
+class SimpleC2ComponentTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    ASSERT_TRUE(base::SetProperty("debug.stagefright.c2_output_queue_depth", "4"));
+    mComponent = std::make_shared<PassThroughComponent>();
+    mListener = std::make_shared<HoldingListener>();
+    ASSERT_EQ(C2_OK, mComponent->setListener_vb(mListener, C2_MAY_BLOCK));
+    ASSERT_EQ(C2_OK, mComponent->start());
+  }
+
+  void TearDown() override {
+    if (mListener) {
+      mListener->release();
+    }
+    if (mComponent) {
+      mComponent->release();
+    }
+    base::SetProperty("debug.stagefright.c2_output_queue_depth", "");
+  }
+
+  void queueWork(uint64_t firstIndex, size_t count) {
+    std::list<std::unique_ptr<C2Work>> items;
+    for (size_t i = 0; i < count; ++i) {
+      std::unique_ptr<C2Work> work(new C2Work);
+      work->input.ordinal.frameIndex = firstIndex + i;
+      work->worklets.emplace_back(new C2Worklet);
+      items.push_back(std::move(work));
+    }
+    ASSERT_EQ(C2_OK, mComponent->queue_nb(&items));
+  }
+
+ protected:
+  std::shared_ptr<PassThroughComponent> mComponent;
+  std::shared_ptr<HoldingListener> mListener;
+};
+
+// flush_sm() returns the work that has not reached the listener, and does not
+// return before the callback in progress has completed. Every work item is
+// returned once, either to the listener or as flushed, in the queued order.
+TEST_F(SimpleC2ComponentTest, FlushWaitsForDeliveryInProgress) {
+  constexpr size_t kNumWork = 5;
+  ASSERT_NO_FATAL_FAILURE(queueWork(0u, kNumWork));
+  ASSERT_TRUE(mListener->waitUntilHeld());
+
+  std::list<std::unique_ptr<C2Work>> flushedWork;
+  std::future<c2_status_t> flushed = std::async(std::launch::async, [this, &flushedWork] {
+    return mComponent->flush_sm(C2Component::FLUSH_COMPONENT, &flushedWork);
+  });
+  EXPECT_EQ(std::future_status::timeout, flushed.wait_for(200ms));
+  EXPECT_TRUE(mListener->delivered().empty());
+
+  mListener->release();
+  ASSERT_EQ(std::future_status::ready, flushed.wait_for(kTimeOut));
+  ASSERT_EQ(C2_OK, flushed.get());
+
+  // The held work reached the listener before flush_sm() returned.
+  std::vector<uint64_t> delivered = mListener->delivered();
+  ASSERT_FALSE(delivered.empty());
+  EXPECT_EQ(0u, delivered.front());
+
+  std::vector<uint64_t> flushedIndices;
+  for (const std::unique_ptr<C2Work>& work : flushedWork) {
+    flushedIndices.push_back(work->input.ordinal.frameIndex.peeku());
+  }
+  EXPECT_TRUE(std::is_sorted(flushedIndices.begin(), flushedIndices.end()));
+
+  // Work processed while the flush was in progress may still be delivered.
+  delivered = mListener->waitForDelivered(kNumWork - flushedIndices.size());
+  EXPECT_TRUE(std::is_sorted(delivered.begin(), delivered.end()));
+  std::multiset<uint64_t> returned(delivered.begin(), delivered.end());
+  returned.insert(flushedIndices.begin(), flushedIndices.end());
+  EXPECT_EQ((std::multiset<uint64_t>{0, 1, 2, 3, 4}), returned);
+
+  // The component keeps working after the flush.
+  ASSERT_NO_FATAL_FAILURE(queueWork(10u, 2u));
+  delivered = mListener->waitForDelivered(kNumWork - flushedIndices.size() + 2);
+  ASSERT_GE(delivered.size(), 2u);
+  EXPECT_EQ(10u, delivered[delivered.size() - 2]);
+  EXPECT_EQ(11u, delivered.back());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  int status = RUN_ALL_TESTS();
+  ALOGV("Test result = %d\n", status);
+  return status;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SimpleC2InterfaceTest"
+#include <log/log.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include <SimpleC2Interface.h>
+
+using namespace android;
+
+static uint32_t GetCpuCoreCount() {
+    return (uint32_t)std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L);
+}
+
+// A configured thread count is used as is, whatever the picture size and the number of cores.
+TEST(SimpleC2InterfaceTest, SoftwareThreadCountExplicit) {
+    const uint32_t cores = GetCpuCoreCount();
+    EXPECT_EQ(1u, GetSoftwareThreadCount(1, 3840, 2160, 0 /* maxThreads */));
+    EXPECT_EQ(3u, GetSoftwareThreadCount(3, 176, 144, 0 /* maxThreads */));
+    EXPECT_EQ(cores * 2, GetSoftwareThreadCount(cores * 2, 0, 0, 0 /* maxThreads */));
+}
+
+// Without a configured count, a thread is used per 115200 pixels, rounded up.
+TEST(SimpleC2InterfaceTest, SoftwareThreadCountFromPictureSize) {
+    const uint32_t cores = GetCpuCoreCount();
+    EXPECT_EQ(1u, GetSoftwareThreadCount(0, 2, 2, 0 /* maxThreads */));
+    EXPECT_EQ(1u, GetSoftwareThreadCount(0, 320, 360, 0 /* maxThreads */));
+    EXPECT_EQ(std::min(2u, cores), GetSoftwareThreadCount(0, 320, 361, 0 /* maxThreads */));
+    EXPECT_EQ(std::min(3u, cores), GetSoftwareThreadCount(0, 640, 480, 0 /* maxThreads */));
+    EXPECT_EQ(std::min(18u, cores), GetSoftwareThreadCount(0, 1920, 1080, 0 /* maxThreads */));
+}
+
+// Without a configured count, the threads are capped at the number of cores, which is also the
+// count used when the picture size is not known.
+TEST(SimpleC2InterfaceTest, SoftwareThreadCountCoreCap) {
+    const uint32_t cores = GetCpuCoreCount();
+    EXPECT_EQ(cores, GetSoftwareThreadCount(0, 7680, 4320, 0 /* maxThreads */));
+    EXPECT_EQ(cores, GetSoftwareThreadCount(0, 0, 0, 0 /* maxThreads */));
+    EXPECT_EQ(cores, GetSoftwareThreadCount(0, 1920, 0, 0 /* maxThreads */));
+}
+
+// The library limit caps both the configured and the chosen counts.
+TEST(SimpleC2InterfaceTest, SoftwareThreadCountLibraryCap) {
+    const uint32_t cores = GetCpuCoreCount();
+    EXPECT_EQ(4u, GetSoftwareThreadCount(16, 1920, 1080, 4 /* maxThreads */));
+    EXPECT_EQ(3u, GetSoftwareThreadCount(3, 1920, 1080, 4 /* maxThreads */));
+    EXPECT_EQ(std::min(2u, cores), GetSoftwareThreadCount(0, 7680, 4320, 2 /* maxThreads */));
+    EXPECT_EQ(std::min(2u, cores), GetSoftwareThreadCount(0, 0, 0, 2 /* maxThreads */));
+    EXPECT_EQ(1u, GetSoftwareThreadCount(0, 320, 240, 2 /* maxThreads */));
+}
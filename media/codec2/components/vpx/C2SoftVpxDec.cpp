@@ -57,6 +57,7 @@ public:
         noOutputReferences();
         noInputLatency();
         noTimeStretch();
+        addSoftwareThreadCount();
 
         // TODO: output latency and reordering
 
@@ -315,6 +316,7 @@ public:
     std::shared_ptr<C2StreamPixelFormatInfo::output> getPixelFormat_l() const {
         return mPixelFormat;
     }
+    uint32_t getSoftwareThreadCount_l() const { return mSoftwareThreadCount->value; }
 
 private:
     std::shared_ptr<C2StreamProfileLevelInfo::input> mProfileLevel;
@@ -443,9 +445,14 @@ status_t C2SoftVpxDec::initDecoder() {
     mMode = MODE_VP8;
 #endif
     mHalPixelFormat = HAL_PIXEL_FORMAT_YV12;
+    uint32_t threads = 1;
     {
         IntfImpl::Lock lock = mIntf->lock();
         mPixelFormatInfo = mIntf->getPixelFormat_l();
+        // libvpx keeps its thread count for the session, so size it for any picture size.
+        threads = GetSoftwareThreadCount(
+                mIntf->getSoftwareThreadCount_l(),
+                0 /* width */, 0 /* height */, 0 /* maxThreads */);
     }
 
     mWidth = 320;
@@ -464,7 +471,8 @@ status_t C2SoftVpxDec::initDecoder() {
 
     vpx_codec_dec_cfg_t cfg;
     memset(&cfg, 0, sizeof(vpx_codec_dec_cfg_t));
-    cfg.threads = mCoreCount = GetCPUCoreCount();
+    cfg.threads = threads;
+    mCoreCount = GetCPUCoreCount();
 
     vpx_codec_flags_t flags;
     memset(&flags, 0, sizeof(vpx_codec_flags_t));
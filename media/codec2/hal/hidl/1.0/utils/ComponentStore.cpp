@@ -471,6 +471,10 @@ Return<void> ComponentStore::debug(
             }
         }
 
+        // Dump buffer pool statistics.
+        out << indent << "Buffer pools:" << std::endl << std::endl
+                << indent << indent << ClientManager::dumpStatistics() << std::endl;
+
         out << "End of dump -- C2ComponentStore: "
                 << mStore->getName() << std::endl;
     }
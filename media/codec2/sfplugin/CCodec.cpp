@@ -689,6 +689,11 @@ public:
         mCodec->mCallback->onFirstTunnelFrameReady();
     }
 
+    void onWorkPending(nsecs_t delayNs) override {
+        // round up so that the message is not delivered before the deadline
+        (new AMessage(CCodec::kWhatSubmitPendingWork, mCodec))->post((delayNs + 999) / 1000);
+    }
+
 private:
     CCodec *mCodec;
 };
@@ -1945,6 +1950,7 @@ void CCodec::stop(bool pushBlankBuffer) {
             state->set(ALLOCATED);
         }
     }
+    reportCopyStats();
     mCallback->onStopCompleted();
 }
 
@@ -2021,11 +2027,25 @@ void CCodec::release(bool sendCallback, bool pushBlankBuffer) {
         state->comp.reset();
     }
     (new AMessage(kWhatRelease, this))->post();
+    reportCopyStats();
     if (sendCallback) {
         mCallback->onReleaseCompleted();
     }
 }
 
+void CCodec::reportCopyStats() {
+    uint64_t copiedBytes = 0u;
+    uint64_t copiedBytesPerSec = 0u;
+    // release() after stop() has nothing new to report
+    if (!mChannel->takeCopyStats(&copiedBytes, &copiedBytesPerSec)) {
+        return;
+    }
+    sp<AMessage> metrics = new AMessage;
+    metrics->setInt64(kCodecLinearBytesCopied, copiedBytes);
+    metrics->setInt64(kCodecLinearBytesCopiedPerSec, copiedBytesPerSec);
+    mCallback->onMetricsUpdated(metrics);
+}
+
 status_t CCodec::setSurface(const sp<Surface> &surface) {
     bool pushBlankBuffer = false;
     {
@@ -2318,7 +2338,12 @@ status_t CCodec::unsubscribeFromParameters(const std::vector<std::string> &names
 void CCodec::onWorkDone(std::list<std::unique_ptr<C2Work>> &workItems) {
     if (!workItems.empty()) {
         Mutexed<std::list<std::unique_ptr<C2Work>>>::Locked queue(mWorkDoneQueue);
+        bool wasEmpty = queue->empty();
         queue->splice(queue->end(), workItems);
+        if (!wasEmpty) {
+            // The pending kWhatWorkDone message will handle these items.
+            return;
+        }
     }
     (new AMessage(kWhatWorkDone, this))->post();
 }
@@ -2399,131 +2424,33 @@ void CCodec::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
         case kWhatWorkDone: {
-            std::unique_ptr<C2Work> work;
+            // Handle as many work items per message as the channel batches
+            // input work, so that completions are not handled one message at
+            // a time when they arrive in bursts.
+            std::list<std::unique_ptr<C2Work>> workItems;
             bool shouldPost = false;
             {
                 Mutexed<std::list<std::unique_ptr<C2Work>>>::Locked queue(mWorkDoneQueue);
                 if (queue->empty()) {
                     break;
                 }
-                work.swap(queue->front());
-                queue->pop_front();
+                auto end = queue->begin();
+                std::advance(end, std::min(queue->size(), mChannel->getWorkBatchSize()));
+                workItems.splice(workItems.end(), *queue, queue->begin(), end);
                 shouldPost = !queue->empty();
             }
             if (shouldPost) {
                 (new AMessage(kWhatWorkDone, this))->post();
             }
-
-            // handle configuration changes in work done
-            std::shared_ptr<const C2StreamInitDataInfo::output> initData;
-            sp<AMessage> outputFormat = nullptr;
-            {
-                Mutexed<std::unique_ptr<Config>>::Locked configLocked(mConfig);
-                const std::unique_ptr<Config> &config = *configLocked;
-                Config::Watcher<C2StreamInitDataInfo::output> initDataWatcher =
-                    config->watch<C2StreamInitDataInfo::output>();
-                if (!work->worklets.empty()
-                        && (work->worklets.front()->output.flags
-                                & C2FrameData::FLAG_DISCARD_FRAME) == 0) {
-
-                    // copy buffer info to config
-                    std::vector<std::unique_ptr<C2Param>> updates;
-                    for (const std::unique_ptr<C2Param> &param
-                            : work->worklets.front()->output.configUpdate) {
-                        updates.push_back(C2Param::Copy(*param));
-                    }
-                    unsigned stream = 0;
-                    std::vector<std::shared_ptr<C2Buffer>> &outputBuffers =
-                        work->worklets.front()->output.buffers;
-                    for (const std::shared_ptr<C2Buffer> &buf : outputBuffers) {
-                        for (const std::shared_ptr<const C2Info> &info : buf->info()) {
-                            // move all info into output-stream #0 domain
-                            updates.emplace_back(
-                                    C2Param::CopyAsStream(*info, true /* output */, stream));
-                        }
-
-                        const std::vector<C2ConstGraphicBlock> blocks = buf->data().graphicBlocks();
-                        // for now only do the first block
-                        if (!blocks.empty()) {
-                            // ALOGV("got output buffer with crop %u,%u+%u,%u and size %u,%u",
-                            //      block.crop().left, block.crop().top,
-                            //      block.crop().width, block.crop().height,
-                            //      block.width(), block.height());
-                            const C2ConstGraphicBlock &block = blocks[0];
-                            updates.emplace_back(new C2StreamCropRectInfo::output(
-                                    stream, block.crop()));
-                        }
-                        ++stream;
-                    }
-
-                    sp<AMessage> oldFormat = config->mOutputFormat;
-                    config->updateConfiguration(updates, config->mOutputDomain);
-                    RevertOutputFormatIfNeeded(oldFormat, config->mOutputFormat);
-
-                    // copy standard infos to graphic buffers if not already present (otherwise, we
-                    // may overwrite the actual intermediate value with a final value)
-                    stream = 0;
-                    const static C2Param::Index stdGfxInfos[] = {
-                        C2StreamRotationInfo::output::PARAM_TYPE,
-                        C2StreamColorAspectsInfo::output::PARAM_TYPE,
-                        C2StreamDataSpaceInfo::output::PARAM_TYPE,
-                        C2StreamHdrStaticInfo::output::PARAM_TYPE,
-                        C2StreamHdr10PlusInfo::output::PARAM_TYPE,  // will be deprecated
-                        C2StreamHdrDynamicMetadataInfo::output::PARAM_TYPE,
-                        C2StreamPixelAspectRatioInfo::output::PARAM_TYPE,
-                        C2StreamSurfaceScalingInfo::output::PARAM_TYPE
-                    };
-                    for (const std::shared_ptr<C2Buffer> &buf : outputBuffers) {
-                        if (buf->data().graphicBlocks().size()) {
-                            for (C2Param::Index ix : stdGfxInfos) {
-                                if (!buf->hasInfo(ix)) {
-                                    const C2Param *param =
-                                        config->getConfigParameterValue(ix.withStream(stream));
-                                    if (param) {
-                                        std::shared_ptr<C2Param> info(C2Param::Copy(*param));
-                                        buf->setInfo(std::static_pointer_cast<C2Info>(info));
-                                    }
-                                }
-                            }
-                        }
-                        ++stream;
-                    }
-                }
-                if (config->mInputSurface) {
-                    if (work->worklets.empty()
-                           || !work->worklets.back()
-                           || (work->worklets.back()->output.flags
-                                  & C2FrameData::FLAG_INCOMPLETE) == 0) {
-                        config->mInputSurface->onInputBufferDone(work->input.ordinal.frameIndex);
-                    }
-                }
-                if (initDataWatcher.hasChanged()) {
-                    initData = initDataWatcher.update();
-                    AmendOutputFormatWithCodecSpecificData(
-                            initData->m.value, initData->flexCount(), config->mCodingMediaType,
-                            config->mOutputFormat);
-                }
-                outputFormat = config->mOutputFormat;
-            }
-            mChannel->onWorkDone(
-                    std::move(work), outputFormat, initData ? initData.get() : nullptr);
-            // log metrics to MediaCodec
-            if (mMetrics->countEntries() == 0) {
-                Mutexed<std::unique_ptr<Config>>::Locked configLocked(mConfig);
-                const std::unique_ptr<Config> &config = *configLocked;
-                uint32_t pf = PIXEL_FORMAT_UNKNOWN;
-                if (!config->mInputSurface) {
-                    pf = mChannel->getBuffersPixelFormat(config->mDomain & Config::IS_ENCODER);
-                } else {
-                    pf = config->mInputSurface->getPixelFormat();
-                }
-                if (pf != PIXEL_FORMAT_UNKNOWN) {
-                    mMetrics->setInt64(kCodecPixelFormat, pf);
-                    mCallback->onMetricsUpdated(mMetrics);
-                }
+            for (std::unique_ptr<C2Work> &work : workItems) {
+                handleWorkDone(std::move(work));
             }
             break;
         }
+        case kWhatSubmitPendingWork: {
+            mChannel->submitPendingWork();
+            break;
+        }
         case kWhatWatch: {
             // watch message already posted; no-op.
             break;
@@ -2536,6 +2463,117 @@ void CCodec::onMessageReceived(const sp<AMessage> &msg) {
     setDeadline(TimePoint::max(), 0ms, "none");
 }
 
+void CCodec::handleWorkDone(std::unique_ptr<C2Work> work) {
+    // handle configuration changes in work done
+    std::shared_ptr<const C2StreamInitDataInfo::output> initData;
+    sp<AMessage> outputFormat = nullptr;
+    {
+        Mutexed<std::unique_ptr<Config>>::Locked configLocked(mConfig);
+        const std::unique_ptr<Config> &config = *configLocked;
+        Config::Watcher<C2StreamInitDataInfo::output> initDataWatcher =
+            config->watch<C2StreamInitDataInfo::output>();
+        if (!work->worklets.empty()
+                && (work->worklets.front()->output.flags
+                        & C2FrameData::FLAG_DISCARD_FRAME) == 0) {
+
+            // copy buffer info to config
+            std::vector<std::unique_ptr<C2Param>> updates;
+            for (const std::unique_ptr<C2Param> &param
+                    : work->worklets.front()->output.configUpdate) {
+                updates.push_back(C2Param::Copy(*param));
+            }
+            unsigned stream = 0;
+            std::vector<std::shared_ptr<C2Buffer>> &outputBuffers =
+                work->worklets.front()->output.buffers;
+            for (const std::shared_ptr<C2Buffer> &buf : outputBuffers) {
+                for (const std::shared_ptr<const C2Info> &info : buf->info()) {
+                    // move all info into output-stream #0 domain
+                    updates.emplace_back(
+                            C2Param::CopyAsStream(*info, true /* output */, stream));
+                }
+
+                const std::vector<C2ConstGraphicBlock> blocks = buf->data().graphicBlocks();
+                // for now only do the first block
+                if (!blocks.empty()) {
+                    // ALOGV("got output buffer with crop %u,%u+%u,%u and size %u,%u",
+                    //      block.crop().left, block.crop().top,
+                    //      block.crop().width, block.crop().height,
+                    //      block.width(), block.height());
+                    const C2ConstGraphicBlock &block = blocks[0];
+                    updates.emplace_back(new C2StreamCropRectInfo::output(
+                            stream, block.crop()));
+                }
+                ++stream;
+            }
+
+            sp<AMessage> oldFormat = config->mOutputFormat;
+            config->updateConfiguration(updates, config->mOutputDomain);
+            RevertOutputFormatIfNeeded(oldFormat, config->mOutputFormat);
+
+            // copy standard infos to graphic buffers if not already present (otherwise, we
+            // may overwrite the actual intermediate value with a final value)
+            stream = 0;
+            const static C2Param::Index stdGfxInfos[] = {
+                C2StreamRotationInfo::output::PARAM_TYPE,
+                C2StreamColorAspectsInfo::output::PARAM_TYPE,
+                C2StreamDataSpaceInfo::output::PARAM_TYPE,
+                C2StreamHdrStaticInfo::output::PARAM_TYPE,
+                C2StreamHdr10PlusInfo::output::PARAM_TYPE,  // will be deprecated
+                C2StreamHdrDynamicMetadataInfo::output::PARAM_TYPE,
+                C2StreamPixelAspectRatioInfo::output::PARAM_TYPE,
+                C2StreamSurfaceScalingInfo::output::PARAM_TYPE
+            };
+            for (const std::shared_ptr<C2Buffer> &buf : outputBuffers) {
+                if (buf->data().graphicBlocks().size()) {
+                    for (C2Param::Index ix : stdGfxInfos) {
+                        if (!buf->hasInfo(ix)) {
+                            const C2Param *param =
+                                config->getConfigParameterValue(ix.withStream(stream));
+                            if (param) {
+                                std::shared_ptr<C2Param> info(C2Param::Copy(*param));
+                                buf->setInfo(std::static_pointer_cast<C2Info>(info));
+                            }
+                        }
+                    }
+                }
+                ++stream;
+            }
+        }
+        if (config->mInputSurface) {
+            if (work->worklets.empty()
+                   || !work->worklets.back()
+                   || (work->worklets.back()->output.flags
+                          & C2FrameData::FLAG_INCOMPLETE) == 0) {
+                config->mInputSurface->onInputBufferDone(work->input.ordinal.frameIndex);
+            }
+        }
+        if (initDataWatcher.hasChanged()) {
+            initData = initDataWatcher.update();
+            AmendOutputFormatWithCodecSpecificData(
+                    initData->m.value, initData->flexCount(), config->mCodingMediaType,
+                    config->mOutputFormat);
+        }
+        outputFormat = config->mOutputFormat;
+    }
+    mChannel->onWorkDone(
+            std::move(work), outputFormat, initData ? initData.get() : nullptr);
+    // log metrics to MediaCodec
+    if (mMetrics->countEntries() == 0) {
+        Mutexed<std::unique_ptr<Config>>::Locked configLocked(mConfig);
+        const std::unique_ptr<Config> &config = *configLocked;
+        uint32_t pf = PIXEL_FORMAT_UNKNOWN;
+        if (!config->mInputSurface) {
+            pf = mChannel->getBuffersPixelFormat(config->mDomain & Config::IS_ENCODER);
+        } else {
+            pf = config->mInputSurface->getPixelFormat();
+        }
+        if (pf != PIXEL_FORMAT_UNKNOWN) {
+            mMetrics->setInt64(kCodecPixelFormat, pf);
+            mCallback->onMetricsUpdated(mMetrics);
+        }
+    }
+}
+
 void CCodec::setDeadline(
         const TimePoint &now,
         const std::chrono::milliseconds &timeout,
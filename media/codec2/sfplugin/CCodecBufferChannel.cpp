@@ -85,6 +85,12 @@ constexpr size_t kSmoothnessFactor = 4;
 // than making it non-blocking. Do not change this value.
 const static size_t kDequeueTimeoutNs = 0;
 
+// Period of the copy rate log while linear buffers are being copied.
+constexpr nsecs_t kCopyStatsLogPeriodNs = 10000000000LL;  // 10 seconds
+
+// Default latency budget of an input work batch.
+constexpr int32_t kDefaultWorkBatchLatencyUs = 5000;
+
 static bool areRenderMetricsEnabled() {
     std::string v = GetServerConfigurableFlag("media_native", "render_metrics_enabled", "false");
     return v == "true";
@@ -162,7 +168,14 @@ CCodecBufferChannel::CCodecBufferChannel(
       mRenderingDepth(3u),
       mMetaMode(MODE_NONE),
       mInputMetEos(false),
-      mSendEncryptedInfoBuffer(false) {
+      mSendEncryptedInfoBuffer(false),
+      mZeroCopyLinear(property_get_bool("debug.stagefright.ccodec_zero_copy_linear", false)),
+      mWorkBatchSize(std::max(
+              property_get_int32("debug.stagefright.ccodec_work_batch_size", 1), 1)),
+      mWorkBatchLatencyNs(std::max(property_get_int32(
+              "debug.stagefright.ccodec_work_batch_latency_us",
+              kDefaultWorkBatchLatencyUs), 0) * 1000LL),
+      mWorkBatchEnabled(false) {
     {
         Mutexed<Input>::Locked input(mInput);
         input->buffers.reset(new DummyInputBuffers(""));
@@ -183,6 +196,17 @@ CCodecBufferChannel::CCodecBufferChannel(
         Mutexed<BlockPools>::Locked pools(mBlockPools);
         pools->outputPoolId = C2BlockPool::BASIC_LINEAR;
     }
+    {
+        Mutexed<CopyStats>::Locked stats(mCopyStats);
+        stats->startNs = stats->lastLogNs = systemTime(SYSTEM_TIME_MONOTONIC);
+        stats->copiedBytes = 0u;
+        stats->copiedBytesSinceLastLog = 0u;
+        stats->taken = false;
+    }
+    {
+        Mutexed<WorkBatcher>::Locked batcher(mWorkBatcher);
+        batcher->maxSize(mWorkBatchSize).maxLatencyNs(mWorkBatchLatencyNs);
+    }
     std::string value = GetServerConfigurableFlag("media_native", "ccodec_rendering_depth", "3");
     android::base::ParseInt(value, &mRenderingDepth);
     mOutputSurface.lock()->maxDequeueBuffers = kSmoothnessFactor + mRenderingDepth;
@@ -268,6 +292,7 @@ status_t CCodecBufferChannel::queueInputBufferInternal(
         // TODO: we want to delay copying buffers.
         if (input->extraBuffers.numComponentBuffers() < input->numExtraSlots) {
             copy = input->buffers->cloneAndReleaseBuffer(buffer);
+            onBytesCopied(input->buffers->takeCopiedBytes());
             if (copy != nullptr) {
                 (void)input->extraBuffers.assignSlot(copy);
                 if (!input->extraBuffers.releaseSlot(copy, &c2buffer, false)) {
@@ -351,6 +376,16 @@ status_t CCodecBufferChannel::queueInputBufferInternal(
     if (!items.empty()) {
         ScopedTrace trace(ATRACE_TAG, android::base::StringPrintf(
                 "CCodecBufferChannel::queue(%s@ts=%lld)", mName, (long long)timeUs).c_str());
+        // Work that changes the state of the component, or that the client
+        // cannot follow up with more input, is never held back.
+        bool submitNow = false;
+        for (const std::unique_ptr<C2Work> &work : items) {
+            if (!work->input.configUpdate.empty()
+                    || (work->input.flags & (C2FrameData::FLAG_END_OF_STREAM
+                                             | C2FrameData::FLAG_CODEC_CONFIG))) {
+                submitNow = true;
+            }
+        }
         {
             Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
             PipelineWatcher::Clock::time_point now = PipelineWatcher::Clock::now();
@@ -360,8 +395,11 @@ status_t CCodecBufferChannel::queueInputBufferInternal(
                         std::vector(work->input.buffers),
                         now);
             }
+            if (watcher->pipelineFull()) {
+                submitNow = true;
+            }
         }
-        err = mComponent->queue(&items);
+        err = queueWork(&items, submitNow);
     }
     if (err != C2_OK) {
         Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
@@ -560,6 +598,7 @@ status_t CCodecBufferChannel::attachEncryptedBuffer(
             return UNKNOWN_ERROR;
         }
         memcpy(view.data(), mDecryptDestination->unsecurePointer(), result);
+        onBytesCopied(result);
     }
     std::shared_ptr<C2Buffer> c2Buffer{C2Buffer::CreateLinearBuffer(
             block->share(codecDataOffset, result - codecDataOffset, C2Fence{}))};
@@ -621,6 +660,7 @@ status_t CCodecBufferChannel::queueSecureInputBuffer(
                 copied = true;
                 // TODO: only copy clear sections
                 memcpy(view.data(), buffer->data(), allocSize);
+                onBytesCopied(allocSize);
             }
         }
     }
@@ -657,6 +697,7 @@ status_t CCodecBufferChannel::queueSecureInputBuffer(
         }
         if (destination.type == DrmBufferType::SHARED_MEMORY) {
             encryptedBuffer->copyDecryptedContent(mDecryptDestination, result);
+            onBytesCopied(result);
         }
     } else {
         // Here we cast CryptoPlugin::SubSample to hardware::cas::native::V1_0::SubSample
@@ -716,6 +757,7 @@ status_t CCodecBufferChannel::queueSecureInputBuffer(
 
         if (dstBuffer.type == BufferType::SHARED_MEMORY) {
             encryptedBuffer->copyDecryptedContentFromMemory(result);
+            onBytesCopied(result);
         }
     }
 
@@ -1187,6 +1229,13 @@ status_t CCodecBufferChannel::start(
         const sp<AMessage> &inputFormat,
         const sp<AMessage> &outputFormat,
         bool buffersBoundToCodec) {
+    {
+        Mutexed<CopyStats>::Locked stats(mCopyStats);
+        stats->startNs = stats->lastLogNs = systemTime(SYSTEM_TIME_MONOTONIC);
+        stats->copiedBytes = 0u;
+        stats->copiedBytesSinceLastLog = 0u;
+        stats->taken = false;
+    }
     C2StreamBufferTypeSetting::input iStreamFormat(0u);
     C2StreamBufferTypeSetting::output oStreamFormat(0u);
     C2ComponentKindSetting kind;
@@ -1571,7 +1620,7 @@ status_t CCodecBufferChannel::start(
         }
 
         if (oStreamFormat.value == C2BufferData::LINEAR) {
-            if (buffersBoundToCodec) {
+            if (buffersBoundToCodec && !mZeroCopyLinear) {
                 // WORKAROUND: if we're using early CSD workaround we convert to
                 //             array mode, to appease apps assuming the output
                 //             buffers to be of the same size.
@@ -1617,6 +1666,23 @@ status_t CCodecBufferChannel::start(
                 .outputDelay(outputDelayValue)
                 .smoothnessFactor(kSmoothnessFactor);
         watcher->flush();
+        watcher->resetSubmitDelay();
+    }
+
+    if (inputFormat || outputFormat) {
+        // Batching trades latency for throughput; keep it off where latency
+        // matters more.
+        int32_t lowLatency = 0;
+        bool lowLatencyRequested =
+                (inputFormat && inputFormat->findInt32(KEY_LOW_LATENCY, &lowLatency)
+                        && lowLatency)
+                || (outputFormat && outputFormat->findInt32(KEY_LOW_LATENCY, &lowLatency)
+                        && lowLatency);
+        mWorkBatchEnabled = mWorkBatchSize > 1u && !mInputSurface && !mTunneled
+                && !lowLatencyRequested;
+        mWorkBatcher.lock()->resetStats();
+        ALOGD_IF(mWorkBatchEnabled, "[%s] batching up to %zu input work items within %lld us",
+                 mName, mWorkBatchSize, (long long)(mWorkBatchLatencyNs / 1000));
     }
 
     mInputMetEos = false;
@@ -1728,6 +1794,7 @@ status_t CCodecBufferChannel::requestInitialInputBuffers(
 void CCodecBufferChannel::stop() {
     mSync.stop();
     mFirstValidFrameIndex = mFrameIndex.load(std::memory_order_relaxed);
+    discardWorkBatch();
 }
 
 void CCodecBufferChannel::stopUseOutputSurface(bool pushBlankBuffer) {
@@ -1754,6 +1821,22 @@ void CCodecBufferChannel::reset() {
     if (mInputSurface != nullptr) {
         mInputSurface.reset();
     }
+    {
+        Mutexed<WorkBatcher>::Locked batcher(mWorkBatcher);
+        if (mWorkBatchEnabled && batcher->numBatches() > 0u) {
+            size_t numSubmitted = 0u;
+            PipelineWatcher::Clock::duration average;
+            PipelineWatcher::Clock::duration max;
+            mPipelineWatcher.lock()->getSubmitDelay(&numSubmitted, &average, &max);
+            ALOGD("[%s] queued %zu work items in %llu batches; "
+                  "held back for %lld us on average, %lld us at most",
+                  mName, numSubmitted, (unsigned long long)batcher->numBatches(),
+                  (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+                          average).count(),
+                  (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+                          max).count());
+        }
+    }
     mPipelineWatcher.lock()->flush();
     {
         Mutexed<Input>::Locked input(mInput);
@@ -1766,6 +1849,14 @@ void CCodecBufferChannel::reset() {
     }
     // reset the frames that are being tracked for onFrameRendered callbacks
     mTrackedFrames.clear();
+
+    uint64_t copiedBytes = 0u;
+    uint64_t copiedBytesPerSec = 0u;
+    getCopyStats(&copiedBytes, &copiedBytesPerSec);
+    ALOGD_IF(copiedBytes > 0u || mZeroCopyLinear,
+             "[%s] copied %llu bytes of linear buffers (%llu bytes/s)%s",
+             mName, (unsigned long long)copiedBytes, (unsigned long long)copiedBytesPerSec,
+             mZeroCopyLinear ? " in zero-copy mode" : "");
 }
 
 void CCodecBufferChannel::release() {
@@ -1870,6 +1961,81 @@ void CCodecBufferChannel::onInputBufferDone(
     }
 }
 
+void CCodecBufferChannel::submitPendingWork() {
+    QueueGuard guard(mSync);
+    if (!guard.isRunning()) {
+        ALOGV("[%s] submitPendingWork: not running", mName);
+        return;
+    }
+    c2_status_t err = C2_OK;
+    {
+        // The batcher stays locked until the batch is queued, so that batches
+        // reach the component in the order they were taken.
+        Mutexed<WorkBatcher>::Locked batcher(mWorkBatcher);
+        std::list<std::unique_ptr<C2Work>> items;
+        if (!batcher->takeExpired(systemTime(SYSTEM_TIME_MONOTONIC), &items)) {
+            return;
+        }
+        err = submitWorkBatch(&items);
+    }
+    if (err != C2_OK) {
+        mCCodecCallback->onError(err, ACTION_CODE_FATAL);
+    }
+}
+
+size_t CCodecBufferChannel::getWorkBatchSize() {
+    return mWorkBatchEnabled ? mWorkBatchSize : 1u;
+}
+
+c2_status_t CCodecBufferChannel::queueWork(
+        std::list<std::unique_ptr<C2Work>> *items, bool submitNow) {
+    if (!mWorkBatchEnabled) {
+        return mComponent->queue(items);
+    }
+    Mutexed<WorkBatcher>::Locked batcher(mWorkBatcher);
+    std::list<std::unique_ptr<C2Work>> batch;
+    nsecs_t delayNs = -1;
+    if (!batcher->add(items, submitNow, systemTime(SYSTEM_TIME_MONOTONIC), &batch, &delayNs)) {
+        if (delayNs >= 0) {
+            mCCodecCallback->onWorkPending(delayNs);
+        }
+        return C2_OK;
+    }
+    return submitWorkBatch(&batch);
+}
+
+c2_status_t CCodecBufferChannel::submitWorkBatch(std::list<std::unique_ptr<C2Work>> *items) {
+    {
+        Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
+        PipelineWatcher::Clock::time_point now = PipelineWatcher::Clock::now();
+        for (const std::unique_ptr<C2Work> &work : *items) {
+            watcher->onWorkSubmitted(work->input.ordinal.frameIndex.peeku(), now);
+        }
+    }
+    ALOGV("[%s] submitting %zu input work items", mName, items->size());
+    c2_status_t err = mComponent->queue(items);
+    if (err != C2_OK) {
+        ALOGD("[%s] failed to queue a batch of %zu work items: %d", mName, items->size(), err);
+        Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
+        for (const std::unique_ptr<C2Work> &work : *items) {
+            watcher->onWorkDone(work->input.ordinal.frameIndex.peeku());
+        }
+    }
+    return err;
+}
+
+void CCodecBufferChannel::discardWorkBatch() {
+    std::list<std::unique_ptr<C2Work>> items;
+    if (mWorkBatcher.lock()->takeAll(&items) == 0u) {
+        return;
+    }
+    ALOGV("[%s] discarding %zu pending input work items", mName, items.size());
+    Mutexed<PipelineWatcher>::Locked watcher(mPipelineWatcher);
+    for (const std::unique_ptr<C2Work> &work : items) {
+        watcher->onWorkDone(work->input.ordinal.frameIndex.peeku());
+    }
+}
+
 bool CCodecBufferChannel::handleWork(
         std::unique_ptr<C2Work> work,
         const sp<AMessage> &outputFormat,
@@ -2139,7 +2305,9 @@ bool CCodecBufferChannel::handleWork(
         }
         size_t index;
         sp<MediaCodecBuffer> outBuffer;
-        if (output->buffers->registerCsd(initData, &index, &outBuffer) == OK) {
+        status_t err = output->buffers->registerCsd(initData, &index, &outBuffer);
+        onBytesCopied(output->buffers->takeCopiedBytes());
+        if (err == OK) {
             outBuffer->meta()->setInt64("timeUs", timestamp.peek());
             outBuffer->meta()->setInt32("flags", BUFFER_FLAG_CODEC_CONFIG);
             ALOGV("[%s] onWorkDone: csd index = %zu [%p]", mName, index, outBuffer.get());
@@ -2228,6 +2396,7 @@ void CCodecBufferChannel::sendOutputBuffers() {
         }
         action = output->buffers->popFromStashAndRegister(
                 &c2Buffer, &index, &outBuffer);
+        onBytesCopied(output->buffers->takeCopiedBytes());
         if (action != OutputBuffers::REALLOCATE) {
             reallocTryNum = 0;
         }
@@ -2413,6 +2582,45 @@ void CCodecBufferChannel::resetBuffersPixelFormat(bool isEncoder) {
     }
 }
 
+void CCodecBufferChannel::getCopyStats(uint64_t *copiedBytes, uint64_t *copiedBytesPerSec) {
+    Mutexed<CopyStats>::Locked stats(mCopyStats);
+    nsecs_t elapsedNs = systemTime(SYSTEM_TIME_MONOTONIC) - stats->startNs;
+    *copiedBytes = stats->copiedBytes;
+    *copiedBytesPerSec = elapsedNs > 0
+            ? (uint64_t)((double)stats->copiedBytes * 1e9 / elapsedNs) : 0u;
+}
+
+bool CCodecBufferChannel::takeCopyStats(uint64_t *copiedBytes, uint64_t *copiedBytesPerSec) {
+    {
+        Mutexed<CopyStats>::Locked stats(mCopyStats);
+        if (stats->taken) {
+            return false;
+        }
+        stats->taken = true;
+    }
+    getCopyStats(copiedBytes, copiedBytesPerSec);
+    return true;
+}
+
+void CCodecBufferChannel::onBytesCopied(size_t bytes) {
+    if (bytes == 0u) {
+        return;
+    }
+    Mutexed<CopyStats>::Locked stats(mCopyStats);
+    stats->copiedBytes += bytes;
+    stats->copiedBytesSinceLastLog += bytes;
+    nsecs_t nowNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t elapsedNs = nowNs - stats->lastLogNs;
+    if (elapsedNs >= kCopyStatsLogPeriodNs) {
+        ALOGD("[%s] copied %llu bytes of linear buffers in the last %lld ms (%llu bytes/s)",
+              mName, (unsigned long long)stats->copiedBytesSinceLastLog,
+              (long long)(elapsedNs / 1000000),
+              (unsigned long long)((double)stats->copiedBytesSinceLastLog * 1e9 / elapsedNs));
+        stats->lastLogNs = nowNs;
+        stats->copiedBytesSinceLastLog = 0u;
+    }
+}
+
 status_t toStatusT(c2_status_t c2s, c2_operation_t c2op) {
     // C2_OK is always translated to OK.
     if (c2s == C2_OK) {
@@ -19,6 +19,7 @@
 #define CCODEC_BUFFER_CHANNEL_H_
 
 #include <deque>
+#include <list>
 #include <map>
 #include <memory>
 #include <vector>
@@ -35,6 +36,7 @@
 #include "FrameReassembler.h"
 #include "InputSurfaceWrapper.h"
 #include "PipelineWatcher.h"
+#include "WorkBatcher.h"
 
 namespace android {
 
@@ -47,6 +49,11 @@ public:
     virtual void onOutputFramesRendered(int64_t mediaTimeUs, nsecs_t renderTimeNs) = 0;
     virtual void onOutputBuffersChanged() = 0;
     virtual void onFirstTunnelFrameReady() = 0;
+    /**
+     * Input work is held back for batching; call
+     * CCodecBufferChannel::submitPendingWork() after |delayNs|.
+     */
+    virtual void onWorkPending(nsecs_t delayNs) = 0;
 };
 
 /**
@@ -198,6 +205,18 @@ public:
      */
     void onInputBufferDone(uint64_t frameIndex, size_t arrayIndex);
 
+    /**
+     * Submit input work held back for batching to the component, if its
+     * latency budget has expired.
+     */
+    void submitPendingWork();
+
+    /**
+     * \return the maximum number of input work items submitted to the
+     *         component at once; 1 if input work is not batched.
+     */
+    size_t getWorkBatchSize();
+
     PipelineWatcher::Clock::duration elapsed();
 
     enum MetaMode {
@@ -216,6 +235,19 @@ public:
 
     void resetBuffersPixelFormat(bool isEncoder);
 
+    /**
+     * Get the number of bytes copied between C2 linear blocks and client
+     * buffers since start(), and the average rate in bytes per second.
+     */
+    void getCopyStats(uint64_t *copiedBytes, uint64_t *copiedBytesPerSec);
+
+    /**
+     * Like getCopyStats(), for reporting the stats once per start().
+     *
+     * \return false if the stats were already taken since start().
+     */
+    bool takeCopyStats(uint64_t *copiedBytes, uint64_t *copiedBytesPerSec);
+
 private:
     uint32_t getInputBuffersPixelFormat();
 
@@ -388,6 +420,44 @@ private:
     std::atomic_bool mSendEncryptedInfoBuffer;
 
     std::atomic_bool mTunneled;
+
+    // If true, linear output buffers of codecs that are not in block model
+    // mode wrap the C2 blocks instead of being copied to an array of
+    // fixed-size buffers.
+    bool mZeroCopyLinear;
+
+    struct CopyStats {
+        nsecs_t startNs;
+        nsecs_t lastLogNs;
+        uint64_t copiedBytes;
+        uint64_t copiedBytesSinceLastLog;
+        bool taken;
+    };
+    Mutexed<CopyStats> mCopyStats;
+
+    /**
+     * Account for |bytes| bytes copied between C2 linear blocks and client
+     * buffers, logging the copy rate periodically.
+     */
+    void onBytesCopied(size_t bytes);
+
+    // Input work items may be held back and submitted to the component in one
+    // queue() call, up to mWorkBatchSize items or until the first item has
+    // waited for mWorkBatchLatencyNs.
+    size_t mWorkBatchSize;
+    nsecs_t mWorkBatchLatencyNs;
+    std::atomic_bool mWorkBatchEnabled;
+
+    Mutexed<WorkBatcher> mWorkBatcher;
+
+    /**
+     * Queue |items| to the component, or hold them back for batching unless
+     * |submitNow| is true. |items| is empty on return if the items were
+     * batched, whether or not the batch was submitted successfully.
+     */
+    c2_status_t queueWork(std::list<std::unique_ptr<C2Work>> *items, bool submitNow);
+    c2_status_t submitWorkBatch(std::list<std::unique_ptr<C2Work>> *items);
+    void discardWorkBatch();
 };
 
 // Conversion of a c2_status_t value to a status_t value may depend on the
@@ -126,6 +126,12 @@ uint32_t CCodecBuffers::getPixelFormatIfApplicable() { return PIXEL_FORMAT_UNKNO
 
 bool CCodecBuffers::resetPixelFormatIfApplicable() { return false; }
 
+size_t CCodecBuffers::takeCopiedBytes() {
+    size_t copiedBytes = mCopiedBytes;
+    mCopiedBytes = 0;
+    return copiedBytes;
+}
+
 // InputBuffers
 
 sp<Codec2Buffer> InputBuffers::cloneAndReleaseBuffer(const sp<MediaCodecBuffer> &buffer) {
@@ -143,6 +149,7 @@ sp<Codec2Buffer> InputBuffers::cloneAndReleaseBuffer(const sp<MediaCodecBuffer>
     if (!copy->copy(c2buffer)) {
         return nullptr;
     }
+    mCopiedBytes += copy->size();
     copy->meta()->extend(buffer->meta());
     return copy;
 }
@@ -197,6 +204,10 @@ void OutputBuffers::updateSkipCutBuffer(const sp<AMessage> &format) {
 
 void OutputBuffers::submit(const sp<MediaCodecBuffer> &buffer) {
     if (mSkipCutBuffer != nullptr) {
+        // SkipCutBuffer only needs to copy the data when it holds back padding
+        if (mPadding > 0) {
+            mCopiedBytes += buffer->size();
+        }
         mSkipCutBuffer->submit(buffer);
     }
 }
@@ -262,6 +273,7 @@ bool OutputBuffers::convert(
         ALOGD("[%s] buffer conversion failed: %d", mName, err);
         return false;
     }
+    mCopiedBytes += srcBuffer->size();
     dstBuffer->setFormat(mFormatWithConverter);
     return true;
 }
@@ -1156,9 +1168,14 @@ status_t OutputBuffersArray::registerBuffer(
         return err;
     }
     c2Buffer->setFormat(mFormat);
-    if (!convert(buffer, &c2Buffer) && !c2Buffer->copy(buffer)) {
-        ALOGD("[%s] copy buffer failed", mName);
-        return WOULD_BLOCK;
+    if (!convert(buffer, &c2Buffer)) {
+        if (!c2Buffer->copy(buffer)) {
+            ALOGD("[%s] copy buffer failed", mName);
+            return WOULD_BLOCK;
+        }
+        if (buffer && buffer->data().type() == C2BufferData::LINEAR) {
+            mCopiedBytes += c2Buffer->size();
+        }
     }
     submit(c2Buffer);
     handleImageData(c2Buffer);
@@ -1183,6 +1200,7 @@ status_t OutputBuffersArray::registerCsd(
         return err;
     }
     memcpy(c2Buffer->base(), csd->m.value, csd->flexCount());
+    mCopiedBytes += csd->flexCount();
     c2Buffer->setRange(0, csd->flexCount());
     c2Buffer->setFormat(mFormat);
     *clientBuffer = c2Buffer;
@@ -1260,6 +1278,10 @@ void OutputBuffersArray::grow(size_t newSize) {
 void OutputBuffersArray::transferFrom(OutputBuffers* source) {
     mFormat = source->mFormat;
     mSkipCutBuffer = source->mSkipCutBuffer;
+    mDelay = source->mDelay;
+    mPadding = source->mPadding;
+    mSampleRate = source->mSampleRate;
+    mChannelCount = source->mChannelCount;
     mPending = std::move(source->mPending);
     mReorderStash = std::move(source->mReorderStash);
     mDepth = source->mDepth;
@@ -1295,6 +1317,7 @@ status_t FlexOutputBuffers::registerCsd(
         sp<MediaCodecBuffer> *clientBuffer) {
     sp<Codec2Buffer> newBuffer = new LocalLinearBuffer(
             mFormat, ABuffer::CreateAsCopy(csd->m.value, csd->flexCount()));
+    mCopiedBytes += csd->flexCount();
     *index = mImpl.assignSlot(newBuffer);
     *clientBuffer = newBuffer;
     return OK;
@@ -91,10 +91,17 @@ public:
      */
     virtual bool resetPixelFormatIfApplicable();
 
+    /**
+     * Return the number of bytes copied between C2 linear blocks and
+     * MediaCodec-facing buffers since the last call, and reset the count.
+     */
+    size_t takeCopiedBytes();
+
 protected:
     std::string mComponentName; ///< name of component for debugging
     std::string mChannelName; ///< name of channel for debugging
     const char *mName; ///< C-string version of channel name
+    size_t mCopiedBytes{0}; ///< bytes copied since the last takeCopiedBytes()
     // Format to be used for creating MediaCodec-facing buffers.
     sp<AMessage> mFormat;
 
@@ -62,6 +62,39 @@ void PipelineWatcher::onWorkQueued(
     (void)mFramesInPipeline.try_emplace(frameIndex, std::move(buffers), queuedAt);
 }
 
+void PipelineWatcher::onWorkSubmitted(
+        uint64_t frameIndex, const Clock::time_point &submittedAt) {
+    ALOGV("onWorkSubmitted(frameIndex=%llu, submittedAt=%lld)",
+          (unsigned long long)frameIndex,
+          (long long)submittedAt.time_since_epoch().count());
+    auto it = mFramesInPipeline.find(frameIndex);
+    if (it == mFramesInPipeline.end()) {
+        ALOGD("onWorkSubmitted: frameIndex not found (%llu); ignored",
+              (unsigned long long)frameIndex);
+        return;
+    }
+    Clock::duration delay = submittedAt - it->second.queuedAt;
+    ++mNumSubmitted;
+    mSubmitDelayTotal += delay;
+    mSubmitDelayMax = std::max(mSubmitDelayMax, delay);
+}
+
+void PipelineWatcher::getSubmitDelay(
+        size_t *numSubmitted, Clock::duration *average, Clock::duration *max) const {
+    *numSubmitted = mNumSubmitted;
+    *average = Clock::duration::zero();
+    if (mNumSubmitted > 0) {
+        *average = mSubmitDelayTotal / static_cast<Clock::rep>(mNumSubmitted);
+    }
+    *max = mSubmitDelayMax;
+}
+
+void PipelineWatcher::resetSubmitDelay() {
+    mNumSubmitted = 0;
+    mSubmitDelayTotal = Clock::duration::zero();
+    mSubmitDelayMax = Clock::duration::zero();
+}
+
 std::shared_ptr<C2Buffer> PipelineWatcher::onInputBufferReleased(
         uint64_t frameIndex, size_t arrayIndex) {
     ALOGV("onInputBufferReleased(frameIndex=%llu, arrayIndex=%zu)",
@@ -37,7 +37,10 @@ public:
         : mInputDelay(0),
           mPipelineDelay(0),
           mOutputDelay(0),
-          mSmoothnessFactor(0) {}
+          mSmoothnessFactor(0),
+          mNumSubmitted(0),
+          mSubmitDelayTotal(Clock::duration::zero()),
+          mSubmitDelayMax(Clock::duration::zero()) {}
     ~PipelineWatcher() = default;
 
     /**
@@ -76,6 +79,32 @@ public:
             std::vector<std::shared_ptr<C2Buffer>> &&buffers,
             const Clock::time_point &queuedAt);
 
+    /**
+     * Client submitted a work item to the component. Work items may be held
+     * back by the client after onWorkQueued(), e.g. to batch them.
+     *
+     * \param frameIndex   input frame index of this work
+     * \param submittedAt  time when the client submitted the work item
+     */
+    void onWorkSubmitted(uint64_t frameIndex, const Clock::time_point &submittedAt);
+
+    /**
+     * Return statistics of the time work items were held back between
+     * onWorkQueued() and onWorkSubmitted(), since the last call to
+     * resetSubmitDelay().
+     *
+     * \param numSubmitted[out]  number of submitted work items
+     * \param average[out]       average time a work item was held back
+     * \param max[out]           longest time a work item was held back
+     */
+    void getSubmitDelay(
+            size_t *numSubmitted, Clock::duration *average, Clock::duration *max) const;
+
+    /**
+     * Reset statistics returned by getSubmitDelay().
+     */
+    void resetSubmitDelay();
+
     /**
      * The component released input buffers from a work item.
      *
@@ -132,6 +161,10 @@ private:
         const Clock::time_point queuedAt;
     };
     std::map<uint64_t, Frame> mFramesInPipeline;
+
+    size_t mNumSubmitted;
+    Clock::duration mSubmitDelayTotal;
+    Clock::duration mSubmitDelayMax;
 };
 
 }  // namespace android
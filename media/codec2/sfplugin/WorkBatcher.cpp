@@ -0,0 +1,80 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "WorkBatcher"
+
+#include <log/log.h>
+
+#include "WorkBatcher.h"
+
+namespace android {
+
+WorkBatcher &WorkBatcher::maxSize(size_t value) {
+    mMaxSize = value;
+    return *this;
+}
+
+WorkBatcher &WorkBatcher::maxLatencyNs(nsecs_t value) {
+    mMaxLatencyNs = value;
+    return *this;
+}
+
+bool WorkBatcher::add(
+        Items *items, bool submitNow, nsecs_t nowNs, Items *batch, nsecs_t *delayNs) {
+    *delayNs = -1;
+    bool newBatch = mItems.empty();
+    if (newBatch) {
+        mFirstAddedNs = nowNs;
+    }
+    mItems.splice(mItems.end(), *items);
+    if (submitNow
+            || mItems.size() >= mMaxSize
+            || nowNs - mFirstAddedNs >= mMaxLatencyNs) {
+        return take(batch);
+    }
+    if (newBatch) {
+        *delayNs = mFirstAddedNs + mMaxLatencyNs - nowNs;
+    }
+    return false;
+}
+
+bool WorkBatcher::takeExpired(nsecs_t nowNs, Items *batch) {
+    if (mItems.empty()) {
+        return false;
+    }
+    if (nowNs - mFirstAddedNs < mMaxLatencyNs) {
+        // This batch was started after the one the caller was scheduled for,
+        // and the caller is scheduled again for this one.
+        return false;
+    }
+    return take(batch);
+}
+
+size_t WorkBatcher::takeAll(Items *items) {
+    size_t size = mItems.size();
+    items->splice(items->end(), mItems);
+    return size;
+}
+
+bool WorkBatcher::take(Items *batch) {
+    ALOGV("taking a batch of %zu items", mItems.size());
+    batch->splice(batch->end(), mItems);
+    ++mNumBatches;
+    return true;
+}
+
+}  // namespace android
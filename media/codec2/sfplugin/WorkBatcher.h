@@ -0,0 +1,115 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WORK_BATCHER_H_
+#define WORK_BATCHER_H_
+
+#include <list>
+#include <memory>
+
+#include <utils/Timers.h>
+
+#include <C2Work.h>
+
+namespace android {
+
+/**
+ * WorkBatcher holds back input work items so that they can be submitted to the
+ * component in one queue() call. A batch is due when it holds maxSize items,
+ * when its first item has waited for maxLatencyNs, or when an item must be
+ * submitted right away (e.g. EOS). Items leave in the order they were added.
+ *
+ * WorkBatcher is not thread-safe; the owner serializes the calls and keeps
+ * submitting batches in the order they were taken.
+ */
+class WorkBatcher {
+public:
+    typedef std::list<std::unique_ptr<C2Work>> Items;
+
+    WorkBatcher()
+        : mMaxSize(1u),
+          mMaxLatencyNs(0),
+          mFirstAddedNs(0),
+          mNumBatches(0u) {}
+    ~WorkBatcher() = default;
+
+    /**
+     * \param value the maximum number of items in a batch
+     * \return  this object
+     */
+    WorkBatcher &maxSize(size_t value);
+
+    /**
+     * \param value the maximum time the first item of a batch is held back
+     * \return  this object
+     */
+    WorkBatcher &maxLatencyNs(nsecs_t value);
+
+    /**
+     * Add |items| to the pending batch.
+     *
+     * \param items     items to add; empty on return
+     * \param submitNow whether the batch is due regardless of its size and age
+     * \param nowNs     current time
+     * \param batch     the batch if it is due; untouched otherwise
+     * \param delayNs   if this call started a batch that is not due, the delay
+     *                  after which takeExpired() should be called; -1 otherwise
+     * \return  true if the batch is due and was moved to |batch|
+     */
+    bool add(Items *items, bool submitNow, nsecs_t nowNs, Items *batch, nsecs_t *delayNs);
+
+    /**
+     * Take the pending batch if its first item has waited for maxLatencyNs.
+     *
+     * \param nowNs current time
+     * \param batch the pending batch if it is due; untouched otherwise
+     * \return  true if the batch was moved to |batch|
+     */
+    bool takeExpired(nsecs_t nowNs, Items *batch);
+
+    /**
+     * Take the pending items regardless of the batch's size and age, e.g. to
+     * discard them on flush.
+     *
+     * \param items the pending items, appended in the order they were added
+     * \return  the number of items taken
+     */
+    size_t takeAll(Items *items);
+
+    /**
+     * \return  the number of batches taken by add() and takeExpired()
+     */
+    uint64_t numBatches() const { return mNumBatches; }
+
+    /**
+     * Reset the batch count.
+     */
+    void resetStats() { mNumBatches = 0u; }
+
+private:
+    bool take(Items *batch);
+
+    size_t mMaxSize;
+    nsecs_t mMaxLatencyNs;
+
+    Items mItems;
+    nsecs_t mFirstAddedNs;
+    uint64_t mNumBatches;
+};
+
+}  // namespace android
+
+#endif  // WORK_BATCHER_H_
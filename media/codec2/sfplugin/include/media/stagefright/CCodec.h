@@ -113,6 +113,12 @@ private:
     void flush();
     void release(bool sendCallback, bool pushBlankBuffer);
 
+    /// reports the buffer copy statistics of the session to MediaCodec metrics, once per start
+    void reportCopyStats();
+
+    /// handles a finished work item from the component
+    void handleWorkDone(std::unique_ptr<C2Work> work);
+
     /**
      * Creates an input surface for the current device configuration compatible with CCodec.
      * This could be backed by the C2 HAL or the OMX HAL.
@@ -149,6 +155,7 @@ private:
         kWhatSetParameters,
 
         kWhatWorkDone,
+        kWhatSubmitPendingWork,
         kWhatWatch,
     };
 
@@ -914,4 +914,40 @@ TEST(LinearOutputBuffersTest, PcmConvertFormat) {
     ASSERT_TRUE(buffers->releaseBuffer(clientBuffer, &c2Buffer));
 }
 
+TEST(LinearOutputBuffersTest, CopiedBytes) {
+    constexpr int32_t kSkipFrames = 16;
+    std::shared_ptr<LinearOutputBuffers> buffers =
+        std::make_shared<LinearOutputBuffers>("test");
+    sp<AMessage> format{new AMessage};
+    format->setInt32(KEY_CHANNEL_COUNT, 1);
+    format->setInt32(KEY_SAMPLE_RATE, 8000);
+    buffers->setFormat(format);
+    buffers->initSkipCutBuffer(kSkipFrames, 0 /* padding */, 8000, 1);
+
+    std::shared_ptr<C2BlockPool> pool;
+    ASSERT_EQ(OK, GetCodec2BlockPool(C2BlockPool::BASIC_LINEAR, nullptr, &pool));
+
+    std::shared_ptr<C2LinearBlock> block;
+    ASSERT_EQ(OK, pool->fetchLinearBlock(
+            1024, C2MemoryUsage{C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE}, &block));
+    std::shared_ptr<C2Buffer> c2Buffer =
+        C2Buffer::CreateLinearBuffer(block->share(0, 1024, C2Fence()));
+
+    // Wrapped buffers are not copied, even when the skip is applied.
+    size_t index;
+    sp<MediaCodecBuffer> clientBuffer;
+    ASSERT_EQ(OK, buffers->registerBuffer(c2Buffer, &index, &clientBuffer));
+    EXPECT_EQ(1024u - kSkipFrames * 2, clientBuffer->size());
+    EXPECT_EQ(0u, buffers->takeCopiedBytes());
+    ASSERT_TRUE(buffers->releaseBuffer(clientBuffer, &c2Buffer));
+
+    // Array mode copies to the client buffers.
+    std::shared_ptr<OutputBuffersArray> array = buffers->toArrayMode(8);
+    ASSERT_EQ(OK, array->registerBuffer(c2Buffer, &index, &clientBuffer));
+    EXPECT_EQ(1024u, clientBuffer->size());
+    EXPECT_EQ(1024u, array->takeCopiedBytes());
+    EXPECT_EQ(0u, array->takeCopiedBytes());
+    ASSERT_TRUE(array->releaseBuffer(clientBuffer, &c2Buffer));
+}
+
 } // namespace android
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "CCodecWorkBatchingBenchmark"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include <android-base/properties.h>
+#include <benchmark/benchmark.h>
+#include <binder/ProcessState.h>
+#include <media/MediaCodecBuffer.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecConstants.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+using namespace android;
+
+// Number of frames encoded per iteration.
+constexpr int32_t kNumFrames = 480;
+
+// Encoder configuration under test.
+struct EncoderConfig {
+    const char *componentName;
+    sp<AMessage> format;
+    size_t frameSize;
+    int64_t frameDurationUs;
+};
+
+// AAC-LC, 48 kHz stereo, 1024 samples per frame.
+static EncoderConfig AacConfig() {
+    sp<AMessage> format = new AMessage;
+    format->setString(KEY_MIME, MIMETYPE_AUDIO_AAC);
+    format->setInt32(KEY_SAMPLE_RATE, 48000);
+    format->setInt32(KEY_CHANNEL_COUNT, 2);
+    format->setInt32(KEY_BIT_RATE, 128000);
+    format->setInt32(KEY_AAC_PROFILE, AACObjectLC);
+    return {"c2.android.aac.encoder", format,
+            1024 * 2 * sizeof(int16_t), 1000000LL * 1024 / 48000};
+}
+
+// H.264 at 240 fps, 320x240.
+static EncoderConfig Avc240FpsConfig() {
+    sp<AMessage> format = new AMessage;
+    format->setString(KEY_MIME, MIMETYPE_VIDEO_AVC);
+    format->setInt32(KEY_WIDTH, 320);
+    format->setInt32(KEY_HEIGHT, 240);
+    format->setInt32(KEY_COLOR_FORMAT, COLOR_FormatYUV420Flexible);
+    format->setFloat(KEY_FRAME_RATE, 240.f);
+    format->setInt32(KEY_BIT_RATE, 2000000);
+    format->setInt32(KEY_I_FRAME_INTERVAL, 1);
+    return {"c2.android.avc.encoder", format, 320 * 240 * 3 / 2, 1000000LL / 240};
+}
+
+// Queues kNumFrames frames and EOS to a started encoder, and drains its
+// output until EOS.
+static status_t EncodeFrames(const sp<MediaCodec> &codec, const EncoderConfig &config) {
+    int32_t numQueued = 0;
+    bool inputEos = false;
+    while (true) {
+        size_t index;
+        while (!inputEos && codec->dequeueInputBuffer(&index, 0) == OK) {
+            sp<MediaCodecBuffer> buffer;
+            status_t err = codec->getInputBuffer(index, &buffer);
+            if (err != OK) {
+                return err;
+            }
+            inputEos = numQueued == kNumFrames;
+            size_t size = inputEos ? 0 : std::min(config.frameSize, buffer->capacity());
+            memset(buffer->base(), numQueued & 0xFF, size);
+            err = codec->queueInputBuffer(
+                    index, 0, size, numQueued * config.frameDurationUs,
+                    inputEos ? BUFFER_FLAG_END_OF_STREAM : 0);
+            if (err != OK) {
+                return err;
+            }
+            ++numQueued;
+        }
+
+        size_t offset, size;
+        int64_t timeUs;
+        uint32_t flags;
+        status_t err = codec->dequeueOutputBuffer(
+                &index, &offset, &size, &timeUs, &flags, 5000 /* timeoutUs */);
+        if (err == OK) {
+            codec->releaseOutputBuffer(index);
+            if (flags & BUFFER_FLAG_END_OF_STREAM) {
+                return OK;
+            }
+        } else if (err != -EAGAIN
+                && err != INFO_FORMAT_CHANGED
+                && err != INFO_OUTPUT_BUFFERS_CHANGED) {
+            return err;
+        }
+    }
+}
+
+/*******************************************************************
+ * Encodes frames with the given input work batch size, and reports the
+ * number of frames encoded per second.
+ *******************************************************************/
+static void BM_EncodeWithWorkBatching(
+        benchmark::State& state, EncoderConfig (*configFn)()) {
+    const int64_t batchSize = state.range(0);
+    if (!base::SetProperty("debug.stagefright.ccodec_work_batch_size",
+                           std::to_string(batchSize))) {
+        state.SkipWithError("cannot set the work batch size");
+        return;
+    }
+    const EncoderConfig config = configFn();
+    sp<ALooper> looper = new ALooper;
+    looper->start();
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        sp<MediaCodec> codec = MediaCodec::CreateByComponentName(looper, config.componentName);
+        if (codec == nullptr) {
+            state.SkipWithError("cannot create the encoder");
+            break;
+        }
+        if (codec->configure(config.format, nullptr, nullptr, MediaCodec::CONFIGURE_FLAG_ENCODE)
+                != OK || codec->start() != OK) {
+            codec->release();
+            state.SkipWithError("cannot start the encoder");
+            break;
+        }
+        state.ResumeTiming();
+
+        status_t err = EncodeFrames(codec, config);
+
+        state.PauseTiming();
+        codec->release();
+        state.ResumeTiming();
+        if (err != OK) {
+            state.SkipWithError("encoding failed");
+            break;
+        }
+    }
+    state.counters["frames_per_sec"] = benchmark::Counter(
+            state.iterations() * kNumFrames, benchmark::Counter::kIsRate);
+
+    looper->stop();
+    base::SetProperty("debug.stagefright.ccodec_work_batch_size", "");
+}
+
+BENCHMARK_CAPTURE(BM_EncodeWithWorkBatching, AAC, AacConfig)
+        ->ArgName("batch")->Arg(1)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_EncodeWithWorkBatching, AVC_240fps, Avc240FpsConfig)
+        ->ArgName("batch")->Arg(1)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+int main(int argc, char **argv) {
+    ProcessState::self()->startThreadPool();
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
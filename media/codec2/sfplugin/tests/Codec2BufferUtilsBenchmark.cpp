@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "Codec2BufferUtilsBenchmark"
+#include <utils/Log.h>
+
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <C2PlatformSupport.h>
+
+#include <media/stagefright/foundation/AUtils.h>
+#include <system/graphics.h>
+
+#include "Codec2BufferUtils.h"
+
+using namespace android;
+
+enum ImageLayout : int64_t {
+    kLayoutI420,
+    kLayoutNV12,
+    kLayoutI420PaddedStride,
+    kLayoutP010,
+    kLayoutYUV420Planar16,
+};
+
+static bool Is10Bit(int64_t layout) {
+    return layout == kLayoutP010 || layout == kLayoutYUV420Planar16;
+}
+
+// Returns the media image of the given layout, and the size of its buffer.
+static MediaImage2 CreateImage(int64_t layout, uint32_t width, uint32_t height, size_t *size) {
+    uint32_t stride = align(width, 64u);
+    const uint32_t vstride = align(height, 16u);
+    switch (layout) {
+        case kLayoutI420PaddedStride:
+            stride = align(width, 64u) + 64;
+            [[fallthrough]];
+        case kLayoutI420:
+            *size = stride * vstride * 3 / 2;
+            return CreateYUV420PlanarMediaImage2(width, height, stride, vstride);
+        case kLayoutNV12:
+            *size = stride * vstride * 3 / 2;
+            return CreateYUV420SemiPlanarMediaImage2(width, height, stride, vstride);
+        case kLayoutP010:
+            *size = stride * vstride * 3;
+            return CreateP010MediaImage2(width, height, stride, vstride);
+        case kLayoutYUV420Planar16:
+        default:
+            *size = stride * vstride * 3;
+            return CreateYUV420Planar16MediaImage2(width, height, stride, vstride);
+    }
+}
+
+/*******************************************************************
+ * Copies a frame between a gralloc buffer and a media image of the given
+ * layout, in the direction given by the last argument (0: from the gralloc
+ * buffer, 1: to the gralloc buffer).
+ *******************************************************************/
+static void BM_ImageCopy(benchmark::State& state) {
+    const int64_t layout = state.range(0);
+    const uint32_t width = state.range(1);
+    const uint32_t height = state.range(2);
+    const bool toView = state.range(3) != 0;
+
+    std::shared_ptr<C2BlockPool> pool;
+    if (GetCodec2BlockPool(C2BlockPool::BASIC_GRAPHIC, nullptr, &pool) != C2_OK) {
+        state.SkipWithError("cannot get the graphic block pool");
+        return;
+    }
+    std::shared_ptr<C2GraphicBlock> block;
+    if (pool->fetchGraphicBlock(
+            width, height,
+            Is10Bit(layout) ? HAL_PIXEL_FORMAT_YCBCR_P010 : HAL_PIXEL_FORMAT_YCbCr_420_888,
+            C2MemoryUsage{C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE},
+            &block) != C2_OK) {
+        state.SkipWithError("cannot allocate the graphic block");
+        return;
+    }
+    C2GraphicView view = block->map().get();
+    if (view.error() != C2_OK) {
+        state.SkipWithError("cannot map the graphic block");
+        return;
+    }
+
+    size_t size = 0;
+    MediaImage2 img = CreateImage(layout, width, height, &size);
+    std::vector<uint8_t> imgBuffer(size, 0x80);
+
+    for (auto _ : state) {
+        status_t err = toView ? ImageCopy(view, imgBuffer.data(), &img)
+                              : ImageCopy(imgBuffer.data(), &img, view);
+        if (err != OK) {
+            state.SkipWithError("ImageCopy failed");
+            return;
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(
+            state.iterations() * (int64_t)width * height * 3 / 2 * (Is10Bit(layout) ? 2 : 1));
+}
+
+static void ImageCopyArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"layout", "width", "height", "toView"});
+    for (int64_t layout : {kLayoutI420, kLayoutNV12, kLayoutI420PaddedStride,
+                           kLayoutP010, kLayoutYUV420Planar16}) {
+        for (const auto &[width, height] : {std::pair<int64_t, int64_t>{1920, 1080},
+                                            std::pair<int64_t, int64_t>{3840, 2160}}) {
+            for (int64_t toView : {0, 1}) {
+                b->Args({layout, width, height, toView});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_ImageCopy)->Apply(ImageCopyArgs)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Codec2BufferUtils.h"
+
+#include <string.h>
+
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <C2BlockInternal.h>
+
+namespace android {
+
+namespace {
+
+// A P010 graphic allocation in memory, with the given stride in pixels.
+class P010MemoryAllocation : public C2GraphicAllocation {
+public:
+    P010MemoryAllocation(uint32_t width, uint32_t height, uint32_t stride)
+        : C2GraphicAllocation(width, height),
+          mRowInc(stride * 2),
+          mMemory(mRowInc * (height + (height + 1) / 2), 0) {
+    }
+
+    c2_status_t map(
+            C2Rect rect, C2MemoryUsage usage, C2Fence *fence,
+            C2PlanarLayout *layout, uint8_t **addr) override {
+        (void)rect;
+        (void)usage;
+        (void)fence;
+        *layout = {
+            C2PlanarLayout::TYPE_YUV,
+            3,  /* numPlanes */
+            2,  /* rootPlanes */
+            {},  /* planes --- to be filled below */
+        };
+        layout->planes[C2PlanarLayout::PLANE_Y] = {
+            C2PlaneInfo::CHANNEL_Y, 2 /* colInc */, mRowInc, 1, 1, 16, 10, 6,
+            C2PlaneInfo::NATIVE, C2PlanarLayout::PLANE_Y, 0 /* offset */,
+        };
+        layout->planes[C2PlanarLayout::PLANE_U] = {
+            C2PlaneInfo::CHANNEL_CB, 4 /* colInc */, mRowInc, 2, 2, 16, 10, 6,
+            C2PlaneInfo::NATIVE, C2PlanarLayout::PLANE_U, 0 /* offset */,
+        };
+        layout->planes[C2PlanarLayout::PLANE_V] = {
+            C2PlaneInfo::CHANNEL_CR, 4 /* colInc */, mRowInc, 2, 2, 16, 10, 6,
+            C2PlaneInfo::NATIVE, C2PlanarLayout::PLANE_U, 2 /* offset */,
+        };
+        const size_t uvOffset = mRowInc * height();
+        addr[C2PlanarLayout::PLANE_Y] = mMemory.data();
+        addr[C2PlanarLayout::PLANE_U] = mMemory.data() + uvOffset;
+        addr[C2PlanarLayout::PLANE_V] = mMemory.data() + uvOffset + 2;
+        return C2_OK;
+    }
+
+    c2_status_t unmap(uint8_t **, C2Rect, C2Fence *) override { return C2_OK; }
+
+    C2Allocator::id_t getAllocatorId() const override { return -1; }
+
+    const C2Handle *handle() const override { return nullptr; }
+
+    bool equals(const std::shared_ptr<const C2GraphicAllocation> &other) const override {
+        return other.get() == this;
+    }
+
+private:
+    const int32_t mRowInc;
+    std::vector<uint8_t> mMemory;
+};
+
+// 10-bit sample of plane |plane| at |row| and |col|
+uint16_t SampleValue(int plane, uint32_t row, uint32_t col) {
+    return (plane * 331 + row * 29 + col * 7) & 0x3ff;
+}
+
+// Samples may be at odd addresses in media images.
+uint16_t ReadSample(
+        const uint8_t *base, int32_t rowInc, int32_t colInc, uint32_t row, uint32_t col) {
+    uint16_t sample;
+    memcpy(&sample, base + (ptrdiff_t)rowInc * row + colInc * col, sizeof(sample));
+    return sample;
+}
+
+void WriteSample(
+        uint8_t *base, int32_t rowInc, int32_t colInc, uint32_t row, uint32_t col,
+        uint16_t sample) {
+    memcpy(base + (ptrdiff_t)rowInc * row + colInc * col, &sample, sizeof(sample));
+}
+
+}  // namespace
+
+// Copies between a P010 view and a YUV420Planar16 image, with odd sizes and strides that are
+// not multiples of the vector width. An odd image stride puts the chroma samples of every
+// other row at odd addresses.
+class P010Planar16CopyTest
+    : public ::testing::TestWithParam<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> {
+protected:
+    void SetUp() override {
+        std::tie(mWidth, mHeight, mViewStride, mImageStride) = GetParam();
+        mBlock = _C2BlockFactory::CreateGraphicBlock(
+                std::make_shared<P010MemoryAllocation>(mWidth, mHeight, mViewStride));
+        ASSERT_NE(nullptr, mBlock);
+        const uint32_t vstride = mHeight + (mHeight & 1);
+        mImage = CreateYUV420Planar16MediaImage2(mWidth, mHeight, mImageStride, vstride);
+        ASSERT_TRUE(IsYUV420Planar16(&mImage));
+        // filled with a value that is not a 10-bit sample, to detect writes past the frame
+        mImageBuffer.assign(mImageStride * vstride * 3, 0xFF);
+    }
+
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mViewStride;
+    uint32_t mImageStride;
+    std::shared_ptr<C2GraphicBlock> mBlock;
+    MediaImage2 mImage;
+    std::vector<uint8_t> mImageBuffer;
+};
+
+TEST_P(P010Planar16CopyTest, CopiesAndShiftsSamples) {
+    C2GraphicView view = mBlock->map().get();
+    ASSERT_EQ(C2_OK, view.error());
+    ASSERT_TRUE(IsP010(view));
+    const C2PlanarLayout layout = view.layout();
+    const uint32_t chromaWidth = (mWidth + 1) / 2;
+    const uint32_t chromaHeight = (mHeight + 1) / 2;
+    const uint32_t planeWidths[] = {mWidth, chromaWidth, chromaWidth};
+    const uint32_t planeHeights[] = {mHeight, chromaHeight, chromaHeight};
+
+    // P010 holds the samples in the high bits
+    for (int p = 0; p < 3; ++p) {
+        const C2PlaneInfo &plane = layout.planes[p];
+        for (uint32_t row = 0; row < planeHeights[p]; ++row) {
+            for (uint32_t col = 0; col < planeWidths[p]; ++col) {
+                WriteSample(view.data()[p], plane.rowInc, plane.colInc, row, col,
+                            SampleValue(p, row, col) << 6);
+            }
+        }
+    }
+
+    ASSERT_EQ(OK, ImageCopy(mImageBuffer.data(), &mImage, view));
+
+    // YUV420Planar16 holds the samples in the low bits
+    for (int p = 0; p < 3; ++p) {
+        const MediaImage2::PlaneInfo &plane = mImage.mPlane[p];
+        const uint8_t *base = mImageBuffer.data() + plane.mOffset;
+        for (uint32_t row = 0; row < planeHeights[p]; ++row) {
+            for (uint32_t col = 0; col < planeWidths[p]; ++col) {
+                ASSERT_EQ(SampleValue(p, row, col),
+                          ReadSample(base, plane.mRowInc, plane.mColInc, row, col))
+                        << "plane " << p << " row " << row << " col " << col;
+            }
+            // the padding of the row is left alone
+            if ((planeWidths[p] + 1) * 2 <= (uint32_t)plane.mRowInc) {
+                ASSERT_EQ(0xFFFF,
+                          ReadSample(base, plane.mRowInc, plane.mColInc, row, planeWidths[p]))
+                        << "plane " << p << " row " << row;
+            }
+        }
+    }
+
+    // and back
+    for (int p = 0; p < 3; ++p) {
+        const C2PlaneInfo &plane = layout.planes[p];
+        for (uint32_t row = 0; row < planeHeights[p]; ++row) {
+            for (uint32_t col = 0; col < planeWidths[p]; ++col) {
+                WriteSample(view.data()[p], plane.rowInc, plane.colInc, row, col, 0);
+            }
+        }
+    }
+    ASSERT_EQ(OK, ImageCopy(view, mImageBuffer.data(), &mImage));
+    for (int p = 0; p < 3; ++p) {
+        const C2PlaneInfo &plane = layout.planes[p];
+        for (uint32_t row = 0; row < planeHeights[p]; ++row) {
+            for (uint32_t col = 0; col < planeWidths[p]; ++col) {
+                ASSERT_EQ(SampleValue(p, row, col) << 6,
+                          ReadSample(view.data()[p], plane.rowInc, plane.colInc, row, col))
+                        << "plane " << p << " row " << row << " col " << col;
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        Codec2BufferUtilsTest,
+        P010Planar16CopyTest,
+        ::testing::Values(
+                // width, height, view stride, image stride
+                std::make_tuple(320u, 240u, 320u, 320u),
+                std::make_tuple(321u, 241u, 333u, 326u),
+                std::make_tuple(33u, 17u, 35u, 34u),
+                std::make_tuple(33u, 17u, 35u, 35u),
+                std::make_tuple(1u, 1u, 2u, 2u),
+                std::make_tuple(15u, 3u, 17u, 18u)));
+
+}  // namespace android
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WorkBatcher.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+namespace {
+
+constexpr nsecs_t kLatencyNs = 5000000;  // 5 ms
+
+WorkBatcher::Items MakeItems(uint64_t firstIndex, size_t count) {
+    WorkBatcher::Items items;
+    for (size_t i = 0; i < count; ++i) {
+        items.emplace_back(new C2Work);
+        items.back()->input.ordinal.frameIndex = firstIndex + i;
+    }
+    return items;
+}
+
+std::vector<uint64_t> FrameIndices(const WorkBatcher::Items &items) {
+    std::vector<uint64_t> indices;
+    for (const std::unique_ptr<C2Work> &work : items) {
+        indices.push_back(work->input.ordinal.frameIndex.peeku());
+    }
+    return indices;
+}
+
+}  // namespace
+
+class WorkBatcherTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mBatcher.maxSize(4u).maxLatencyNs(kLatencyNs);
+    }
+
+    // Adds one item per call, like CCodecBufferChannel::queueInputBufferInternal(), and appends
+    // the batches that fall due to |mSubmitted|.
+    void add(uint64_t frameIndex, bool submitNow, nsecs_t nowNs) {
+        WorkBatcher::Items items = MakeItems(frameIndex, 1u);
+        WorkBatcher::Items batch;
+        nsecs_t delayNs;
+        if (mBatcher.add(&items, submitNow, nowNs, &batch, &delayNs)) {
+            EXPECT_FALSE(batch.empty());
+            EXPECT_EQ(-1, delayNs);
+            submit(&batch);
+        }
+        EXPECT_TRUE(items.empty());
+    }
+
+    void submit(WorkBatcher::Items *batch) {
+        mBatchSizes.push_back(batch->size());
+        mSubmitted.splice(mSubmitted.end(), *batch);
+    }
+
+    WorkBatcher mBatcher;
+    WorkBatcher::Items mSubmitted;
+    std::vector<size_t> mBatchSizes;
+};
+
+TEST_F(WorkBatcherTest, SubmitsFullBatchesInOrder) {
+    for (uint64_t i = 0; i < 10u; ++i) {
+        add(i, false /* submitNow */, 0);
+    }
+    EXPECT_EQ((std::vector<size_t>{4u, 4u}), mBatchSizes);
+    EXPECT_EQ((std::vector<uint64_t>{0, 1, 2, 3, 4, 5, 6, 7}), FrameIndices(mSubmitted));
+    EXPECT_EQ(2u, mBatcher.numBatches());
+
+    // The rest of the items stay in order behind the submitted ones.
+    WorkBatcher::Items rest;
+    EXPECT_EQ(2u, mBatcher.takeAll(&rest));
+    submit(&rest);
+    EXPECT_EQ((std::vector<uint64_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), FrameIndices(mSubmitted));
+}
+
+TEST_F(WorkBatcherTest, SubmitsPartialBatchForSubmitNow) {
+    add(0, false /* submitNow */, 0);
+    add(1, false /* submitNow */, 0);
+    add(2, true /* submitNow */, 0);
+    add(3, false /* submitNow */, 0);
+    EXPECT_EQ(std::vector<size_t>{3u}, mBatchSizes);
+    EXPECT_EQ((std::vector<uint64_t>{0, 1, 2}), FrameIndices(mSubmitted));
+}
+
+TEST_F(WorkBatcherTest, AsksForDelayOncePerBatch) {
+    WorkBatcher::Items batch;
+    WorkBatcher::Items items = MakeItems(0u, 1u);
+    nsecs_t delayNs;
+    EXPECT_FALSE(mBatcher.add(&items, false /* submitNow */, 1000, &batch, &delayNs));
+    EXPECT_EQ(kLatencyNs, delayNs);
+
+    items = MakeItems(1u, 1u);
+    EXPECT_FALSE(mBatcher.add(&items, false /* submitNow */, 2000, &batch, &delayNs));
+    EXPECT_EQ(-1, delayNs);
+    EXPECT_TRUE(batch.empty());
+}
+
+TEST_F(WorkBatcherTest, SubmitsExpiredBatchesInOrder) {
+    add(0, false /* submitNow */, 0);
+    add(1, false /* submitNow */, kLatencyNs / 2);
+
+    // Not due yet.
+    WorkBatcher::Items batch;
+    EXPECT_FALSE(mBatcher.takeExpired(kLatencyNs - 1, &batch));
+    EXPECT_TRUE(batch.empty());
+
+    EXPECT_TRUE(mBatcher.takeExpired(kLatencyNs, &batch));
+    submit(&batch);
+    EXPECT_FALSE(mBatcher.takeExpired(kLatencyNs, &batch));
+
+    // An item added after the first item expired takes the whole batch along.
+    add(2, false /* submitNow */, 2 * kLatencyNs);
+    add(3, false /* submitNow */, 3 * kLatencyNs);
+    EXPECT_EQ((std::vector<size_t>{2u, 2u}), mBatchSizes);
+    EXPECT_EQ((std::vector<uint64_t>{0, 1, 2, 3}), FrameIndices(mSubmitted));
+}
+
+TEST_F(WorkBatcherTest, IgnoresExpiryOfEarlierBatch) {
+    add(0, false /* submitNow */, 0);
+    add(1, true /* submitNow */, 0);
+    // A new batch started after the one the expiry was scheduled for.
+    add(2, false /* submitNow */, kLatencyNs / 2);
+
+    WorkBatcher::Items batch;
+    EXPECT_FALSE(mBatcher.takeExpired(kLatencyNs, &batch));
+    EXPECT_TRUE(mBatcher.takeExpired(kLatencyNs / 2 + kLatencyNs, &batch));
+    submit(&batch);
+    EXPECT_EQ((std::vector<uint64_t>{0, 1, 2}), FrameIndices(mSubmitted));
+}
+
+TEST_F(WorkBatcherTest, DiscardsPendingItemsOnFlush) {
+    for (uint64_t i = 0; i < 6u; ++i) {
+        add(i, false /* submitNow */, 0);
+    }
+    ASSERT_EQ((std::vector<uint64_t>{0, 1, 2, 3}), FrameIndices(mSubmitted));
+
+    WorkBatcher::Items discarded;
+    EXPECT_EQ(2u, mBatcher.takeAll(&discarded));
+    EXPECT_EQ((std::vector<uint64_t>{4, 5}), FrameIndices(discarded));
+    EXPECT_EQ(0u, mBatcher.takeAll(&discarded));
+
+    // The pending expiry finds nothing to submit.
+    WorkBatcher::Items batch;
+    EXPECT_FALSE(mBatcher.takeExpired(kLatencyNs, &batch));
+    EXPECT_TRUE(batch.empty());
+
+    // Items queued after the flush start a new batch, with a new delay.
+    WorkBatcher::Items items = MakeItems(10u, 1u);
+    nsecs_t delayNs;
+    EXPECT_FALSE(mBatcher.add(&items, false /* submitNow */, kLatencyNs, &batch, &delayNs));
+    EXPECT_EQ(kLatencyNs, delayNs);
+    EXPECT_FALSE(mBatcher.takeExpired(2 * kLatencyNs - 1, &batch));
+    EXPECT_TRUE(mBatcher.takeExpired(2 * kLatencyNs, &batch));
+    submit(&batch);
+    EXPECT_EQ((std::vector<uint64_t>{0, 1, 2, 3, 10}), FrameIndices(mSubmitted));
+}
+
+TEST_F(WorkBatcherTest, SubmitsEveryItemWithoutLatency) {
+    mBatcher.maxLatencyNs(0);
+    add(0, false /* submitNow */, 0);
+    add(1, false /* submitNow */, 0);
+    EXPECT_EQ((std::vector<size_t>{1u, 1u}), mBatchSizes);
+}
+
+}  // namespace android
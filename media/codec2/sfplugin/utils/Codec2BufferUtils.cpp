@@ -22,6 +22,9 @@
 
 #include <libyuv.h>
 
+#include <stdio.h>
+#include <string.h>
+
 #include <list>
 #include <mutex>
 
@@ -33,6 +36,13 @@
 
 #include "Codec2BufferUtils.h"
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#define USE_NEON 1
+#include <arm_neon.h>
+#else
+#define USE_NEON 0
+#endif
+
 namespace android {
 
 namespace {
@@ -57,6 +67,22 @@ struct MemCopier<false, S> {
     }
 };
 
+/**
+ * Copies a row of pixels between a MediaImage and a graphic view.
+ *
+ * \param S pixel size in bytes if known at compile time, or 0 to use |bpp|
+ */
+template<bool ToMediaImage, size_t S, typename ImgPtr, typename ViewPtr>
+inline static void _PixelRowCopy(
+        ImgPtr imgPtr, ViewPtr viewPtr, uint32_t width,
+        int32_t imgColInc, int32_t viewColInc, size_t bpp) {
+    for (uint32_t col = 0; col < width; ++col) {
+        MemCopier<ToMediaImage, S>::copy(imgPtr, viewPtr, S ? S : bpp);
+        imgPtr += imgColInc;
+        viewPtr += viewColInc;
+    }
+}
+
 /**
  * Copies between a MediaImage and a graphic view.
  *
@@ -103,12 +129,20 @@ static status_t _ImageCopy(View &view, const MediaImage2 *img, ImagePixel *imgBa
             }
         } else {
             for (uint32_t row = 0; row < planeH; ++row) {
-                decltype(imgRow) imgPtr = imgRow;
-                decltype(viewRow) viewPtr = viewRow;
-                for (uint32_t col = 0; col < planeW; ++col) {
-                    MemCopier<ToMediaImage, 0>::copy(imgPtr, viewPtr, bpp);
-                    imgPtr += img->mPlane[i].mColInc;
-                    viewPtr += plane.colInc;
+                // fixed-size copies for the common depths so that they are not library calls
+                switch (bpp) {
+                    case 1:
+                        _PixelRowCopy<ToMediaImage, 1>(imgRow, viewRow, planeW,
+                                img->mPlane[i].mColInc, plane.colInc, bpp);
+                        break;
+                    case 2:
+                        _PixelRowCopy<ToMediaImage, 2>(imgRow, viewRow, planeW,
+                                img->mPlane[i].mColInc, plane.colInc, bpp);
+                        break;
+                    default:
+                        _PixelRowCopy<ToMediaImage, 0>(imgRow, viewRow, planeW,
+                                img->mPlane[i].mColInc, plane.colInc, bpp);
+                        break;
                 }
                 imgRow += img->mPlane[i].mRowInc;
                 viewRow += plane.rowInc;
@@ -118,6 +152,276 @@ static status_t _ImageCopy(View &view, const MediaImage2 *img, ImagePixel *imgBa
     return OK;
 }
 
+// YUV420Planar16 holds 10-bit samples in the low bits, P010 in the high bits.
+constexpr int kP010Shift = 6;
+
+/**
+ * Returns |sample| shifted left by |shift| bits, or right if |shift| is negative.
+ */
+inline static uint16_t Shift16(uint16_t sample, int shift) {
+    return shift >= 0 ? (uint16_t)(sample << shift) : (uint16_t)(sample >> -shift);
+}
+
+// 16-bit samples of media images may be at odd addresses.
+inline static uint16_t Load16(const uint8_t *ptr) {
+    uint16_t sample;
+    memcpy(&sample, ptr, sizeof(sample));
+    return sample;
+}
+
+inline static void Store16(uint8_t *ptr, uint16_t sample) {
+    memcpy(ptr, &sample, sizeof(sample));
+}
+
+#if USE_NEON
+/**
+ * Returns true iff all pointers allow 16-bit vector access.
+ */
+static bool IsAligned16(std::initializer_list<const uint8_t *> ptrs) {
+    uintptr_t bits = 0;
+    for (const uint8_t *ptr : ptrs) {
+        bits |= (uintptr_t)ptr;
+    }
+    return (bits & 1) == 0;
+}
+#endif
+
+/**
+ * Copies a row of 16-bit samples, shifted as by Shift16().
+ */
+static void ShiftRow16(const uint8_t *src, uint8_t *dst, uint32_t width, int shift) {
+    uint32_t x = 0;
+#if USE_NEON
+    if (IsAligned16({src, dst})) {
+        const int16x8_t shifts = vdupq_n_s16(shift);
+        for (; x + 8 <= width; x += 8) {
+            vst1q_u16((uint16_t *)dst + x,
+                      vshlq_u16(vld1q_u16((const uint16_t *)src + x), shifts));
+        }
+    }
+#endif
+    for (; x < width; ++x) {
+        Store16(dst + 2 * x, Shift16(Load16(src + 2 * x), shift));
+    }
+}
+
+/**
+ * Splits a row of interleaved 16-bit chroma samples into separate U and V rows, shifting
+ * the samples as by Shift16().
+ */
+static void SplitUVRow16(
+        const uint8_t *uv, uint8_t *u, uint8_t *v, uint32_t width, int shift) {
+    uint32_t x = 0;
+#if USE_NEON
+    if (IsAligned16({uv, u, v})) {
+        const int16x8_t shifts = vdupq_n_s16(shift);
+        for (; x + 8 <= width; x += 8) {
+            uint16x8x2_t pixels = vld2q_u16((const uint16_t *)uv + 2 * x);
+            vst1q_u16((uint16_t *)u + x, vshlq_u16(pixels.val[0], shifts));
+            vst1q_u16((uint16_t *)v + x, vshlq_u16(pixels.val[1], shifts));
+        }
+    }
+#endif
+    for (; x < width; ++x) {
+        Store16(u + 2 * x, Shift16(Load16(uv + 4 * x), shift));
+        Store16(v + 2 * x, Shift16(Load16(uv + 4 * x + 2), shift));
+    }
+}
+
+/**
+ * Interleaves a row of 16-bit U and V samples, shifting them as by Shift16().
+ */
+static void MergeUVRow16(
+        const uint8_t *u, const uint8_t *v, uint8_t *uv, uint32_t width, int shift) {
+    uint32_t x = 0;
+#if USE_NEON
+    if (IsAligned16({u, v, uv})) {
+        const int16x8_t shifts = vdupq_n_s16(shift);
+        for (; x + 8 <= width; x += 8) {
+            uint16x8x2_t pixels;
+            pixels.val[0] = vshlq_u16(vld1q_u16((const uint16_t *)u + x), shifts);
+            pixels.val[1] = vshlq_u16(vld1q_u16((const uint16_t *)v + x), shifts);
+            vst2q_u16((uint16_t *)uv + 2 * x, pixels);
+        }
+    }
+#endif
+    for (; x < width; ++x) {
+        Store16(uv + 4 * x, Shift16(Load16(u + 2 * x), shift));
+        Store16(uv + 4 * x + 2, Shift16(Load16(v + 2 * x), shift));
+    }
+}
+
+static void ShiftPlane16(
+        const uint8_t *src, int32_t srcStride, uint8_t *dst, int32_t dstStride,
+        uint32_t width, uint32_t height, int shift) {
+    for (uint32_t row = 0; row < height; ++row) {
+        ShiftRow16(src, dst, width, shift);
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+static void SplitUVPlane16(
+        const uint8_t *srcUV, int32_t srcStrideUV,
+        uint8_t *dstU, int32_t dstStrideU, uint8_t *dstV, int32_t dstStrideV,
+        uint32_t width, uint32_t height, int shift) {
+    for (uint32_t row = 0; row < height; ++row) {
+        SplitUVRow16(srcUV, dstU, dstV, width, shift);
+        srcUV += srcStrideUV;
+        dstU += dstStrideU;
+        dstV += dstStrideV;
+    }
+}
+
+static void MergeUVPlane16(
+        const uint8_t *srcU, int32_t srcStrideU, const uint8_t *srcV, int32_t srcStrideV,
+        uint8_t *dstUV, int32_t dstStrideUV, uint32_t width, uint32_t height, int shift) {
+    for (uint32_t row = 0; row < height; ++row) {
+        MergeUVRow16(srcU, srcV, dstUV, width, shift);
+        srcU += srcStrideU;
+        srcV += srcStrideV;
+        dstUV += dstStrideUV;
+    }
+}
+
+enum _Yuv420Layout {
+    LAYOUT_OTHER,
+    LAYOUT_NV12,
+    LAYOUT_NV21,
+    LAYOUT_I420,
+    LAYOUT_P010,
+    LAYOUT_PLANAR16,
+};
+
+/**
+ * Planes of a YUV 420 image or view, for the layouts that have optimized copies.
+ */
+struct _Yuv420Planes {
+    _Yuv420Layout layout;
+    uint8_t *y;
+    uint8_t *u;
+    uint8_t *v;
+    int32_t strideY;
+    int32_t strideU;
+    int32_t strideV;
+
+    explicit _Yuv420Planes(const C2GraphicView &view)
+        : layout(IsNV12(view) ? LAYOUT_NV12
+                : IsNV21(view) ? LAYOUT_NV21
+                : IsI420(view) ? LAYOUT_I420
+                : IsP010(view) ? LAYOUT_P010
+                : LAYOUT_OTHER),
+          // the view is only written to if it is the destination
+          y(const_cast<uint8_t *>(view.data()[0])),
+          u(const_cast<uint8_t *>(view.data()[1])),
+          v(const_cast<uint8_t *>(view.data()[2])),
+          strideY(view.layout().planes[0].rowInc),
+          strideU(view.layout().planes[1].rowInc),
+          strideV(view.layout().planes[2].rowInc) {
+    }
+
+    _Yuv420Planes(const uint8_t *imgBase, const MediaImage2 *img)
+        : layout(IsNV12(img) ? LAYOUT_NV12
+                : IsNV21(img) ? LAYOUT_NV21
+                : IsI420(img) ? LAYOUT_I420
+                : IsP010(img) ? LAYOUT_P010
+                : IsYUV420Planar16(img) ? LAYOUT_PLANAR16
+                : LAYOUT_OTHER),
+          y(const_cast<uint8_t *>(imgBase) + img->mPlane[0].mOffset),
+          u(const_cast<uint8_t *>(imgBase) + img->mPlane[1].mOffset),
+          v(const_cast<uint8_t *>(imgBase) + img->mPlane[2].mOffset),
+          strideY(img->mPlane[0].mRowInc),
+          strideU(img->mPlane[1].mRowInc),
+          strideV(img->mPlane[2].mRowInc) {
+    }
+};
+
+/**
+ * Copies between YUV 420 layouts that have libyuv or SIMD kernels.
+ *
+ * \return false if there is no optimized copy for this pair of layouts, in which case
+ *         nothing was copied.
+ */
+static bool _OptimizedImageCopy(
+        const _Yuv420Planes &s, const _Yuv420Planes &d, int width, int height) {
+    static const char *kLayoutNames[] = {
+        "other", "NV12", "NV21", "I420", "P010", "YUV420Planar16",
+    };
+    const bool is16Bit = s.layout == LAYOUT_P010 || s.layout == LAYOUT_PLANAR16;
+    if (s.layout == LAYOUT_OTHER || d.layout == LAYOUT_OTHER
+            || is16Bit != (d.layout == LAYOUT_P010 || d.layout == LAYOUT_PLANAR16)
+            || (s.layout == LAYOUT_PLANAR16 && d.layout == LAYOUT_PLANAR16)) {
+        return false;
+    }
+
+    char traceName[64];
+    snprintf(traceName, sizeof(traceName), "ImageCopy: %s->%s",
+             kLayoutNames[s.layout], kLayoutNames[d.layout]);
+    ScopedTrace trace(ATRACE_TAG, traceName);
+
+    // chroma planes also cover the last column and row of odd sized frames
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    int result = 0;
+    switch (s.layout * 8 + d.layout) {
+        case LAYOUT_NV12 * 8 + LAYOUT_NV12:
+            libyuv::CopyPlane(s.y, s.strideY, d.y, d.strideY, width, height);
+            libyuv::CopyPlane(s.u, s.strideU, d.u, d.strideU, chromaWidth * 2, chromaHeight);
+            break;
+        case LAYOUT_NV12 * 8 + LAYOUT_NV21:
+            result = libyuv::NV21ToNV12(s.y, s.strideY, s.u, s.strideU,
+                                        d.y, d.strideY, d.v, d.strideV, width, height);
+            break;
+        case LAYOUT_NV12 * 8 + LAYOUT_I420:
+            result = libyuv::NV12ToI420(s.y, s.strideY, s.u, s.strideU, d.y, d.strideY,
+                                        d.u, d.strideU, d.v, d.strideV, width, height);
+            break;
+        case LAYOUT_NV21 * 8 + LAYOUT_NV12:
+            result = libyuv::NV21ToNV12(s.y, s.strideY, s.v, s.strideV,
+                                        d.y, d.strideY, d.u, d.strideU, width, height);
+            break;
+        case LAYOUT_NV21 * 8 + LAYOUT_NV21:
+            libyuv::CopyPlane(s.y, s.strideY, d.y, d.strideY, width, height);
+            libyuv::CopyPlane(s.v, s.strideV, d.v, d.strideV, chromaWidth * 2, chromaHeight);
+            break;
+        case LAYOUT_NV21 * 8 + LAYOUT_I420:
+            result = libyuv::NV21ToI420(s.y, s.strideY, s.v, s.strideV, d.y, d.strideY,
+                                        d.u, d.strideU, d.v, d.strideV, width, height);
+            break;
+        case LAYOUT_I420 * 8 + LAYOUT_NV12:
+            result = libyuv::I420ToNV12(s.y, s.strideY, s.u, s.strideU, s.v, s.strideV,
+                                        d.y, d.strideY, d.u, d.strideU, width, height);
+            break;
+        case LAYOUT_I420 * 8 + LAYOUT_NV21:
+            result = libyuv::I420ToNV21(s.y, s.strideY, s.u, s.strideU, s.v, s.strideV,
+                                        d.y, d.strideY, d.v, d.strideV, width, height);
+            break;
+        case LAYOUT_I420 * 8 + LAYOUT_I420:
+            libyuv::CopyPlane(s.y, s.strideY, d.y, d.strideY, width, height);
+            libyuv::CopyPlane(s.u, s.strideU, d.u, d.strideU, chromaWidth, chromaHeight);
+            libyuv::CopyPlane(s.v, s.strideV, d.v, d.strideV, chromaWidth, chromaHeight);
+            break;
+        case LAYOUT_P010 * 8 + LAYOUT_P010:
+            libyuv::CopyPlane(s.y, s.strideY, d.y, d.strideY, width * 2, height);
+            libyuv::CopyPlane(s.u, s.strideU, d.u, d.strideU, chromaWidth * 4, chromaHeight);
+            break;
+        case LAYOUT_P010 * 8 + LAYOUT_PLANAR16:
+            ShiftPlane16(s.y, s.strideY, d.y, d.strideY, width, height, -kP010Shift);
+            SplitUVPlane16(s.u, s.strideU, d.u, d.strideU, d.v, d.strideV,
+                           chromaWidth, chromaHeight, -kP010Shift);
+            break;
+        case LAYOUT_PLANAR16 * 8 + LAYOUT_P010:
+            ShiftPlane16(s.y, s.strideY, d.y, d.strideY, width, height, kP010Shift);
+            MergeUVPlane16(s.u, s.strideU, s.v, s.strideV, d.u, d.strideU,
+                           chromaWidth, chromaHeight, kP010Shift);
+            break;
+        default:
+            return false;
+    }
+    // libyuv conversions only fail on invalid arguments
+    return result == 0;
+}
+
 }  // namespace
 
 status_t ImageCopy(uint8_t *imgBase, const MediaImage2 *img, const C2GraphicView &view) {
@@ -127,79 +431,9 @@ status_t ImageCopy(uint8_t *imgBase, const MediaImage2 *img, const C2GraphicView
         || view.crop().height != img->mHeight) {
         return BAD_VALUE;
     }
-    const uint8_t* src_y = view.data()[0];
-    const uint8_t* src_u = view.data()[1];
-    const uint8_t* src_v = view.data()[2];
-    int32_t src_stride_y = view.layout().planes[0].rowInc;
-    int32_t src_stride_u = view.layout().planes[1].rowInc;
-    int32_t src_stride_v = view.layout().planes[2].rowInc;
-    uint8_t* dst_y = imgBase + img->mPlane[0].mOffset;
-    uint8_t* dst_u = imgBase + img->mPlane[1].mOffset;
-    uint8_t* dst_v = imgBase + img->mPlane[2].mOffset;
-    int32_t dst_stride_y = img->mPlane[0].mRowInc;
-    int32_t dst_stride_u = img->mPlane[1].mRowInc;
-    int32_t dst_stride_v = img->mPlane[2].mRowInc;
-    int width = view.crop().width;
-    int height = view.crop().height;
-
-    if (IsNV12(view)) {
-        if (IsNV12(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->NV12");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_u, src_stride_u, dst_u, dst_stride_u, width, height / 2);
-            return OK;
-        } else if (IsNV21(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->NV21");
-            if (!libyuv::NV21ToNV12(src_y, src_stride_y, src_u, src_stride_u,
-                                    dst_y, dst_stride_y, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        } else if (IsI420(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->I420");
-            if (!libyuv::NV12ToI420(src_y, src_stride_y, src_u, src_stride_u, dst_y, dst_stride_y,
-                                    dst_u, dst_stride_u, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        }
-    } else if (IsNV21(view)) {
-        if (IsNV12(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->NV12");
-            if (!libyuv::NV21ToNV12(src_y, src_stride_y, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_u, dst_stride_u, width, height)) {
-                return OK;
-            }
-        } else if (IsNV21(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->NV21");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_v, src_stride_v, dst_v, dst_stride_v, width, height / 2);
-            return OK;
-        } else if (IsI420(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->I420");
-            if (!libyuv::NV21ToI420(src_y, src_stride_y, src_v, src_stride_v, dst_y, dst_stride_y,
-                                    dst_u, dst_stride_u, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        }
-    } else if (IsI420(view)) {
-        if (IsNV12(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->NV12");
-            if (!libyuv::I420ToNV12(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_u, dst_stride_u, width, height)) {
-                return OK;
-            }
-        } else if (IsNV21(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->NV21");
-            if (!libyuv::I420ToNV21(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        } else if (IsI420(img)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->I420");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_u, src_stride_u, dst_u, dst_stride_u, width / 2, height / 2);
-            libyuv::CopyPlane(src_v, src_stride_v, dst_v, dst_stride_v, width / 2, height / 2);
-            return OK;
-        }
+    if (_OptimizedImageCopy(_Yuv420Planes(view), _Yuv420Planes(imgBase, img),
+                            view.crop().width, view.crop().height)) {
+        return OK;
     }
     ScopedTrace trace(ATRACE_TAG, "ImageCopy: generic");
     return _ImageCopy<true>(view, img, imgBase);
@@ -212,78 +446,9 @@ status_t ImageCopy(C2GraphicView &view, const uint8_t *imgBase, const MediaImage
         || view.crop().height != img->mHeight) {
         return BAD_VALUE;
     }
-    const uint8_t* src_y = imgBase + img->mPlane[0].mOffset;
-    const uint8_t* src_u = imgBase + img->mPlane[1].mOffset;
-    const uint8_t* src_v = imgBase + img->mPlane[2].mOffset;
-    int32_t src_stride_y = img->mPlane[0].mRowInc;
-    int32_t src_stride_u = img->mPlane[1].mRowInc;
-    int32_t src_stride_v = img->mPlane[2].mRowInc;
-    uint8_t* dst_y = view.data()[0];
-    uint8_t* dst_u = view.data()[1];
-    uint8_t* dst_v = view.data()[2];
-    int32_t dst_stride_y = view.layout().planes[0].rowInc;
-    int32_t dst_stride_u = view.layout().planes[1].rowInc;
-    int32_t dst_stride_v = view.layout().planes[2].rowInc;
-    int width = view.crop().width;
-    int height = view.crop().height;
-    if (IsNV12(img)) {
-        if (IsNV12(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->NV12");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_u, src_stride_u, dst_u, dst_stride_u, width, height / 2);
-            return OK;
-        } else if (IsNV21(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->NV21");
-            if (!libyuv::NV21ToNV12(src_y, src_stride_y, src_u, src_stride_u,
-                                    dst_y, dst_stride_y, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        } else if (IsI420(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV12->I420");
-            if (!libyuv::NV12ToI420(src_y, src_stride_y, src_u, src_stride_u, dst_y, dst_stride_y,
-                                    dst_u, dst_stride_u, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        }
-    } else if (IsNV21(img)) {
-        if (IsNV12(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->NV12");
-            if (!libyuv::NV21ToNV12(src_y, src_stride_y, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_u, dst_stride_u, width, height)) {
-                return OK;
-            }
-        } else if (IsNV21(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->NV21");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_v, src_stride_v, dst_v, dst_stride_v, width, height / 2);
-            return OK;
-        } else if (IsI420(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: NV21->I420");
-            if (!libyuv::NV21ToI420(src_y, src_stride_y, src_v, src_stride_v, dst_y, dst_stride_y,
-                                    dst_u, dst_stride_u, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        }
-    } else if (IsI420(img)) {
-        if (IsNV12(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->NV12");
-            if (!libyuv::I420ToNV12(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_u, dst_stride_u, width, height)) {
-                return OK;
-            }
-        } else if (IsNV21(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->NV21");
-            if (!libyuv::I420ToNV21(src_y, src_stride_y, src_u, src_stride_u, src_v, src_stride_v,
-                                    dst_y, dst_stride_y, dst_v, dst_stride_v, width, height)) {
-                return OK;
-            }
-        } else if (IsI420(view)) {
-            ScopedTrace trace(ATRACE_TAG, "ImageCopy: I420->I420");
-            libyuv::CopyPlane(src_y, src_stride_y, dst_y, dst_stride_y, width, height);
-            libyuv::CopyPlane(src_u, src_stride_u, dst_u, dst_stride_u, width / 2, height / 2);
-            libyuv::CopyPlane(src_v, src_stride_v, dst_v, dst_stride_v, width / 2, height / 2);
-            return OK;
-        }
+    if (_OptimizedImageCopy(_Yuv420Planes(imgBase, img), _Yuv420Planes(view),
+                            view.crop().width, view.crop().height)) {
+        return OK;
     }
     ScopedTrace trace(ATRACE_TAG, "ImageCopy: generic");
     return _ImageCopy<false>(view, img, imgBase);
@@ -435,6 +600,39 @@ bool IsI420(const MediaImage2 *img) {
             && img->mPlane[2].mOffset > img->mPlane[1].mOffset);
 }
 
+static bool IsYUV420_16bit(const MediaImage2 *img) {
+    return (img->mType == MediaImage2::MEDIA_IMAGE_TYPE_YUV
+            && img->mNumPlanes == 3
+            && img->mBitDepth == 10
+            && img->mBitDepthAllocated == 16
+            && img->mPlane[0].mColInc == 2
+            && img->mPlane[0].mHorizSubsampling == 1
+            && img->mPlane[0].mVertSubsampling == 1
+            && img->mPlane[1].mHorizSubsampling == 2
+            && img->mPlane[1].mVertSubsampling == 2
+            && img->mPlane[2].mHorizSubsampling == 2
+            && img->mPlane[2].mVertSubsampling == 2);
+}
+
+bool IsP010(const MediaImage2 *img) {
+    if (!IsYUV420_16bit(img)) {
+        return false;
+    }
+    return (img->mPlane[1].mColInc == 4
+            && img->mPlane[2].mColInc == 4
+            && img->mPlane[1].mRowInc == img->mPlane[2].mRowInc
+            && (img->mPlane[2].mOffset == img->mPlane[1].mOffset + 2));
+}
+
+bool IsYUV420Planar16(const MediaImage2 *img) {
+    if (!IsYUV420_16bit(img)) {
+        return false;
+    }
+    return (img->mPlane[1].mColInc == 2
+            && img->mPlane[2].mColInc == 2
+            && img->mPlane[2].mOffset != img->mPlane[1].mOffset);
+}
+
 FlexLayout GetYuv420FlexibleLayout() {
     static FlexLayout sLayout = []{
         AHardwareBuffer_Desc desc = {
@@ -575,6 +773,76 @@ MediaImage2 CreateYUV420SemiPlanarMediaImage2(
     };
 }
 
+MediaImage2 CreateYUV420Planar16MediaImage2(
+        uint32_t width, uint32_t height, uint32_t stride, uint32_t vstride) {
+    return MediaImage2 {
+        .mType = MediaImage2::MEDIA_IMAGE_TYPE_YUV,
+        .mNumPlanes = 3,
+        .mWidth = width,
+        .mHeight = height,
+        .mBitDepth = 10,
+        .mBitDepthAllocated = 16,
+        .mPlane = {
+            {
+                .mOffset = 0,
+                .mColInc = 2,
+                .mRowInc = (int32_t)stride * 2,
+                .mHorizSubsampling = 1,
+                .mVertSubsampling = 1,
+            },
+            {
+                .mOffset = stride * vstride * 2,
+                .mColInc = 2,
+                .mRowInc = (int32_t)stride,
+                .mHorizSubsampling = 2,
+                .mVertSubsampling = 2,
+            },
+            {
+                .mOffset = stride * vstride * 5 / 2,
+                .mColInc = 2,
+                .mRowInc = (int32_t)stride,
+                .mHorizSubsampling = 2,
+                .mVertSubsampling = 2,
+            }
+        },
+    };
+}
+
+MediaImage2 CreateP010MediaImage2(
+        uint32_t width, uint32_t height, uint32_t stride, uint32_t vstride) {
+    return MediaImage2 {
+        .mType = MediaImage2::MEDIA_IMAGE_TYPE_YUV,
+        .mNumPlanes = 3,
+        .mWidth = width,
+        .mHeight = height,
+        .mBitDepth = 10,
+        .mBitDepthAllocated = 16,
+        .mPlane = {
+            {
+                .mOffset = 0,
+                .mColInc = 2,
+                .mRowInc = (int32_t)stride * 2,
+                .mHorizSubsampling = 1,
+                .mVertSubsampling = 1,
+            },
+            {
+                .mOffset = stride * vstride * 2,
+                .mColInc = 4,
+                .mRowInc = (int32_t)stride * 2,
+                .mHorizSubsampling = 2,
+                .mVertSubsampling = 2,
+            },
+            {
+                .mOffset = stride * vstride * 2 + 2,
+                .mColInc = 4,
+                .mRowInc = (int32_t)stride * 2,
+                .mHorizSubsampling = 2,
+                .mVertSubsampling = 2,
+            }
+        },
+    };
+}
+
 // Matrix coefficient to convert RGB to Planar YUV data.
 // Each sub-array represents the 3X3 coeff used with R, G and B
 static const int16_t bt601Matrix[2][3][3] = {
@@ -65,6 +65,30 @@ MediaImage2 CreateYUV420PlanarMediaImage2(
 MediaImage2 CreateYUV420SemiPlanarMediaImage2(
         uint32_t width, uint32_t height, uint32_t stride, uint32_t vstride);
 
+/**
+ * Creates a MediaImage2 with 16-bit planar YUV 420 layout (YUV420Planar16), holding 10-bit
+ * values in the least significant bits, as the software decoders produce it. ImageCopy()
+ * shifts the values when copying between this layout and a P010 view.
+ *
+ * \param width width of image in pixels
+ * \param height height of image in pixels
+ * \param stride stride of image in pixels
+ * \param vstride vertical stride of image in pixels
+ */
+MediaImage2 CreateYUV420Planar16MediaImage2(
+        uint32_t width, uint32_t height, uint32_t stride, uint32_t vstride);
+
+/**
+ * Creates a MediaImage2 with P010 layout.
+ *
+ * \param width width of image in pixels
+ * \param height height of image in pixels
+ * \param stride stride of image in pixels
+ * \param vstride vertical stride of image in pixels
+ */
+MediaImage2 CreateP010MediaImage2(
+        uint32_t width, uint32_t height, uint32_t stride, uint32_t vstride);
+
 /**
  * Copies a graphic view into a media image.
  *
@@ -137,6 +161,16 @@ bool IsNV21(const MediaImage2 *img);
  */
 bool IsI420(const MediaImage2 *img);
 
+/**
+ * Returns true iff a MediaImage2 has a P010 layout.
+ */
+bool IsP010(const MediaImage2 *img);
+
+/**
+ * Returns true iff a MediaImage2 has a 16-bit planar YUV 420 layout holding 10-bit values.
+ */
+bool IsYUV420Planar16(const MediaImage2 *img);
+
 enum FlexLayout {
     FLEX_LAYOUT_UNKNOWN,
     FLEX_LAYOUT_PLANAR,
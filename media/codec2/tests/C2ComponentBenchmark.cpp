@@ -0,0 +1,568 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** \file
+ * Throughput benchmark of the software Codec2 components.
+ *
+ * Every component of the platform component store is run in-process. Decoders are fed the
+ * elementary streams and .info files of the Codec2 VTS corpus, and encoders are fed generated
+ * frames. Each benchmark reports frames per second, per-frame latency percentiles, the peak
+ * resident memory and the number of allocations per frame.
+ *
+ * Usage:
+ *   codec2_component_benchmark [-P <corpus dir>] [--benchmark_filter=<regex>]
+ *           [--benchmark_format=json] [--benchmark_out=<file>]
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2ComponentBenchmark"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <C2Component.h>
+#include <C2Config.h>
+#include <C2PlatformSupport.h>
+#include <SimpleC2Interface.h>
+#include <system/graphics.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+// Counts heap allocations so that the benchmarks can report allocations per frame.
+static std::atomic<size_t> gNumAllocations(0);
+
+void *operator new(size_t size) {
+    gNumAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        abort();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace {
+
+// Directory of the corpus, as for the Codec2 VTS tests.
+std::string gCorpusDir = "/data/local/tmp/media/";
+
+// Maximum number of work items queued to a component at a time.
+constexpr size_t kMaxWorkInFlight = 16;
+constexpr nsecs_t kTimeOutNs = 10000000000LL;  // 10s
+
+// Number of frames encoded per iteration, and number of distinct input frames cycled through.
+constexpr uint64_t kNumEncodeFrames = 300;
+constexpr size_t kNumEncodeInputs = 8;
+constexpr uint32_t kAudioSamplesPerFrame = 1024;
+
+// Flags of the .info files of the corpus.
+constexpr uint32_t kInfoFlagConfigData = 1 << 5;
+
+struct CorpusStream {
+    const char *mediaType;
+    const char *streamFile;
+    const char *infoFile;
+};
+
+const CorpusStream kCorpus[] = {
+    {"video/avc", "bbb_avc_176x144_300kbps_60fps.h264", "bbb_avc_176x144_300kbps_60fps.info"},
+    {"video/avc", "bbb_avc_640x360_768kbps_30fps.h264", "bbb_avc_640x360_768kbps_30fps.info"},
+    {"video/hevc", "bbb_hevc_176x144_176kbps_60fps.hevc", "bbb_hevc_176x144_176kbps_60fps.info"},
+    {"video/hevc", "bbb_hevc_640x360_1600kbps_30fps.hevc",
+     "bbb_hevc_640x360_1600kbps_30fps.info"},
+    {"video/mpeg2", "bbb_mpeg2_352x288_1mbps_60fps.m2v", "bbb_mpeg2_352x288_1mbps_60fps.info"},
+    {"video/mp4v-es", "bbb_mpeg4_352x288_512kbps_30fps.m4v",
+     "bbb_mpeg4_352x288_512kbps_30fps.info"},
+    {"video/x-vnd.on2.vp8", "bbb_vp8_640x360_2mbps_30fps.vp8", "bbb_vp8_640x360_2mbps_30fps.info"},
+    {"video/x-vnd.on2.vp9", "bbb_vp9_176x144_285kbps_60fps.vp9",
+     "bbb_vp9_176x144_285kbps_60fps.info"},
+    {"video/x-vnd.on2.vp9", "bbb_vp9_640x360_1600kbps_30fps.vp9",
+     "bbb_vp9_640x360_1600kbps_30fps.info"},
+    {"video/av01", "bbb_av1_176_144.av1", "bbb_av1_176_144.info"},
+    {"video/av01", "bbb_av1_640_360.av1", "bbb_av1_640_360.info"},
+    {"audio/mp4a-latm", "bbb_aac_stereo_128kbps_48000hz.aac",
+     "bbb_aac_stereo_128kbps_48000hz.info"},
+    {"audio/mpeg", "bbb_mp3_stereo_192kbps_48000hz.mp3", "bbb_mp3_stereo_192kbps_48000hz.info"},
+    {"audio/opus", "bbb_opus_stereo_128kbps_48000hz.opus",
+     "bbb_opus_stereo_128kbps_48000hz.info"},
+    {"audio/flac", "bbb_flac_stereo_680kbps_48000hz.flac",
+     "bbb_flac_stereo_680kbps_48000hz.info"},
+};
+
+// Thread counts of the software decoders; 0 selects the count from the resolution.
+const int64_t kThreadCounts[] = {0, 1, 2, 4};
+
+// Resolutions of the video encoders.
+const std::pair<int64_t, int64_t> kEncodeSizes[] = {{176, 144}, {640, 360}, {1280, 720}};
+
+struct Frame {
+    std::vector<uint8_t> data;
+    uint32_t flags;
+    uint64_t timestampUs;
+};
+
+// Reads a stream of the corpus; returns false if it is missing.
+bool ReadStream(const CorpusStream &stream, std::vector<Frame> *frames) {
+    std::ifstream info(gCorpusDir + stream.infoFile);
+    std::ifstream data(gCorpusDir + stream.streamFile, std::ios::binary);
+    if (!info.is_open() || !data.is_open()) {
+        return false;
+    }
+    int32_t size;
+    uint32_t flags;
+    uint64_t timestampUs;
+    while (info >> size >> flags >> timestampUs) {
+        Frame frame;
+        frame.data.resize(size);
+        if (!data.read(reinterpret_cast<char *>(frame.data.data()), size)) {
+            return false;
+        }
+        frame.flags = (flags == kInfoFlagConfigData) ? C2FrameData::FLAG_CODEC_CONFIG : 0;
+        frame.timestampUs = timestampUs;
+        frames->push_back(std::move(frame));
+    }
+    return !frames->empty();
+}
+
+/**
+ * Tracks the work queued to a component, and records the latency of every
+ * finished work item.
+ */
+class BenchmarkListener : public C2Component::Listener {
+public:
+    void onWorkDone_nb(std::weak_ptr<C2Component> comp,
+                       std::list<std::unique_ptr<C2Work>> workItems) override {
+        (void)comp;
+        nsecs_t now = systemTime();
+        std::lock_guard<std::mutex> lock(mLock);
+        for (const std::unique_ptr<C2Work> &work : workItems) {
+            if (work->result != C2_OK) {
+                ALOGD("work #%llu failed: %d",
+                      (unsigned long long)work->input.ordinal.frameIndex.peeku(), work->result);
+                mError = true;
+                continue;
+            }
+            if (work->worklets.empty()) {
+                continue;
+            }
+            const C2FrameData &output = work->worklets.front()->output;
+            if (output.flags & C2FrameData::FLAG_INCOMPLETE) {
+                continue;
+            }
+            uint64_t frameIndex = work->input.ordinal.frameIndex.peeku();
+            if (frameIndex < mQueuedAtNs.size()) {
+                mLatenciesNs.push_back(now - mQueuedAtNs[frameIndex]);
+            }
+            --mNumInFlight;
+            if (output.flags & C2FrameData::FLAG_END_OF_STREAM) {
+                mEos = true;
+            }
+        }
+        mCondition.notify_all();
+    }
+
+    void onTripped_nb(std::weak_ptr<C2Component> comp,
+                      std::vector<std::shared_ptr<C2SettingResult>> settingResults) override {
+        (void)comp;
+        (void)settingResults;
+    }
+
+    void onError_nb(std::weak_ptr<C2Component> comp, uint32_t errorCode) override {
+        (void)comp;
+        ALOGE("component error %u", errorCode);
+        std::lock_guard<std::mutex> lock(mLock);
+        mError = true;
+        mCondition.notify_all();
+    }
+
+    void reset(size_t numFrames) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mQueuedAtNs.assign(numFrames, 0);
+        mNumInFlight = 0;
+        mEos = false;
+        mError = false;
+    }
+
+    // Waits until work item |frameIndex| can be queued; returns false on error or time out.
+    bool waitToQueue(uint64_t frameIndex) {
+        std::unique_lock<std::mutex> lock(mLock);
+        if (!mCondition.wait_for(lock, std::chrono::nanoseconds(kTimeOutNs), [this] {
+                return mError || mNumInFlight < kMaxWorkInFlight; })) {
+            return false;
+        }
+        ++mNumInFlight;
+        mQueuedAtNs[frameIndex] = systemTime();
+        return !mError;
+    }
+
+    // Waits for the end of stream; returns false on error or time out.
+    bool waitForEos() {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mCondition.wait_for(lock, std::chrono::nanoseconds(kTimeOutNs), [this] {
+            return mError || mEos; }) && !mError;
+    }
+
+    // Reports the latency percentiles of all finished work.
+    void reportLatencies(benchmark::State &state) {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mLatenciesNs.empty()) {
+            return;
+        }
+        std::sort(mLatenciesNs.begin(), mLatenciesNs.end());
+        for (int percentile : {50, 90, 99}) {
+            size_t index = (mLatenciesNs.size() - 1) * percentile / 100;
+            state.counters["latency_p" + std::to_string(percentile) + "_ms"] =
+                    mLatenciesNs[index] / 1E6;
+        }
+    }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::vector<nsecs_t> mQueuedAtNs;
+    std::vector<nsecs_t> mLatenciesNs;
+    size_t mNumInFlight = 0;
+    bool mEos = false;
+    bool mError = false;
+};
+
+// Resets the peak resident set size of this process.
+void ResetPeakRss() {
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if (file) {
+        fputs("5", file);
+        fclose(file);
+    }
+}
+
+// Returns the peak resident set size of this process in kilobytes, or 0 if unknown.
+long GetPeakRssKb() {
+    FILE *file = fopen("/proc/self/status", "r");
+    if (!file) {
+        return 0;
+    }
+    char line[128];
+    long peakKb = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "VmHWM: %ld kB", &peakKb) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+    return peakKb;
+}
+
+std::shared_ptr<C2Buffer> CreateLinearBuffer(
+        const std::shared_ptr<C2BlockPool> &pool, const uint8_t *data, size_t size) {
+    std::shared_ptr<C2LinearBlock> block;
+    if (pool->fetchLinearBlock(
+            size, {C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE}, &block) != C2_OK) {
+        return nullptr;
+    }
+    C2WriteView view = block->map().get();
+    if (view.error() != C2_OK) {
+        return nullptr;
+    }
+    memcpy(view.base(), data, size);
+    return C2Buffer::CreateLinearBuffer(block->share(0, size, C2Fence()));
+}
+
+// Fills a YUV 4:2:0 block with a pattern that varies with |seed|.
+bool FillGraphicBlock(const std::shared_ptr<C2GraphicBlock> &block, uint32_t seed) {
+    C2GraphicView view = block->map().get();
+    if (view.error() != C2_OK) {
+        return false;
+    }
+    const C2PlanarLayout &layout = view.layout();
+    for (uint32_t i = 0; i < layout.numPlanes; ++i) {
+        const C2PlaneInfo &plane = layout.planes[i];
+        uint8_t *base = view.data()[i];
+        uint32_t width = view.width() / plane.colSampling;
+        uint32_t height = view.height() / plane.rowSampling;
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                base[y * plane.rowInc + x * plane.colInc] = (x + y * 3 + seed * 7) & 0xFF;
+            }
+        }
+    }
+    return true;
+}
+
+// Runs one component through all of |frames| and EOS for every iteration.
+template <typename CreateInput>
+void RunComponent(benchmark::State &state, const std::string &name, uint32_t threadCount,
+                  const std::vector<C2Param *> &config, uint64_t numFrames,
+                  const CreateInput &createInput) {
+    std::shared_ptr<C2ComponentStore> store = GetCodec2PlatformComponentStore();
+    std::shared_ptr<BenchmarkListener> listener = std::make_shared<BenchmarkListener>();
+    ResetPeakRss();
+    size_t numAllocations = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::shared_ptr<C2Component> component;
+        if (store->createComponent(name, &component) != C2_OK ||
+                component->setListener_vb(listener, C2_MAY_BLOCK) != C2_OK) {
+            state.SkipWithError("cannot create the component");
+            break;
+        }
+        std::vector<C2Param *> params = config;
+        C2SoftwareThreadCountTuning threads(threadCount);
+        params.push_back(&threads);
+        std::vector<std::unique_ptr<C2SettingResult>> failures;
+        // components without a thread count setting ignore it
+        (void)component->intf()->config_vb(params, C2_MAY_BLOCK, &failures);
+        if (component->start() != C2_OK) {
+            state.SkipWithError("cannot start the component");
+            break;
+        }
+        listener->reset(numFrames + 1);
+        size_t allocationsBefore = gNumAllocations.load();
+        state.ResumeTiming();
+
+        bool success = true;
+        for (uint64_t frameIndex = 0; success && frameIndex <= numFrames; ++frameIndex) {
+            std::unique_ptr<C2Work> work(new C2Work);
+            work->input.ordinal.frameIndex = frameIndex;
+            work->input.flags = C2FrameData::FLAG_END_OF_STREAM;
+            if (frameIndex < numFrames) {
+                success = createInput(frameIndex, work.get());
+            }
+            work->worklets.emplace_back(new C2Worklet);
+            std::list<std::unique_ptr<C2Work>> items;
+            items.push_back(std::move(work));
+            success = success && listener->waitToQueue(frameIndex)
+                    && component->queue_nb(&items) == C2_OK;
+        }
+        success = success && listener->waitForEos();
+
+        state.PauseTiming();
+        numAllocations += gNumAllocations.load() - allocationsBefore;
+        component->stop();
+        component->release();
+        component.reset();
+        state.ResumeTiming();
+        if (!success) {
+            state.SkipWithError("the component failed");
+            break;
+        }
+    }
+    state.counters["frames_per_sec"] = benchmark::Counter(
+            state.iterations() * numFrames, benchmark::Counter::kIsRate);
+    state.counters["allocs_per_frame"] =
+            (double)numAllocations / std::max<int64_t>(state.iterations() * numFrames, 1);
+    state.counters["peak_rss_kb"] = GetPeakRssKb();
+    listener->reportLatencies(state);
+}
+
+/*******************************************************************
+ * Decodes a stream of the corpus with the given decoder and thread count.
+ *******************************************************************/
+void BM_Decode(benchmark::State &state, std::string name, CorpusStream stream) {
+    const uint32_t threadCount = state.range(0);
+    std::vector<Frame> frames;
+    if (!ReadStream(stream, &frames)) {
+        state.SkipWithError("cannot read the stream; check the -P corpus directory");
+        return;
+    }
+    std::shared_ptr<C2BlockPool> pool;
+    if (GetCodec2BlockPool(C2BlockPool::BASIC_LINEAR, nullptr, &pool) != C2_OK) {
+        state.SkipWithError("cannot get the linear block pool");
+        return;
+    }
+    RunComponent(state, name, threadCount, {}, frames.size(),
+                 [&frames, &pool](uint64_t frameIndex, C2Work *work) {
+        const Frame &frame = frames[frameIndex];
+        work->input.flags = (C2FrameData::flags_t)frame.flags;
+        work->input.ordinal.timestamp = frame.timestampUs;
+        if (frame.data.empty()) {
+            return true;
+        }
+        std::shared_ptr<C2Buffer> buffer =
+                CreateLinearBuffer(pool, frame.data.data(), frame.data.size());
+        work->input.buffers.push_back(buffer);
+        return buffer != nullptr;
+    });
+}
+
+/*******************************************************************
+ * Encodes generated frames of the given size with the given video encoder.
+ *******************************************************************/
+void BM_EncodeVideo(benchmark::State &state, std::string name) {
+    const uint32_t width = state.range(0);
+    const uint32_t height = state.range(1);
+    std::shared_ptr<C2BlockPool> pool;
+    if (GetCodec2BlockPool(C2BlockPool::BASIC_GRAPHIC, nullptr, &pool) != C2_OK) {
+        state.SkipWithError("cannot get the graphic block pool");
+        return;
+    }
+    std::vector<std::shared_ptr<C2GraphicBlock>> blocks(kNumEncodeInputs);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (pool->fetchGraphicBlock(
+                width, height, HAL_PIXEL_FORMAT_YCBCR_420_888,
+                {C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE}, &blocks[i]) != C2_OK ||
+                !FillGraphicBlock(blocks[i], i)) {
+            state.SkipWithError("cannot allocate the input frames");
+            return;
+        }
+    }
+    C2StreamPictureSizeInfo::input size(0u, width, height);
+    C2StreamFrameRateInfo::output frameRate(0u, 30.);
+    RunComponent(state, name, 0, {&size, &frameRate}, kNumEncodeFrames,
+                 [&blocks, width, height](uint64_t frameIndex, C2Work *work) {
+        work->input.flags = (C2FrameData::flags_t)0;
+        work->input.ordinal.timestamp = frameIndex * 1000000 / 30;
+        work->input.buffers.push_back(C2Buffer::CreateGraphicBuffer(
+                blocks[frameIndex % blocks.size()]->share(C2Rect(width, height), C2Fence())));
+        return true;
+    });
+}
+
+/*******************************************************************
+ * Encodes generated 16-bit PCM with the given audio encoder, at the sample
+ * rate and channel count the encoder settles on for 48kHz stereo.
+ *******************************************************************/
+void BM_EncodeAudio(benchmark::State &state, std::string name) {
+    std::shared_ptr<C2ComponentStore> store = GetCodec2PlatformComponentStore();
+    std::shared_ptr<C2ComponentInterface> intf;
+    C2StreamSampleRateInfo::input sampleRate(0u, 48000);
+    C2StreamChannelCountInfo::input channelCount(0u, 2);
+    std::vector<std::unique_ptr<C2SettingResult>> failures;
+    if (store->createInterface(name, &intf) != C2_OK) {
+        state.SkipWithError("cannot create the interface");
+        return;
+    }
+    (void)intf->config_vb({&sampleRate, &channelCount}, C2_MAY_BLOCK, &failures);
+    (void)intf->query_vb({&sampleRate, &channelCount}, {}, C2_MAY_BLOCK, nullptr);
+
+    std::shared_ptr<C2BlockPool> pool;
+    if (GetCodec2BlockPool(C2BlockPool::BASIC_LINEAR, nullptr, &pool) != C2_OK) {
+        state.SkipWithError("cannot get the linear block pool");
+        return;
+    }
+    const size_t frameSize = kAudioSamplesPerFrame * channelCount.value * sizeof(int16_t);
+    std::vector<uint8_t> pcm(frameSize * kNumEncodeInputs);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        pcm[i] = (i * 37 + (i >> 8)) & 0xFF;
+    }
+    const uint64_t frameDurationUs =
+            1000000ull * kAudioSamplesPerFrame / std::max(sampleRate.value, 1u);
+    RunComponent(state, name, 0, {&sampleRate, &channelCount}, kNumEncodeFrames,
+                 [&pcm, &pool, frameSize, frameDurationUs](uint64_t frameIndex, C2Work *work) {
+        work->input.flags = (C2FrameData::flags_t)0;
+        work->input.ordinal.timestamp = frameIndex * frameDurationUs;
+        std::shared_ptr<C2Buffer> buffer = CreateLinearBuffer(
+                pool, pcm.data() + (frameIndex % kNumEncodeInputs) * frameSize, frameSize);
+        work->input.buffers.push_back(buffer);
+        return buffer != nullptr;
+    });
+}
+
+// Registers the benchmarks of every software component of the platform store.
+void RegisterBenchmarks() {
+    std::shared_ptr<C2ComponentStore> store = GetCodec2PlatformComponentStore();
+    for (const std::shared_ptr<const C2Component::Traits> &traits : store->listComponents()) {
+        const std::string &name = traits->name;
+        const bool isVideo = traits->domain == C2Component::DOMAIN_VIDEO;
+        if (traits->kind == C2Component::KIND_DECODER) {
+            for (const CorpusStream &stream : kCorpus) {
+                if (traits->mediaType != stream.mediaType) {
+                    continue;
+                }
+                benchmark::internal::Benchmark *b = benchmark::RegisterBenchmark(
+                        ("BM_Decode/" + name + "/" + stream.streamFile).c_str(),
+                        BM_Decode, name, stream);
+                b->ArgName("threads");
+                for (int64_t threadCount : kThreadCounts) {
+                    b->Arg(threadCount);
+                    if (!isVideo) {
+                        break;
+                    }
+                }
+                b->Unit(benchmark::kMillisecond)->UseRealTime();
+            }
+        } else if (traits->kind == C2Component::KIND_ENCODER && isVideo) {
+            benchmark::internal::Benchmark *b = benchmark::RegisterBenchmark(
+                    ("BM_EncodeVideo/" + name).c_str(), BM_EncodeVideo, name);
+            b->ArgNames({"width", "height"});
+            for (const auto &[width, height] : kEncodeSizes) {
+                b->Args({width, height});
+            }
+            b->Unit(benchmark::kMillisecond)->UseRealTime();
+        } else if (traits->kind == C2Component::KIND_ENCODER
+                && traits->domain == C2Component::DOMAIN_AUDIO) {
+            benchmark::RegisterBenchmark(
+                    ("BM_EncodeAudio/" + name).c_str(), BM_EncodeAudio, name)
+                    ->Unit(benchmark::kMillisecond)->UseRealTime();
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    // -P <dir> selects the corpus directory; the remaining arguments go to the benchmark library.
+    int numArgs = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            gCorpusDir = argv[++i];
+            if (!gCorpusDir.empty() && gCorpusDir.back() != '/') {
+                gCorpusDir += '/';
+            }
+        } else {
+            argv[numArgs++] = argv[i];
+        }
+    }
+    argc = numArgs;
+
+    RegisterBenchmarks();
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
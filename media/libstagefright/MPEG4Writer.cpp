@@ -31,6 +31,7 @@
 #include <utils/Log.h>
 
 #include <functional>
+#include <vector>
 #include <fcntl.h>
 
 #include <media/stagefright/MediaSource.h>
@@ -73,6 +74,20 @@ static const int64_t kInitialDelayTimeUs     = 700000LL;
 static const int64_t kMaxMetadataSize = 0x4000000LL;   // 64MB max per-frame metadata size
 static const int64_t kMaxCttsOffsetTimeUs = 30 * 60 * 1000000LL;  // 30 minutes
 static const size_t kESDSScratchBufferSize = 10;  // kMaxAtomSize in Mpeg4Extractor 64MB
+// Bytes per block of the compact sample tables
+static const uint32_t kTableBlockSize = 4096;
+// Fixed parts of 'moov' and of each 'trak', on top of the sample tables.
+// These have to be changed whenever its needed in the future.
+static const int64_t kApproxMoovHeadersSize = 500;
+static const int64_t kApproxTrackHeadersSize = 800;
+// Fragmented MP4: stop waiting for a lagging track once the others are this many
+// fragment durations ahead of the next cut.
+static const int64_t kFragmentMaxLagFactor = 4;
+// Number of 'sidx' references reserved when the duration limit is unknown.
+static const size_t kDefaultSidxReferenceCount = 4096;
+// 'trun' sample_flags, ISO/IEC 14496-12 8.8.3.1
+static const uint32_t kFragmentSyncSampleFlags = 0x02000000;     // depends on no other
+static const uint32_t kFragmentNonSyncSampleFlags = 0x01010000;  // non-sync, depends on others
 
 static const char kMetaKey_Version[]    = "com.android.version";
 static const char kMetaKey_Manufacturer[]      = "com.android.manufacturer";
@@ -160,9 +175,11 @@ public:
     bool isAvif() const { return mIsAvif; }
     bool isHeif() const { return mIsHeif; }
     bool isAudio() const { return mIsAudio; }
+    bool isVideo() const { return mIsVideo; }
     bool isMPEG4() const { return mIsMPEG4; }
     bool usePrefix() const { return mIsAvc || mIsHevc || mIsHeic || mIsDovi; }
     bool isExifData(MediaBufferBase *buffer, uint32_t *tiffHdrOffset) const;
+    int32_t getTimeScale() const { return mTimeScale; }
     void addChunkOffset(off64_t offset);
     void addItemOffsetAndSize(off64_t offset, size_t size, bool isExif);
     void flushItemRefs();
@@ -173,6 +190,8 @@ public:
     const char *getTrackType() const;
     void resetInternal();
     int64_t trackMetaDataSize();
+    // Bytes currently held in memory by the sample tables.
+    size_t sampleTablesAllocatedSize() const;
 
 private:
     // A helper class to handle faster write box with table entries
@@ -311,6 +330,158 @@ private:
         DISALLOW_EVIL_CONSTRUCTORS(ListTableEntries);
     };
 
+    // A compact counterpart of ListTableEntries for the tables that grow with every
+    // sample or chunk. Each value is kept as the zigzag varint of its difference from
+    // the same column of the previous entry, so near-constant sizes and durations and
+    // monotonic sample ids and chunk offsets mostly take one or two bytes instead of
+    // four or eight. Values are added in host byte order and only expanded to their
+    // fixed width while the box is written out.
+    template<class TYPE, unsigned ENTRY_SIZE>
+    // ENTRY_SIZE: # of values in each entry
+    struct CompactTableEntries {
+        static_assert(ENTRY_SIZE > 0, "ENTRY_SIZE must be positive");
+        static_assert(sizeof(TYPE) == 4 || sizeof(TYPE) == 8, "TYPE must be 32 or 64 bits");
+
+        // Enough for any 64-bit value
+        static constexpr uint32_t kMaxVarintSize = 10;
+        // Entries expanded at a time in write()
+        static constexpr size_t kWriteBatchEntries = 256;
+
+        CompactTableEntries(uint32_t blockSize)
+            : mBlockSize(blockSize),
+            mTotalNumTableEntries(0),
+            mNumValuesInCurrEntry(0),
+            mCurrBlockOffset(0),
+            mCurrBlock(NULL) {
+            CHECK_GE(mBlockSize, kMaxVarintSize);
+            std::fill_n(mLastEntry, ENTRY_SIZE, 0);
+        }
+
+        // Free the allocated memory.
+        ~CompactTableEntries() {
+            for (const Block &block : mBlocks) {
+                delete[] block.mData;
+            }
+        }
+
+        // Store a single value.
+        // @arg value must be in host byte order and non-negative.
+        void add(const TYPE& value) {
+            int64_t curr = static_cast<int64_t>(value);
+            CHECK_GE(curr, 0);
+            int64_t delta = curr - mLastEntry[mNumValuesInCurrEntry];
+            mLastEntry[mNumValuesInCurrEntry] = curr;
+            uint64_t zigzag =
+                    (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+
+            if (mCurrBlock == NULL || mCurrBlockOffset + kMaxVarintSize > mBlockSize) {
+                mCurrBlock = new uint8_t[mBlockSize];
+                CHECK(mCurrBlock != NULL);
+                mBlocks.push_back({mCurrBlock, 0});
+                mCurrBlockOffset = 0;
+            }
+            while (zigzag >= 0x80) {
+                mCurrBlock[mCurrBlockOffset++] = (zigzag & 0x7f) | 0x80;
+                zigzag >>= 7;
+            }
+            mCurrBlock[mCurrBlockOffset++] = zigzag;
+            mBlocks.back().mSize = mCurrBlockOffset;
+
+            if (++mNumValuesInCurrEntry == ENTRY_SIZE) {
+                ++mTotalNumTableEntries;
+                mNumValuesInCurrEntry = 0;
+            }
+        }
+
+        // Write out the table entries:
+        // 1. the number of entries goes first
+        // 2. followed by the values in the table entries in order, in network byte order
+        // @arg writer the writer to actual write to the storage
+        // @arg update if set, is given each entry in host byte order before it is written
+        void write(MPEG4Writer *writer,
+                std::function<void(TYPE(& /* entry */)[ENTRY_SIZE])> update = nullptr) const {
+            CHECK_EQ(mNumValuesInCurrEntry, 0u);
+            writer->writeInt32(mTotalNumTableEntries);
+
+            TYPE entries[kWriteBatchEntries][ENTRY_SIZE];
+            int64_t lastEntry[ENTRY_SIZE] = {};
+            size_t numEntries = 0;
+            unsigned column = 0;
+            for (const Block &block : mBlocks) {
+                uint32_t pos = 0;
+                while (pos < block.mSize) {
+                    uint64_t zigzag = 0;
+                    uint32_t shift = 0;
+                    uint8_t byte;
+                    do {
+                        byte = block.mData[pos++];
+                        zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                        shift += 7;
+                    } while (byte & 0x80);
+                    lastEntry[column] += static_cast<int64_t>(zigzag >> 1) ^
+                            -static_cast<int64_t>(zigzag & 1);
+                    entries[numEntries][column] = static_cast<TYPE>(lastEntry[column]);
+
+                    if (++column == ENTRY_SIZE) {
+                        column = 0;
+                        if (update) {
+                            update(entries[numEntries]);
+                        }
+                        if (++numEntries == kWriteBatchEntries) {
+                            writeEntries(writer, entries, numEntries);
+                            numEntries = 0;
+                        }
+                    }
+                }
+            }
+            writeEntries(writer, entries, numEntries);
+        }
+
+        // Return the number of entries in the table.
+        uint32_t count() const { return mTotalNumTableEntries; }
+
+        // Return the value in the given column of the last complete entry, or 0 if none.
+        TYPE last(unsigned column) const {
+            CHECK_LT(column, ENTRY_SIZE);
+            return mTotalNumTableEntries == 0 ? 0 : static_cast<TYPE>(mLastEntry[column]);
+        }
+
+        // Return the number of bytes held by the table.
+        size_t allocatedSize() const { return mBlocks.size() * mBlockSize; }
+
+    private:
+        struct Block {
+            uint8_t *mData;
+            uint32_t mSize;  // bytes in use
+        };
+
+        static void writeEntries(
+                MPEG4Writer *writer, TYPE (*entries)[ENTRY_SIZE], size_t numEntries) {
+            if (numEntries == 0) {
+                return;
+            }
+            TYPE *values = entries[0];
+            for (size_t i = 0; i < numEntries * ENTRY_SIZE; ++i) {
+                if constexpr (sizeof(TYPE) == 8) {
+                    values[i] = hton64(values[i]);
+                } else {
+                    values[i] = htonl(values[i]);
+                }
+            }
+            writer->write(entries, sizeof(TYPE) * ENTRY_SIZE, numEntries);
+        }
+
+        uint32_t         mBlockSize;  // # bytes in a block
+        uint32_t         mTotalNumTableEntries;
+        uint32_t         mNumValuesInCurrEntry;  // up to ENTRY_SIZE
+        uint32_t         mCurrBlockOffset;
+        uint8_t          *mCurrBlock;
+        int64_t          mLastEntry[ENTRY_SIZE];
+        std::vector<Block> mBlocks;
+
+        DISALLOW_EVIL_CONSTRUCTORS(CompactTableEntries);
+    };
+
 
 
     MPEG4Writer *mOwner;
@@ -345,12 +516,15 @@ private:
     List<MediaBuffer *> mChunkSamples;
 
     bool mSamplesHaveSameSize;
-    ListTableEntries<uint32_t, 1> *mStszTableEntries;
-    ListTableEntries<off64_t, 1> *mCo64TableEntries;
-    ListTableEntries<uint32_t, 3> *mStscTableEntries;
-    ListTableEntries<uint32_t, 1> *mStssTableEntries;
-    ListTableEntries<uint32_t, 2> *mSttsTableEntries;
-    ListTableEntries<uint32_t, 2> *mCttsTableEntries;
+    // Sample counts are kept apart from the tables, which stay empty for fragmented files.
+    uint32_t mNumSamples;
+    uint32_t mNumSyncSamples;
+    CompactTableEntries<uint32_t, 1> *mStszTableEntries;
+    CompactTableEntries<off64_t, 1> *mCo64TableEntries;
+    CompactTableEntries<uint32_t, 3> *mStscTableEntries;
+    CompactTableEntries<uint32_t, 1> *mStssTableEntries;
+    CompactTableEntries<uint32_t, 2> *mSttsTableEntries;
+    CompactTableEntries<uint32_t, 2> *mCttsTableEntries;
     ListTableEntries<uint32_t, 3> *mElstTableEntries; // 3columns: segDuration, mediaTime, mediaRate
 
     int64_t mMinCttsOffsetTimeUs;
@@ -552,6 +726,14 @@ void MPEG4Writer::initInternal(int fd, bool isFirstSession) {
     mWriteBoxToMemory = false;
     mFreeBoxOffset = 0;
     mStreamableFile = false;
+    mFragmented = false;
+    mFragmentDurationUs = 0;
+    mFragmentedMoovWritten = false;
+    mFragmentSequenceNumber = 0;
+    mLastFragmentEndUs = -1;
+    mMehdOffset = 0;
+    mSidxOffset = 0;
+    mSidxReservedSize = 0;
     mTimeScale = -1;
     mHasFileLevelMeta = false;
     mIsAvif = false;
@@ -627,10 +809,12 @@ status_t MPEG4Writer::Track::dump(
     snprintf(buffer, SIZE, "       reached EOS: %s\n",
             mReachedEOS? "true": "false");
     result.append(buffer);
-    snprintf(buffer, SIZE, "       frames encoded : %d\n", mStszTableEntries->count());
+    snprintf(buffer, SIZE, "       frames encoded : %u\n", mNumSamples);
     result.append(buffer);
     snprintf(buffer, SIZE, "       duration encoded : %" PRId64 " us\n", mTrackDurationUs);
     result.append(buffer);
+    snprintf(buffer, SIZE, "       sample tables : %zu bytes\n", sampleTablesAllocatedSize());
+    result.append(buffer);
     ::write(fd, result.string(), result.size());
     return OK;
 }
@@ -947,6 +1131,18 @@ status_t MPEG4Writer::start(MetaData *param) {
     CHECK_GT(mTimeScale, 0);
     ALOGV("movie time scale: %d", mTimeScale);
 
+    int64_t fragmentDurationUs;
+    if (param && param->findInt64(kKeyFragmentDurationUs, &fragmentDurationUs) &&
+            fragmentDurationUs > 0) {
+        if (mHasFileLevelMeta) {
+            ALOGE("Fragmented output is not supported for image tracks");
+            return ERROR_UNSUPPORTED;
+        }
+        mFragmented = true;
+        mFragmentDurationUs = fragmentDurationUs;
+        ALOGI("Writing fragments of %" PRId64 " us", mFragmentDurationUs);
+    }
+
     /*
      * When the requested file size limit is small, the priority
      * is to meet the file size limit requirement, rather than
@@ -954,7 +1150,8 @@ status_t MPEG4Writer::start(MetaData *param) {
      * whether the actual recorded file is streamable or not.
      */
     mStreamableFile =
-        (mMaxFileSizeLimitBytes != 0 &&
+        (!mFragmented &&
+         mMaxFileSizeLimitBytes != 0 &&
          mMaxFileSizeLimitBytes >= kMinStreamableFileSizeInBytes);
 
     /*
@@ -1024,7 +1221,9 @@ status_t MPEG4Writer::start(MetaData *param) {
 
     mFreeBoxOffset = mOffset;
 
-    if (mInMemoryCacheSize == 0) {
+    // A fragmented file writes its 'moov' right after 'ftyp' once the first
+    // fragment is cut, so there is nothing to reserve up front.
+    if (!mFragmented && mInMemoryCacheSize == 0) {
         int32_t bitRate = -1;
         if (mHasFileLevelMeta) {
             mFileLevelMetaDataSize = estimateFileLevelMetaSize(param);
@@ -1062,7 +1261,9 @@ status_t MPEG4Writer::start(MetaData *param) {
 
     mOffset = mMdatOffset;
     seekOrPostError(mFd, mMdatOffset, SEEK_SET);
-    write("\x00\x00\x00\x01mdat????????", 16);
+    if (!mFragmented) {
+        write("\x00\x00\x00\x01mdat????????", 16);
+    }
 
     /* Confirm whether the writing of the initial file atoms, ftyp and free,
      * are written to the file properly by posting kWhatNoIOErrorSoFar to the
@@ -1357,6 +1558,17 @@ status_t MPEG4Writer::reset(bool stopSource, bool waitForAnyPreviousCallToComple
         return mResetStatus;
     }
 
+    if (mFragmented) {
+        // All the fragments are in the file already; only the indexes are left.
+        finishFragmentedFile(maxDurationUs);
+        status_t errRelease = release();
+        if (err == OK) {
+            err = errRelease;
+        }
+        mResetStatus = err;
+        return mResetStatus;
+    }
+
     // Fix up the size of the 'mdat' chunk.
     seekOrPostError(mFd, mMdatOffset + 8, SEEK_SET);
     uint64_t size = mOffset - mMdatOffset;
@@ -1497,24 +1709,29 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
         writeUdtaBox();
     }
     writeMoovLevelMetaBox();
-    // Loop through all the tracks to get the global time offset if there is
-    // any ctts table appears in a video track.
-    int64_t minCttsOffsetTimeUs = kMaxCttsOffsetTimeUs;
-    for (List<Track *>::iterator it = mTracks.begin();
-        it != mTracks.end(); ++it) {
-        if (!(*it)->isHeif()) {
-            minCttsOffsetTimeUs =
-                std::min(minCttsOffsetTimeUs, (*it)->getMinCttsOffsetTimeUs());
+    // Fragments carry signed composition offsets in 'trun', which need no
+    // adjustment of the movie start time. Besides, only the first few samples
+    // are known when the 'moov' of a fragmented file is written.
+    if (!mFragmented) {
+        // Loop through all the tracks to get the global time offset if there is
+        // any ctts table appears in a video track.
+        int64_t minCttsOffsetTimeUs = kMaxCttsOffsetTimeUs;
+        for (List<Track *>::iterator it = mTracks.begin();
+            it != mTracks.end(); ++it) {
+            if (!(*it)->isHeif()) {
+                minCttsOffsetTimeUs =
+                    std::min(minCttsOffsetTimeUs, (*it)->getMinCttsOffsetTimeUs());
+            }
         }
-    }
-    ALOGI("Adjust the moov start time from %lld us -> %lld us", (long long)mStartTimestampUs,
-          (long long)(mStartTimestampUs + minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs));
-    // Adjust movie start time.
-    mStartTimestampUs += minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs;
+        ALOGI("Adjust the moov start time from %lld us -> %lld us", (long long)mStartTimestampUs,
+              (long long)(mStartTimestampUs + minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs));
+        // Adjust movie start time.
+        mStartTimestampUs += minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs;
 
-    // Add mStartTimeOffsetBFramesUs(-ve or zero) to the start offset of tracks.
-    mStartTimeOffsetBFramesUs = minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs;
-    ALOGV("mStartTimeOffsetBFramesUs :%" PRId32, mStartTimeOffsetBFramesUs);
+        // Add mStartTimeOffsetBFramesUs(-ve or zero) to the start offset of tracks.
+        mStartTimeOffsetBFramesUs = minCttsOffsetTimeUs - kMaxCttsOffsetTimeUs;
+        ALOGV("mStartTimeOffsetBFramesUs :%" PRId32, mStartTimeOffsetBFramesUs);
+    }
 
     for (List<Track *>::iterator it = mTracks.begin();
         it != mTracks.end(); ++it) {
@@ -1522,9 +1739,170 @@ void MPEG4Writer::writeMoovBox(int64_t durationUs) {
             (*it)->writeTrackHeader();
         }
     }
+    if (mFragmented) {
+        writeMvexBox();
+    }
     endBox();  // moov
 }
 
+void MPEG4Writer::writeMvexBox() {
+    beginBox("mvex");
+    beginBox("mehd");
+    writeInt32(0x01000000);    // version=1, flags=0
+    mMehdOffset = mOffset;
+    writeInt64(0);             // fragment duration, patched in finishFragmentedFile()
+    endBox();  // mehd
+    for (List<Track *>::iterator it = mTracks.begin();
+        it != mTracks.end(); ++it) {
+        beginBox("trex");
+        writeInt32(0);         // version=0, flags=0
+        writeInt32((*it)->getTrackId().getId());
+        writeInt32(1);         // default sample description index
+        writeInt32(0);         // default sample duration
+        writeInt32(0);         // default sample size
+        writeInt32(0);         // default sample flags: sync sample
+        endBox();  // trex
+    }
+    endBox();  // mvex
+}
+
+void MPEG4Writer::writeFragmentedMoovBox() {
+    ALOGV("writeFragmentedMoovBox");
+    CHECK(!mFragmentedMoovWritten);
+    writeMoovBox(0);
+    mFragmentedMoovWritten = true;
+    ALOGI("MOOV atom was written to the file");
+
+    // Reserve room for the 'sidx' right in front of the first 'moof'. It is
+    // filled in at the end of the session; until then the fragments remain
+    // playable from the start without it.
+    size_t referenceCount = kDefaultSidxReferenceCount;
+    if (mMaxFileDurationLimitUs > 0) {
+        referenceCount = std::min((int64_t)UINT16_MAX,
+                mMaxFileDurationLimitUs / mFragmentDurationUs + 2);
+    }
+    mSidxOffset = mOffset;
+    mSidxReservedSize = 40 + 12 * referenceCount  // sidx
+                      + 8;                        // trailing free box
+    writeInt32(mSidxReservedSize);
+    writeFourcc("free");
+    std::vector<uint8_t> zeros(mSidxReservedSize - 8, 0);
+    write(zeros.data(), 1, zeros.size());
+}
+
+void MPEG4Writer::writeSidxBox() {
+    if (mSidxEntries.empty() || mSidxReservedSize == 0) {
+        return;
+    }
+
+    // Merge neighboring subsegments until the index fits into the reserved space.
+    size_t capacity = (mSidxReservedSize - 8 - 40) / 12;
+    while (mSidxEntries.size() > capacity) {
+        Vector<SidxEntry> merged;
+        for (size_t i = 0; i < mSidxEntries.size(); i += 2) {
+            SidxEntry entry = mSidxEntries[i];
+            if (i + 1 < mSidxEntries.size()) {
+                entry.mSize += mSidxEntries[i + 1].mSize;
+                entry.mDurationTicks += mSidxEntries[i + 1].mDurationTicks;
+            }
+            merged.push_back(entry);
+        }
+        mSidxEntries = merged;
+    }
+
+    std::vector<uint32_t> references;
+    references.reserve(mSidxEntries.size() * 3);
+    for (size_t i = 0; i < mSidxEntries.size(); ++i) {
+        if (mSidxEntries[i].mSize > 0x7fffffff) {
+            ALOGW("Fragment of %" PRIu64 " bytes is too large to be indexed",
+                    mSidxEntries[i].mSize);
+            return;
+        }
+        references.push_back(htonl(mSidxEntries[i].mSize));  // reference_type=0
+        references.push_back(htonl(mSidxEntries[i].mDurationTicks));
+        references.push_back(htonl(0x90000000));  // starts_with_SAP=1, SAP_type=1
+    }
+
+    // Reference the first video track, or the first track if there is no video.
+    uint32_t referenceId = 0;
+    for (List<Track *>::iterator it = mTracks.begin(); it != mTracks.end(); ++it) {
+        if (referenceId == 0 || (*it)->isVideo()) {
+            referenceId = (*it)->getTrackId().getId();
+            if ((*it)->isVideo()) {
+                break;
+            }
+        }
+    }
+
+    off64_t endOffset = mOffset;
+    mOffset = mSidxOffset;
+    seekOrPostError(mFd, mOffset, SEEK_SET);
+    uint32_t sidxSize = 40 + 12 * mSidxEntries.size();
+    beginBox("sidx");
+    writeInt32(0x01000000);    // version=1, flags=0
+    writeInt32(referenceId);
+    writeInt32(mTimeScale);
+    writeInt64(0);             // earliest presentation time
+    writeInt64(mSidxReservedSize - sidxSize);  // first offset, past the free box below
+    writeInt16(0);             // reserved
+    writeInt16(mSidxEntries.size());
+    write(references.data(), sizeof(uint32_t), references.size());
+    endBox();  // sidx
+    writeInt32(mSidxReservedSize - sidxSize);
+    writeFourcc("free");
+    mOffset = endOffset;
+    seekOrPostError(mFd, mOffset, SEEK_SET);
+}
+
+void MPEG4Writer::writeMfraBox() {
+    off64_t mfraOffset = mOffset;
+    beginBox("mfra");
+    for (List<FragmentInfo>::iterator it = mFragmentInfos.begin();
+         it != mFragmentInfos.end(); ++it) {
+        beginBox("tfra");
+        writeInt32(0x01000000);    // version=1, flags=0
+        writeInt32(it->mTrack->getTrackId().getId());
+        writeInt32(0);             // 1 byte traf_number, trun_number and sample_number
+        writeInt32(it->mTfraEntries.size());
+        for (size_t i = 0; i < it->mTfraEntries.size(); ++i) {
+            const TfraEntry &entry = it->mTfraEntries[i];
+            writeInt64(entry.mTimeTicks);
+            writeInt64(entry.mMoofOffset);
+            writeInt8(entry.mTrafNumber);
+            writeInt8(1);          // trun_number
+            writeInt8(1);          // sample_number
+        }
+        endBox();  // tfra
+    }
+    beginBox("mfro");
+    writeInt32(0);                 // version=0, flags=0
+    writeInt32(mOffset + 4 - mfraOffset);  // size of the enclosing mfra box
+    endBox();  // mfro
+    endBox();  // mfra
+}
+
+void MPEG4Writer::finishFragmentedFile(int64_t durationUs) {
+    ALOGV("finishFragmentedFile");
+    if (!mFragmentedMoovWritten) {
+        // No fragment was cut; the file still needs its header.
+        writeFragmentedMoovBox();
+    }
+    writeMfraBox();
+    writeSidxBox();
+
+    // Fix up the duration in 'mehd'.
+    uint64_t duration = (durationUs * mTimeScale + 5E5) / 1E6;
+    duration = hton64(duration);
+    seekOrPostError(mFd, mMehdOffset, SEEK_SET);
+    writeOrPostError(mFd, &duration, 8);
+    seekOrPostError(mFd, mOffset, SEEK_SET);
+    mMdatEndOffset = mOffset;
+
+    mFragmentInfos.clear();
+    mSidxEntries.clear();
+    ALOGI("%" PRIu32 " fragments were written to the file", mFragmentSequenceNumber);
+}
+
 void MPEG4Writer::writeFtypBox(MetaData *param) {
     beginBox("ftyp");
 
@@ -1563,6 +1941,10 @@ void MPEG4Writer::writeFtypBox(MetaData *param) {
         if (mHasMoovBox) {
             writeFourcc("isom");
             writeFourcc("mp42");
+            if (mFragmented) {
+                // 'tfdt' and signed composition offsets in 'trun'
+                writeFourcc("iso6");
+            }
         }
         // If an AV1 video track is present, write "av01" as one of the
         // compatible brands.
@@ -2013,16 +2395,11 @@ bool MPEG4Writer::preAllocate(uint64_t wantSize) {
     if (mFallocateErr == true)
         return false;
 
-    // approxMOOVHeadersSize has to be changed whenever its needed in the future.
-    uint64_t approxMOOVHeadersSize = 500;
-    // approxTrackHeadersSize has to be changed whenever its needed in the future.
-    const uint64_t approxTrackHeadersSize = 800;
-
     uint64_t approxMOOVBoxSize = 0;
     if (mPreAllocFirstTime) {
         mPreAllocFirstTime = false;
-        approxMOOVBoxSize = approxMOOVHeadersSize + mFileLevelMetaDataSize + mMoovExtraSize +
-                            (approxTrackHeadersSize * numTracks());
+        approxMOOVBoxSize = kApproxMoovHeadersSize + mFileLevelMetaDataSize + mMoovExtraSize +
+                            (kApproxTrackHeadersSize * numTracks());
         ALOGV("firstTimeAllocation approxMOOVBoxSize:%" PRIu64, approxMOOVBoxSize);
     }
 
@@ -2085,16 +2462,36 @@ bool MPEG4Writer::truncatePreAllocation() {
     return status;
 }
 
-bool MPEG4Writer::exceedsFileSizeLimit() {
-    // No limit
-    if (mMaxFileSizeLimitBytes == 0) {
-        return false;
+int64_t MPEG4Writer::estimateMoovBoxSize() {
+    int64_t size = kApproxMoovHeadersSize + mMoovExtraSize;
+    for (List<Track *>::iterator it = mTracks.begin();
+         it != mTracks.end(); ++it) {
+        size += kApproxTrackHeadersSize + (*it)->trackMetaDataSize();
     }
+    return size;
+}
+
+int64_t MPEG4Writer::estimateTotalFileSize() {
     int64_t nTotalBytesEstimate = static_cast<int64_t>(mInMemoryCacheSize);
     for (List<Track *>::iterator it = mTracks.begin();
          it != mTracks.end(); ++it) {
         nTotalBytesEstimate += (*it)->getEstimatedTrackSizeBytes();
     }
+    if (mStreamableFile && mHasMoovBox) {
+        // Track estimates leave out the tables of a streamable file since they are
+        // meant to fit in the reserved space; whatever does not will go to the end.
+        nTotalBytesEstimate += std::max<int64_t>(0,
+                estimateMoovBoxSize() + mFileLevelMetaDataSize - mInMemoryCacheSize);
+    }
+    return nTotalBytesEstimate;
+}
+
+bool MPEG4Writer::exceedsFileSizeLimit() {
+    // No limit
+    if (mMaxFileSizeLimitBytes == 0) {
+        return false;
+    }
+    int64_t nTotalBytesEstimate = estimateTotalFileSize();
 
     if (!mStreamableFile) {
         // Add 1024 bytes as error tolerance
@@ -2113,11 +2510,7 @@ bool MPEG4Writer::approachingFileSizeLimit() {
         return false;
     }
 
-    int64_t nTotalBytesEstimate = static_cast<int64_t>(mInMemoryCacheSize);
-    for (List<Track *>::iterator it = mTracks.begin();
-         it != mTracks.end(); ++it) {
-        nTotalBytesEstimate += (*it)->getEstimatedTrackSizeBytes();
-    }
+    int64_t nTotalBytesEstimate = estimateTotalFileSize();
 
     if (!mStreamableFile) {
         // Add 1024 bytes as error tolerance
@@ -2201,12 +2594,14 @@ MPEG4Writer::Track::Track(
       mTrackDurationUs(0),
       mEstimatedTrackSizeBytes(0),
       mSamplesHaveSameSize(true),
-      mStszTableEntries(new ListTableEntries<uint32_t, 1>(1000)),
-      mCo64TableEntries(new ListTableEntries<off64_t, 1>(1000)),
-      mStscTableEntries(new ListTableEntries<uint32_t, 3>(1000)),
-      mStssTableEntries(new ListTableEntries<uint32_t, 1>(1000)),
-      mSttsTableEntries(new ListTableEntries<uint32_t, 2>(1000)),
-      mCttsTableEntries(new ListTableEntries<uint32_t, 2>(1000)),
+      mNumSamples(0),
+      mNumSyncSamples(0),
+      mStszTableEntries(new CompactTableEntries<uint32_t, 1>(kTableBlockSize)),
+      mCo64TableEntries(new CompactTableEntries<off64_t, 1>(kTableBlockSize)),
+      mStscTableEntries(new CompactTableEntries<uint32_t, 3>(kTableBlockSize)),
+      mStssTableEntries(new CompactTableEntries<uint32_t, 1>(kTableBlockSize)),
+      mSttsTableEntries(new CompactTableEntries<uint32_t, 2>(kTableBlockSize)),
+      mCttsTableEntries(new CompactTableEntries<uint32_t, 2>(kTableBlockSize)),
       mElstTableEntries(new ListTableEntries<uint32_t, 3>(3)), // Reserve 3 rows, a row has 3 items
       mMinCttsOffsetTimeUs(0),
       mMinCttsOffsetTicks(0),
@@ -2289,30 +2684,32 @@ void MPEG4Writer::Track::resetInternal() {
     mIsMalformed = false;
     mTrackDurationUs = 0;
     mEstimatedTrackSizeBytes = 0;
-    mSamplesHaveSameSize = false;
+    mSamplesHaveSameSize = true;
+    mNumSamples = 0;
+    mNumSyncSamples = 0;
     if (mStszTableEntries != NULL) {
         delete mStszTableEntries;
-        mStszTableEntries = new ListTableEntries<uint32_t, 1>(1000);
+        mStszTableEntries = new CompactTableEntries<uint32_t, 1>(kTableBlockSize);
     }
     if (mCo64TableEntries != NULL) {
         delete mCo64TableEntries;
-        mCo64TableEntries = new ListTableEntries<off64_t, 1>(1000);
+        mCo64TableEntries = new CompactTableEntries<off64_t, 1>(kTableBlockSize);
     }
     if (mStscTableEntries != NULL) {
         delete mStscTableEntries;
-        mStscTableEntries = new ListTableEntries<uint32_t, 3>(1000);
+        mStscTableEntries = new CompactTableEntries<uint32_t, 3>(kTableBlockSize);
     }
     if (mStssTableEntries != NULL) {
         delete mStssTableEntries;
-        mStssTableEntries = new ListTableEntries<uint32_t, 1>(1000);
+        mStssTableEntries = new CompactTableEntries<uint32_t, 1>(kTableBlockSize);
     }
     if (mSttsTableEntries != NULL) {
         delete mSttsTableEntries;
-        mSttsTableEntries = new ListTableEntries<uint32_t, 2>(1000);
+        mSttsTableEntries = new CompactTableEntries<uint32_t, 2>(kTableBlockSize);
     }
     if (mCttsTableEntries != NULL) {
         delete mCttsTableEntries;
-        mCttsTableEntries = new ListTableEntries<uint32_t, 2>(1000);
+        mCttsTableEntries = new CompactTableEntries<uint32_t, 2>(kTableBlockSize);
     }
     if (mElstTableEntries != NULL) {
         delete mElstTableEntries;
@@ -2322,18 +2719,26 @@ void MPEG4Writer::Track::resetInternal() {
 }
 
 int64_t MPEG4Writer::Track::trackMetaDataSize() {
+    // Table payloads exactly as writeStblBox() and writeEdtsBox() would write them now.
     int64_t co64BoxSizeBytes = mCo64TableEntries->count() * 8;
-    int64_t stszBoxSizeBytes = mStszTableEntries->count() * 4;
+    int64_t stszBoxSizeBytes = mSamplesHaveSameSize ? 0 : mStszTableEntries->count() * 4;
+    int64_t cttsBoxSizeBytes =
+            (mMinCttsOffsetTicks == mMaxCttsOffsetTicks) ? 0 : mCttsTableEntries->count() * 8;
     int64_t trackMetaDataSize = mStscTableEntries->count() * 12 +  // stsc box size
                                 mStssTableEntries->count() * 4 +   // stss box size
                                 mSttsTableEntries->count() * 8 +   // stts box size
-                                mCttsTableEntries->count() * 8 +   // ctts box size
+                                cttsBoxSizeBytes +                 // ctts box size
                                 mElstTableEntries->count() * 12 +  // elst box size
                                 co64BoxSizeBytes +                 // stco box size
                                 stszBoxSizeBytes;                  // stsz box size
     return trackMetaDataSize;
 }
 
+size_t MPEG4Writer::Track::sampleTablesAllocatedSize() const {
+    return mStszTableEntries->allocatedSize() + mCo64TableEntries->allocatedSize() +
+           mStscTableEntries->allocatedSize() + mStssTableEntries->allocatedSize() +
+           mSttsTableEntries->allocatedSize() + mCttsTableEntries->allocatedSize();
+}
 
 void MPEG4Writer::Track::updateTrackSizeEstimate() {
     mEstimatedTrackSizeBytes = mMdatSizeBytes;  // media data size
@@ -2344,29 +2749,44 @@ void MPEG4Writer::Track::updateTrackSizeEstimate() {
 
 void MPEG4Writer::Track::addOneStscTableEntry(
         size_t chunkId, size_t sampleId) {
-    mStscTableEntries->add(htonl(chunkId));
-    mStscTableEntries->add(htonl(sampleId));
-    mStscTableEntries->add(htonl(1));
+    // Fragmented files carry the sample layout and timing in each 'trun' instead.
+    if (mOwner->mFragmented) {
+        return;
+    }
+    // A chunk holding as many samples as the previous entry's is implied by it.
+    if (mStscTableEntries->count() > 0 && mStscTableEntries->last(1) == sampleId) {
+        return;
+    }
+    mStscTableEntries->add(chunkId);
+    mStscTableEntries->add(sampleId);
+    mStscTableEntries->add(1);
 }
 
 void MPEG4Writer::Track::addOneStssTableEntry(size_t sampleId) {
-    mStssTableEntries->add(htonl(sampleId));
+    ++mNumSyncSamples;
+    if (mOwner->mFragmented) {
+        return;
+    }
+    mStssTableEntries->add(sampleId);
 }
 
 void MPEG4Writer::Track::addOneSttsTableEntry(size_t sampleCount, int32_t delta) {
     if (delta == 0) {
         ALOGW("0-duration samples found: %zu", sampleCount);
     }
-    mSttsTableEntries->add(htonl(sampleCount));
-    mSttsTableEntries->add(htonl(delta));
+    if (mOwner->mFragmented) {
+        return;
+    }
+    mSttsTableEntries->add(sampleCount);
+    mSttsTableEntries->add(delta);
 }
 
 void MPEG4Writer::Track::addOneCttsTableEntry(size_t sampleCount, int32_t sampleOffset) {
-    if (!mIsVideo) {
+    if (!mIsVideo || mOwner->mFragmented) {
         return;
     }
-    mCttsTableEntries->add(htonl(sampleCount));
-    mCttsTableEntries->add(htonl(sampleOffset));
+    mCttsTableEntries->add(sampleCount);
+    mCttsTableEntries->add(sampleOffset);
 }
 
 void MPEG4Writer::Track::addOneElstTableEntry(
@@ -2450,7 +2870,7 @@ bool MPEG4Writer::Track::isExifData(
 
 void MPEG4Writer::Track::addChunkOffset(off64_t offset) {
     CHECK(!mIsHeif);
-    mCo64TableEntries->add(hton64(offset));
+    mCo64TableEntries->add(offset);
 }
 
 void MPEG4Writer::Track::addItemOffsetAndSize(off64_t offset, size_t size, bool isExif) {
@@ -2863,6 +3283,308 @@ bool MPEG4Writer::findChunkToWrite(Chunk *chunk) {
     return false;
 }
 
+void MPEG4Writer::bufferFragmentSample(Track *track, const FragmentSample &sample) {
+    ALOGV("bufferFragmentSample: %p", track);
+    Mutex::Autolock autolock(mLock);
+    CHECK_EQ(mDone, false);
+
+    for (List<FragmentInfo>::iterator it = mFragmentInfos.begin();
+         it != mFragmentInfos.end(); ++it) {
+
+        if (track == it->mTrack) {  // Found owner
+            it->mSamples.push_back(sample);
+            mChunkReadyCondition.signal();
+            return;
+        }
+    }
+
+    CHECK(!"Received a fragment sample for a unknown track");
+}
+
+void MPEG4Writer::markFragmentTrackDone(Track *track, uint32_t lastSampleDurationTicks) {
+    ALOGV("markFragmentTrackDone: %p", track);
+    Mutex::Autolock autolock(mLock);
+
+    for (List<FragmentInfo>::iterator it = mFragmentInfos.begin();
+         it != mFragmentInfos.end(); ++it) {
+        if (track == it->mTrack) {
+            it->mDone = true;
+            it->mLastSampleDurationTicks = lastSampleDurationTicks;
+            mChunkReadyCondition.signal();
+            return;
+        }
+    }
+}
+
+bool MPEG4Writer::findFragmentToWrite(
+        bool flush, List<FragmentRun> *runs, int64_t *durationUs) {
+    ALOGV("findFragmentToWrite");
+
+    // Fragments are cut at the sync samples of the first video track, or of
+    // the first track if there is no video.
+    FragmentInfo *ref = NULL;
+    bool allDone = true;
+    int64_t earliestTimeUs = INT64_MAX;
+    int64_t latestTimeUs = INT64_MIN;
+    for (List<FragmentInfo>::iterator it = mFragmentInfos.begin();
+         it != mFragmentInfos.end(); ++it) {
+        if (ref == NULL || (it->mTrack->isVideo() && !ref->mTrack->isVideo())) {
+            ref = &(*it);
+        }
+        allDone = allDone && it->mDone;
+        if (!it->mSamples.empty()) {
+            earliestTimeUs = std::min(earliestTimeUs, it->mSamples.begin()->mTimeUs);
+            latestTimeUs = std::max(latestTimeUs, (--it->mSamples.end())->mTimeUs);
+        }
+    }
+
+    if (earliestTimeUs == INT64_MAX) {
+        ALOGV("Nothing to be written after all");
+        return false;
+    }
+    if (mLastFragmentEndUs < 0) {
+        mLastFragmentEndUs = earliestTimeUs;
+    }
+
+    int64_t cutTimeUs = -1;
+    if (!ref->mSamples.empty()) {
+        List<FragmentSample>::iterator it = ref->mSamples.begin();
+        int64_t startTimeUs = it->mTimeUs;
+        for (++it; it != ref->mSamples.end(); ++it) {
+            if (it->mIsSync && it->mTimeUs - startTimeUs >= mFragmentDurationUs) {
+                cutTimeUs = it->mTimeUs;
+                break;
+            }
+        }
+    }
+    if (cutTimeUs < 0 && ref->mDone &&
+            latestTimeUs >= mLastFragmentEndUs + mFragmentDurationUs) {
+        // The reference track has ended; keep cutting the others by time.
+        cutTimeUs = mLastFragmentEndUs + mFragmentDurationUs;
+    }
+    if (cutTimeUs < 0) {
+        if (!flush && !allDone) {
+            return false;
+        }
+        cutTimeUs = INT64_MAX;
+    }
+
+    if (cutTimeUs != INT64_MAX && !flush) {
+        // Wait for the other tracks to catch up with the cut, unless one of them
+        // lags behind so much that holding the rest back would only grow the queue.
+        for (List<FragmentInfo>::iterator it = mFragmentInfos.begin();
+             it != mFragmentInfos.end(); ++it) {
+            if (!it->mDone &&
+                    (it->mSamples.empty() || (--it->mSamples.end())->mTimeUs < cutTimeUs) &&
+                    latestTimeUs - cutTimeUs < kFragmentMaxLagFactor * mFragmentDurationUs) {
+                return false;
+            }
+        }
+    }
+
+    int64_t fragmentEndUs = INT64_MIN;
+    for (;;) {
+        for (List<FragmentInfo>::iterator it = mFragmentInfos.begin();
+             it != mFragmentInfos.end(); ++it) {
+            FragmentRun run;
+            run.mTrack = it->mTrack;
+            run.mBaseMediaDecodeTicks = it->mNextDecodeTicks;
+            int32_t timeScale = it->mTrack->getTimeScale();
+            while (!it->mSamples.empty()) {
+                List<FragmentSample>::iterator sampleIt = it->mSamples.begin();
+                if (sampleIt->mTimeUs >= cutTimeUs) {
+                    break;
+                }
+                // A sample lasts until the next one of the same track starts.
+                List<FragmentSample>::iterator nextIt = sampleIt;
+                ++nextIt;
+                if (nextIt != it->mSamples.end()) {
+                    sampleIt->mDurationTicks = nextIt->mDeltaTicks;
+                } else if (it->mDone) {
+                    sampleIt->mDurationTicks = it->mLastSampleDurationTicks;
+                } else {
+                    break;
+                }
+                it->mNextDecodeTicks += sampleIt->mDurationTicks;
+                fragmentEndUs = std::max(fragmentEndUs, sampleIt->mTimeUs +
+                        (int64_t)sampleIt->mDurationTicks * 1000000LL / timeScale);
+                run.mSamples.push_back(*sampleIt);
+                it->mSamples.erase(sampleIt);
+            }
+            if (!run.mSamples.empty()) {
+                runs->push_back(run);
+            }
+        }
+        if (!runs->empty() || cutTimeUs == INT64_MAX || !(flush || allDone)) {
+            break;
+        }
+        // Nothing before the cut; whatever is left goes into the last fragment.
+        cutTimeUs = INT64_MAX;
+    }
+
+    if (runs->empty()) {
+        return false;
+    }
+
+    if (cutTimeUs != INT64_MAX) {
+        fragmentEndUs = cutTimeUs;
+    }
+    *durationUs = std::max((int64_t)0, fragmentEndUs - mLastFragmentEndUs);
+    mLastFragmentEndUs = std::max(mLastFragmentEndUs, fragmentEndUs);
+    return true;
+}
+
+void MPEG4Writer::writeFragmentToFile(List<FragmentRun> *runs, int64_t durationUs) {
+    ALOGV("writeFragmentToFile: %zu tracks, %" PRId64 " us", runs->size(), durationUs);
+
+    if (!mFragmentedMoovWritten) {
+        writeFragmentedMoovBox();
+    }
+
+    // The 'trun' data offsets are relative to the start of the 'moof', so its
+    // size has to be known before any of it is written.
+    uint64_t moofSize = 8 + 16;  // moof header + mfhd
+    uint64_t mdatPayloadSize = 0;
+    for (List<FragmentRun>::iterator it = runs->begin(); it != runs->end(); ++it) {
+        size_t bytesPerSample = it->mTrack->isVideo() ? 16 : 8;
+        moofSize += 8                  // traf header
+                  + 16                 // tfhd
+                  + 20                 // tfdt
+                  + 20 + it->mSamples.size() * bytesPerSample;  // trun
+        for (List<FragmentSample>::iterator sampleIt = it->mSamples.begin();
+             sampleIt != it->mSamples.end(); ++sampleIt) {
+            mdatPayloadSize += sampleIt->mSize;
+        }
+    }
+    bool largeMdat = (mdatPayloadSize + 8 > UINT32_MAX);
+    uint64_t mdatHeaderSize = largeMdat ? 16 : 8;
+
+    const off64_t moofOffset = mOffset;
+    uint64_t dataOffset = moofSize + mdatHeaderSize;
+    uint32_t trafNumber = 0;
+    beginBox("moof");
+    beginBox("mfhd");
+    writeInt32(0);                          // version=0, flags=0
+    writeInt32(++mFragmentSequenceNumber);  // sequence number
+    endBox();  // mfhd
+    for (List<FragmentRun>::iterator it = runs->begin(); it != runs->end(); ++it) {
+        Track *track = it->mTrack;
+        bool isVideo = track->isVideo();
+        ++trafNumber;
+        beginBox("traf");
+            beginBox("tfhd");
+            writeInt32(0x020000);           // version=0, flags=default-base-is-moof
+            writeInt32(track->getTrackId().getId());
+            endBox();  // tfhd
+            beginBox("tfdt");
+            writeInt32(0x01000000);         // version=1, flags=0
+            writeInt64(it->mBaseMediaDecodeTicks);
+            endBox();  // tfdt
+            beginBox("trun");
+            // version=1 for signed composition offsets, flags=data-offset,
+            // sample-duration, sample-size and for video, sample-flags and
+            // sample-composition-time-offsets. Others use the 'trex' defaults.
+            writeInt32(isVideo ? 0x01000F01 : 0x01000301);
+            writeInt32(it->mSamples.size());
+            writeInt32(dataOffset);
+            std::vector<uint32_t> entries;
+            entries.reserve(it->mSamples.size() * (isVideo ? 4 : 2));
+            for (List<FragmentSample>::iterator sampleIt = it->mSamples.begin();
+                 sampleIt != it->mSamples.end(); ++sampleIt) {
+                entries.push_back(htonl(sampleIt->mDurationTicks));
+                entries.push_back(htonl(sampleIt->mSize));
+                if (isVideo) {
+                    entries.push_back(htonl(sampleIt->mIsSync ?
+                            kFragmentSyncSampleFlags : kFragmentNonSyncSampleFlags));
+                    entries.push_back(htonl(sampleIt->mCompositionOffsetTicks));
+                }
+                dataOffset += sampleIt->mSize;
+            }
+            write(entries.data(), sizeof(uint32_t), entries.size());
+            endBox();  // trun
+        endBox();  // traf
+
+        const FragmentSample &first = *it->mSamples.begin();
+        if (first.mIsSync) {
+            for (List<FragmentInfo>::iterator infoIt = mFragmentInfos.begin();
+                 infoIt != mFragmentInfos.end(); ++infoIt) {
+                if (infoIt->mTrack == track) {
+                    int64_t presentationTicks = (int64_t)it->mBaseMediaDecodeTicks +
+                            first.mCompositionOffsetTicks;
+                    infoIt->mTfraEntries.push_back({
+                        .mTimeTicks = (uint64_t)std::max((int64_t)0, presentationTicks),
+                        .mMoofOffset = (uint64_t)moofOffset,
+                        .mTrafNumber = trafNumber,
+                    });
+                    break;
+                }
+            }
+        }
+    }
+    endBox();  // moof
+    CHECK_EQ((uint64_t)(mOffset - moofOffset), moofSize);
+
+    if (largeMdat) {
+        writeInt32(1);
+        writeFourcc("mdat");
+        writeInt64(mdatPayloadSize + 16);
+    } else {
+        writeInt32(mdatPayloadSize + 8);
+        writeFourcc("mdat");
+    }
+    for (List<FragmentRun>::iterator it = runs->begin(); it != runs->end(); ++it) {
+        bool usePrefix = it->mTrack->usePrefix();
+        while (!it->mSamples.empty()) {
+            List<FragmentSample>::iterator sampleIt = it->mSamples.begin();
+            size_t bytesWritten;
+            addSample_l(sampleIt->mBuffer, usePrefix, 0 /* tiffHdrOffset */, &bytesWritten);
+            if (bytesWritten != sampleIt->mSize) {
+                ALOGW("%s sample of %zu bytes was expected to be %u bytes",
+                        it->mTrack->getTrackType(), bytesWritten, sampleIt->mSize);
+            }
+            sampleIt->mBuffer->release();
+            sampleIt->mBuffer = NULL;
+            it->mSamples.erase(sampleIt);
+        }
+    }
+
+    mSidxEntries.push_back({
+        .mSize = (uint64_t)(mOffset - moofOffset),
+        .mDurationTicks = (uint32_t)((durationUs * mTimeScale + 500000LL) / 1000000LL),
+    });
+}
+
+void MPEG4Writer::writeAllFragments() {
+    ALOGV("writeAllFragments");
+    size_t outstandingFragments = 0;
+    List<FragmentRun> runs;
+    int64_t durationUs;
+    while (findFragmentToWrite(true /* flush */, &runs, &durationUs)) {
+        // writeFragmentToFile() may need mLock to write out the 'moov'.
+        mLock.unlock();
+        writeFragmentToFile(&runs, durationUs);
+        mLock.lock();
+        runs.clear();
+        ++outstandingFragments;
+    }
+
+    // Samples still held back belong to tracks that never reported their end.
+    for (List<FragmentInfo>::iterator it = mFragmentInfos.begin();
+         it != mFragmentInfos.end(); ++it) {
+        for (List<FragmentSample>::iterator sampleIt = it->mSamples.begin();
+             sampleIt != it->mSamples.end(); ++sampleIt) {
+            sampleIt->mBuffer->release();
+        }
+        if (!it->mSamples.empty()) {
+            ALOGW("Dropped %zu trailing samples of %s track",
+                    it->mSamples.size(), it->mTrack->getTrackType());
+        }
+        it->mSamples.clear();
+    }
+
+    ALOGD("%zu fragments are written in the last batch", outstandingFragments);
+}
+
 void MPEG4Writer::threadFunc() {
     ALOGV("threadFunc");
 
@@ -2874,6 +3596,24 @@ void MPEG4Writer::threadFunc() {
     }
 
     Mutex::Autolock autoLock(mLock);
+    while (!mDone && mFragmented) {
+        List<FragmentRun> runs;
+        int64_t durationUs;
+        bool fragmentFound = false;
+
+        while (!mDone && !(fragmentFound = findFragmentToWrite(false, &runs, &durationUs))) {
+            mChunkReadyCondition.wait(mLock);
+        }
+
+        // Fragments are always written without holding the lock, as the 'moov'
+        // written along with the first one takes mLock to read the start time.
+        if (fragmentFound) {
+            mLock.unlock();
+            writeFragmentToFile(&runs, durationUs);
+            mLock.lock();
+        }
+    }
+
     while (!mDone) {
         Chunk chunk;
         bool chunkFound = false;
@@ -2897,7 +3637,11 @@ void MPEG4Writer::threadFunc() {
         }
     }
 
-    writeAllChunks();
+    if (mFragmented) {
+        writeAllFragments();
+    } else {
+        writeAllChunks();
+    }
     ALOGV("threadFunc mOffset:%lld, mMaxOffsetAppend:%lld", (long long)mOffset,
           (long long)mMaxOffsetAppend);
     mOffset = std::max(mOffset, mMaxOffsetAppend);
@@ -2917,6 +3661,19 @@ status_t MPEG4Writer::startWriterThread() {
         info.mMaxInterChunkDurUs = 0;
         mChunkInfos.push_back(info);
     }
+    mFragmentInfos.clear();
+    mSidxEntries.clear();
+    if (mFragmented) {
+        for (List<Track *>::iterator it = mTracks.begin();
+             it != mTracks.end(); ++it) {
+            FragmentInfo info;
+            info.mTrack = *it;
+            info.mDone = false;
+            info.mLastSampleDurationTicks = 0;
+            info.mNextDecodeTicks = 0;
+            mFragmentInfos.push_back(info);
+        }
+    }
 
     pthread_attr_t attr;
     pthread_attr_init(&attr);
@@ -3653,6 +4410,15 @@ status_t MPEG4Writer::Track::threadEntry() {
             lastSample = -1;
         }
         ALOGV("sampleFileOffset:%lld", (long long)sampleFileOffset);
+        if (sampleFileOffset != -1 && mOwner->mFragmented) {
+            ALOGE("Samples already in the file can't be put into fragments, %s track",
+                    trackName);
+            buffer->release();
+            buffer = nullptr;
+            mSource->stop();
+            mIsMalformed = true;
+            break;
+        }
 
         /*
          * Reserve space in the file for the current sample + to be written MOOV box. If reservation
@@ -3747,7 +4513,7 @@ status_t MPEG4Writer::Track::threadEntry() {
         }
 ////////////////////////////////////////////////////////////////////////////////
         if (!mIsHeif) {
-            if (mStszTableEntries->count() == 0) {
+            if (mNumSamples == 0) {
                 mFirstSampleTimeRealUs = systemTime() / 1000;
                 if (timestampUs < 0 && mFirstSampleStartOffsetUs == 0) {
                     mFirstSampleStartOffsetUs = -timestampUs;
@@ -3841,7 +4607,7 @@ status_t MPEG4Writer::Track::threadEntry() {
                     break;
                 }
 
-                if (mStszTableEntries->count() == 0) {
+                if (mNumSamples == 0) {
                     // Force the first ctts table entry to have one single entry
                     // so that we can do adjustment for the initial track start
                     // time offset easily in writeCttsBox().
@@ -3859,7 +4625,7 @@ status_t MPEG4Writer::Track::threadEntry() {
                 }
 
                 // Update ctts time offset range
-                if (mStszTableEntries->count() == 0) {
+                if (mNumSamples == 0) {
                     mMinCttsOffsetTicks = currCttsOffsetTimeTicks;
                     mMaxCttsOffsetTicks = currCttsOffsetTimeTicks;
                 } else {
@@ -3925,9 +4691,12 @@ status_t MPEG4Writer::Track::threadEntry() {
                     timestampUs += deltaUs;
                 }
             }
-            mStszTableEntries->add(htonl(sampleSize));
+            if (!mOwner->mFragmented) {
+                mStszTableEntries->add(sampleSize);
+            }
+            ++mNumSamples;
 
-            if (mStszTableEntries->count() > 2) {
+            if (mNumSamples > 2) {
 
                 // Force the first sample to have its own stts entry so that
                 // we can adjust its value later to maintain the A/V sync.
@@ -3939,7 +4708,7 @@ status_t MPEG4Writer::Track::threadEntry() {
                 }
             }
             if (mSamplesHaveSameSize) {
-                if (mStszTableEntries->count() >= 2 && previousSampleSize != sampleSize) {
+                if (mNumSamples >= 2 && previousSampleSize != sampleSize) {
                     mSamplesHaveSameSize = false;
                 }
                 previousSampleSize = sampleSize;
@@ -3951,7 +4720,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             lastTimestampUs = timestampUs;
 
             if (isSync != 0) {
-                addOneStssTableEntry(mStszTableEntries->count());
+                addOneStssTableEntry(mNumSamples);
             }
 
             if (mTrackingProgressStatus) {
@@ -3961,6 +4730,23 @@ status_t MPEG4Writer::Track::threadEntry() {
                 trackProgressStatus(timestampUs);
             }
         }
+        if (mOwner->mFragmented) {
+            FragmentSample sample;
+            sample.mBuffer = copy;
+            sample.mTimeUs = mStartTimestampUs + timestampUs;
+            sample.mSize = sampleSize;
+            sample.mDeltaTicks = currDurationTicks;
+            sample.mDurationTicks = 0;
+            sample.mCompositionOffsetTicks = 0;
+            if (mIsVideo) {
+                // Undo the bias that keeps the offsets in 'ctts' non-negative.
+                sample.mCompositionOffsetTicks = currCttsOffsetTimeTicks -
+                        (kMaxCttsOffsetTimeUs * mTimeScale + 500000LL) / 1000000LL;
+            }
+            sample.mIsSync = isSync;
+            mOwner->bufferFragmentSample(this, sample);
+            continue;
+        }
         if (!hasMultipleTracks) {
             size_t bytesWritten;
             off64_t offset = mOwner->addSample_l(
@@ -4016,7 +4802,7 @@ status_t MPEG4Writer::Track::threadEntry() {
     mOwner->trackProgressStatus(mTrackId.getId(), -1, err);
 
     // Add final entries only for non-empty tracks.
-    if (mStszTableEntries->count() > 0) {
+    if (mNumSamples > 0) {
         if (mIsHeif) {
             if (!mChunkSamples.empty()) {
                 bufferChunk(0);
@@ -4025,7 +4811,7 @@ status_t MPEG4Writer::Track::threadEntry() {
         } else {
             // Last chunk
             if (!hasMultipleTracks) {
-                addOneStscTableEntry(1, mStszTableEntries->count());
+                addOneStscTableEntry(1, mNumSamples);
             } else if (!mChunkSamples.empty()) {
                 addOneStscTableEntry(++nChunks, mChunkSamples.size());
                 bufferChunk(timestampUs);
@@ -4034,7 +4820,7 @@ status_t MPEG4Writer::Track::threadEntry() {
             // We don't really know how long the last frame lasts, since
             // there is no frame time after it, just repeat the previous
             // frame's duration.
-            if (mStszTableEntries->count() == 1) {
+            if (mNumSamples == 1) {
                 if (lastSampleDurationUs >= 0) {
                     addOneSttsTableEntry(sampleCount, lastSampleDurationTicks);
                 } else {
@@ -4064,12 +4850,21 @@ status_t MPEG4Writer::Track::threadEntry() {
             }
         }
     }
+    if (mOwner->mFragmented) {
+        // The last sample lasts as long as computed above for the 'stts' table.
+        uint32_t finalSampleTicks = 0;
+        if (mNumSamples > 0) {
+            finalSampleTicks =
+                    lastSampleDurationUs >= 0 ? lastSampleDurationTicks : lastDurationTicks;
+        }
+        mOwner->markFragmentTrackDone(this, finalSampleTicks);
+    }
     mReachedEOS = true;
 
     sendTrackSummary(hasMultipleTracks);
 
-    ALOGI("Received total/0-length (%d/%d) buffers and encoded %d frames. - %s",
-            count, nZeroLengthFrames, mStszTableEntries->count(), trackName);
+    ALOGI("Received total/0-length (%d/%d) buffers and encoded %u frames. - %s",
+            count, nZeroLengthFrames, mNumSamples, trackName);
     if (mIsAudio) {
         ALOGI("Audio track drift time: %" PRId64 " us", mOwner->getDriftTimeUs());
     }
@@ -4090,26 +4885,26 @@ bool MPEG4Writer::Track::isTrackMalFormed() {
         mOwner->mStartMeta->findInt32(kKeyEmptyTrackMalFormed, &emptyTrackMalformed) &&
         emptyTrackMalformed) {
         // MediaRecorder(sets kKeyEmptyTrackMalFormed by default) report empty tracks as malformed.
-        if (!mIsHeif && mStszTableEntries->count() == 0) {  // no samples written
+        if (!mIsHeif && mNumSamples == 0) {  // no samples written
             ALOGE("The number of recorded samples is 0");
             mIsMalformed = true;
             return true;
         }
-        if (mIsVideo && mStssTableEntries->count() == 0) {  // no sync frames for video
+        if (mIsVideo && mNumSyncSamples == 0) {  // no sync frames for video
             ALOGE("There are no sync frames for video track");
             mIsMalformed = true;
             return true;
         }
     } else {
         // Through MediaMuxer, empty tracks can be added. No sync frames for video.
-        if (mIsVideo && mStszTableEntries->count() > 0 && mStssTableEntries->count() == 0) {
+        if (mIsVideo && mNumSamples > 0 && mNumSyncSamples == 0) {
             ALOGE("There are no sync frames for video track");
             mIsMalformed = true;
             return true;
         }
     }
     // Don't check for CodecSpecificData when track is empty.
-    if (mStszTableEntries->count() > 0 && OK != checkCodecSpecificData()) {
+    if (mNumSamples > 0 && OK != checkCodecSpecificData()) {
         // No codec specific data.
         mIsMalformed = true;
         return true;
@@ -4137,7 +4932,7 @@ void MPEG4Writer::Track::sendTrackSummary(bool hasMultipleTracks) {
 
     mOwner->notify(MEDIA_RECORDER_TRACK_EVENT_INFO,
                     trackNum | MEDIA_RECORDER_TRACK_INFO_ENCODED_FRAMES,
-                    mStszTableEntries->count());
+                    mNumSamples);
 
     {
         // The system delay time excluding the requested initial delay that
@@ -4364,8 +5159,11 @@ int64_t MPEG4Writer::Track::getMinCttsOffsetTimeUs() {
 
 void MPEG4Writer::Track::writeStblBox() {
     mOwner->beginBox("stbl");
-    // Add subboxes for only non-empty and well-formed tracks.
-    if (mStszTableEntries->count() > 0 && !isTrackMalFormed()) {
+    // Add subboxes for only non-empty and well-formed tracks. In a fragmented
+    // file the samples follow in later fragments, and the tables stay empty.
+    bool hasSampleEntry = mOwner->mFragmented ?
+            (OK == checkCodecSpecificData()) : (mNumSamples > 0 && !isTrackMalFormed());
+    if (hasSampleEntry) {
         mOwner->beginBox("stsd");
         mOwner->writeInt32(0);               // version=0, flags=0
         mOwner->writeInt32(1);               // entry count
@@ -4378,7 +5176,7 @@ void MPEG4Writer::Track::writeStblBox() {
         }
         mOwner->endBox();  // stsd
         writeSttsBox();
-        if (mIsVideo) {
+        if (mIsVideo && !mOwner->mFragmented) {
             writeCttsBox();
             writeStssBox();
         }
@@ -4751,7 +5549,8 @@ void MPEG4Writer::Track::writeTkhdBox(uint32_t now) {
     mOwner->writeInt32(now);           // modification time
     mOwner->writeInt32(mTrackId.getId()); // track id starts with 1
     mOwner->writeInt32(0);             // reserved
-    int64_t trakDurationUs = getDurationUs();
+    // The duration of a fragmented track is only known from its fragments.
+    int64_t trakDurationUs = mOwner->mFragmented ? 0 : getDurationUs();
     int32_t mvhdTimeScale = mOwner->getTimeScale();
     int32_t tkhdDuration =
         (trakDurationUs * mvhdTimeScale + 5E5) / 1E6;
@@ -4840,7 +5639,9 @@ void MPEG4Writer::Track::writeEdtsBox() {
     ALOGV("movieStartOffsetBFramesUs:%" PRId32, movieStartOffsetBFramesUs);
 
     // This media/track's real duration (sum of duration of all samples in this track).
-    uint32_t tkhdDurationTicks = (mTrackDurationUs * mvhdTimeScale + 5E5) / 1E6;
+    // A zero duration in the last edit of a fragmented track spans all of its fragments.
+    uint32_t tkhdDurationTicks = mOwner->mFragmented ? 0 :
+            (mTrackDurationUs * mvhdTimeScale + 5E5) / 1E6;
     ALOGV("mTrackDurationUs:%" PRId64 "us", mTrackDurationUs);
 
     int64_t movieStartTimeUs = mOwner->getStartTimestampUs();
@@ -4869,7 +5670,10 @@ void MPEG4Writer::Track::writeEdtsBox() {
             int32_t firstSampleOffsetTicks =
                     (mFirstSampleStartOffsetUs * mvhdTimeScale + 5E5) / 1E6;
             // samples before 0 don't count in for duration, hence subtract firstSampleOffsetTicks.
-            addOneElstTableEntry(tkhdDurationTicks - firstSampleOffsetTicks, mediaTime, 1, 0);
+            if (tkhdDurationTicks > 0) {
+                tkhdDurationTicks -= firstSampleOffsetTicks;
+            }
+            addOneElstTableEntry(tkhdDurationTicks, mediaTime, 1, 0);
         } else {
             // Track starting at zero.
             ALOGV("No edit list entry required for this track");
@@ -4954,7 +5758,7 @@ void MPEG4Writer::Track::writeEdtsBox() {
 }
 
 void MPEG4Writer::Track::writeMdhdBox(uint32_t now) {
-    int64_t trakDurationUs = getDurationUs();
+    int64_t trakDurationUs = mOwner->mFragmented ? 0 : getDurationUs();
     int64_t mdhdDuration = (trakDurationUs * mTimeScale + 5E5) / 1E6;
     mOwner->beginBox("mdhd");
 
@@ -5146,9 +5950,9 @@ void MPEG4Writer::Track::writeCttsBox() {
     int64_t deltaTimeUs = mMinCttsOffsetTimeUs;
     ALOGV("ctts deltaTimeUs:%" PRId64, deltaTimeUs);
     int64_t delta = (deltaTimeUs * mTimeScale + 500000LL) / 1000000LL;
-    mCttsTableEntries->adjustEntries([delta](size_t /* ix */, uint32_t (&value)[2]) {
+    mCttsTableEntries->write(mOwner, [delta](uint32_t (&value)[2]) {
         // entries are <count, ctts> pairs; adjust only ctts
-        uint32_t duration = htonl(value[1]); // back to host byte order
+        uint32_t duration = value[1];
         // Prevent overflow and underflow
         if (delta > duration) {
             duration = 0;
@@ -5157,9 +5961,8 @@ void MPEG4Writer::Track::writeCttsBox() {
         } else {
             duration -= delta;
         }
-        value[1] = htonl(duration);
+        value[1] = duration;
     });
-    mCttsTableEntries->write(mOwner);
     mOwner->endBox();  // ctts
 }
 
@@ -5173,8 +5976,14 @@ void MPEG4Writer::Track::writeStssBox() {
 void MPEG4Writer::Track::writeStszBox() {
     mOwner->beginBox("stsz");
     mOwner->writeInt32(0);  // version=0, flags=0
-    mOwner->writeInt32(0);
-    mStszTableEntries->write(mOwner);
+    if (mSamplesHaveSameSize) {
+        // A single sample size stands in for the whole table
+        mOwner->writeInt32(mStszTableEntries->last(0));
+        mOwner->writeInt32(mStszTableEntries->count());
+    } else {
+        mOwner->writeInt32(0);
+        mStszTableEntries->write(mOwner);
+    }
     mOwner->endBox();  // stsz
 }
 
@@ -75,6 +75,10 @@ void SkipCutBuffer::submit(MediaBuffer *buffer) {
         mFrontPadding -= to_drop;
     }
 
+    // Nothing is held back without back padding, so the data can stay in place.
+    if (mBackPadding == 0 && mWriteHead == mReadHead) {
+        return;
+    }
 
     // append data to cutbuffer
     char *src = ((char*) buffer->data()) + offset;
@@ -108,6 +112,10 @@ void SkipCutBuffer::submitInternal(const sp<T>& buffer) {
         mFrontPadding -= to_drop;
     }
 
+    // Nothing is held back without back padding, so the data can stay in place.
+    if (mBackPadding == 0 && mWriteHead == mReadHead) {
+        return;
+    }
 
     // append data to cutbuffer
     char *src = (char*) buffer->data();
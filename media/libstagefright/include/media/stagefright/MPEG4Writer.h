@@ -157,6 +157,8 @@ private:
     status_t startTracks(MetaData *params);
     size_t numTracks();
     int64_t estimateMoovBoxSize(int32_t bitRate);
+    // Size of the 'moov' for the samples written so far, from the exact table entry counts.
+    int64_t estimateMoovBoxSize();
     int64_t estimateFileLevelMetaSize(MetaData *params);
     void writeCachedBoxToFile(const char *type);
     void printWriteDurations();
@@ -192,6 +194,50 @@ private:
     List<ChunkInfo> mChunkInfos;            // Chunk infos
     Condition       mChunkReadyCondition;   // Signal that chunks are available
 
+    // Fragmented MP4 writing
+    struct FragmentSample {
+        MediaBuffer *mBuffer;
+        int64_t mTimeUs;                    // Decoding time on the movie time line
+        uint32_t mSize;                     // Size in 'mdat', including NAL length prefixes
+        uint32_t mDeltaTicks;               // Decoding time delta from the previous sample
+        uint32_t mDurationTicks;            // Set when the sample is cut into a fragment
+        int32_t mCompositionOffsetTicks;
+        bool mIsSync;
+    };
+    struct TfraEntry {
+        uint64_t mTimeTicks;
+        uint64_t mMoofOffset;
+        uint32_t mTrafNumber;
+    };
+    struct FragmentInfo {
+        Track                *mTrack;       // Owner
+        List<FragmentSample> mSamples;      // Samples waiting for a fragment
+        bool                 mDone;         // No more samples will be buffered
+        uint32_t             mLastSampleDurationTicks;  // Valid once mDone is set
+        uint64_t             mNextDecodeTicks;  // 'tfdt' of the next fragment
+        Vector<TfraEntry>    mTfraEntries;  // Random access points written so far
+    };
+    struct FragmentRun {
+        Track                *mTrack;
+        List<FragmentSample> mSamples;
+        uint64_t             mBaseMediaDecodeTicks;
+    };
+    struct SidxEntry {
+        uint64_t mSize;                     // 'moof' + 'mdat' size
+        uint32_t mDurationTicks;            // In movie time scale
+    };
+
+    bool              mFragmented;
+    int64_t           mFragmentDurationUs;
+    bool              mFragmentedMoovWritten;
+    uint32_t          mFragmentSequenceNumber;
+    int64_t           mLastFragmentEndUs;
+    off64_t           mMehdOffset;
+    off64_t           mSidxOffset;          // Space reserved for 'sidx' after 'moov'
+    off64_t           mSidxReservedSize;
+    List<FragmentInfo> mFragmentInfos;
+    Vector<SidxEntry> mSidxEntries;
+
     // HEIF writing
     typedef key_value_pair_t< const char *, Vector<uint16_t> > ItemRefs;
     typedef struct _ItemInfo {
@@ -262,6 +308,24 @@ private:
     // Actually write the given chunk to the file.
     void writeChunkToFile(Chunk* chunk);
 
+    // Buffer a single sample of a fragmented file to be written out later.
+    void bufferFragmentSample(Track *track, const FragmentSample &sample);
+
+    // No more samples will come from the track. Its last sample lasts
+    // lastSampleDurationTicks.
+    void markFragmentTrackDone(Track *track, uint32_t lastSampleDurationTicks);
+
+    // Cut the next fragment out of the buffered samples if there is one.
+    // When flush is true, everything left is cut regardless of the fragment
+    // duration. Return true if a fragment is found; otherwise, return false.
+    bool findFragmentToWrite(bool flush, List<FragmentRun> *runs, int64_t *durationUs);
+
+    // Write the given fragment as a 'moof' and 'mdat' pair.
+    void writeFragmentToFile(List<FragmentRun> *runs, int64_t durationUs);
+
+    // Write all buffered fragments from all tracks
+    void writeAllFragments();
+
     // Adjust other track media clock (presumably wall clock)
     // based on audio track media clock with the drift time.
     int64_t mDriftTimeUs;
@@ -302,6 +366,7 @@ private:
     uint16_t addItem_l(const ItemInfo &);
     void addRefs_l(uint16_t itemId, const ItemRefs &);
 
+    int64_t estimateTotalFileSize();
     bool exceedsFileSizeLimit();
     bool exceedsFileDurationLimit();
     bool approachingFileSizeLimit();
@@ -311,6 +376,11 @@ private:
     void writeCompositionMatrix(int32_t degrees);
     void writeMvhdBox(int64_t durationUs);
     void writeMoovBox(int64_t durationUs);
+    void writeMvexBox();
+    void writeFragmentedMoovBox();
+    void writeSidxBox();
+    void writeMfraBox();
+    void finishFragmentedFile(int64_t durationUs);
     void writeFtypBox(MetaData *param);
     void writeUdtaBox();
     void writeGeoDataBox();
@@ -25,6 +25,11 @@ namespace android {
 // NB: These are not yet exposed as public Java API constants.
 inline constexpr char kCodecPixelFormat[] =
         "android.media.mediacodec.pixel-format";
+// bytes of linear buffers copied between codec and client buffers, and the average rate
+inline constexpr char kCodecLinearBytesCopied[] =
+        "android.media.mediacodec.linear-bytes-copied";
+inline constexpr char kCodecLinearBytesCopiedPerSec[] =
+        "android.media.mediacodec.linear-bytes-copied-per-sec";
 
 }
 
@@ -284,6 +284,10 @@ enum {
     kKeyLastSampleIndexInChunk = 'lsic',  //int64_t, index of last sample in a chunk.
     kKeySampleTimeBeforeAppend = 'lsba', // int64_t, timestamp of last sample of a track.
 
+    // Fragmented MP4 authoring: when set, MPEG4Writer emits 'moof'/'mdat' pairs of
+    // roughly this duration instead of indexing all samples in a single 'moov'.
+    kKeyFragmentDurationUs = 'frgd', // int64_t
+
     // DVB component tag
     kKeyDvbComponentTag = 'copt', // int32_t, component tag for DVB video/audio/subtitle
 
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MPEG4WriterBenchmark"
+#include <utils/Log.h>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include <media/mediarecorder.h>
+#include <media/stagefright/MPEG4Writer.h>
+#include <media/stagefright/MediaAdapter.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MetaData.h>
+
+using namespace android;
+
+#define OUTPUT_FILE_NAME "/data/local/tmp/MPEG4WriterBenchmark.mp4"
+
+// Sync frame every second, as a camera recording would have.
+constexpr int32_t kSyncFrameIntervalSec = 1;
+
+/*******************************************************************
+ * Muxes a synthetic single track video recording of the given length
+ * and frame rate, and reports the heap held by the writer right before
+ * stop(), which is dominated by the in-memory sample tables.
+ * The first parameter is the duration in hours, the second the frame rate.
+ *******************************************************************/
+static void BM_MPEG4Writer_SampleTableMemory(benchmark::State& state) {
+    const int64_t durationHours = state.range(0);
+    const int64_t frameRate = state.range(1);
+    const int64_t numFrames = durationHours * 3600 * frameRate;
+
+    for (auto _ : state) {
+        int fd = open(OUTPUT_FILE_NAME, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR,
+                      S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            state.SkipWithError("Failed to open output file");
+            return;
+        }
+
+        sp<MetaData> trackMeta = new MetaData;
+        trackMeta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_H263);
+        trackMeta->setInt32(kKeyWidth, 1920);
+        trackMeta->setInt32(kKeyHeight, 1080);
+        sp<MediaAdapter> track = new MediaAdapter(trackMeta);
+
+        sp<MPEG4Writer> writer = new MPEG4Writer(fd);
+        writer->addSource(track);
+        sp<MetaData> fileMeta = new MetaData;
+        fileMeta->setInt32(kKeyFileType, output_format::OUTPUT_FORMAT_MPEG_4);
+        fileMeta->setInt32(kKeyRealTimeRecording, false);
+
+        const size_t heapBefore = mallinfo().uordblks;
+        if (writer->start(fileMeta.get()) != OK) {
+            state.SkipWithError("Failed to start the writer");
+            close(fd);
+            return;
+        }
+
+        for (int64_t i = 0; i < numFrames; ++i) {
+            const bool isSync = (i % (frameRate * kSyncFrameIntervalSec)) == 0;
+            // Keep payloads tiny so the file stays small; vary them like an encoder would.
+            MediaBuffer *buffer = new MediaBuffer(isSync ? 64 : (size_t)(16 + (i * 7) % 32));
+            // Released in MediaAdapter::signalBufferReturned().
+            buffer->add_ref();
+            MetaDataBase &sampleMeta = buffer->meta_data();
+            sampleMeta.setInt64(kKeyTime, i * 1000000LL / frameRate);
+            sampleMeta.setInt64(kKeyDecodingTime, i * 1000000LL / frameRate);
+            if (isSync) {
+                sampleMeta.setInt32(kKeyIsSyncFrame, true);
+            }
+            if (track->pushBuffer(buffer) != OK) {
+                state.SkipWithError("Writer did not consume a buffer");
+                break;
+            }
+        }
+        const size_t heapAfter = mallinfo().uordblks;
+
+        track->stop();
+        writer->stop();
+        close(fd);
+
+        struct stat st;
+        stat(OUTPUT_FILE_NAME, &st);
+        state.counters["heap_bytes"] = heapAfter > heapBefore ? heapAfter - heapBefore : 0;
+        state.counters["heap_bytes_per_frame"] =
+                heapAfter > heapBefore ? (double)(heapAfter - heapBefore) / numFrames : 0;
+        state.counters["file_bytes"] = st.st_size;
+        remove(OUTPUT_FILE_NAME);
+    }
+}
+
+BENCHMARK(BM_MPEG4Writer_SampleTableMemory)
+        ->Args({1, 30})
+        ->Args({10, 60})
+        ->Unit(benchmark::kSecond)
+        ->Iterations(1);
+
+BENCHMARK_MAIN();
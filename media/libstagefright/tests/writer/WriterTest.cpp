@@ -896,6 +896,122 @@ TEST_P(WriteFunctionalityTest, Mpeg4WriterTest) {
     close(fd);
 }
 
+// Writes the input as fragmented MP4 and validates it through the extractor
+TEST_P(WriteFunctionalityTest, FragmentedMpeg4WriterTest) {
+    if (mDisableTest) return;
+    if (mWriterName != standardWriters::MPEG4) return;
+    ALOGV("Test fragmented output of MPEG4 writer");
+
+    inputId inpId[] = {get<1>(GetParam()), get<2>(GetParam())};
+    ASSERT_NE(inpId[0], UNUSED_ID) << "Test expects first inputId to be a valid id";
+    // HEIC goes through the file level meta path, which has no fragmented form
+    if (inpId[0] == HEIC_1 || inpId[1] == HEIC_1) return;
+
+    int32_t fd =
+            open(OUTPUT_FILE_NAME, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    ASSERT_GE(fd, 0) << "Failed to open output file to dump writer's data";
+
+    int32_t status = createWriter(fd);
+    ASSERT_EQ(status, (status_t)OK) << "Failed to create writer for mpeg4 output format";
+
+    int32_t numTracks = inpId[1] != UNUSED_ID ? 2 : 1;
+    size_t fileSize[numTracks];
+    configFormat param[numTracks];
+    for (int32_t idx = 0; idx < numTracks; idx++) {
+        string inputFile = gEnv->getRes();
+        string inputInfo = gEnv->getRes();
+        bool isAudio;
+        getFileDetails(inputFile, inputInfo, param[idx], isAudio, inpId[idx]);
+        ASSERT_NE(inputFile.compare(gEnv->getRes()), 0) << "No input file specified";
+
+        struct stat buf;
+        status = stat(inputFile.c_str(), &buf);
+        ASSERT_EQ(status, 0) << "Failed to get properties of input file:" << inputFile;
+        fileSize[idx] = buf.st_size;
+
+        ASSERT_NO_FATAL_FAILURE(getInputBufferInfo(inputFile, inputInfo, idx));
+        status = addWriterSource(isAudio, param[idx], idx);
+        ASSERT_EQ((status_t)OK, status) << "Failed to add source for mpeg4 Writer";
+    }
+
+    mFileMeta->setInt64(kKeyFragmentDurationUs, kDefaultFragmentDurationUs);
+    status = mWriter->start(mFileMeta.get());
+    ASSERT_EQ((status_t)OK, status) << "Could not start the writer";
+
+    for (int32_t idx = 0; idx < numTracks; idx++) {
+        status = sendBuffersToWriter(mInputStream[idx], mBufferInfo[idx], mInputFrameId[idx],
+                                     mCurrentTrack[idx], 0, mBufferInfo[idx].size());
+        ASSERT_EQ((status_t)OK, status) << "mpeg4 writer failed";
+        status = mCurrentTrack[idx]->stop();
+        ASSERT_EQ((status_t)OK, status) << "Failed to stop the track";
+    }
+    status = mWriter->stop();
+    ASSERT_EQ((status_t)OK, status) << "Failed to stop the writer";
+    close(fd);
+
+    AMediaExtractor *extractor = AMediaExtractor_new();
+    ASSERT_NE(extractor, nullptr) << "Failed to create extractor";
+    int32_t trackCount = -1;
+    ASSERT_NO_FATAL_FAILURE(setupExtractor(extractor, OUTPUT_FILE_NAME, trackCount));
+    ASSERT_EQ(trackCount, numTracks)
+            << "Tracks reported by extractor does not match with input number of tracks";
+
+    for (int32_t idx = 0; idx < numTracks; idx++) {
+        AMediaExtractor_selectTrack(extractor, idx);
+    }
+    // Every sample is expected back in order, with its size, payload and timestamp intact.
+    // Sync flags are not compared since only the first sample of a fragment is marked.
+    vector<uint8_t> inputData[numTracks];
+    size_t inputOffset[numTracks];
+    int32_t frameIdx[numTracks];
+    for (int32_t idx = 0; idx < numTracks; idx++) {
+        inputData[idx].resize(fileSize[idx]);
+        mInputStream[idx].seekg(0, mInputStream[idx].beg);
+        mInputStream[idx].read((char *)inputData[idx].data(), fileSize[idx]);
+        ASSERT_EQ(mInputStream[idx].gcount(), fileSize[idx]);
+        inputOffset[idx] = 0;
+        frameIdx[idx] = 0;
+        while (frameIdx[idx] < mBufferInfo[idx].size() &&
+               mBufferInfo[idx][frameIdx[idx]].flags == CODEC_CONFIG_FLAG) {
+            inputOffset[idx] += mBufferInfo[idx][frameIdx[idx]].size;
+            frameIdx[idx]++;
+        }
+    }
+    vector<uint8_t> sample;
+    while (1) {
+        ssize_t sampleSize = AMediaExtractor_getSampleSize(extractor);
+        if (sampleSize < 0) break;
+        int32_t idx = AMediaExtractor_getSampleTrackIndex(extractor);
+        ASSERT_GE(idx, 0);
+        ASSERT_LT(idx, numTracks);
+        ASSERT_LT(frameIdx[idx], mBufferInfo[idx].size()) << "Extracted more samples than input";
+
+        const BufferInfo &info = mBufferInfo[idx][frameIdx[idx]];
+        sample.resize(sampleSize);
+        ASSERT_EQ(AMediaExtractor_readSampleData(extractor, sample.data(), sampleSize), sampleSize);
+        ASSERT_EQ(info.size, sampleSize) << "Extracted sample size does not match input";
+        ASSERT_EQ(memcmp(inputData[idx].data() + inputOffset[idx], sample.data(), sampleSize), 0)
+                << "Extracted sample does not match input";
+        ASSERT_LE(abs(info.timeUs - AMediaExtractor_getSampleTime(extractor)),
+                  kMpeg4MuxToleranceTimeUs)
+                << "Extracted timestamp does not match input timestamp " << info.timeUs;
+        inputOffset[idx] += sampleSize;
+        frameIdx[idx]++;
+        AMediaExtractor_advance(extractor);
+    }
+    for (int32_t idx = 0; idx < numTracks; idx++) {
+        ASSERT_EQ(frameIdx[idx], mBufferInfo[idx].size()) << "Not all samples were extracted";
+    }
+
+    // Seeking through the segment index must land inside the file
+    int64_t seekTimeUs = mBufferInfo[0].back().timeUs / 2;
+    ASSERT_EQ(AMediaExtractor_seekTo(extractor, seekTimeUs, AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC),
+              AMEDIA_OK);
+    ASSERT_GE(AMediaExtractor_getSampleSize(extractor), 0) << "No sample after seek";
+    ASSERT_LE(AMediaExtractor_getSampleTime(extractor), mBufferInfo[0].back().timeUs);
+    AMediaExtractor_delete(extractor);
+}
+
 class ListenerTest
     : public WriterTest,
       public ::testing::TestWithParam<tuple<
@@ -36,6 +36,7 @@ constexpr uint32_t kMaxCSDStrlen = 16;
 constexpr uint32_t kMaxCount = 20;
 constexpr int32_t kMimeSize = 128;
 constexpr int32_t kDefaultInterleaveDuration = 0;
+constexpr int64_t kDefaultFragmentDurationUs = 1000000;
 // Geodata is set according to ISO-6709 standard.
 constexpr int32_t kDefaultLatitudex10000 = 500000;
 constexpr int32_t kDefaultLongitudex10000 = 1000000;
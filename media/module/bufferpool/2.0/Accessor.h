@@ -25,6 +25,7 @@
 #include "BufferStatus.h"
 
 #include <set>
+#include <string>
 
 namespace android {
 namespace hardware {
@@ -189,6 +190,8 @@ struct Accessor : public IAccessor {
 
     static void createEvictor();
 
+    static std::string dumpStatistics();
+
 private:
     class Impl;
     std::shared_ptr<Impl> mImpl;
@@ -22,7 +22,9 @@
 #include <time.h>
 #include <unistd.h>
 #include <utils/Log.h>
+#include <algorithm>
 #include <thread>
+#include <vector>
 #include "AccessorImpl.h"
 #include "Connection.h"
 
@@ -44,6 +46,9 @@ namespace {
 
     static constexpr nsecs_t kEvictGranularityNs = 1000000000; // 1 sec
     static constexpr nsecs_t kEvictDurationNs = 5000000000; // 5 secs
+
+    static constexpr size_t kMaxRetainedBytes = 1024*1024*32;
+    static constexpr nsecs_t kRetainDurationNs = 5000000000; // 5 secs
 }
 
 // Buffer structure in bufferpool process
@@ -151,7 +156,7 @@ uint32_t Accessor::Impl::sSeqId = time(nullptr) & kSeqIdMax;
 
 Accessor::Impl::Impl(
         const std::shared_ptr<BufferPoolAllocator> &allocator)
-        : mAllocator(allocator), mScheduleEvictTs(0) {}
+        : mAllocator(allocator), mScheduleEvictTs(0), mBufferPool(allocator) {}
 
 Accessor::Impl::~Impl() {
 }
@@ -214,7 +219,10 @@ ResultStatus Accessor::Impl::allocate(
     std::unique_lock<std::mutex> lock(mBufferPool.mMutex);
     mBufferPool.processStatusMessages();
     ResultStatus status = ResultStatus::OK;
-    if (!mBufferPool.getFreeBuffer(mAllocator, params, bufferId, handle)) {
+    ++sTotalRequests;
+    if (mBufferPool.getFreeBuffer(mAllocator, params, bufferId, handle)) {
+        ++sTotalRecycles;
+    } else if (!mBufferPool.getRetainedBuffer(params, bufferId, handle)) {
         lock.unlock();
         std::shared_ptr<BufferPoolAllocation> alloc;
         size_t allocSize;
@@ -302,8 +310,10 @@ bool Accessor::Impl::isValid() {
     return mBufferPool.isValid();
 }
 
-Accessor::Impl::Impl::BufferPool::BufferPool()
-    : mTimestampUs(getTimestampNow()),
+Accessor::Impl::Impl::BufferPool::BufferPool(
+        const std::shared_ptr<BufferPoolAllocator> &allocator)
+    : mAllocator(allocator),
+      mTimestampUs(getTimestampNow()),
       mLastCleanUpUs(mTimestampUs),
       mLastLogUs(mTimestampUs),
       mSeq(0),
@@ -322,13 +332,17 @@ std::atomic<std::uint32_t> Accessor::Impl::BufferPool::Invalidation::sInvSeqId(0
 
 Accessor::Impl::Impl::BufferPool::~BufferPool() {
     std::lock_guard<std::mutex> lock(mMutex);
+    if (sRetainer) {
+        sRetainer->releaseAll(this);
+    }
     ALOGD("Destruction - bufferpool2 %p "
           "cached: %zu/%zuM, %zu/%d%% in use; "
-          "allocs: %zu, %d%% recycled; "
+          "allocs: %zu, %d%% recycled, %d%% reused; "
           "transfers: %zu, %d%% unfetched",
           this, mStats.mBuffersCached, mStats.mSizeCached >> 20,
           mStats.mBuffersInUse, percentage(mStats.mBuffersInUse, mStats.mBuffersCached),
           mStats.mTotalAllocations, percentage(mStats.mTotalRecycles, mStats.mTotalAllocations),
+          percentage(mStats.mTotalReuses, mStats.mTotalAllocations),
           mStats.mTotalTransfers,
           percentage(mStats.mTotalTransfers - mStats.mTotalFetches, mStats.mTotalTransfers));
 }
@@ -690,6 +704,7 @@ bool Accessor::Impl::BufferPool::getFreeBuffer(
         BufferId id = *bufferIt;
         mFreeBuffers.erase(bufferIt);
         mStats.onBufferRecycled(mBuffers[id]->mAllocSize);
+        onSizeClassUsed(mBuffers[id]->mAllocSize);
         *handle = mBuffers[id]->handle();
         *pId = id;
         ALOGV("recycle a buffer %u %p", id, *handle);
@@ -698,12 +713,29 @@ bool Accessor::Impl::BufferPool::getFreeBuffer(
     return false;
 }
 
+bool Accessor::Impl::BufferPool::getRetainedBuffer(
+        const std::vector<uint8_t> &params, BufferId *pId,
+        const native_handle_t** handle) {
+    std::shared_ptr<BufferPoolAllocation> alloc;
+    size_t allocSize;
+    std::vector<uint8_t> config;
+    if (!sRetainer->reuse(this, mAllocator, params, &alloc, &allocSize, &config)) {
+        return false;
+    }
+    if (addNewBuffer(alloc, allocSize, config, pId, handle, true) != ResultStatus::OK) {
+        return false;
+    }
+    ALOGV("reuse a retained buffer %u %p", *pId, *handle);
+    return true;
+}
+
 ResultStatus Accessor::Impl::BufferPool::addNewBuffer(
         const std::shared_ptr<BufferPoolAllocation> &alloc,
         const size_t allocSize,
         const std::vector<uint8_t> &params,
         BufferId *pId,
-        const native_handle_t** handle) {
+        const native_handle_t** handle,
+        bool reused) {
 
     BufferId bufferId = mSeq++;
     if (mSeq == Connection::SYNC_BUFFERID) {
@@ -716,7 +748,12 @@ ResultStatus Accessor::Impl::BufferPool::addNewBuffer(
         auto res = mBuffers.insert(std::make_pair(
                 bufferId, std::move(buffer)));
         if (res.second) {
-            mStats.onBufferAllocated(allocSize);
+            if (reused) {
+                mStats.onBufferReused(allocSize);
+            } else {
+                mStats.onBufferAllocated(allocSize);
+            }
+            onSizeClassUsed(allocSize);
             *handle = alloc->handle();
             *pId = bufferId;
             return ResultStatus::OK;
@@ -740,26 +777,59 @@ void Accessor::Impl::BufferPool::cleanUp(bool clearCache) {
                   mStats.mTotalRecycles, mStats.mTotalAllocations,
                   mStats.mTotalFetches, mStats.mTotalTransfers);
         }
-        for (auto freeIt = mFreeBuffers.begin(); freeIt != mFreeBuffers.end();) {
+        // Evict the buffers of the least recently used size classes first.
+        std::vector<std::pair<int64_t, BufferId>> evictOrder;
+        evictOrder.reserve(mFreeBuffers.size());
+        for (BufferId bufferId : mFreeBuffers) {
+            auto it = mBuffers.find(bufferId);
+            int64_t usedUs = it == mBuffers.end() ? 0 : mSizeClassUsedUs[it->second->mAllocSize];
+            evictOrder.emplace_back(usedUs, bufferId);
+        }
+        std::sort(evictOrder.begin(), evictOrder.end());
+        for (const std::pair<int64_t, BufferId> &entry : evictOrder) {
             if (!clearCache && mStats.buffersNotInUse() <= kUnusedBufferCountTarget &&
                     (mStats.mSizeCached < kMinAllocBytesForEviction ||
                      mBuffers.size() < kMinBufferCountForEviction)) {
                 break;
             }
-            auto it = mBuffers.find(*freeIt);
+            auto it = mBuffers.find(entry.second);
             if (it != mBuffers.end() &&
                     it->second->mOwnerCount == 0 && it->second->mTransactionCount == 0) {
-                mStats.onBufferEvicted(it->second->mAllocSize);
-                mBuffers.erase(it);
-                freeIt = mFreeBuffers.erase(freeIt);
+                retireBuffer(it);
+                mFreeBuffers.erase(entry.second);
             } else {
-                ++freeIt;
                 ALOGW("bufferpool2 inconsistent!");
             }
         }
+        // Forget the size classes without any buffer.
+        std::set<size_t> sizeClasses;
+        for (auto it = mBuffers.begin(); it != mBuffers.end(); ++it) {
+            sizeClasses.insert(it->second->mAllocSize);
+        }
+        for (auto it = mSizeClassUsedUs.begin(); it != mSizeClassUsedUs.end();) {
+            if (sizeClasses.count(it->first) == 0) {
+                it = mSizeClassUsedUs.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 }
 
+void Accessor::Impl::BufferPool::retireBuffer(
+        std::map<BufferId, std::unique_ptr<InternalBuffer>>::iterator it) {
+    const InternalBuffer &buffer = *it->second;
+    mStats.onBufferEvicted(buffer.mAllocSize);
+    sRetainer->retain(this, buffer.mAllocation, buffer.mAllocSize, buffer.mConfig,
+                      mSizeClassUsedUs[buffer.mAllocSize], systemTime());
+    mBuffers.erase(it);
+    sEvictor->notify();
+}
+
+void Accessor::Impl::BufferPool::onSizeClassUsed(size_t allocSize) {
+    mSizeClassUsedUs[allocSize] = mTimestampUs;
+}
+
 void Accessor::Impl::BufferPool::invalidate(
         bool needsAck, BufferId from, BufferId to,
         const std::shared_ptr<Accessor::Impl> &impl) {
@@ -768,8 +838,7 @@ void Accessor::Impl::BufferPool::invalidate(
             auto it = mBuffers.find(*freeIt);
             if (it != mBuffers.end() &&
                 it->second->mOwnerCount == 0 && it->second->mTransactionCount == 0) {
-                mStats.onBufferEvicted(it->second->mAllocSize);
-                mBuffers.erase(it);
+                retireBuffer(it);
                 freeIt = mFreeBuffers.erase(freeIt);
                 continue;
             } else {
@@ -914,7 +983,7 @@ void Accessor::Impl::evictorThread(
         {
             nsecs_t now = systemTime();
             std::unique_lock<std::mutex> lock(mutex);
-            if (accessors.size() == 0) {
+            if (accessors.size() == 0 && sRetainer->empty()) {
                 cv.wait(lock);
             }
             auto it = accessors.begin();
@@ -940,6 +1009,7 @@ void Accessor::Impl::evictorThread(
             ALOGD("evictor expired: %d, evicted: %d", expired, evicted);
         }
         evictList.clear();
+        sRetainer->releaseExpired(systemTime());
         ::usleep(kEvictGranularityNs / 1000);
     }
 }
@@ -968,14 +1038,44 @@ void Accessor::Impl::AccessorEvictor::addAccessor(
     }
 }
 
+void Accessor::Impl::AccessorEvictor::notify() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCv.notify_one();
+}
+
 std::unique_ptr<Accessor::Impl::AccessorEvictor> Accessor::Impl::sEvictor;
 
+std::unique_ptr<BufferRetainer> Accessor::Impl::sRetainer;
+std::atomic<size_t> Accessor::Impl::sTotalRequests(0);
+std::atomic<size_t> Accessor::Impl::sTotalRecycles(0);
+
 void Accessor::Impl::createEvictor() {
+    if (!sRetainer) {
+        sRetainer = std::make_unique<BufferRetainer>(kMaxRetainedBytes, kRetainDurationNs);
+    }
     if (!sEvictor) {
         sEvictor = std::make_unique<Accessor::Impl::AccessorEvictor>();
     }
 }
 
+std::string Accessor::Impl::dumpStatistics() {
+    if (!sRetainer) {
+        return "bufferpool2: not in use\n";
+    }
+    size_t requests = sTotalRequests;
+    size_t recycles = sTotalRecycles;
+    BufferRetainer::Stats stats = sRetainer->getStats();
+    size_t allocations = requests - std::min(requests, recycles + stats.mTotalReused);
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "bufferpool2: requests: %zu, %zu allocated, %d%% recycled, %d%% reused; "
+             "retained: %zu buffers/%zuK, %zu retained, %zu released\n",
+             requests, allocations, percentage(recycles, requests),
+             percentage(stats.mTotalReused, requests), stats.mBuffersRetained,
+             stats.mSizeRetained >> 10, stats.mTotalRetained, stats.mTotalReleased);
+    return buf;
+}
+
 void Accessor::Impl::scheduleEvictIfNeeded() {
     nsecs_t now = systemTime();
 
@@ -19,9 +19,11 @@
 
 #include <map>
 #include <set>
+#include <string>
 #include <condition_variable>
 #include <utils/Timers.h>
 #include "Accessor.h"
+#include "BufferRetainer.h"
 
 namespace android {
 namespace hardware {
@@ -74,6 +76,8 @@ public:
 
     static void createEvictor();
 
+    static std::string dumpStatistics();
+
 private:
     // ConnectionId = pid : (timestamp_created + seqId)
     // in order to guarantee uniqueness for each connection
@@ -92,6 +96,7 @@ private:
     struct BufferPool {
     private:
         std::mutex mMutex;
+        const std::shared_ptr<BufferPoolAllocator> mAllocator;
         int64_t mTimestampUs;
         int64_t mLastCleanUpUs;
         int64_t mLastLogUs;
@@ -116,6 +121,9 @@ private:
         std::map<BufferId, std::unique_ptr<InternalBuffer>> mBuffers;
         std::set<BufferId> mFreeBuffers;
         std::set<ConnectionId> mConnectionIds;
+        // Last allocation timestamp of each allocation size. Free buffers of
+        // the least recently used sizes are evicted first.
+        std::map<size_t, int64_t> mSizeClassUsedUs;
 
         struct Invalidation {
             static std::atomic<std::uint32_t> sInvSeqId;
@@ -184,6 +192,9 @@ private:
             /// # of allocations that were served from the cache.
             /// (# of allocator alloc prevented)
             size_t mTotalRecycles;
+            /// # of recycles that were served from buffers retained after
+            /// this buffer pool evicted them.
+            size_t mTotalReuses;
             /// # of buffer transfers initiated.
             size_t mTotalTransfers;
             /// # of transfers that had to be fetched.
@@ -191,7 +202,8 @@ private:
 
             Stats()
                 : mSizeCached(0), mBuffersCached(0), mSizeInUse(0), mBuffersInUse(0),
-                  mTotalAllocations(0), mTotalRecycles(0), mTotalTransfers(0), mTotalFetches(0) {}
+                  mTotalAllocations(0), mTotalRecycles(0), mTotalReuses(0),
+                  mTotalTransfers(0), mTotalFetches(0) {}
 
             /// # of currently unused buffers
             size_t buffersNotInUse() const {
@@ -225,6 +237,14 @@ private:
                 mTotalRecycles++;
             }
 
+            /// A buffer retained after eviction is reused on an allocation
+            /// request.
+            void onBufferReused(size_t allocSize) {
+                onBufferAllocated(allocSize);
+                mTotalRecycles++;
+                mTotalReuses++;
+            }
+
             /// A buffer is available to be recycled.
             void onBufferUnused(size_t allocSize) {
                 mSizeInUse -= allocSize;
@@ -249,11 +269,20 @@ private:
         void invalidate(bool needsAck, BufferId from, BufferId to,
                         const std::shared_ptr<Accessor::Impl> &impl);
 
+        /**
+         * Evicts a free buffer, and hands its allocation over to the
+         * process-wide retainer.
+         */
+        void retireBuffer(std::map<BufferId, std::unique_ptr<InternalBuffer>>::iterator it);
+
+        /** Marks the size class of an allocation as used. */
+        void onSizeClassUsed(size_t allocSize);
+
         static void createInvalidator();
 
     public:
         /** Creates a buffer pool. */
-        BufferPool();
+        BufferPool(const std::shared_ptr<BufferPoolAllocator> &allocator);
 
         /** Destroys a buffer pool. */
         ~BufferPool();
@@ -344,6 +373,21 @@ private:
                 const std::vector<uint8_t> &params,
                 BufferId *pId, const native_handle_t **handle);
 
+        /**
+         * Reuses a compatible allocation retained after this buffer pool
+         * evicted it if it is possible.
+         *
+         * @param params    the allocation parameters.
+         * @param pId       the id of the reused buffer.
+         * @param handle    the native handle of the reused buffer.
+         *
+         * @return {@code true} when a buffer is reused, {@code false}
+         *         otherwise.
+         */
+        bool getRetainedBuffer(
+                const std::vector<uint8_t> &params,
+                BufferId *pId, const native_handle_t **handle);
+
         /**
          * Adds a newly allocated buffer to bufferpool.
          *
@@ -352,6 +396,8 @@ private:
          * @param params    the allocation parameters.
          * @param pId       the buffer id for the newly allocated buffer.
          * @param handle    the native handle for the newly allocated buffer.
+         * @param reused    whether the buffer was retained after eviction
+         *                  instead of being allocated.
          *
          * @return OK when an allocation is successfully allocated.
          *         NO_MEMORY when there is no memory.
@@ -362,7 +408,8 @@ private:
                 const size_t allocSize,
                 const std::vector<uint8_t> &params,
                 BufferId *pId,
-                const native_handle_t **handle);
+                const native_handle_t **handle,
+                bool reused = false);
 
         /**
          * Processes pending buffer status messages and performs periodic cache
@@ -408,10 +455,17 @@ private:
 
         AccessorEvictor();
         void addAccessor(const std::weak_ptr<Accessor::Impl> &impl, nsecs_t ts);
+        void notify();
     };
 
     static std::unique_ptr<AccessorEvictor> sEvictor;
 
+    static std::unique_ptr<BufferRetainer> sRetainer;
+
+    /// process-wide statistics
+    static std::atomic<size_t> sTotalRequests;
+    static std::atomic<size_t> sTotalRecycles;
+
     static void evictorThread(
         std::map<const std::weak_ptr<Accessor::Impl>, nsecs_t, std::owner_less<>> &accessors,
         std::mutex &mutex,
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BufferPoolRetainer2.0"
+//#define LOG_NDEBUG 0
+
+#include <utils/Log.h>
+#include <algorithm>
+#include "BufferRetainer.h"
+
+namespace android {
+namespace hardware {
+namespace media {
+namespace bufferpool {
+namespace V2_0 {
+namespace implementation {
+
+BufferRetainer::BufferRetainer(size_t maxBytes, nsecs_t retainDurationNs)
+    : mMaxBytes(maxBytes), mRetainDurationNs(retainDurationNs),
+      mRetainedBytes(0), mTotalRetained(0), mTotalReused(0), mTotalReleased(0) {}
+
+void BufferRetainer::retain(
+        const void *owner,
+        const std::shared_ptr<BufferPoolAllocation> &alloc,
+        size_t allocSize, const std::vector<uint8_t> &config,
+        int64_t lastUsedUs, nsecs_t now) {
+    if (allocSize > mMaxBytes) {
+        return;
+    }
+    // Allocations are released after the lock is dropped.
+    std::list<Entry> released;
+    std::lock_guard<std::mutex> lock(mMutex);
+    while (mRetainedBytes + allocSize > mMaxBytes) {
+        auto lru = std::min_element(
+                mEntries.begin(), mEntries.end(),
+                [](const Entry &a, const Entry &b) { return a.mLastUsedUs < b.mLastUsedUs; });
+        mRetainedBytes -= lru->mAllocSize;
+        ++mTotalReleased;
+        released.splice(released.end(), mEntries, lru);
+    }
+    mEntries.push_back({owner, alloc, allocSize, config, lastUsedUs, now});
+    mRetainedBytes += allocSize;
+    ++mTotalRetained;
+}
+
+bool BufferRetainer::reuse(
+        const void *owner,
+        const std::shared_ptr<BufferPoolAllocator> &allocator,
+        const std::vector<uint8_t> &params,
+        std::shared_ptr<BufferPoolAllocation> *alloc,
+        size_t *allocSize, std::vector<uint8_t> *config) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (it->mOwner == owner && allocator->compatible(params, it->mConfig)) {
+            *alloc = std::move(it->mAllocation);
+            *allocSize = it->mAllocSize;
+            *config = std::move(it->mConfig);
+            mRetainedBytes -= it->mAllocSize;
+            ++mTotalReused;
+            mEntries.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void BufferRetainer::releaseExpired(nsecs_t now) {
+    std::list<Entry> released;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        auto next = std::next(it);
+        if (now > it->mRetainedTs + mRetainDurationNs) {
+            mRetainedBytes -= it->mAllocSize;
+            ++mTotalReleased;
+            released.splice(released.end(), mEntries, it);
+        }
+        it = next;
+    }
+}
+
+void BufferRetainer::releaseAll(const void *owner) {
+    std::list<Entry> released;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        auto next = std::next(it);
+        if (it->mOwner == owner) {
+            mRetainedBytes -= it->mAllocSize;
+            ++mTotalReleased;
+            released.splice(released.end(), mEntries, it);
+        }
+        it = next;
+    }
+    if (!released.empty()) {
+        ALOGV("released %zu allocations of a closed buffer pool", released.size());
+    }
+}
+
+bool BufferRetainer::empty() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.empty();
+}
+
+BufferRetainer::Stats BufferRetainer::getStats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return {mEntries.size(), mRetainedBytes, mTotalRetained, mTotalReused, mTotalReleased};
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace bufferpool
+}  // namespace media
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_MEDIA_BUFFERPOOL_V2_0_BUFFERRETAINER_H
+#define ANDROID_HARDWARE_MEDIA_BUFFERPOOL_V2_0_BUFFERRETAINER_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <utils/Timers.h>
+#include <bufferpool/BufferPoolTypes.h>
+
+namespace android {
+namespace hardware {
+namespace media {
+namespace bufferpool {
+namespace V2_0 {
+namespace implementation {
+
+/**
+ * Process-wide cache of free allocations evicted from buffer pools.
+ *
+ * An allocation is only handed back to the buffer pool which evicted it, so
+ * that the contents of a buffer never reach another client. Allocations are
+ * kept up to a total size, releasing the allocations of the least recently
+ * used size classes first, and released after a fixed duration or when the
+ * buffer pool goes away.
+ */
+class BufferRetainer {
+public:
+    struct Stats {
+        /// # of currently retained allocations.
+        size_t mBuffersRetained;
+        /// Total size of currently retained allocations.
+        size_t mSizeRetained;
+        /// # of allocations retained.
+        size_t mTotalRetained;
+        /// # of retained allocations reused.
+        size_t mTotalReused;
+        /// # of retained allocations released without reuse.
+        size_t mTotalReleased;
+    };
+
+    /**
+     * Creates a retainer.
+     *
+     * @param maxBytes          the maximum total size of retained allocations.
+     * @param retainDurationNs  how long an allocation is retained.
+     */
+    BufferRetainer(size_t maxBytes, nsecs_t retainDurationNs);
+
+    /**
+     * Retains an allocation evicted from a buffer pool.
+     *
+     * @param owner         the buffer pool which evicted the allocation.
+     * @param alloc         the allocation.
+     * @param allocSize     the size of the allocation.
+     * @param config        the allocation parameters of the allocation.
+     * @param lastUsedUs    when the size class of the allocation was last used
+     *                      by the buffer pool.
+     * @param now           the current time.
+     */
+    void retain(const void *owner,
+                const std::shared_ptr<BufferPoolAllocation> &alloc,
+                size_t allocSize, const std::vector<uint8_t> &config,
+                int64_t lastUsedUs, nsecs_t now);
+
+    /**
+     * Takes back an allocation retained for a buffer pool, which is compatible
+     * with the requested allocation parameters.
+     *
+     * @param owner         the buffer pool.
+     * @param allocator     the allocator of the buffer pool.
+     * @param params        the requested allocation parameters.
+     * @param alloc         the reused allocation.
+     * @param allocSize     the size of the reused allocation.
+     * @param config        the allocation parameters of the reused allocation.
+     *
+     * @return {@code true} when an allocation is reused, {@code false}
+     *         otherwise.
+     */
+    bool reuse(const void *owner,
+               const std::shared_ptr<BufferPoolAllocator> &allocator,
+               const std::vector<uint8_t> &params,
+               std::shared_ptr<BufferPoolAllocation> *alloc,
+               size_t *allocSize, std::vector<uint8_t> *config);
+
+    /** Releases the allocations retained for longer than the retain duration. */
+    void releaseExpired(nsecs_t now);
+
+    /** Releases the allocations retained for a buffer pool. */
+    void releaseAll(const void *owner);
+
+    bool empty();
+
+    Stats getStats();
+
+private:
+    struct Entry {
+        const void *mOwner;
+        std::shared_ptr<BufferPoolAllocation> mAllocation;
+        size_t mAllocSize;
+        std::vector<uint8_t> mConfig;
+        int64_t mLastUsedUs;
+        nsecs_t mRetainedTs;
+    };
+
+    const size_t mMaxBytes;
+    const nsecs_t mRetainDurationNs;
+
+    std::mutex mMutex;
+    std::list<Entry> mEntries;
+    size_t mRetainedBytes;
+    size_t mTotalRetained;
+    size_t mTotalReused;
+    size_t mTotalReleased;
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace bufferpool
+}  // namespace media
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_MEDIA_BUFFERPOOL_V2_0_BUFFERRETAINER_H
@@ -488,6 +488,10 @@ sp<ClientManager> ClientManager::getInstance() {
     return sInstance;
 }
 
+std::string ClientManager::dumpStatistics() {
+    return Accessor::dumpStatistics();
+}
+
 ClientManager::ClientManager() : mImpl(new Impl()) {}
 
 ClientManager::~ClientManager() {
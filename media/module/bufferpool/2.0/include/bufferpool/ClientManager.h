@@ -21,6 +21,7 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 #include <memory>
+#include <string>
 #include "BufferPoolTypes.h"
 
 namespace android {
@@ -173,6 +174,12 @@ struct ClientManager : public IClientManager {
      */
     void cleanUp();
 
+    /**
+     * Returns the buffer allocation and reuse statistics of the buffer pools
+     * in this process, for dumpsys.
+     */
+    static std::string dumpStatistics();
+
     /** Destructs the manager of buffer pool clients.  */
     ~ClientManager();
 private:
@@ -26,6 +26,7 @@
 #include <sys/wait.h>
 #include <unordered_set>
 #include <vector>
+#include "BufferRetainer.h"
 #include "allocator.h"
 
 using android::hardware::configureRpcThreadpool;
@@ -33,6 +34,7 @@ using android::hardware::media::bufferpool::BufferPoolData;
 using android::hardware::media::bufferpool::V2_0::IClientManager;
 using android::hardware::media::bufferpool::V2_0::ResultStatus;
 using android::hardware::media::bufferpool::V2_0::implementation::BufferId;
+using android::hardware::media::bufferpool::V2_0::implementation::BufferRetainer;
 using android::hardware::media::bufferpool::V2_0::implementation::ClientManager;
 using android::hardware::media::bufferpool::V2_0::implementation::ConnectionId;
 using android::hardware::media::bufferpool::V2_0::implementation::TransactionId;
@@ -68,6 +70,8 @@ union PipeMessage {
 
 static int32_t kNumIterationCount = 10;
 
+static constexpr nsecs_t kRetainDurationNs = 5000000000;  // 5 secs
+
 class BufferpoolTest {
   public:
     BufferpoolTest() : mConnectionValid(false), mManager(nullptr), mAllocator(nullptr) {
@@ -384,6 +388,113 @@ TEST_F(BufferpoolUnitTest, FlushTest) {
     timestampUs.clear();
 }
 
+// Retains an allocation of |size| bytes for |owner| with the allocation parameters |config|,
+// and returns a reference to it that expires when the retainer releases it.
+static std::weak_ptr<BufferPoolAllocation> retain(BufferRetainer* retainer, const void* owner,
+                                                  size_t size, uint8_t config, int64_t lastUsedUs,
+                                                  nsecs_t now = 0) {
+    std::shared_ptr<BufferPoolAllocation> alloc = std::make_shared<BufferPoolAllocation>(nullptr);
+    retainer->retain(owner, alloc, size, {config}, lastUsedUs, now);
+    return alloc;
+}
+
+// The retainer keeps allocations up to its size limit, and does not keep allocations larger
+// than the limit.
+TEST_F(BufferpoolUnitTest, RetainerCap) {
+    BufferRetainer retainer(100, kRetainDurationNs);
+    std::weak_ptr<BufferPoolAllocation> first = retain(&retainer, this, 40, 1, 1);
+    std::weak_ptr<BufferPoolAllocation> second = retain(&retainer, this, 40, 1, 2);
+    EXPECT_EQ(retainer.getStats().mSizeRetained, 80);
+
+    std::weak_ptr<BufferPoolAllocation> third = retain(&retainer, this, 40, 1, 3);
+    EXPECT_TRUE(first.expired()) << "retainer exceeded its size limit";
+    EXPECT_FALSE(second.expired());
+    EXPECT_FALSE(third.expired());
+
+    std::weak_ptr<BufferPoolAllocation> large = retain(&retainer, this, 101, 2, 4);
+    EXPECT_TRUE(large.expired()) << "allocation larger than the limit was retained";
+
+    BufferRetainer::Stats stats = retainer.getStats();
+    EXPECT_EQ(stats.mBuffersRetained, 2);
+    EXPECT_EQ(stats.mSizeRetained, 80);
+    EXPECT_EQ(stats.mTotalRetained, 3);
+    EXPECT_EQ(stats.mTotalReleased, 1);
+}
+
+// When the retainer is full, the allocations of the least recently used size classes are
+// released first, regardless of the order in which they were retained.
+TEST_F(BufferpoolUnitTest, RetainerLruEviction) {
+    BufferRetainer retainer(100, kRetainDurationNs);
+    std::weak_ptr<BufferPoolAllocation> recent = retain(&retainer, this, 30, 1, 5);
+    std::weak_ptr<BufferPoolAllocation> oldest = retain(&retainer, this, 50, 2, 1);
+    std::weak_ptr<BufferPoolAllocation> older = retain(&retainer, this, 20, 3, 3);
+
+    std::weak_ptr<BufferPoolAllocation> newest = retain(&retainer, this, 40, 4, 9);
+    EXPECT_TRUE(oldest.expired());
+    EXPECT_FALSE(older.expired());
+    EXPECT_FALSE(recent.expired());
+    EXPECT_FALSE(newest.expired());
+
+    newest.reset();
+    std::weak_ptr<BufferPoolAllocation> last = retain(&retainer, this, 30, 5, 10);
+    EXPECT_TRUE(older.expired());
+    EXPECT_FALSE(recent.expired());
+    EXPECT_FALSE(last.expired());
+    EXPECT_EQ(retainer.getStats().mSizeRetained, 100);
+}
+
+// Allocations are released once they have been retained for the retain duration.
+TEST_F(BufferpoolUnitTest, RetainerExpiry) {
+    BufferRetainer retainer(100, kRetainDurationNs);
+    std::weak_ptr<BufferPoolAllocation> first = retain(&retainer, this, 10, 1, 1, 0);
+    std::weak_ptr<BufferPoolAllocation> second =
+            retain(&retainer, this, 10, 1, 1, kRetainDurationNs / 2);
+
+    retainer.releaseExpired(kRetainDurationNs);
+    EXPECT_FALSE(first.expired());
+    EXPECT_FALSE(second.expired());
+
+    retainer.releaseExpired(kRetainDurationNs + 1);
+    EXPECT_TRUE(first.expired());
+    EXPECT_FALSE(second.expired());
+
+    retainer.releaseExpired(kRetainDurationNs / 2 + kRetainDurationNs + 1);
+    EXPECT_TRUE(second.expired());
+    EXPECT_TRUE(retainer.empty());
+    EXPECT_EQ(retainer.getStats().mTotalReleased, 2);
+}
+
+// Retained allocations are only reused by the buffer pool that evicted them, with compatible
+// allocation parameters, and are released with that buffer pool.
+TEST_F(BufferpoolUnitTest, RetainerReuse) {
+    BufferRetainer retainer(100, kRetainDurationNs);
+    int owner;
+    int otherOwner;
+    std::weak_ptr<BufferPoolAllocation> first = retain(&retainer, &owner, 10, 1, 1);
+    std::weak_ptr<BufferPoolAllocation> second = retain(&retainer, &owner, 20, 2, 1);
+
+    std::shared_ptr<BufferPoolAllocation> alloc;
+    size_t allocSize;
+    std::vector<uint8_t> config;
+    EXPECT_FALSE(retainer.reuse(&otherOwner, mAllocator, {1}, &alloc, &allocSize, &config))
+            << "allocation reused by another buffer pool";
+    EXPECT_FALSE(retainer.reuse(&owner, mAllocator, {3}, &alloc, &allocSize, &config))
+            << "allocation reused with incompatible parameters";
+
+    ASSERT_TRUE(retainer.reuse(&owner, mAllocator, {2}, &alloc, &allocSize, &config));
+    EXPECT_EQ(alloc, second.lock());
+    EXPECT_EQ(allocSize, 20);
+    EXPECT_EQ(config, std::vector<uint8_t>{2});
+    EXPECT_EQ(retainer.getStats().mTotalReused, 1);
+    EXPECT_EQ(retainer.getStats().mSizeRetained, 10);
+
+    retainer.releaseAll(&otherOwner);
+    EXPECT_FALSE(first.expired());
+    retainer.releaseAll(&owner);
+    EXPECT_TRUE(first.expired());
+    EXPECT_TRUE(retainer.empty());
+}
+
 // Buffer transfer test between processes.
 TEST_F(BufferpoolFunctionalityTest, TransferBuffer) {
     // initialize the receiver
@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ExtractorBenchmark"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/DataSource.h>
+#include <media/MediaExtractorPluginHelper.h>
+#include <media/stagefright/MediaBufferGroup.h>
+
+// Each benchmark binary is built for exactly one extractor, like the fuzzers, since every
+// extractor library defines its own GETEXTRACTORDEF().
+#if defined(EXTRACTOR_AAC)
+#include "AACExtractor.h"
+#elif defined(EXTRACTOR_AMR)
+#include "AMRExtractor.h"
+#elif defined(EXTRACTOR_FLAC)
+#include "FLACExtractor.h"
+#elif defined(EXTRACTOR_MKV)
+#include "MatroskaExtractor.h"
+#elif defined(EXTRACTOR_MP3)
+#include "MP3Extractor.h"
+#elif defined(EXTRACTOR_MP4)
+#include "MPEG4Extractor.h"
+#elif defined(EXTRACTOR_MPEG2PS)
+#include "MPEG2PSExtractor.h"
+#elif defined(EXTRACTOR_MPEG2TS)
+#include "MPEG2TSExtractor.h"
+#elif defined(EXTRACTOR_OGG)
+#include "OggExtractor.h"
+#elif defined(EXTRACTOR_WAV)
+#include "WAVExtractor.h"
+#else
+#error "No extractor selected"
+#endif
+
+extern "C" {
+android::ExtractorDef GETEXTRACTORDEF();
+}
+
+using namespace android;
+
+constexpr int32_t kNumRandomSeeks = 32;
+constexpr int32_t kRandomSeed = 700;
+
+// Clips from the extractor test resources, see README.md.
+static const char *const kCorpus[] = {
+#if defined(EXTRACTOR_AAC)
+        "test_mono_44100Hz_aac.aac",
+#elif defined(EXTRACTOR_AMR)
+        "bbb_mono_8kHz_amrnb.amr",
+        "bbb_mono_16kHz_amrwb.amr",
+#elif defined(EXTRACTOR_FLAC)
+        "bbb_stereo_48kHz_flac.flac",
+#elif defined(EXTRACTOR_MKV)
+        "bbb_cif_768kbps_30fps_mpeg4.mkv",
+        "bbb_340x280_30fps_vp9.webm",
+#elif defined(EXTRACTOR_MP3)
+        "bbb_stereo_48kHz_mp3.mp3",
+        "sinesweepmp3lame.mp3",
+#elif defined(EXTRACTOR_MP4)
+        "crowd_508x240_25fps_hevc.mp4",
+        "test3.heic",
+#elif defined(EXTRACTOR_MPEG2PS)
+        "swirl_144x136_mpeg2.mpg",
+#elif defined(EXTRACTOR_MPEG2TS)
+        "bbb_cif_768kbps_30fps_mpeg2.ts",
+#elif defined(EXTRACTOR_OGG)
+        "test_stereo_48kHz_opus.opus",
+        "bbb_stereo_48kHz_vorbis.ogg",
+#elif defined(EXTRACTOR_WAV)
+        "test_mono_8kHz_gsm.wav",
+#endif
+};
+
+// Counts every operator new so the metadata benchmarks can report allocations per file.
+static std::atomic<int64_t> gNumAllocations{0};
+
+void *operator new(size_t size) {
+    ++gNumAllocations;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    ++gNumAllocations;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    ++gNumAllocations;
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    ++gNumAllocations;
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+// Serves a clip from memory so that storage does not add noise, while counting the reads an
+// extractor issues. Every readAt() would be one pread() on a FileSource.
+class CorpusSource : public DataSource {
+  public:
+    explicit CorpusSource(const std::vector<uint8_t> &data) : mData(data) {}
+
+    status_t initCheck() const override { return OK; }
+
+    ssize_t readAt(off64_t offset, void *data, size_t size) override {
+        ++mNumReads;
+        if (offset < 0 || offset >= static_cast<off64_t>(mData.size())) {
+            return 0;
+        }
+        size = std::min(size, mData.size() - static_cast<size_t>(offset));
+        memcpy(data, mData.data() + offset, size);
+        mBytesRead += size;
+        return size;
+    }
+
+    status_t getSize(off64_t *size) override {
+        *size = mData.size();
+        return OK;
+    }
+
+    int64_t numReads() const { return mNumReads; }
+    int64_t bytesRead() const { return mBytesRead; }
+
+  private:
+    const std::vector<uint8_t> &mData;
+    int64_t mNumReads = 0;
+    int64_t mBytesRead = 0;
+
+    DISALLOW_EVIL_CONSTRUCTORS(CorpusSource);
+};
+
+static MediaExtractorPluginHelper *createExtractor(const sp<CorpusSource> &source) {
+#if defined(EXTRACTOR_AAC)
+    return new AACExtractor(new DataSourceHelper(source->wrap()), 0);
+#elif defined(EXTRACTOR_AMR)
+    return new AMRExtractor(new DataSourceHelper(source->wrap()));
+#elif defined(EXTRACTOR_FLAC)
+    return new FLACExtractor(new DataSourceHelper(source->wrap()));
+#elif defined(EXTRACTOR_MKV)
+    return new MatroskaExtractor(new DataSourceHelper(source->wrap()));
+#elif defined(EXTRACTOR_MP3)
+    return new MP3Extractor(new DataSourceHelper(source->wrap()), nullptr);
+#elif defined(EXTRACTOR_MP4)
+    return new MPEG4Extractor(new DataSourceHelper(source->wrap()));
+#elif defined(EXTRACTOR_MPEG2PS)
+    return new MPEG2PSExtractor(new DataSourceHelper(source->wrap()));
+#elif defined(EXTRACTOR_MPEG2TS)
+    return new MPEG2TSExtractor(new DataSourceHelper(source->wrap()));
+#elif defined(EXTRACTOR_OGG)
+    return new OggExtractor(new DataSourceHelper(source->wrap()));
+#elif defined(EXTRACTOR_WAV)
+    return new WAVExtractor(new DataSourceHelper(source->wrap()));
+#endif
+}
+
+static void setIoCounters(benchmark::State &state, const CorpusSource &source,
+                          int64_t numAllocations) {
+    state.counters["reads"] =
+            benchmark::Counter(source.numReads(), benchmark::Counter::kAvgIterations);
+    state.counters["bytes_read"] =
+            benchmark::Counter(source.bytesRead(), benchmark::Counter::kAvgIterations);
+    state.counters["allocs"] =
+            benchmark::Counter(numAllocations, benchmark::Counter::kAvgIterations);
+}
+
+// Time taken by the sniffer to claim the clip.
+static void BM_Sniff(benchmark::State &state, const std::vector<uint8_t> *data) {
+    sp<CorpusSource> source = new CorpusSource(*data);
+    ExtractorDef def = GETEXTRACTORDEF();
+    int64_t numAllocations = 0;
+    for (auto _ : state) {
+        float confidence = 0.0f;
+        void *meta = nullptr;
+        FreeMetaFunc freeMeta = nullptr;
+        int64_t allocationsBefore = gNumAllocations;
+        CreatorFunc creator = nullptr;
+        if (def.def_version == EXTRACTORDEF_VERSION_NDK_V1) {
+            creator = def.u.v2.sniff(source->wrap(), &confidence, &meta, &freeMeta);
+        } else if (def.def_version == EXTRACTORDEF_VERSION_NDK_V2) {
+            creator = def.u.v3.sniff(source->wrap(), &confidence, &meta, &freeMeta);
+        }
+        numAllocations += gNumAllocations - allocationsBefore;
+        if (meta != nullptr && freeMeta != nullptr) {
+            freeMeta(meta);
+        }
+        if (creator == nullptr) {
+            state.SkipWithError("Sniffer did not recognize the clip");
+            return;
+        }
+    }
+    setIoCounters(state, *source, numAllocations);
+}
+
+// Time to first usable metadata: extractor creation, container and all track formats.
+static void BM_ReadMetaData(benchmark::State &state, const std::vector<uint8_t> *data) {
+    sp<CorpusSource> source = new CorpusSource(*data);
+    int64_t numAllocations = 0;
+    for (auto _ : state) {
+        int64_t allocationsBefore = gNumAllocations;
+        MediaExtractorPluginHelper *extractor = createExtractor(source);
+        AMediaFormat *format = AMediaFormat_new();
+        extractor->getMetaData(format);
+        size_t numTracks = extractor->countTracks();
+        for (size_t i = 0; i < numTracks; ++i) {
+            extractor->getTrackMetaData(
+                    format, i, MediaExtractorPluginHelper::kIncludeExtensiveMetaData);
+        }
+        AMediaFormat_delete(format);
+        delete extractor;
+        numAllocations += gNumAllocations - allocationsBefore;
+        if (numTracks == 0) {
+            state.SkipWithError("Extractor found no tracks");
+            return;
+        }
+    }
+    setIoCounters(state, *source, numAllocations);
+}
+
+// Runs |body| on each started track of a freshly created extractor.
+template <typename Body>
+static bool forEachTrack(const sp<CorpusSource> &source, Body body) {
+    MediaExtractorPluginHelper *extractor = createExtractor(source);
+    MediaBufferGroup *bufferGroup = new MediaBufferGroup();
+    size_t numTracks = extractor->countTracks();
+    for (size_t i = 0; i < numTracks; ++i) {
+        MediaTrackHelper *track = extractor->getTrack(i);
+        if (track == nullptr) {
+            continue;
+        }
+        CMediaTrack *cTrack = wrap(track);
+        if (cTrack->start(track, bufferGroup->wrap()) == AMEDIA_OK) {
+            AMediaFormat *format = AMediaFormat_new();
+            int64_t durationUs = 0;
+            extractor->getTrackMetaData(format, i, 0);
+            AMediaFormat_getInt64(format, AMEDIAFORMAT_KEY_DURATION, &durationUs);
+            AMediaFormat_delete(format);
+            body(track, durationUs);
+            cTrack->stop(track);
+        }
+        free(cTrack);
+        delete track;
+    }
+    delete bufferGroup;
+    delete extractor;
+    return numTracks > 0;
+}
+
+// Demuxing throughput when playing every track from start to end.
+static void BM_SequentialRead(benchmark::State &state, const std::vector<uint8_t> *data) {
+    sp<CorpusSource> source = new CorpusSource(*data);
+    int64_t sampleBytes = 0;
+    int64_t numSamples = 0;
+    for (auto _ : state) {
+        bool hasTracks = forEachTrack(source, [&](MediaTrackHelper *track, int64_t) {
+            MediaBufferHelper *buffer = nullptr;
+            while (track->read(&buffer) == AMEDIA_OK) {
+                if (buffer) {
+                    sampleBytes += buffer->range_length();
+                    ++numSamples;
+                    buffer->release();
+                    buffer = nullptr;
+                }
+            }
+        });
+        if (!hasTracks) {
+            state.SkipWithError("Extractor found no tracks");
+            return;
+        }
+    }
+    state.SetBytesProcessed(sampleBytes);
+    state.SetItemsProcessed(numSamples);
+    state.counters["reads"] =
+            benchmark::Counter(source->numReads(), benchmark::Counter::kAvgIterations);
+}
+
+// Timestamps of the samples of one track as read from the start, keyed on their contents.
+using SampleTimes = std::unordered_map<size_t, int64_t>;
+// Marks contents shared by several samples, e.g. silence, which cannot tell where a seek landed.
+constexpr int64_t kAmbiguousTime = -1;
+
+static size_t hashSample(MediaBufferHelper *buffer) {
+    return std::hash<std::string_view>()(std::string_view(
+            static_cast<const char *>(buffer->data()) + buffer->range_offset(),
+            buffer->range_length()));
+}
+
+static std::vector<SampleTimes> getSampleTimes(const std::vector<uint8_t> &data) {
+    sp<CorpusSource> source = new CorpusSource(data);
+    std::vector<SampleTimes> tracks;
+    forEachTrack(source, [&](MediaTrackHelper *track, int64_t) {
+        SampleTimes &times = tracks.emplace_back();
+        MediaBufferHelper *buffer = nullptr;
+        while (track->read(&buffer) == AMEDIA_OK) {
+            if (buffer) {
+                int64_t timeUs;
+                if (AMediaFormat_getInt64(buffer->meta_data(), AMEDIAFORMAT_KEY_TIME_US,
+                                          &timeUs)) {
+                    auto [it, inserted] = times.emplace(hashSample(buffer), timeUs);
+                    if (!inserted) {
+                        it->second = kAmbiguousTime;
+                    }
+                }
+                buffer->release();
+                buffer = nullptr;
+            }
+        }
+    });
+    return tracks;
+}
+
+// Seeks per second to random positions, each followed by the read that completes it.
+// seek_error_us is the mean difference between the timestamp reported for the first sample
+// after a seek and the timestamp that sample has when the track is read from the start, which
+// exposes seeks that land somewhere else than they claim, e.g. estimated seeks in VBR streams.
+static void BM_RandomSeek(benchmark::State &state, const std::vector<uint8_t> *data) {
+    const std::vector<SampleTimes> sampleTimes = getSampleTimes(*data);
+    sp<CorpusSource> source = new CorpusSource(*data);
+    int64_t numSeeks = 0;
+    int64_t seekErrorUs = 0;
+    int64_t numCheckedSeeks = 0;
+    for (auto _ : state) {
+        std::mt19937 generator(kRandomSeed);
+        size_t trackIndex = 0;
+        bool hasTracks = forEachTrack(source, [&](MediaTrackHelper *track, int64_t durationUs) {
+            const SampleTimes *times =
+                    trackIndex < sampleTimes.size() ? &sampleTimes[trackIndex] : nullptr;
+            ++trackIndex;
+            std::uniform_int_distribution<int64_t> position(0, std::max<int64_t>(durationUs, 0));
+            for (int32_t i = 0; i < kNumRandomSeeks; ++i) {
+                MediaTrackHelper::ReadOptions options(
+                        CMediaTrackReadOptions::SEEK | CMediaTrackReadOptions::SEEK_PREVIOUS_SYNC,
+                        position(generator));
+                MediaBufferHelper *buffer = nullptr;
+                track->read(&buffer, &options);
+                if (buffer) {
+                    int64_t timeUs;
+                    if (times != nullptr && AMediaFormat_getInt64(buffer->meta_data(),
+                                                                  AMEDIAFORMAT_KEY_TIME_US,
+                                                                  &timeUs)) {
+                        auto it = times->find(hashSample(buffer));
+                        if (it != times->end() && it->second != kAmbiguousTime) {
+                            seekErrorUs += std::abs(timeUs - it->second);
+                            ++numCheckedSeeks;
+                        }
+                    }
+                    buffer->release();
+                }
+                ++numSeeks;
+            }
+        });
+        if (!hasTracks) {
+            state.SkipWithError("Extractor found no tracks");
+            return;
+        }
+    }
+    state.SetItemsProcessed(numSeeks);
+    state.counters["reads"] =
+            benchmark::Counter(source->numReads(), benchmark::Counter::kAvgIterations);
+    state.counters["seek_error_us"] =
+            numCheckedSeeks > 0 ? static_cast<double>(seekErrorUs) / numCheckedSeeks : 0;
+}
+
+int main(int argc, char **argv) {
+    std::string res = "/data/local/tmp/";
+    // Leave the google-benchmark flags to benchmark::Initialize().
+    std::vector<char *> benchmarkArgs;
+    for (int i = 0; i < argc; ++i) {
+        if ((!strcmp(argv[i], "-P") || !strcmp(argv[i], "--res")) && i + 1 < argc) {
+            res = argv[++i];
+            if (res.back() != '/') res += '/';
+        } else {
+            benchmarkArgs.push_back(argv[i]);
+        }
+    }
+
+    // Clips stay loaded for the lifetime of the benchmarks registered on them.
+    std::vector<std::vector<uint8_t>> clips(std::size(kCorpus));
+    for (size_t i = 0; i < std::size(kCorpus); ++i) {
+        std::ifstream file(res + kCorpus[i], std::ios::binary);
+        if (!file.is_open()) {
+            fprintf(stderr, "Unable to open %s%s\n", res.c_str(), kCorpus[i]);
+            return 1;
+        }
+        clips[i].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        const std::string name = kCorpus[i];
+        benchmark::RegisterBenchmark(("BM_Sniff/" + name).c_str(), BM_Sniff, &clips[i]);
+        benchmark::RegisterBenchmark(("BM_ReadMetaData/" + name).c_str(), BM_ReadMetaData,
+                                     &clips[i]);
+        benchmark::RegisterBenchmark(("BM_SequentialRead/" + name).c_str(), BM_SequentialRead,
+                                     &clips[i]);
+        benchmark::RegisterBenchmark(("BM_RandomSeek/" + name).c_str(), BM_RandomSeek,
+                                     &clips[i]);
+    }
+
+    int benchmarkArgc = benchmarkArgs.size();
+    benchmark::Initialize(&benchmarkArgc, benchmarkArgs.data());
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -38,13 +38,24 @@
 
 #include <arpa/inet.h>
 #include <inttypes.h>
+#include <memory>
+#include <new>
 #include <vector>
 
 namespace android {
 
 struct DataSourceBaseReader : public mkvparser::IMkvReader {
-    explicit DataSourceBaseReader(DataSourceHelper *source)
-        : mSource(source) {
+    // libwebm parses a cluster through many reads of a few bytes each. With
+    // read-ahead enabled those are served from a handful of windows filled by
+    // large reads of the source, one window per position the parser and the
+    // tracks' frame reads are working at.
+    static constexpr size_t kReadAheadWindowSize = 64 * 1024;
+    static constexpr size_t kNumReadAheadWindows = 4;
+
+    explicit DataSourceBaseReader(DataSourceHelper *source, bool readAhead = false)
+        : mSource(source),
+          mReadAhead(readAhead),
+          mUseCount(0) {
     }
 
     virtual int Read(long long position, long length, unsigned char* buffer) {
@@ -55,6 +66,11 @@ struct DataSourceBaseReader : public mkvparser::IMkvReader {
             return 0;
         }
 
+        if (mReadAhead && (size_t)length < kReadAheadWindowSize
+                && readFromWindow(position, length, buffer)) {
+            return 0;
+        }
+
         ssize_t n = mSource->readAt(position, buffer, length);
 
         if (n <= 0) {
@@ -89,7 +105,65 @@ struct DataSourceBaseReader : public mkvparser::IMkvReader {
     }
 
 private:
+    struct Window {
+        Window() : mOffset(0), mLength(0), mLastUse(0) {}
+
+        off64_t mOffset;
+        size_t mLength;
+        uint64_t mLastUse;
+        std::unique_ptr<uint8_t[]> mData;
+    };
+
     DataSourceHelper *mSource;
+    bool mReadAhead;
+
+    // Frames are read outside of the extractor lock, so the windows have their own.
+    Mutex mWindowLock;
+    Window mWindows[kNumReadAheadWindows];
+    uint64_t mUseCount;
+
+    // Returns false if the range cannot be read ahead, e.g. because it extends
+    // past the end of the source; the caller then reads it directly.
+    bool readFromWindow(long long position, long length, unsigned char *buffer) {
+        Mutex::Autolock autoLock(mWindowLock);
+
+        Window *window = NULL;
+        for (size_t i = 0; i < kNumReadAheadWindows; ++i) {
+            Window &w = mWindows[i];
+            if (w.mLength > 0 && position >= w.mOffset
+                    && position + length <= w.mOffset + (off64_t)w.mLength) {
+                window = &w;
+                break;
+            }
+        }
+
+        if (window == NULL) {
+            // Replace the least recently used window.
+            window = &mWindows[0];
+            for (size_t i = 1; i < kNumReadAheadWindows; ++i) {
+                if (mWindows[i].mLastUse < window->mLastUse) {
+                    window = &mWindows[i];
+                }
+            }
+            if (window->mData == NULL) {
+                window->mData.reset(new (std::nothrow) uint8_t[kReadAheadWindowSize]);
+                if (window->mData == NULL) {
+                    return false;
+                }
+            }
+            ssize_t n = mSource->readAt(position, window->mData.get(), kReadAheadWindowSize);
+            if (n < length) {
+                window->mLength = 0;
+                return false;
+            }
+            window->mOffset = position;
+            window->mLength = n;
+        }
+
+        window->mLastUse = ++mUseCount;
+        memcpy(buffer, window->mData.get() + (position - window->mOffset), length);
+        return true;
+    }
 
     DataSourceBaseReader(const DataSourceBaseReader &);
     DataSourceBaseReader &operator=(const DataSourceBaseReader &);
@@ -371,6 +445,8 @@ void BlockIterator::advance_l() {
         } else if (res == 0) {
             // We're done with this cluster
 
+            mExtractor->addToClusterIndex_l(mCluster);
+
             const mkvparser::Cluster *nextCluster;
             res = mExtractor->mSegment->ParseNext(
                     mCluster, nextCluster, pos, len);
@@ -552,6 +628,20 @@ void BlockIterator::seek(
     CHECK_GT(pTP->m_block, 0);
     mBlockEntryIndex = pTP->m_block - 1;
 
+    if (thisTrack->GetType() != 1) {
+        // Non-video tracks finalize on time rather than on a key frame, so they
+        // can start from the last cluster before the seek point instead of
+        // walking forward from a possibly distant video Cue.
+        const MatroskaExtractor::ClusterIndexEntry *entry =
+                mExtractor->findIndexedCluster_l(seekTimeNs);
+        if (entry != NULL && entry->mPosition > pTP->m_pos) {
+            mCluster = pSegment->FindOrPreloadCluster(entry->mPosition);
+            CHECK(mCluster);
+            CHECK(!mCluster->EOS());
+            mBlockEntryIndex = 0;
+        }
+    }
+
     for (;;) {
         advance_l();
 
@@ -584,7 +674,15 @@ int64_t BlockIterator::blockTimeUs() const {
 }
 
 void BlockIterator::seekwithoutcue_l(int64_t seekTimeUs, int64_t *actualFrameTimeUs) {
-    mCluster = mExtractor->mSegment->FindCluster(seekTimeUs * 1000ll);
+    // Segment::FindCluster() only searches the clusters parsed so far, which is
+    // all of them only if the segment was fully loaded on open.
+    const MatroskaExtractor::ClusterIndexEntry *entry =
+            mExtractor->findIndexedCluster_l(seekTimeUs * 1000ll);
+    if (entry != NULL) {
+        mCluster = mExtractor->mSegment->FindOrPreloadCluster(entry->mPosition);
+    } else {
+        mCluster = mExtractor->mSegment->FindCluster(seekTimeUs * 1000ll);
+    }
     const long status = mCluster->GetFirst(mBlockEntry);
     if (status < 0) {  // error
         ALOGE("get last blockenry failed!");
@@ -592,6 +690,10 @@ void BlockIterator::seekwithoutcue_l(int64_t seekTimeUs, int64_t *actualFrameTim
         return;
     }
     mBlockEntryIndex = 0;
+    if (mBlockEntry == NULL) {
+        // nothing parsed in this cluster yet
+        advance_l();
+    }
     while (!eos() && ((block()->GetTrackNumber() != mTrackNum) || (blockTimeUs() < seekTimeUs))) {
         advance_l();
     }
@@ -1332,8 +1434,12 @@ static const char *MKVFourCC2MIME(uint32_t fourcc) {
 
 MatroskaExtractor::MatroskaExtractor(DataSourceHelper *source)
     : mDataSource(source),
-      mReader(new DataSourceBaseReader(mDataSource)),
+      mReader(new DataSourceBaseReader(mDataSource,
+              // caching sources already read ahead
+              !(mDataSource->flags() & DataSourceBase::kIsCachingDataSource))),
       mSegment(NULL),
+      mClusterIndexEnd(-1),
+      mClusterIndexComplete(true),
       mExtractedThumbnails(false),
       mIsWebm(false),
       mSeekPreRollNs(0) {
@@ -1405,6 +1511,12 @@ MatroskaExtractor::MatroskaExtractor(DataSourceHelper *source)
                 long len;
                 ret = mSegment->LoadCluster(pos, len);
                 ALOGV("has Cue data, Cluster num=%ld", mSegment->GetCount());
+                // Only the first cluster is loaded, so index the rest as needed.
+                const mkvparser::Cluster *first = mSegment->GetFirst();
+                if (ret >= 0 && first != NULL && !first->EOS()) {
+                    mClusterIndexEnd = first->m_element_start;
+                    mClusterIndexComplete = false;
+                }
             } else  {
                 long status_Load = mSegment->Load();
                 ALOGW("no Cue data,Segment Load status:%ld",status_Load);
@@ -1436,6 +1548,102 @@ MatroskaExtractor::MatroskaExtractor(DataSourceHelper *source)
     addTracks();
 }
 
+void MatroskaExtractor::addToClusterIndex_l(const mkvparser::Cluster *cluster) {
+    if (mClusterIndexComplete
+            || cluster->m_element_start != mClusterIndexEnd
+            || cluster->m_element_size <= 0) {
+        return;
+    }
+
+    const long long timeNs = cluster->GetTime();
+    if (timeNs < 0) {
+        mClusterIndexComplete = true;
+        return;
+    }
+
+    ClusterIndexEntry entry = { timeNs, cluster->GetPosition() };
+    mClusterIndex.push_back(entry);
+    mClusterIndexEnd = cluster->m_element_start + cluster->m_element_size;
+}
+
+const MatroskaExtractor::ClusterIndexEntry *MatroskaExtractor::findIndexedCluster_l(
+        long long timeNs) {
+    if (mClusterIndex.empty() && mClusterIndexComplete) {
+        return NULL;
+    }
+
+    // Walk the cluster headers past the seek point. This only reads the
+    // element headers and the cluster timecode, and uses its own reader so
+    // that it does not evict the read-ahead windows.
+    if (!mClusterIndexComplete
+            && (mClusterIndex.empty() || mClusterIndex.top().mTimeNs <= timeNs)) {
+        DataSourceBaseReader reader(mDataSource);
+        long long stop = -1;
+        if (mSegment->m_size >= 0) {
+            stop = mSegment->m_start + mSegment->m_size;
+        } else {
+            reader.Length(&stop, NULL);
+        }
+        const long long scale = mSegment->GetInfo()->GetTimeCodeScale();
+
+        while (mClusterIndex.empty() || mClusterIndex.top().mTimeNs <= timeNs) {
+            long long pos = mClusterIndexEnd;
+            long long id, size;
+            if (stop < 0 || pos >= stop
+                    || mkvparser::ParseElementHeader(&reader, pos, stop, id, size) != 0
+                    || size < 0) {
+                mClusterIndexComplete = true;
+                break;
+            }
+            const long long next = pos + size;
+
+            if (id == libwebm::kMkvCluster) {
+                long long timecode = -1;
+                while (pos < next) {
+                    long long childId, childSize;
+                    if (mkvparser::ParseElementHeader(
+                            &reader, pos, next, childId, childSize) != 0) {
+                        break;
+                    }
+                    if (childId == libwebm::kMkvTimecode) {
+                        timecode = mkvparser::UnserializeUInt(&reader, pos, childSize);
+                        break;
+                    }
+                    if (childId == libwebm::kMkvSimpleBlock
+                            || childId == libwebm::kMkvBlockGroup) {
+                        // the timecode must precede the blocks
+                        break;
+                    }
+                    pos += childSize;
+                }
+                if (timecode < 0 || scale <= 0 || timecode > INT64_MAX / scale) {
+                    ALOGW("cannot index cluster at %lld", mClusterIndexEnd);
+                    mClusterIndexComplete = true;
+                    break;
+                }
+                ClusterIndexEntry entry =
+                        { timecode * scale, mClusterIndexEnd - mSegment->m_start };
+                mClusterIndex.push_back(entry);
+            }
+            mClusterIndexEnd = next;
+        }
+        ALOGV("indexed %zu clusters", mClusterIndex.size());
+    }
+
+    // Find the last cluster starting at or before timeNs.
+    size_t lo = 0;
+    size_t hi = mClusterIndex.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mClusterIndex[mid].mTimeNs <= timeNs) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo == 0 ? NULL : &mClusterIndex[lo - 1];
+}
+
 MatroskaExtractor::~MatroskaExtractor() {
     delete mSegment;
     mSegment = NULL;
@@ -81,8 +81,22 @@ private:
         const mkvparser::CuePoint::TrackPosition *find(long long timeNs) const;
     };
 
+    // Start time and position of the clusters in file order, used to seek
+    // without walking every block in between when Cues are missing or sparse.
+    // Filled as blocks are read, and by walking cluster headers ahead of a
+    // seek past the indexed range.
+    struct ClusterIndexEntry {
+        int64_t mTimeNs;
+        // Relative to the segment payload, like Cue track positions.
+        long long mPosition;
+    };
+
     Mutex mLock;
     Vector<TrackInfo> mTracks;
+    Vector<ClusterIndexEntry> mClusterIndex;
+    // Absolute offset of the next cluster to add to mClusterIndex.
+    long long mClusterIndexEnd;
+    bool mClusterIndexComplete;
 
     DataSourceHelper *mDataSource;
     DataSourceBaseReader *mReader;
@@ -105,6 +119,8 @@ private:
             const mkvparser::VideoTrack *vtrack,
             AMediaFormat *meta);
     bool isLiveStreaming() const;
+    void addToClusterIndex_l(const mkvparser::Cluster *cluster);
+    const ClusterIndexEntry *findIndexedCluster_l(long long timeNs);
 
     MatroskaExtractor(const MatroskaExtractor &);
     MatroskaExtractor &operator=(const MatroskaExtractor &);
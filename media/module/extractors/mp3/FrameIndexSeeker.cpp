@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FrameIndexSeeker"
+
+#include <inttypes.h>
+
+#include <memory>
+#include <new>
+
+#include <utils/Log.h>
+
+#include "FrameIndexSeeker.h"
+#include "MP3Extractor.h"
+
+#include <media/stagefright/foundation/avc_utils.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ByteUtils.h>
+
+#include <media/stagefright/DataSourceBase.h>
+#include <media/MediaExtractorPluginApi.h>
+#include <media/MediaExtractorPluginHelper.h>
+
+namespace android {
+
+// Same as in MP3Extractor: the header bits that must not change between frames.
+static const uint32_t kMask = 0xfffe0c00;
+
+// Frames are a few hundred bytes, so the scan reads the stream in large chunks
+// rather than reading every frame header on its own.
+static const size_t kScanChunkSize = 64 * 1024;
+
+FrameIndexSeeker::FrameIndexSeeker()
+    : mSource(NULL),
+      mFileSize(0),
+      mFixedHeader(0),
+      mSampleRate(0),
+      mSamplesPerFrame(0),
+      mFramesPerEntry(8),
+      mNumFrames(0),
+      mNextFramePos(0),
+      mComplete(false),
+      mProbed(false),
+      mVbr(false) {
+}
+
+// static
+FrameIndexSeeker *FrameIndexSeeker::CreateFromSource(
+        DataSourceHelper *source, off64_t first_frame_pos, uint32_t fixed_header) {
+    // Scanning ahead through a network cache would stall playback.
+    if (source->flags() & DataSourceBase::kIsCachingDataSource) {
+        return NULL;
+    }
+
+    off64_t size;
+    if (source->getSize(&size) != OK) {
+        return NULL;
+    }
+
+    size_t frameSize;
+    int sampleRate;
+    int numSamples;
+    if (!GetMPEGAudioFrameSize(
+                fixed_header, &frameSize, &sampleRate, NULL, NULL, &numSamples)
+            || sampleRate <= 0 || numSamples <= 0) {
+        return NULL;
+    }
+
+    FrameIndexSeeker *seeker = new (std::nothrow) FrameIndexSeeker;
+    if (seeker == NULL) {
+        return NULL;
+    }
+    seeker->mSource = source;
+    seeker->mFileSize = size;
+    seeker->mFixedHeader = fixed_header;
+    seeker->mSampleRate = sampleRate;
+    seeker->mSamplesPerFrame = numSamples;
+    seeker->mNextFramePos = first_frame_pos;
+
+    return seeker;
+}
+
+bool FrameIndexSeeker::getDuration(int64_t *durationUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mComplete) {
+        return false;
+    }
+
+    *durationUs = mNumFrames * mSamplesPerFrame * 1000000LL / mSampleRate;
+    return true;
+}
+
+bool FrameIndexSeeker::getOffsetForTime(int64_t *timeUs, off64_t *pos) {
+    const int64_t samplesPerFrameUs = mSamplesPerFrame * 1000000LL;
+    if (*timeUs < 0) {
+        *timeUs = 0;
+    } else if (*timeUs > INT64_MAX / mSampleRate) {
+        return false;
+    }
+    int64_t frame = *timeUs * mSampleRate / samplesPerFrameUs;
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (!isVbr_l()) {
+        // Let the caller estimate the position from the bitrate.
+        return false;
+    }
+
+    indexFrames_l(frame);
+    if (mNumFrames == 0) {
+        return false;
+    }
+    if (frame >= mNumFrames) {
+        frame = mNumFrames - 1;
+    }
+
+    // Walk the few frames between the closest entry and the target.
+    off64_t offset = mEntries[frame / mFramesPerEntry];
+    const int64_t skip = frame % mFramesPerEntry;
+    if (skip > 0) {
+        off64_t next = offset;
+        if (scanFrames_l(&next, skip + 1, false /* addToIndex */, &offset) < skip + 1) {
+            return false;
+        }
+    }
+
+    *pos = offset;
+    *timeUs = frame * samplesPerFrameUs / mSampleRate;
+
+    ALOGV("seek to frame %" PRId64 " at %lld, time %" PRId64,
+            frame, (long long)offset, *timeUs);
+    return true;
+}
+
+bool FrameIndexSeeker::isVbr_l() {
+    if (mProbed) {
+        return mVbr;
+    }
+    mProbed = true;
+
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[kScanChunkSize]);
+    if (buffer == NULL) {
+        return false;
+    }
+    ssize_t n = mSource->readAt(mNextFramePos, buffer.get(), kScanChunkSize);
+    size_t offset = 0;
+    while (n >= 4 && offset + 4 <= (size_t)n) {
+        uint32_t header = U32_AT(buffer.get() + offset);
+        size_t frameSize;
+        if ((header & kMask) != (mFixedHeader & kMask)
+                || !GetMPEGAudioFrameSize(header, &frameSize)) {
+            break;
+        }
+        // Bitrate index
+        if (((header ^ mFixedHeader) & 0xf000) != 0) {
+            mVbr = true;
+            break;
+        }
+        offset += frameSize;
+    }
+
+    ALOGV("stream is %s", mVbr ? "VBR" : "CBR");
+    return mVbr;
+}
+
+void FrameIndexSeeker::indexFrames_l(int64_t lastFrame) {
+    if (mComplete || mNumFrames > lastFrame) {
+        return;
+    }
+
+    const int64_t wanted = lastFrame + 1 - mNumFrames;
+    if (scanFrames_l(&mNextFramePos, wanted, true /* addToIndex */) < wanted) {
+        mComplete = true;
+    }
+
+    ALOGV("indexed %" PRId64 " frames in %zu entries%s",
+            mNumFrames, mEntries.size(), mComplete ? ", done" : "");
+}
+
+int64_t FrameIndexSeeker::scanFrames_l(
+        off64_t *pos, int64_t numFrames, bool addToIndex, off64_t *lastFramePos) {
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[kScanChunkSize]);
+    if (buffer == NULL) {
+        return 0;
+    }
+
+    int64_t found = 0;
+    while (found < numFrames) {
+        const off64_t chunkPos = *pos;
+        ssize_t n = mSource->readAt(chunkPos, buffer.get(), kScanChunkSize);
+        if (n < 4) {
+            break;
+        }
+
+        size_t offset = 0;
+        bool truncated = false;
+        bool lostSync = false;
+        while (found < numFrames && offset + 4 <= (size_t)n) {
+            uint32_t header = U32_AT(buffer.get() + offset);
+            size_t frameSize;
+            if ((header & kMask) != (mFixedHeader & kMask)
+                    || !GetMPEGAudioFrameSize(header, &frameSize)) {
+                lostSync = true;
+                break;
+            }
+
+            if (chunkPos + (off64_t)(offset + frameSize) > mFileSize) {
+                // A truncated last frame cannot be played.
+                truncated = true;
+                break;
+            }
+
+            if (addToIndex) {
+                addFrame_l(chunkPos + offset);
+            }
+            if (lastFramePos != NULL) {
+                *lastFramePos = chunkPos + offset;
+            }
+            ++found;
+            offset += frameSize;
+        }
+
+        *pos = chunkPos + offset;
+        if (lostSync) {
+            // Lost sync, e.g. in junk or a tag between frames. Resync the same
+            // way as MP3Source::read(), so that a false sync in tag data is not
+            // taken for a frame.
+            ALOGV("lost sync at %lld", (long long)*pos);
+            if (!MP3Resync(mSource, mFixedHeader, pos, NULL, NULL)) {
+                break;
+            }
+            continue;
+        }
+        if (truncated || ((size_t)n < kScanChunkSize && offset + 4 > (size_t)n)) {
+            break;
+        }
+    }
+    return found;
+}
+
+void FrameIndexSeeker::addFrame_l(off64_t pos) {
+    if (mNumFrames % mFramesPerEntry == 0) {
+        if (mEntries.size() == kMaxEntries) {
+            for (size_t i = 1; i < kMaxEntries / 2; ++i) {
+                mEntries.editItemAt(i) = mEntries[2 * i];
+            }
+            mEntries.resize(kMaxEntries / 2);
+            mFramesPerEntry *= 2;
+        }
+        if (mNumFrames % mFramesPerEntry == 0) {
+            mEntries.push_back(pos);
+        }
+    }
+    ++mNumFrames;
+}
+
+}  // namespace android
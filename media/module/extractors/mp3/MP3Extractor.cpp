@@ -20,6 +20,7 @@
 
 #include "MP3Extractor.h"
 
+#include "FrameIndexSeeker.h"
 #include "ID3.h"
 #include "VBRISeeker.h"
 #include "XINGSeeker.h"
@@ -43,7 +44,7 @@ namespace android {
 // Yes ... there are things that must indeed match...
 static const uint32_t kMask = 0xfffe0c00;
 
-static bool Resync(
+bool MP3Resync(
         DataSourceHelper *source, uint32_t match_header,
         off64_t *inout_pos, off64_t *post_id3_pos, uint32_t *out_header) {
     if (post_id3_pos != NULL) {
@@ -266,7 +267,7 @@ MP3Extractor::MP3Extractor(
         post_id3_pos = meta->post_id3_pos;
         success = true;
     } else {
-        success = Resync(mDataSource, 0, &pos, &post_id3_pos, &header);
+        success = MP3Resync(mDataSource, 0, &pos, &post_id3_pos, &header);
     }
 
     if (!success) {
@@ -304,12 +305,17 @@ MP3Extractor::MP3Extractor(
         GetMPEGAudioFrameSize(
                 header, &frame_size, &sample_rate, &num_channels, &bitrate);
         pos += frame_size;
-        if (!Resync(mDataSource, 0, &pos, &post_id3_pos, &header)) {
+        if (!MP3Resync(mDataSource, 0, &pos, &post_id3_pos, &header)) {
             // mInitCheck will remain NO_INIT
             return;
         }
         mFirstFramePos = pos;
         mFixedHeader = header;
+    } else {
+        // Without a seek table, a position estimated from the bitrate of the
+        // first frame can be far off in a VBR stream, so index the frames of
+        // those.
+        mSeeker = FrameIndexSeeker::CreateFromSource(mDataSource, mFirstFramePos, mFixedHeader);
     }
 
     size_t frame_size;
@@ -548,7 +554,7 @@ media_status_t MP3Source::read(
                 header, &frame_size, &sample_rate, NULL,
                 &bitrate, &num_samples)) {
 
-            // re-calculate mCurrentTimeUs because we might have called Resync()
+            // re-calculate mCurrentTimeUs because we might have called MP3Resync()
             if (seekCBR) {
                 mCurrentTimeUs = (mCurrentPos - mFirstFramePos) * 8000 / bitrate;
                 mBasisTimeUs = mCurrentTimeUs;
@@ -561,7 +567,7 @@ media_status_t MP3Source::read(
         ALOGV("lost sync! header = 0x%08x, old header = 0x%08x\n", header, mFixedHeader);
 
         off64_t pos = mCurrentPos;
-        if (!Resync(mDataSource, mFixedHeader, &pos, NULL, NULL)) {
+        if (!MP3Resync(mDataSource, mFixedHeader, &pos, NULL, NULL)) {
             ALOGE("Unable to resync. Signalling end of stream.");
 
             buffer->release();
@@ -689,7 +695,7 @@ static CreatorFunc Sniff(
         ALOGV("MPEG1PS container is not supported!");
         return NULL;
     }
-    if (!Resync(&helper, 0, &pos, &post_id3_pos, &header)) {
+    if (!MP3Resync(&helper, 0, &pos, &post_id3_pos, &header)) {
         return NULL;
     }
 
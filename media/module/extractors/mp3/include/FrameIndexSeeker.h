@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_INDEX_SEEKER_H_
+
+#define FRAME_INDEX_SEEKER_H_
+
+#include "MP3Seeker.h"
+
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+class DataSourceHelper;
+
+// Seeks to the exact frame for a time in VBR files that carry neither a XING
+// nor a VBRI table, where a bitrate based estimate lands anywhere. The frames
+// are indexed on demand, scanning forward only as far as the furthest seek so
+// far. Constant bitrate streams are left to the bitrate based estimate, which
+// is exact enough for them and does not read ahead.
+struct FrameIndexSeeker : public MP3Seeker {
+    static FrameIndexSeeker *CreateFromSource(
+            DataSourceHelper *source, off64_t first_frame_pos, uint32_t fixed_header);
+
+    // Only known once the whole file has been indexed.
+    virtual bool getDuration(int64_t *durationUs);
+    virtual bool getOffsetForTime(int64_t *timeUs, off64_t *pos);
+
+private:
+    // Bounds the index to 64KB. Once full, every other entry is dropped and
+    // the index keeps every twice as many frames.
+    static const size_t kMaxEntries = 8192;
+
+    DataSourceHelper *mSource;
+    off64_t mFileSize;
+    uint32_t mFixedHeader;
+    int mSampleRate;
+    int mSamplesPerFrame;
+
+    Mutex mLock;
+    // Offset of every mFramesPerEntry-th frame, starting with the first one.
+    Vector<off64_t> mEntries;
+    int64_t mFramesPerEntry;
+    int64_t mNumFrames;
+    off64_t mNextFramePos;
+    bool mComplete;
+    bool mProbed;
+    bool mVbr;
+
+    FrameIndexSeeker();
+
+    // Checks whether the bitrate changes between the first frames.
+    bool isVbr_l();
+    void indexFrames_l(int64_t lastFrame);
+    // Steps over up to numFrames frames from *pos, resyncing over whatever lies
+    // between them, and leaves *pos after the last one and *lastFramePos at
+    // its start. Returns the number of frames found before the end of the stream.
+    int64_t scanFrames_l(off64_t *pos, int64_t numFrames, bool addToIndex,
+            off64_t *lastFramePos = NULL);
+    void addFrame_l(off64_t pos);
+
+    DISALLOW_EVIL_CONSTRUCTORS(FrameIndexSeeker);
+};
+
+}  // namespace android
+
+#endif  // FRAME_INDEX_SEEKER_H_
@@ -32,6 +32,13 @@ struct MP3Seeker;
 class String8;
 struct Mp3Meta;
 
+// Finds the first frame at or after *inout_pos that is followed by three more
+// frames, skipping ID3v2 tags when starting at offset 0. If match_header is
+// not 0, the frames must match its fixed header bits.
+bool MP3Resync(
+        DataSourceHelper *source, uint32_t match_header,
+        off64_t *inout_pos, off64_t *post_id3_pos, uint32_t *out_header);
+
 class MP3Extractor : public MediaExtractorPluginHelper {
 public:
     MP3Extractor(DataSourceHelper *source, Mp3Meta *meta);
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MP3ExtractorSeekTest"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <media/DataSource.h>
+#include <media/MediaExtractorPluginHelper.h>
+#include <media/stagefright/MediaBufferGroup.h>
+
+#include <MP3Extractor.h>
+
+using namespace android;
+
+// MPEG-1 Layer III, 44.1 kHz, stereo, no CRC
+constexpr uint32_t kBaseHeader = 0xfffb0000;
+constexpr int32_t kSampleRate = 44100;
+constexpr int32_t kSamplesPerFrame = 1152;
+// Layer III bitrates of MPEG-1 in kbps, by bitrate index
+constexpr int32_t kBitrates[] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+
+// Serves a synthesized stream from memory, counting the bytes read.
+class MemorySource : public DataSource {
+  public:
+    explicit MemorySource(std::vector<uint8_t> data) : mData(std::move(data)) {}
+
+    status_t initCheck() const override { return OK; }
+
+    ssize_t readAt(off64_t offset, void *data, size_t size) override {
+        if (offset < 0 || offset >= static_cast<off64_t>(mData.size())) {
+            return 0;
+        }
+        size = std::min(size, mData.size() - static_cast<size_t>(offset));
+        memcpy(data, mData.data() + offset, size);
+        mBytesRead += size;
+        return size;
+    }
+
+    status_t getSize(off64_t *size) override {
+        *size = mData.size();
+        return OK;
+    }
+
+    int64_t bytesRead() const { return mBytesRead; }
+
+  private:
+    const std::vector<uint8_t> mData;
+    int64_t mBytesRead = 0;
+
+    DISALLOW_EVIL_CONSTRUCTORS(MemorySource);
+};
+
+// Appends a frame carrying its frame number right after the header.
+static void appendFrame(std::vector<uint8_t> *data, int32_t bitrateIndex, uint32_t frameNumber) {
+    const size_t frameSize = 144000 * kBitrates[bitrateIndex] / kSampleRate;
+    const uint32_t header = kBaseHeader | (bitrateIndex << 12);
+    const size_t pos = data->size();
+    data->resize(pos + frameSize, 0);
+    for (int i = 0; i < 4; ++i) {
+        (*data)[pos + i] = header >> (24 - 8 * i);
+        (*data)[pos + 4 + i] = frameNumber >> (24 - 8 * i);
+    }
+}
+
+static int64_t frameTimeUs(int64_t frame) {
+    return frame * kSamplesPerFrame * 1000000LL / kSampleRate;
+}
+
+class MP3ExtractorSeekTest : public ::testing::Test {
+  public:
+    void SetUp() override { mBufferGroup = new MediaBufferGroup(); }
+
+    void TearDown() override {
+        if (mTrack != nullptr) {
+            mCTrack->stop(mTrack);
+            free(mCTrack);
+            delete mTrack;
+        }
+        delete mExtractor;
+        delete mBufferGroup;
+    }
+
+    void createExtractor(std::vector<uint8_t> data) {
+        mSource = new MemorySource(std::move(data));
+        mExtractor = new MP3Extractor(new DataSourceHelper(mSource->wrap()), nullptr);
+        ASSERT_EQ(mExtractor->countTracks(), 1u);
+        mTrack = mExtractor->getTrack(0);
+        ASSERT_NE(mTrack, nullptr);
+        mCTrack = wrap(mTrack);
+        ASSERT_EQ(mCTrack->start(mTrack, mBufferGroup->wrap()), AMEDIA_OK);
+    }
+
+    // Seeks to the given time and returns the number and time of the frame read.
+    void seekTo(int64_t seekTimeUs, uint32_t *frameNumber, int64_t *timeUs) {
+        MediaTrackHelper::ReadOptions options(
+                CMediaTrackReadOptions::SEEK | CMediaTrackReadOptions::SEEK_PREVIOUS_SYNC,
+                seekTimeUs);
+        MediaBufferHelper *buffer = nullptr;
+        ASSERT_EQ(mTrack->read(&buffer, &options), AMEDIA_OK);
+        ASSERT_NE(buffer, nullptr);
+        ASSERT_GE(buffer->range_length(), 8u);
+        const uint8_t *data = static_cast<const uint8_t *>(buffer->data()) + buffer->range_offset();
+        *frameNumber = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+        EXPECT_TRUE(AMediaFormat_getInt64(buffer->meta_data(), AMEDIAFORMAT_KEY_TIME_US, timeUs));
+        buffer->release();
+    }
+
+    sp<MemorySource> mSource;
+    MP3Extractor *mExtractor = nullptr;
+    MediaBufferGroup *mBufferGroup = nullptr;
+    MediaTrackHelper *mTrack = nullptr;
+    CMediaTrack *mCTrack = nullptr;
+};
+
+// Seeks in a VBR stream without a seek table land on the frame of the requested time, also
+// past a tag holding a false sync word between the frames.
+TEST_F(MP3ExtractorSeekTest, VbrSeekAccuracy) {
+    constexpr uint32_t kNumFrames = 3000;
+    constexpr uint32_t kTagAfterFrame = 1000;
+    // Runs of 64, 320 and 128 kbps frames
+    constexpr int32_t kBitrateIndices[] = {5, 14, 9};
+
+    std::vector<uint8_t> data;
+    for (uint32_t i = 0; i < kNumFrames; ++i) {
+        appendFrame(&data, kBitrateIndices[(i / 97) % 3], i);
+        if (i == kTagAfterFrame) {
+            // An APE tag whose data looks like a frame header, with no frames following it
+            static const uint8_t kTag[] = {'A', 'P', 'E', 'T', 'A', 'G', 'E', 'X',
+                                           0xff, 0xfb, 0x90, 0x00};
+            data.insert(data.end(), kTag, kTag + sizeof(kTag));
+            data.resize(data.size() + 600, 0);
+        }
+    }
+    ASSERT_NO_FATAL_FAILURE(createExtractor(std::move(data)));
+
+    for (uint32_t frame : {2500u, 10u, 999u, 1001u, 1002u, 1500u, 0u, kNumFrames - 1}) {
+        SCOPED_TRACE(frame);
+        uint32_t frameNumber;
+        int64_t timeUs;
+        // Halfway into the frame, which starts before the requested time
+        ASSERT_NO_FATAL_FAILURE(
+                seekTo((frameTimeUs(frame) + frameTimeUs(frame + 1)) / 2, &frameNumber, &timeUs));
+        EXPECT_EQ(frameNumber, frame);
+        EXPECT_EQ(timeUs, frameTimeUs(frame));
+    }
+}
+
+// Constant bitrate streams are seeked by the bitrate, without reading up to the seek position.
+TEST_F(MP3ExtractorSeekTest, CbrSeekDoesNotScan) {
+    constexpr uint32_t kNumFrames = 20000;
+
+    std::vector<uint8_t> data;
+    for (uint32_t i = 0; i < kNumFrames; ++i) {
+        appendFrame(&data, 9 /* 128 kbps */, i);
+    }
+    const size_t size = data.size();
+    ASSERT_NO_FATAL_FAILURE(createExtractor(std::move(data)));
+
+    const int64_t bytesReadBefore = mSource->bytesRead();
+    uint32_t frameNumber;
+    int64_t timeUs;
+    ASSERT_NO_FATAL_FAILURE(seekTo(frameTimeUs(kNumFrames - 100), &frameNumber, &timeUs));
+    EXPECT_LT(mSource->bytesRead() - bytesReadBefore, static_cast<int64_t>(size / 16));
+    // The frame sizes round the bitrate down, so the estimate lands a little late.
+    EXPECT_GE(frameNumber, kNumFrames - 100);
+    EXPECT_LT(frameNumber, kNumFrames);
+}
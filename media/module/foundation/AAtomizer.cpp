@@ -21,20 +21,30 @@
 namespace android {
 
 // static
-AAtomizer AAtomizer::gAtomizer;
+AAtomizer &AAtomizer::Get() {
+    // Never destroyed, so atoms stay valid during static destruction.
+    static AAtomizer *atomizer = new AAtomizer;
+    return *atomizer;
+}
 
 // static
 const char *AAtomizer::Atomize(const char *name) {
-    return gAtomizer.atomize(name);
+    return Get().atomize(name, SIZE_MAX);
+}
+
+// static
+const char *AAtomizer::TryAtomize(const char *name, size_t maxAtoms) {
+    return Get().atomize(name, maxAtoms);
 }
 
-AAtomizer::AAtomizer() {
+AAtomizer::AAtomizer()
+    : mNumAtoms(0) {
     for (size_t i = 0; i < 128; ++i) {
         mAtoms.push(List<AString>());
     }
 }
 
-const char *AAtomizer::atomize(const char *name) {
+const char *AAtomizer::atomize(const char *name, size_t maxAtoms) {
     Mutex::Autolock autoLock(mLock);
 
     const size_t n = mAtoms.size();
@@ -48,12 +58,19 @@ const char *AAtomizer::atomize(const char *name) {
         ++it;
     }
 
+    if (mNumAtoms >= maxAtoms) {
+        return NULL;
+    }
+
     entry.push_back(AString(name));
+    ++mNumAtoms;
 
     return (*--entry.end()).c_str();
 }
 
 // static
+// the hash is meant to wrap around
+__attribute__((no_sanitize("integer")))
 uint32_t AAtomizer::Hash(const char *s) {
     uint32_t sum = 0;
     while (*s != '\0') {
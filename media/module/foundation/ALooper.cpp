@@ -23,6 +23,10 @@
 
 #include <sys/time.h>
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 #include "ALooper.h"
 
 #include "AHandler.h"
@@ -73,8 +77,125 @@ int64_t ALooper::getNowUs() {
     return GetNowUs();
 }
 
+// Messages posted without a delay go to a lock-free FIFO, the others to a
+// min-heap under ALooper::mLock. Both are ordered on (mWhenUs, mSeq), which
+// keeps the delivery order of a single time-sorted list.
+struct ALooper::EventQueue {
+    struct Event {
+        int64_t mWhenUs;
+        // Orders events due at the same time by posting order.
+        uint64_t mSeq;
+        sp<AMessage> mMessage;
+        sp<RefBase> mToken;
+    };
+
+    // Unbounded multi-producer single-consumer FIFO that posters push to without
+    // taking mLock. Only the looper thread pops.
+    struct ImmediateQueue {
+        ImmediateQueue();
+        ~ImmediateQueue();
+
+        void push(Event &&event);
+        // Returns the oldest event, or nullptr if none is available yet.
+        Event *front();
+        void pop();
+
+    private:
+        struct Node {
+            std::atomic<Node *> mNext{nullptr};
+            Event mEvent;
+        };
+        std::atomic<Node *> mHead;  // last pushed
+        Node *mTail;                // consumer side, a consumed placeholder
+
+        DISALLOW_EVIL_CONSTRUCTORS(ImmediateQueue);
+    };
+
+    EventQueue()
+        : mNextDelayedUs(INT64_MAX),
+          mNextSeq(0),
+          mLoopWaiting(false),
+          mRunning(false) {
+    }
+
+    static bool isLater(const Event &a, const Event &b);
+    void pushDelayed_l(Event &&event);
+    void popDelayed_l(Event *event);
+
+    // Messages posted without delay, delivered in posting order.
+    ImmediateQueue mImmediateQueue;
+    // Messages posted with a delay or a token, as a min-heap on (mWhenUs, mSeq).
+    std::vector<Event> mDelayedQueue;
+    // mWhenUs of the top of mDelayedQueue, or INT64_MAX; lets loop() deliver
+    // immediate messages without taking mLock.
+    std::atomic<int64_t> mNextDelayedUs;
+    std::atomic<uint64_t> mNextSeq;
+    // Set while loop() waits on mQueueChangedCondition.
+    std::atomic<bool> mLoopWaiting;
+    // Whether mThread is set or mRunningLocally, readable without mLock.
+    std::atomic<bool> mRunning;
+
+    DISALLOW_EVIL_CONSTRUCTORS(EventQueue);
+};
+
+ALooper::EventQueue::ImmediateQueue::ImmediateQueue() {
+    Node *placeholder = new Node;
+    mHead.store(placeholder, std::memory_order_relaxed);
+    mTail = placeholder;
+}
+
+ALooper::EventQueue::ImmediateQueue::~ImmediateQueue() {
+    while (front() != nullptr) {
+        pop();
+    }
+    delete mTail;
+}
+
+void ALooper::EventQueue::ImmediateQueue::push(Event &&event) {
+    Node *node = new Node;
+    node->mEvent = std::move(event);
+    Node *prev = mHead.exchange(node, std::memory_order_acq_rel);
+    // Until this store the consumer sees the queue end at prev.
+    prev->mNext.store(node, std::memory_order_release);
+}
+
+ALooper::EventQueue::Event *ALooper::EventQueue::ImmediateQueue::front() {
+    Node *next = mTail->mNext.load(std::memory_order_acquire);
+    return next == nullptr ? nullptr : &next->mEvent;
+}
+
+void ALooper::EventQueue::ImmediateQueue::pop() {
+    // The front node becomes the placeholder; its event has been moved out.
+    Node *next = mTail->mNext.load(std::memory_order_acquire);
+    CHECK(next != nullptr);
+    delete mTail;
+    mTail = next;
+    mTail->mEvent = Event();
+}
+
+// static
+bool ALooper::EventQueue::isLater(const Event &a, const Event &b) {
+    return a.mWhenUs != b.mWhenUs ? a.mWhenUs > b.mWhenUs : a.mSeq > b.mSeq;
+}
+
+void ALooper::EventQueue::pushDelayed_l(Event &&event) {
+    mDelayedQueue.push_back(std::move(event));
+    std::push_heap(mDelayedQueue.begin(), mDelayedQueue.end(), isLater);
+    mNextDelayedUs.store(mDelayedQueue.front().mWhenUs, std::memory_order_release);
+}
+
+void ALooper::EventQueue::popDelayed_l(Event *event) {
+    std::pop_heap(mDelayedQueue.begin(), mDelayedQueue.end(), isLater);
+    *event = std::move(mDelayedQueue.back());
+    mDelayedQueue.pop_back();
+    mNextDelayedUs.store(
+            mDelayedQueue.empty() ? INT64_MAX : mDelayedQueue.front().mWhenUs,
+            std::memory_order_release);
+}
+
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mEventQueue(new EventQueue),
+      mRunningLocally(false) {
     // clean up stale AHandlers. Doing it here instead of in the destructor avoids
     // the side effect of objects being deleted from the unregister function recursively.
     gLooperRoster.unregisterStaleHandlers();
@@ -82,6 +203,7 @@ ALooper::ALooper()
 
 ALooper::~ALooper() {
     stop();
+    delete mEventQueue;
     // stale AHandlers are now cleaned up in the constructor of the next ALooper to come along
 }
 
@@ -108,6 +230,7 @@ status_t ALooper::start(
             }
 
             mRunningLocally = true;
+            mEventQueue->mRunning = true;
         }
 
         do {
@@ -124,10 +247,12 @@ status_t ALooper::start(
 
     mThread = new LooperThread(this, canCallJava);
 
+    mEventQueue->mRunning = true;
     status_t err = mThread->run(
             mName.empty() ? "ALooper" : mName.c_str(), priority);
     if (err != OK) {
         mThread.clear();
+        mEventQueue->mRunning = false;
     }
 
     return err;
@@ -144,6 +269,7 @@ status_t ALooper::stop() {
         runningLocally = mRunningLocally;
         mThread.clear();
         mRunningLocally = false;
+        mEventQueue->mRunning = false;
     }
 
     if (thread == NULL && !runningLocally) {
@@ -170,38 +296,47 @@ status_t ALooper::stop() {
 }
 
 void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
-    Mutex::Autolock autoLock(mLock);
-
-    int64_t whenUs;
-    if (delayUs > 0) {
-        int64_t nowUs = getNowUs();
-        whenUs = (delayUs > INT64_MAX - nowUs ? INT64_MAX : nowUs + delayUs);
+    EventQueue &queue = *mEventQueue;
+    EventQueue::Event event;
+    event.mMessage = msg;
+    event.mToken = nullptr;
 
-    } else {
-        whenUs = getNowUs();
+    if (delayUs <= 0) {
+        // Most messages are posted without delay; queue them without
+        // contending with the looper thread for mLock.
+        event.mWhenUs = getNowUs();
+        event.mSeq = queue.mNextSeq++;
+        queue.mImmediateQueue.push(std::move(event));
+
+        // Either loop() sees the message before it waits, or this sees that it
+        // is waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (queue.mLoopWaiting.load(std::memory_order_relaxed)) {
+            Mutex::Autolock autoLock(mLock);
+            mQueueChangedCondition.signal();
+        }
+        return;
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
-    }
+    Mutex::Autolock autoLock(mLock);
 
-    Event event;
-    event.mWhenUs = whenUs;
-    event.mMessage = msg;
-    event.mToken = nullptr;
+    int64_t nowUs = getNowUs();
+    event.mWhenUs = (delayUs > INT64_MAX - nowUs ? INT64_MAX : nowUs + delayUs);
+    event.mSeq = queue.mNextSeq++;
 
-    if (it == mEventQueue.begin()) {
+    if (queue.mDelayedQueue.empty()
+            || event.mWhenUs < queue.mDelayedQueue.front().mWhenUs) {
         mQueueChangedCondition.signal();
     }
 
-    mEventQueue.insert(it, event);
+    queue.pushDelayed_l(std::move(event));
 }
 
 status_t ALooper::postUnique(const sp<AMessage> &msg, const sp<RefBase> &token, int64_t delayUs) {
     if (token == nullptr) {
         return -EINVAL;
     }
+    EventQueue &queue = *mEventQueue;
     Mutex::Autolock autoLock(mLock);
 
     int64_t whenUs;
@@ -215,28 +350,24 @@ status_t ALooper::postUnique(const sp<AMessage> &msg, const sp<RefBase> &token,
     // We only need to wake the loop up if we're rescheduling to the earliest event in the queue.
     // This needs to be checked now, before we reschedule the message, in case this message is
     // already at the beginning of the queue.
-    bool shouldAwakeLoop = mEventQueue.empty() || whenUs < mEventQueue.begin()->mWhenUs;
-
-    // Erase any previously-posted event with this token.
-    for (auto i = mEventQueue.begin(); i != mEventQueue.end();) {
-        if (i->mToken == token) {
-            i = mEventQueue.erase(i);
-        } else {
-            ++i;
-        }
-    }
-
-    // Find the insertion point for the rescheduled message.
-    List<Event>::iterator i = mEventQueue.begin();
-    while (i != mEventQueue.end() && i->mWhenUs <= whenUs) {
-        ++i;
+    std::vector<EventQueue::Event> &delayed = queue.mDelayedQueue;
+    bool shouldAwakeLoop = delayed.empty() || whenUs < delayed.front().mWhenUs;
+
+    // Erase any previously-posted event with this token. Only postUnique() sets
+    // tokens, so these are all in the delayed queue.
+    auto end = std::remove_if(delayed.begin(), delayed.end(),
+            [&token](const EventQueue::Event &event) { return event.mToken == token; });
+    if (end != delayed.end()) {
+        delayed.erase(end, delayed.end());
+        std::make_heap(delayed.begin(), delayed.end(), EventQueue::isLater);
     }
 
-    Event event;
+    EventQueue::Event event;
     event.mWhenUs = whenUs;
+    event.mSeq = queue.mNextSeq++;
     event.mMessage = msg;
     event.mToken = token;
-    mEventQueue.insert(i, event);
+    queue.pushDelayed_l(std::move(event));
 
     // If we rescheduled the event to be earlier than the first event, then we need to wake up the
     // looper earlier than it was previously scheduled to be woken up. Otherwise, it can sleep until
@@ -248,33 +379,52 @@ status_t ALooper::postUnique(const sp<AMessage> &msg, const sp<RefBase> &token,
 }
 
 bool ALooper::loop() {
-
-    Event event;
-
-    {
+    EventQueue &queue = *mEventQueue;
+    EventQueue::Event event;
+
+    // Deliver immediate messages without taking mLock, as long as no delayed
+    // message is due before them. Ties are resolved under the lock.
+    EventQueue::Event *immediate = queue.mImmediateQueue.front();
+    if (immediate != nullptr
+            && queue.mRunning.load(std::memory_order_acquire)
+            && immediate->mWhenUs < queue.mNextDelayedUs.load(std::memory_order_acquire)) {
+        event = std::move(*immediate);
+        queue.mImmediateQueue.pop();
+    } else {
         Mutex::Autolock autoLock(mLock);
         if (mThread == NULL && !mRunningLocally) {
             return false;
         }
-        if (mEventQueue.empty()) {
-            mQueueChangedCondition.wait(mLock);
-            return true;
-        }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
-        int64_t nowUs = getNowUs();
 
-        if (whenUs > nowUs) {
-            int64_t delayUs = whenUs - nowUs;
-            if (delayUs > INT64_MAX / 1000) {
-                delayUs = INT64_MAX / 1000;
+        immediate = queue.mImmediateQueue.front();
+        const bool delayedFirst = !queue.mDelayedQueue.empty()
+                && (immediate == nullptr
+                        || !EventQueue::isLater(queue.mDelayedQueue.front(), *immediate));
+
+        if (immediate != nullptr && !delayedFirst) {
+            event = std::move(*immediate);
+            queue.mImmediateQueue.pop();
+        } else if (delayedFirst && queue.mDelayedQueue.front().mWhenUs <= getNowUs()) {
+            queue.popDelayed_l(&event);
+        } else {
+            queue.mLoopWaiting.store(true, std::memory_order_relaxed);
+            // Pairs with the fence in post().
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (immediate != nullptr || queue.mImmediateQueue.front() == nullptr) {
+                if (delayedFirst) {
+                    int64_t delayUs = queue.mDelayedQueue.front().mWhenUs - getNowUs();
+                    if (delayUs > INT64_MAX / 1000) {
+                        delayUs = INT64_MAX / 1000;
+                    }
+                    mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+                } else {
+                    mQueueChangedCondition.wait(mLock);
+                }
             }
-            mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+            queue.mLoopWaiting.store(false, std::memory_order_relaxed);
 
             return true;
         }
-
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
     }
 
     event.mMessage->deliver();
@@ -20,6 +20,10 @@
 
 #include <ctype.h>
 
+#include <algorithm>
+#include <memory>
+#include <new>
+
 #include "AMessage.h"
 
 #include <log/log.h>
@@ -41,6 +45,187 @@ namespace android {
 
 extern ALooperRoster gLooperRoster;
 
+// The message cache hides use-after-free of messages from the sanitizers.
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(hwaddress_sanitizer)
+#define AMESSAGE_NO_CACHE
+#endif
+#endif
+
+namespace {
+
+// Freed messages, and the smallest item storage blocks, kept per thread for
+// reuse. Zero-initialized and trivially destructible, so it remains usable
+// while the thread is being torn down.
+struct MessageCache {
+    enum {
+        kMaxCachedMessages = 64,
+    };
+    void *mBlocks[kMaxCachedMessages];
+    size_t mNumBlocks;
+    void *mItemBlocks[kMaxCachedMessages];
+    size_t mNumItemBlocks;
+    bool mDrainerRegistered;
+    bool mDrained;
+};
+
+thread_local MessageCache gMessageCache;
+
+// Returns the cached messages to the heap on thread exit.
+struct MessageCacheDrainer {
+    ~MessageCacheDrainer() {
+        MessageCache &cache = gMessageCache;
+        while (cache.mNumBlocks > 0) {
+            ::operator delete(cache.mBlocks[--cache.mNumBlocks]);
+        }
+        while (cache.mNumItemBlocks > 0) {
+            ::operator delete(cache.mItemBlocks[--cache.mNumItemBlocks]);
+        }
+        cache.mDrained = true;
+    }
+};
+
+void registerMessageCacheDrainer() {
+    static thread_local MessageCacheDrainer sDrainer;
+    (void)sDrainer;
+}
+
+#ifndef AMESSAGE_NO_CACHE
+// Keeps |block| in |blocks| if there is room, returning whether it did.
+bool cacheBlock(void **blocks, size_t *numBlocks, void *block) {
+    MessageCache &cache = gMessageCache;
+    if (cache.mDrained || *numBlocks >= MessageCache::kMaxCachedMessages) {
+        return false;
+    }
+    if (!cache.mDrainerRegistered) {
+        registerMessageCacheDrainer();
+        cache.mDrainerRegistered = true;
+    }
+    blocks[(*numBlocks)++] = block;
+    return true;
+}
+#endif
+
+// Allocates item storage. |recycled| blocks all have the same size, the
+// smallest one, and may come from the cache.
+void *allocateItemBlock(size_t size, bool recycled) {
+#ifndef AMESSAGE_NO_CACHE
+    MessageCache &cache = gMessageCache;
+    if (recycled && cache.mNumItemBlocks > 0) {
+        return cache.mItemBlocks[--cache.mNumItemBlocks];
+    }
+#else
+    (void)recycled;
+#endif
+    return ::operator new(size);
+}
+
+void freeItemBlock(void *block, bool recycled) {
+#ifndef AMESSAGE_NO_CACHE
+    MessageCache &cache = gMessageCache;
+    if (recycled && cacheBlock(cache.mItemBlocks, &cache.mNumItemBlocks, block)) {
+        return;
+    }
+#else
+    (void)recycled;
+#endif
+    ::operator delete(block);
+}
+
+// Item names are interned so that messages can share them instead of each
+// holding a copy. As names may also come from apps, the number of atoms
+// created here is bounded; past that, items fall back to owning their name.
+constexpr size_t kMaxInternedNameLength = 64;
+constexpr size_t kMaxInternedNames = 1024;
+
+// FNV-1a, used to index the items of large messages.
+__attribute__((no_sanitize("integer")))
+uint32_t hashName(const char *name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Maps the address of recently seen names (mostly literals) to their atoms and
+// hashes, so that repeated keys skip the atomizer's lock and compare by address.
+struct NameCache {
+    enum {
+        kNumSlots = 128,
+    };
+    struct Entry {
+        const char *mKey;
+        const char *mAtom;
+        uint32_t mHash;
+    };
+    Entry mEntries[kNumSlots];
+};
+
+thread_local NameCache gNameCache;
+
+NameCache::Entry *nameCacheEntry(const char *name) {
+    return &gNameCache.mEntries[(reinterpret_cast<uintptr_t>(name) >> 2) % NameCache::kNumSlots];
+}
+
+// Returns the cache entry for |name| if it has one.
+const NameCache::Entry *findCachedName(const char *name) {
+    const NameCache::Entry *entry = nameCacheEntry(name);
+    // the key may be a reused buffer, so verify the contents as well
+    if (entry->mKey == name && !strcmp(entry->mAtom, name)) {
+        return entry;
+    }
+    return nullptr;
+}
+
+void cacheName(const char *name, const char *atom, uint32_t hash) {
+    NameCache::Entry *entry = nameCacheEntry(name);
+    entry->mKey = name;
+    entry->mAtom = atom;
+    entry->mHash = hash;
+}
+
+const char *internName(const char *name, size_t len) {
+    if (len > kMaxInternedNameLength) {
+        return nullptr;
+    }
+    const NameCache::Entry *cached = findCachedName(name);
+    if (cached != nullptr) {
+        return cached->mAtom;
+    }
+    const char *atom = AAtomizer::TryAtomize(name, kMaxInternedNames);
+    if (atom != nullptr) {
+        cacheName(name, atom, hashName(name, len));
+    }
+    return atom;
+}
+
+}  // namespace
+
+// static
+void *AMessage::operator new(size_t size) {
+#ifndef AMESSAGE_NO_CACHE
+    MessageCache &cache = gMessageCache;
+    if (size == sizeof(AMessage) && cache.mNumBlocks > 0) {
+        return cache.mBlocks[--cache.mNumBlocks];
+    }
+#endif
+    return ::operator new(size);
+}
+
+// static
+void AMessage::operator delete(void *ptr, size_t size) {
+#ifndef AMESSAGE_NO_CACHE
+    MessageCache &cache = gMessageCache;
+    if (size == sizeof(AMessage) && cacheBlock(cache.mBlocks, &cache.mNumBlocks, ptr)) {
+        return;
+    }
+#else
+    (void)size;
+#endif
+    ::operator delete(ptr);
+}
+
 status_t AReplyToken::setReply(const sp<AMessage> &reply) {
     if (mReplied) {
         ALOGE("trying to post a duplicate reply");
@@ -89,8 +274,7 @@ void AMessage::setTarget(const sp<const AHandler> &handler) {
 void AMessage::clear() {
     // Item needs to be handled delicately
     for (Item &item : mItems) {
-        delete[] item.mName;
-        item.mName = NULL;
+        item.freeName();
         freeItemValue(&item);
     }
     mItems.clear();
@@ -100,7 +284,10 @@ void AMessage::freeItemValue(Item *item) {
     switch (item->mType) {
         case kTypeString:
         {
-            delete item->u.stringValue;
+            if (!item->mStringIsInline) {
+                delete item->u.stringValue;
+            }
+            item->mStringIsInline = false;
             break;
         }
 
@@ -150,22 +337,50 @@ static void reportStats() {
 }
 #endif
 
+// |atom| is the interned |name| if known, or NULL.
+inline bool AMessage::Item::hasName(const char *name, size_t len, const char *atom) const {
+    if (mName == name || mName == atom) {
+        return true;
+    }
+    if (atom != nullptr && mNameIsAtom) {
+        return false; // distinct atoms are distinct names
+    }
+    return mNameLength == len && !memcmp(mName, name, len);
+}
+
 inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
+    const NameCache::Entry *cached = findCachedName(name);
+    const char *atom = cached == nullptr ? nullptr : cached->mAtom;
+
+    const uint16_t *index = mItems.index();
+    if (index != nullptr) {
+        const size_t mask = mItems.indexSize() - 1;
+        size_t slot = (cached == nullptr ? hashName(name, len) : cached->mHash) & mask;
+        for (; index[slot] != 0; slot = (slot + 1) & mask) {
+            const size_t i = index[slot] - 1;
+            if (mItems[i].hasName(name, len, atom)) {
+                return i;
+            }
+        }
+        return mItems.size();
+    }
+
 #ifdef DUMP_STATS
     size_t memchecks = 0;
 #endif
     size_t i = 0;
     for (; i < mItems.size(); i++) {
-        if (len != mItems[i].mNameLength) {
-            continue;
-        }
 #ifdef DUMP_STATS
         ++memchecks;
 #endif
-        if (!memcmp(mItems[i].mName, name, len)) {
+        if (mItems[i].hasName(name, len, atom)) {
             break;
         }
     }
+    // compare by address the next time this name is looked up
+    if (atom == nullptr && i < mItems.size() && mItems[i].mNameIsAtom) {
+        cacheName(name, mItems[i].mName, hashName(name, len));
+    }
 #ifdef DUMP_STATS
     {
         Mutex::Autolock _l(gLock);
@@ -180,18 +395,154 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
 }
 
 // assumes item's name was uninitialized or NULL
-void AMessage::Item::setName(const char *name, size_t len) {
+void AMessage::Item::setName(const char *name, size_t len, bool intern) {
     mNameLength = len;
-    mName = new char[len + 1];
-    memcpy((void*)mName, name, len + 1);
+    mName = intern ? internName(name, len) : nullptr;
+    mNameIsAtom = mName != nullptr;
+    if (!mNameIsAtom) {
+        char *copy = new char[len + 1];
+        memcpy(copy, name, len + 1);
+        mName = copy;
+    }
+}
+
+void AMessage::Item::freeName() {
+    if (!mNameIsAtom) {
+        delete[] mName;
+    }
+    mName = nullptr;
+    mNameIsAtom = false;
+}
+
+// assumes the item's value was freed
+void AMessage::Item::setStringValue(const char *s, size_t len) {
+    if (len <= kMaxInlineStringLength) {
+        // |s| may be the previous value of this item
+        memmove(u.inlineString, s, len);
+        u.inlineString[len] = '\0';
+        mInlineStringLength = static_cast<uint8_t>(len);
+        mStringIsInline = true;
+    } else {
+        u.stringValue = new AString(s, len);
+        mStringIsInline = false;
+    }
+}
+
+AMessage::Item::Item()
+    : mName(nullptr),
+      mNameLength(0),
+      mType(kTypeInt32),
+      mNameIsAtom(false),
+      mStringIsInline(false),
+      mInlineStringLength(0) {
+    memset(&u, 0, sizeof(u));
 }
 
 AMessage::Item::Item(const char *name, size_t len)
-    : mType(kTypeInt32) {
-    // mName and mNameLength are initialized by setName
+    : mType(kTypeInt32),
+      mStringIsInline(false),
+      mInlineStringLength(0) {
+    memset(&u, 0, sizeof(u));
+    // mName, mNameLength and mNameIsAtom are initialized by setName
     setName(name, len);
 }
 
+AMessage::ItemList::~ItemList() {
+    freeItemBlock(mData, mCapacity == kMinItemCapacity);
+}
+
+const uint16_t *AMessage::ItemList::index() const {
+    if (mCapacity <= kMinIndexedItems) {
+        return nullptr;
+    }
+    return reinterpret_cast<const uint16_t *>(mData + mCapacity);
+}
+
+uint16_t *AMessage::ItemList::index() {
+    return const_cast<uint16_t *>(static_cast<const ItemList *>(this)->index());
+}
+
+// assumes there is an index
+void AMessage::ItemList::indexItem(size_t i) {
+    uint16_t *slots = index();
+    const size_t mask = indexSize() - 1;
+    size_t slot = hashName(mData[i].mName, mData[i].mNameLength) & mask;
+    while (slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    slots[slot] = static_cast<uint16_t>(i + 1);
+}
+
+void AMessage::ItemList::rebuildIndex() {
+    uint16_t *slots = index();
+    if (slots == nullptr) {
+        return;
+    }
+    memset(slots, 0, indexSize() * sizeof(*slots));
+    for (size_t i = 0; i < mSize; ++i) {
+        indexItem(i);
+    }
+}
+
+void AMessage::ItemList::reserve(size_t capacity) {
+    if (capacity <= mCapacity) {
+        return;
+    }
+    // capacities are powers of two, as they also size the index, which keeps
+    // the load factor at or below 1/2
+    size_t newCapacity = std::max<size_t>(mCapacity * 2, kMinItemCapacity);
+    while (newCapacity < capacity) {
+        newCapacity *= 2;
+    }
+    size_t blockSize = newCapacity * sizeof(Item);
+    if (newCapacity > kMinIndexedItems) {
+        blockSize += newCapacity * 2 * sizeof(uint16_t);
+    }
+    Item *data = static_cast<Item *>(
+            allocateItemBlock(blockSize, newCapacity == kMinItemCapacity));
+    std::uninitialized_copy(mData, mData + mSize, data);
+    freeItemBlock(mData, mCapacity == kMinItemCapacity);
+    mData = data;
+    mCapacity = newCapacity;
+    rebuildIndex();
+}
+
+void AMessage::ItemList::emplace_back(const char *name, size_t len) {
+    reserve(mSize + 1);
+    new (&mData[mSize]) Item(name, len);
+    if (index() != nullptr) {
+        indexItem(mSize);
+    }
+    ++mSize;
+}
+
+void AMessage::ItemList::clear() {
+    mSize = 0;
+    rebuildIndex();
+}
+
+void AMessage::ItemList::resize(size_t size) {
+    reserve(size);
+    for (size_t i = mSize; i < size; ++i) {
+        new (&mData[i]) Item();
+    }
+    mSize = size;
+}
+
+AMessage::ItemList &AMessage::ItemList::operator=(const ItemList &other) {
+    if (this != &other) {
+        reserve(other.mSize);
+        std::uninitialized_copy(other.begin(), other.end(), mData);
+        mSize = other.mSize;
+        if (mCapacity == other.mCapacity && index() != nullptr) {
+            memcpy(index(), other.index(), indexSize() * sizeof(uint16_t));
+        } else {
+            rebuildIndex();
+        }
+    }
+    return *this;
+}
+
 AMessage::Item *AMessage::allocateItem(const char *name) {
     size_t len = strlen(name);
     size_t i = findItemIndex(name, len);
@@ -305,7 +656,7 @@ void AMessage::setString(
     Item *item = allocateItem(name);
     if (item) {
         item->mType = kTypeString;
-        item->u.stringValue = new AString(s, len < 0 ? strlen(s) : len);
+        item->setStringValue(s, len < 0 ? strlen(s) : len);
     }
 }
 
@@ -360,7 +711,7 @@ void AMessage::setRect(
 bool AMessage::findString(const char *name, AString *value) const {
     const Item *item = findItem(name, kTypeString);
     if (item) {
-        *value = *item->u.stringValue;
+        value->setTo(item->stringData(), item->stringLength());
         return true;
     }
     return false;
@@ -505,14 +856,19 @@ sp<AMessage> AMessage::dup() const {
         const Item *from = &mItems[i];
         Item *to = &msg->mItems[i];
 
-        to->setName(from->mName, from->mNameLength);
+        // atoms are shared, other names are copied
+        if (!from->mNameIsAtom) {
+            to->setName(from->mName, from->mNameLength, false /* intern */);
+        }
         to->mType = from->mType;
 
         switch (from->mType) {
             case kTypeString:
             {
-                to->u.stringValue =
-                    new AString(*from->u.stringValue);
+                if (!from->mStringIsInline) {
+                    to->u.stringValue =
+                        new AString(*from->u.stringValue);
+                }
                 break;
             }
 
@@ -616,7 +972,7 @@ AString AMessage::debugString(int32_t indent) const {
                 tmp = AStringPrintf(
                         "string %s = \"%s\"",
                         item.mName,
-                        item.u.stringValue->c_str());
+                        item.stringData());
                 break;
             case kTypeObject:
                 tmp = AStringPrintf(
@@ -738,7 +1094,7 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
                     continue;
                     // The loop will terminate subsequently.
                 } else {
-                    item->u.stringValue = new AString(stringValue);
+                    item->setStringValue(stringValue, strlen(stringValue));
                 }
                 break;
             }
@@ -771,8 +1127,10 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
             }
         }
 
-        item->setName(name, strlen(name));
+        // names from other processes are not interned
+        item->setName(name, strlen(name), false /* intern */);
     }
+    msg->mItems.rebuildIndex();
 
     return msg;
 }
@@ -818,7 +1176,7 @@ void AMessage::writeToParcel(Parcel *parcel) const {
 
             case kTypeString:
             {
-                parcel->writeCString(item.u.stringValue->c_str());
+                parcel->writeCString(item.stringData());
                 break;
             }
 
@@ -851,8 +1209,19 @@ sp<AMessage> AMessage::changesFrom(const sp<const AMessage> &other, bool deep) c
         diff->setTarget(mHandler.promote());
     }
 
-    for (const Item &item : mItems) {
-        const Item *oitem = other->findItem(item.mName, item.mType);
+    for (size_t i = 0; i < mItems.size(); ++i) {
+        const Item &item = mItems[i];
+        // messages derived from one another mostly keep their items in the same order
+        const char *atom = item.mNameIsAtom ? item.mName : nullptr;
+        size_t oi = i;
+        if (oi >= other->mItems.size()
+                || !other->mItems[oi].hasName(item.mName, item.mNameLength, atom)) {
+            oi = other->findItemIndex(item.mName, item.mNameLength);
+        }
+        const Item *oitem = NULL;
+        if (oi < other->mItems.size() && other->mItems[oi].mType == item.mType) {
+            oitem = &other->mItems[oi];
+        }
         switch (item.mType) {
             case kTypeInt32:
                 if (oitem == NULL || item.u.int32Value != oitem->u.int32Value) {
@@ -874,19 +1243,21 @@ sp<AMessage> AMessage::changesFrom(const sp<const AMessage> &other, bool deep) c
 
             case kTypeFloat:
                 if (oitem == NULL || item.u.floatValue != oitem->u.floatValue) {
-                    diff->setFloat(item.mName, item.u.sizeValue);
+                    diff->setFloat(item.mName, item.u.floatValue);
                 }
                 break;
 
             case kTypeDouble:
                 if (oitem == NULL || item.u.doubleValue != oitem->u.doubleValue) {
-                    diff->setDouble(item.mName, item.u.sizeValue);
+                    diff->setDouble(item.mName, item.u.doubleValue);
                 }
                 break;
 
             case kTypeString:
-                if (oitem == NULL || *item.u.stringValue != *oitem->u.stringValue) {
-                    diff->setString(item.mName, *item.u.stringValue);
+                if (oitem == NULL
+                        || item.stringLength() != oitem->stringLength()
+                        || memcmp(item.stringData(), oitem->stringData(), item.stringLength())) {
+                    diff->setString(item.mName, item.stringData(), item.stringLength());
                 }
                 break;
 
@@ -989,7 +1360,9 @@ AMessage::ItemData AMessage::getEntryAt(size_t index) const {
             case kTypeDouble:   it.set(mItems[index].u.doubleValue); break;
             case kTypePointer:  it.set(mItems[index].u.ptrValue); break;
             case kTypeRect:     it.set(mItems[index].u.rectValue); break;
-            case kTypeString:   it.set(*mItems[index].u.stringValue); break;
+            case kTypeString:
+                it.set(AString(mItems[index].stringData(), mItems[index].stringLength()));
+                break;
             case kTypeObject: {
                 sp<RefBase> obj = mItems[index].u.refValue;
                 it.set(obj);
@@ -1026,9 +1399,9 @@ status_t AMessage::setEntryNameAt(size_t index, const char *name) {
     if (findItemIndex(name, len) < mItems.size()) {
         return ALREADY_EXISTS;
     }
-    delete[] mItems[index].mName;
-    mItems[index].mName = nullptr;
+    mItems[index].freeName();
     mItems[index].setName(name, len);
+    mItems.rebuildIndex();
     return OK;
 }
 
@@ -1063,7 +1436,7 @@ status_t AMessage::setEntryAt(size_t index, const ItemData &item) {
     } else if (item.find(&dst->u.rectValue)) {
         dst->mType = kTypeRect;
     } else if (item.find(&stringValue)) {
-        dst->u.stringValue = new AString(stringValue);
+        dst->setStringValue(stringValue.c_str(), stringValue.size());
         dst->mType = kTypeString;
     } else if (item.find(&refValue)) {
         if (refValue != NULL) { refValue->incStrong(this); }
@@ -1091,8 +1464,7 @@ status_t AMessage::removeEntryAt(size_t index) {
         return BAD_INDEX;
     }
     // delete entry data and objects
-    delete[] mItems[index].mName;
-    mItems[index].mName = nullptr;
+    mItems[index].freeName();
     freeItemValue(&mItems[index]);
 
     // swap entry with last entry and clear last entry's data
@@ -1100,9 +1472,12 @@ status_t AMessage::removeEntryAt(size_t index) {
     if (index < lastIndex) {
         mItems[index] = mItems[lastIndex];
         mItems[lastIndex].mName = nullptr;
+        mItems[lastIndex].mNameIsAtom = false;
         mItems[lastIndex].mType = kTypeInt32;
+        mItems[lastIndex].mStringIsInline = false;
     }
     mItems.pop_back();
+    mItems.rebuildIndex();
     return OK;
 }
 
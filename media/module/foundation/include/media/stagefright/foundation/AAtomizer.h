@@ -31,15 +31,21 @@ namespace android {
 struct AAtomizer {
     static const char *Atomize(const char *name);
 
+    // Like Atomize(), but returns NULL instead of adding a new atom once
+    // |maxAtoms| atoms exist, for names that may come from untrusted input.
+    static const char *TryAtomize(const char *name, size_t maxAtoms);
+
 private:
-    static AAtomizer gAtomizer;
+    // Constructed on first use, as messages may be built during static initialization.
+    static AAtomizer &Get();
 
     Mutex mLock;
     Vector<List<AString> > mAtoms;
+    size_t mNumAtoms;
 
     AAtomizer();
 
-    const char *atomize(const char *name);
+    const char *atomize(const char *name, size_t maxAtoms);
 
     static uint32_t Hash(const char *s);
 
@@ -67,18 +67,16 @@ protected:
 private:
     friend struct AMessage;       // post()
 
-    struct Event {
-        int64_t mWhenUs;
-        sp<AMessage> mMessage;
-        sp<RefBase> mToken;
-    };
-
     Mutex mLock;
     Condition mQueueChangedCondition;
 
     AString mName;
 
-    List<Event> mEventQueue;
+    // The queues of posted messages, see ALooper.cpp. They live out of line, in
+    // place of the List of events kept here before, so that the size and
+    // layout of ALooper do not change for code built against older headers.
+    struct EventQueue;
+    EventQueue *mEventQueue;
 
     struct LooperThread;
     sp<LooperThread> mThread;
@@ -65,6 +65,10 @@ struct AMessage : public RefBase {
     AMessage();
     AMessage(uint32_t what, const sp<const AHandler> &handler);
 
+    // Messages are recycled through a small per-thread cache.
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
 #if !defined(__ANDROID_VNDK__) && !defined(__ANDROID_APEX__)
     // Construct an AMessage from a parcel.
     // nestingAllowed determines how many levels AMessage can be nested inside
@@ -295,6 +299,12 @@ private:
     wp<AHandler> mHandler;
     wp<ALooper> mLooper;
 
+    enum {
+        kMaxNumItems = 256,
+        // String values up to this length are stored in the item itself.
+        kMaxInlineStringLength = 15,
+    };
+
     struct Item {
         union {
             int32_t int32Value;
@@ -306,19 +316,82 @@ private:
             RefBase *refValue;
             AString *stringValue;
             Rect rectValue;
+            char inlineString[kMaxInlineStringLength + 1];
         } u;
         const char *mName;
         size_t      mNameLength;
         Type mType;
-        void setName(const char *name, size_t len);
-        Item() : mName(nullptr), mNameLength(0), mType(kTypeInt32) { }
+        bool mNameIsAtom;       // mName is owned by AAtomizer
+        bool mStringIsInline;   // string value is held in u.inlineString
+        uint8_t mInlineStringLength;
+        void setName(const char *name, size_t len, bool intern = true);
+        void freeName();
+        void setStringValue(const char *s, size_t len);
+        bool hasName(const char *name, size_t len, const char *atom) const;
+        const char *stringData() const {
+            return mStringIsInline ? u.inlineString : u.stringValue->c_str();
+        }
+        size_t stringLength() const {
+            return mStringIsInline ? mInlineStringLength : u.stringValue->size();
+        }
+        Item();
         Item(const char *name, size_t length);
     };
 
+    // A vector of items whose smallest storage blocks are recycled per thread
+    // like the messages themselves. Once its capacity exceeds kMinIndexedItems,
+    // the block also holds an open-addressed hash index of the items by name,
+    // with item index + 1 in each slot (0 marks an empty slot).
+    // Items are trivially copyable; their names and values are managed by AMessage.
+    //
+    // It takes the place of the std::vector<Item> kept here before, and has the
+    // same size, so that the layout of AMessage does not change for code built
+    // against older headers.
+    struct ItemList {
+        ItemList() : mData(nullptr), mSize(0), mCapacity(0) { }
+        ~ItemList();
+
+        size_t size() const { return mSize; }
+        bool empty() const { return mSize == 0; }
+        Item &operator[](size_t i) { return mData[i]; }
+        const Item &operator[](size_t i) const { return mData[i]; }
+        Item *begin() { return mData; }
+        Item *end() { return mData + mSize; }
+        const Item *begin() const { return mData; }
+        const Item *end() const { return mData + mSize; }
+
+        void emplace_back(const char *name, size_t len);
+        void pop_back() { --mSize; }
+        void clear();
+        // Items added by resize() are unnamed, and left out of the index.
+        void resize(size_t size);
+        ItemList &operator=(const ItemList &other);
+
+        ItemList(const ItemList &) = delete;
+
+        /** Returns the index, or NULL if the items are not indexed. */
+        const uint16_t *index() const;
+        size_t indexSize() const { return mCapacity * 2; }
+
+        /** Rebuilds the index, if there is one, after items were renamed or moved. */
+        void rebuildIndex();
+
+    private:
+        Item *mData;
+        size_t mSize;
+        size_t mCapacity;
+
+        uint16_t *index();
+        void indexItem(size_t i);
+        void reserve(size_t capacity);
+    };
+
     enum {
-        kMaxNumItems = 256
+        kMinItemCapacity = 8,
+        kMinIndexedItems = 16,
     };
-    std::vector<Item> mItems;
+    ItemList mItems;
+    static_assert(sizeof(ItemList) == sizeof(std::vector<Item>), "AMessage layout changed");
 
     /**
      * Allocates an item with the given key |name|. If the key already exists, the corresponding
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ALooperBenchmark"
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+using namespace android;
+
+constexpr int32_t kMessagesPerProducer = 10000;
+// Every Nth message is posted with a delay, as a renderer or codec would mix
+// timed events with immediate ones.
+constexpr int32_t kDelayedMessageInterval = 16;
+constexpr int64_t kDelayUs = 100;
+
+// Records the time from post to delivery of each message.
+struct LatencyHandler : public AHandler {
+    enum {
+        kWhatPing = 'ping',
+    };
+
+    explicit LatencyHandler(size_t expected) : mExpected(expected) {
+        mLatenciesUs.reserve(expected);
+    }
+
+    void waitForAll() {
+        Mutex::Autolock autoLock(mDoneLock);
+        while (mLatenciesUs.size() < mExpected) {
+            mDoneCondition.wait(mDoneLock);
+        }
+    }
+
+    std::vector<int64_t> mLatenciesUs;
+
+protected:
+    void onMessageReceived(const sp<AMessage> &msg) override {
+        int64_t dueUs;
+        CHECK(msg->findInt64("due", &dueUs));
+        Mutex::Autolock autoLock(mDoneLock);
+        mLatenciesUs.push_back(ALooper::GetNowUs() - dueUs);
+        if (mLatenciesUs.size() == mExpected) {
+            mDoneCondition.signal();
+        }
+    }
+
+private:
+    const size_t mExpected;
+    Mutex mDoneLock;
+    Condition mDoneCondition;
+};
+
+/*******************************************************************
+ * Posts kMessagesPerProducer messages from each of a number of producer
+ * threads to a single looper, and reports the delay from the time each
+ * message was due to its delivery. The parameter is the number of producers.
+ *******************************************************************/
+static void BM_ALooper_PostToDeliverLatency(benchmark::State &state) {
+    const int32_t numProducers = state.range(0);
+    const size_t numMessages = (size_t)numProducers * kMessagesPerProducer;
+    std::vector<int64_t> latenciesUs;
+
+    for (auto _ : state) {
+        sp<ALooper> looper = new ALooper;
+        looper->setName("ALooperBenchmark");
+        sp<LatencyHandler> handler = new LatencyHandler(numMessages);
+        looper->registerHandler(handler);
+        looper->start();
+
+        std::vector<std::thread> producers;
+        for (int32_t p = 0; p < numProducers; ++p) {
+            producers.emplace_back([&handler] {
+                for (int32_t i = 0; i < kMessagesPerProducer; ++i) {
+                    sp<AMessage> msg = new AMessage(LatencyHandler::kWhatPing, handler);
+                    const bool delayed = (i % kDelayedMessageInterval) == 0;
+                    msg->setInt64("due", ALooper::GetNowUs() + (delayed ? kDelayUs : 0));
+                    msg->post(delayed ? kDelayUs : 0);
+                }
+            });
+        }
+        for (std::thread &producer : producers) {
+            producer.join();
+        }
+        handler->waitForAll();
+
+        looper->stop();
+        looper->unregisterHandler(handler->id());
+        latenciesUs.insert(latenciesUs.end(),
+                           handler->mLatenciesUs.begin(), handler->mLatenciesUs.end());
+    }
+
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+    int64_t totalUs = 0;
+    for (int64_t latencyUs : latenciesUs) {
+        totalUs += latencyUs;
+    }
+    state.SetItemsProcessed(latenciesUs.size());
+    state.counters["mean_latency_us"] = (double)totalUs / latenciesUs.size();
+    state.counters["p50_latency_us"] = latenciesUs[latenciesUs.size() / 2];
+    state.counters["p99_latency_us"] = latenciesUs[latenciesUs.size() * 99 / 100];
+}
+
+BENCHMARK(BM_ALooper_PostToDeliverLatency)
+        ->Arg(1)
+        ->Arg(2)
+        ->Arg(4)
+        ->Arg(8)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
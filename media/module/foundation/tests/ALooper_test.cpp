@@ -0,0 +1,192 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ALooper_test"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/RefBase.h>
+
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+using namespace android;
+using namespace std::chrono_literals;
+
+namespace {
+
+class LooperWithSettableClock : public ALooper {
+public:
+  LooperWithSettableClock() : mClockUs(0) {}
+
+  void setClockUs(int64_t nowUs) {
+    mClockUs = nowUs;
+  }
+
+  int64_t getNowUs() override {
+    return mClockUs;
+  }
+
+private:
+  std::atomic<int64_t> mClockUs;
+};
+
+// Records the "what" of the messages it receives, in delivery order.
+class RecordingHandler : public AHandler {
+public:
+  // Waits until |count| messages have been received, or the timeout.
+  std::vector<uint32_t> waitFor(size_t count, std::chrono::milliseconds timeout = 1s) {
+    std::unique_lock<std::mutex> lock(mLock);
+    mCondition.wait_for(lock, timeout, [this, count] { return mReceived.size() >= count; });
+    return mReceived;
+  }
+
+protected:
+  void onMessageReceived(const sp<AMessage> &msg) override {
+    std::lock_guard<std::mutex> lock(mLock);
+    mReceived.push_back(msg->what());
+    mCondition.notify_all();
+  }
+
+private:
+  std::mutex mLock;
+  std::condition_variable mCondition;
+  std::vector<uint32_t> mReceived;
+};
+
+}  // namespace
+
+// Messages due at the same time are delivered in posting order, whether they were posted with
+// post() or postUnique().
+TEST(ALooper_tests, deliversSameTimeMessagesInPostingOrder) {
+  sp<RecordingHandler> handler = new RecordingHandler;
+  sp<LooperWithSettableClock> looper = new LooperWithSettableClock();
+  looper->registerHandler(handler);
+
+  constexpr uint32_t kNumMessages = 64;
+  std::vector<uint32_t> expected;
+  for (uint32_t i = 0; i < kNumMessages; ++i) {
+    sp<AMessage> msg = new AMessage(i, handler);
+    if (i % 3 == 1) {
+      msg->postUnique(msg, 0);
+    } else {
+      msg->post();
+    }
+    expected.push_back(i);
+  }
+
+  looper->start();
+  EXPECT_EQ(handler->waitFor(kNumMessages), expected);
+  looper->stop();
+}
+
+// A delayed message that falls due at the time an immediate message is posted was posted first,
+// so it is delivered first.
+TEST(ALooper_tests, deliversDueDelayedMessageBeforeLaterImmediateMessage) {
+  sp<RecordingHandler> handler = new RecordingHandler;
+  sp<LooperWithSettableClock> looper = new LooperWithSettableClock();
+  looper->registerHandler(handler);
+
+  (new AMessage(1, handler))->post(100);
+  (new AMessage(2, handler))->post(200);
+  looper->setClockUs(100);
+  (new AMessage(3, handler))->post();
+  (new AMessage(4, handler))->post();
+
+  looper->start();
+  EXPECT_EQ(handler->waitFor(3), (std::vector<uint32_t>{1, 3, 4}));
+
+  looper->setClockUs(200);
+  (new AMessage(5, handler))->post();
+  EXPECT_EQ(handler->waitFor(5), (std::vector<uint32_t>{1, 3, 4, 2, 5}));
+  looper->stop();
+}
+
+// Messages posted from several threads keep the order in which each thread posted them.
+TEST(ALooper_tests, keepsPerThreadOrderWithConcurrentPosters) {
+  sp<RecordingHandler> handler = new RecordingHandler;
+  sp<ALooper> looper = new ALooper();
+  looper->registerHandler(handler);
+  looper->start();
+
+  constexpr uint32_t kNumThreads = 4;
+  constexpr uint32_t kNumMessagesPerThread = 2000;
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&handler, t] {
+      for (uint32_t i = 0; i < kNumMessagesPerThread; ++i) {
+        (new AMessage(t << 16 | i, handler))->post();
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  std::vector<uint32_t> received = handler->waitFor(kNumThreads * kNumMessagesPerThread, 5s);
+  ASSERT_EQ(received.size(), kNumThreads * kNumMessagesPerThread);
+  std::vector<uint32_t> next(kNumThreads, 0);
+  for (uint32_t what : received) {
+    ASSERT_EQ(what & 0xffff, next[what >> 16]++);
+  }
+  looper->stop();
+}
+
+// An immediate message wakes up a looper that is waiting, with an empty queue or for a delayed
+// message that is not yet due.
+TEST(ALooper_tests, wakesUpForImmediateMessage) {
+  sp<RecordingHandler> handler = new RecordingHandler;
+  sp<ALooper> looper = new ALooper();
+  looper->registerHandler(handler);
+  looper->start();
+
+  std::this_thread::sleep_for(50ms);  // let the looper wait on an empty queue
+  (new AMessage(1, handler))->post();
+  EXPECT_EQ(handler->waitFor(1), std::vector<uint32_t>{1});
+
+  (new AMessage(2, handler))->post(10000000 /* 10s */);
+  std::this_thread::sleep_for(50ms);  // let the looper wait for the delayed message
+  (new AMessage(3, handler))->post();
+  EXPECT_EQ(handler->waitFor(2), (std::vector<uint32_t>{1, 3}));
+  looper->stop();
+}
+
+// stop() returns promptly while the looper waits, and pending messages are not delivered.
+TEST(ALooper_tests, stopsWhileWaiting) {
+  sp<RecordingHandler> handler = new RecordingHandler;
+  sp<ALooper> looper = new ALooper();
+  looper->registerHandler(handler);
+  looper->start();
+
+  (new AMessage(1, handler))->post(10000000 /* 10s */);
+  std::this_thread::sleep_for(50ms);  // let the looper wait for the delayed message
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(looper->stop(), OK);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+
+  (new AMessage(2, handler))->post();
+  EXPECT_TRUE(handler->waitFor(1, 100ms).empty());
+  EXPECT_EQ(looper->stop(), INVALID_OPERATION);
+}
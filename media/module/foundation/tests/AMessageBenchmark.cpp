@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AMessageBenchmark"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <iterator>
+#include <new>
+
+#include <benchmark/benchmark.h>
+
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+
+using namespace android;
+
+// Counts heap allocations so that the benchmarks can report allocations per message.
+static std::atomic<size_t> gNumAllocations(0);
+
+void *operator new(size_t size) {
+    gNumAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        abort();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+enum {
+    kWhatCodecNotify = 'codc',
+};
+
+// Builds a message like the ones MediaCodec sends for every input or output buffer.
+static sp<AMessage> makeBufferCallback(int64_t timeUs) {
+    sp<AMessage> msg = new AMessage;
+    msg->setWhat(kWhatCodecNotify);
+    msg->setInt32("callbackID", 2 /* CB_OUTPUT_AVAILABLE */);
+    msg->setInt32("index", 3);
+    msg->setSize("offset", 0);
+    msg->setSize("size", 4096);
+    msg->setInt64("timeUs", timeUs);
+    msg->setInt32("flags", 0);
+    return msg;
+}
+
+// Builds a message with |numItems| int32 entries named like format keys.
+static sp<AMessage> makeFormat(int64_t numItems) {
+    sp<AMessage> msg = new AMessage;
+    for (int64_t i = 0; i < numItems; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "vendor.key-%lld", (long long)i);
+        msg->setInt32(name, (int32_t)i);
+    }
+    msg->setString("mime", "video/avc");
+    return msg;
+}
+
+// Keys of a video decoder format as configured through MediaCodec and CCodecConfig.
+static const char *kCodecFormatKeys[] = {
+    "width", "height", "stride", "slice-height", "color-format", "color-standard",
+    "color-range", "color-transfer", "crop-left", "crop-top", "crop-right", "crop-bottom",
+    "max-input-size", "max-width", "max-height", "profile", "level", "rotation-degrees",
+    "sar-width", "sar-height", "priority", "low-latency", "push-blank-buffers-on-shutdown",
+    "android._dataspace", "android._video-scaling", "track-id", "bitrate", "bitrate-mode",
+    "i-frame-interval", "intra-refresh-period", "prepend-sps-pps-to-idr-frames",
+    "max-b-frames", "latency", "feature-adaptive-playback", "feature-tunneled-playback",
+    "audio-session-id", "display-width", "display-height", "allow-frame-drop",
+    "picture-type", "repeat-previous-frame-after", "create-input-buffers-suspended",
+    "tile-width", "tile-height", "grid-rows", "grid-cols", "time-lapse-enable",
+    "vendor.qti-ext-dec-picture-order.enable", "vendor.qti-ext-dec-low-latency.enable",
+    "vendor.qti-ext-extradata-enable.types", "android._color-format",
+    "android._tunnel-peek", "video-qp-min", "video-qp-max", "hdr10-plus-info",
+};
+
+static sp<AMessage> makeCodecFormat() {
+    sp<AMessage> format = new AMessage;
+    format->setString("mime", "video/hevc");
+    int32_t value = 0;
+    for (const char *key : kCodecFormatKeys) {
+        format->setInt32(key, ++value);
+    }
+    format->setInt64("durationUs", 120000000LL);
+    format->setFloat("frame-rate", 30.f);
+    format->setFloat("operating-rate", 60.f);
+    return format;
+}
+
+/*******************************************************************
+ * Creates and destroys a buffer callback message, and reports the number
+ * of heap allocations it takes.
+ *******************************************************************/
+static void BM_AMessage_CreateAndDestroy(benchmark::State& state) {
+    int64_t timeUs = 0;
+    // warm up the per-thread caches
+    makeBufferCallback(timeUs);
+
+    const size_t allocationsBefore = gNumAllocations.load();
+    for (auto _ : state) {
+        sp<AMessage> msg = makeBufferCallback(timeUs);
+        benchmark::DoNotOptimize(msg.get());
+        timeUs += 33333;
+    }
+    const size_t allocations = gNumAllocations.load() - allocationsBefore;
+    state.counters["allocs_per_message"] = (double)allocations / state.iterations();
+}
+
+/*******************************************************************
+ * Looks up the last added key of a message with the given number of items.
+ *******************************************************************/
+static void BM_AMessage_FindInt32(benchmark::State& state) {
+    sp<AMessage> msg = makeFormat(state.range(0));
+    char name[32];
+    snprintf(name, sizeof(name), "vendor.key-%lld", (long long)(state.range(0) - 1));
+
+    for (auto _ : state) {
+        int32_t value = 0;
+        benchmark::DoNotOptimize(msg->findInt32(name, &value));
+        benchmark::DoNotOptimize(value);
+    }
+}
+
+/*******************************************************************
+ * Updates an existing key of a buffer callback message.
+ *******************************************************************/
+static void BM_AMessage_SetInt64(benchmark::State& state) {
+    sp<AMessage> msg = makeBufferCallback(0);
+    int64_t timeUs = 0;
+
+    for (auto _ : state) {
+        msg->setInt64("timeUs", timeUs);
+        timeUs += 33333;
+    }
+}
+
+/*******************************************************************
+ * Copies a message with the given number of items, and reports the number
+ * of heap allocations per copy.
+ *******************************************************************/
+static void BM_AMessage_Dup(benchmark::State& state) {
+    sp<AMessage> msg = makeFormat(state.range(0));
+    msg->dup();
+
+    const size_t allocationsBefore = gNumAllocations.load();
+    for (auto _ : state) {
+        sp<AMessage> copy = msg->dup();
+        benchmark::DoNotOptimize(copy.get());
+    }
+    const size_t allocations = gNumAllocations.load() - allocationsBefore;
+    state.counters["allocs_per_message"] = (double)allocations / state.iterations();
+}
+
+/*******************************************************************
+ * Looks up every key of a codec format.
+ *******************************************************************/
+static void BM_AMessage_FindCodecFormatKeys(benchmark::State& state) {
+    sp<AMessage> format = makeCodecFormat();
+
+    for (auto _ : state) {
+        for (const char *key : kCodecFormatKeys) {
+            int32_t value = 0;
+            benchmark::DoNotOptimize(format->findInt32(key, &value));
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * std::size(kCodecFormatKeys));
+}
+
+/*******************************************************************
+ * Diffs a codec format against an output format change of a few keys, as
+ * CCodecConfig and MediaCodec do on format updates.
+ *******************************************************************/
+static void BM_AMessage_ChangesFromCodecFormat(benchmark::State& state) {
+    sp<AMessage> format = makeCodecFormat();
+    sp<AMessage> updated = format->dup();
+    updated->setInt32("crop-right", 1919);
+    updated->setInt32("color-range", 2);
+    updated->setFloat("frame-rate", 60.f);
+
+    for (auto _ : state) {
+        sp<AMessage> diff = updated->changesFrom(format);
+        benchmark::DoNotOptimize(diff.get());
+    }
+}
+
+BENCHMARK(BM_AMessage_CreateAndDestroy);
+BENCHMARK(BM_AMessage_FindInt32)->Arg(4)->Arg(16)->Arg(64);
+BENCHMARK(BM_AMessage_SetInt64);
+BENCHMARK(BM_AMessage_Dup)->Arg(4)->Arg(16)->Arg(64);
+BENCHMARK(BM_AMessage_FindCodecFormatKeys);
+BENCHMARK(BM_AMessage_ChangesFromCodecFormat);
+
+BENCHMARK_MAIN();
@@ -17,10 +17,14 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "AData_test"
 
+#include <string>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <utils/RefBase.h>
 
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -335,3 +339,232 @@ TEST(AMessage_tests, postUnique_withNullToken_returnsInvalidArgument) {
   sp<AMessage> msg = new AMessage(0, mockHandler);
   EXPECT_EQ(msg->postUnique(nullptr, 0), -EINVAL);
 }
+
+// String values of up to 15 characters are stored in the item, longer ones in an AString.
+TEST(AMessage_tests, storesStringsAroundInlineLength) {
+  const AString kInline("fifteen-chars-x");  // 15 characters
+  const AString kHeap("sixteen-chars-xx");   // 16 characters
+  ASSERT_EQ(15u, kInline.size());
+  ASSERT_EQ(16u, kHeap.size());
+
+  sp<AMessage> msg = new AMessage();
+  msg->setString("inline", kInline);
+  msg->setString("heap", kHeap);
+  msg->setString("empty", "");
+
+  AString value;
+  EXPECT_TRUE(msg->findString("inline", &value));
+  EXPECT_EQ(kInline, value);
+  EXPECT_TRUE(msg->findString("heap", &value));
+  EXPECT_EQ(kHeap, value);
+  EXPECT_TRUE(msg->findString("empty", &value));
+  EXPECT_EQ(AString(), value);
+
+  // replacing values moves them between the two kinds of storage
+  msg->setString("inline", kHeap);
+  msg->setString("heap", kInline);
+  EXPECT_TRUE(msg->findString("inline", &value));
+  EXPECT_EQ(kHeap, value);
+  EXPECT_TRUE(msg->findString("heap", &value));
+  EXPECT_EQ(kInline, value);
+
+  // a value set from its own previous value
+  msg->setString("heap", value);
+  EXPECT_TRUE(msg->findString("heap", &value));
+  EXPECT_EQ(kInline, value);
+
+  AMessage::Type type;
+  size_t index = msg->findEntryByName("inline");
+  EXPECT_STREQ("inline", msg->getEntryNameAt(index, &type));
+  EXPECT_EQ(AMessage::kTypeString, type);
+  EXPECT_TRUE(msg->getEntryAt(index).find(&value));
+  EXPECT_EQ(kHeap, value);
+}
+
+// Item names are interned. Removing an entry moves the last one in its place, which must still
+// be found by name, whether the name is passed as the same literal or as another copy.
+TEST(AMessage_tests, removesEntriesWithInternedNames) {
+  sp<AMessage> msg = new AMessage();
+  msg->setInt32("first", 1);
+  msg->setInt32("second", 2);
+  msg->setInt32("third", 3);
+  ASSERT_EQ(3u, msg->countEntries());
+
+  EXPECT_EQ(OK, msg->removeEntryAt(msg->findEntryByName("first")));
+  EXPECT_EQ(2u, msg->countEntries());
+
+  const std::string third("third");
+  int32_t value;
+  EXPECT_FALSE(msg->findInt32("first", &value));
+  EXPECT_TRUE(msg->findInt32("third", &value));
+  EXPECT_EQ(3, value);
+  EXPECT_TRUE(msg->findInt32(third.c_str(), &value));
+  EXPECT_EQ(3, value);
+  EXPECT_TRUE(msg->findInt32("second", &value));
+  EXPECT_EQ(2, value);
+
+  // removing the last entry, and adding back a removed name
+  EXPECT_EQ(OK, msg->removeEntryAt(msg->countEntries() - 1));
+  EXPECT_FALSE(msg->findInt32("second", &value));
+  EXPECT_EQ(BAD_INDEX, msg->removeEntryAt(msg->countEntries()));
+  msg->setInt32("first", 4);
+  EXPECT_TRUE(msg->findInt32("first", &value));
+  EXPECT_EQ(4, value);
+  EXPECT_EQ(2u, msg->countEntries());
+
+  // other messages share the atoms of the names
+  sp<AMessage> other = new AMessage();
+  other->setInt32(third.c_str(), 5);
+  EXPECT_EQ(OK, other->removeEntryByName("third"));
+  EXPECT_EQ(0u, other->countEntries());
+  EXPECT_TRUE(msg->findInt32("third", &value));
+  EXPECT_EQ(3, value);
+}
+
+// dup() gives the copy its own strings and names, stored inline or not.
+TEST(AMessage_tests, dupCopiesStringsAndNames) {
+  // names this long are not interned, so each message owns a copy
+  const std::string longName(100, 'n');
+  sp<AMessage> msg = new AMessage(42, nullptr);
+  msg->setString("inline", "short");
+  msg->setString("heap", "a string too long to be stored inline");
+  msg->setString(longName.c_str(), "value of a long name");
+
+  sp<AMessage> copy = msg->dup();
+  msg->setString("inline", "changed");
+  msg->setString("heap", "another string too long to be stored inline");
+  msg->clear();
+
+  EXPECT_EQ(42u, copy->what());
+  EXPECT_EQ(3u, copy->countEntries());
+  AString value;
+  EXPECT_TRUE(copy->findString("inline", &value));
+  EXPECT_EQ(AString("short"), value);
+  EXPECT_TRUE(copy->findString("heap", &value));
+  EXPECT_EQ(AString("a string too long to be stored inline"), value);
+  EXPECT_TRUE(copy->findString(longName.c_str(), &value));
+  EXPECT_EQ(AString("value of a long name"), value);
+}
+
+// Messages with more than 16 items look them up through an index, which must follow the items
+// as they are added, replaced, removed, renamed and cleared.
+TEST(AMessage_tests, findsItemsOfLargeMessages) {
+  constexpr int32_t kNumItems = 100;
+  sp<AMessage> msg = new AMessage();
+  std::vector<std::string> names;
+  for (int32_t i = 0; i < kNumItems; ++i) {
+    names.push_back("item-" + std::to_string(i));
+    msg->setInt32(names.back().c_str(), i);
+  }
+  ASSERT_EQ(size_t(kNumItems), msg->countEntries());
+
+  int32_t value;
+  for (int32_t i = 0; i < kNumItems; ++i) {
+    EXPECT_TRUE(msg->findInt32(names[i].c_str(), &value)) << names[i];
+    EXPECT_EQ(i, value);
+  }
+  EXPECT_FALSE(msg->findInt32("item-100", &value));
+
+  // replacing an item with a value of another type keeps a single entry
+  sp<RefBase> obj = new ABuffer(4);
+  msg->setObject("item-7", obj);
+  sp<RefBase> found;
+  EXPECT_TRUE(msg->findObject("item-7", &found));
+  EXPECT_EQ(obj, found);
+  EXPECT_FALSE(msg->findInt32("item-7", &value));
+  EXPECT_EQ(size_t(kNumItems), msg->countEntries());
+
+  // removing items moves the last one in their place
+  for (int32_t i = 0; i < kNumItems; i += 3) {
+    EXPECT_EQ(OK, msg->removeEntryByName(names[i].c_str()));
+  }
+  for (int32_t i = 0; i < kNumItems; ++i) {
+    if (i == 7) {
+      EXPECT_TRUE(msg->findObject(names[i].c_str(), &found));
+    } else if (i % 3 == 0) {
+      EXPECT_FALSE(msg->findInt32(names[i].c_str(), &value)) << names[i];
+    } else {
+      EXPECT_TRUE(msg->findInt32(names[i].c_str(), &value)) << names[i];
+      EXPECT_EQ(i, value);
+    }
+  }
+
+  EXPECT_EQ(OK, msg->setEntryNameAt(msg->findEntryByName("item-8"), "renamed"));
+  EXPECT_FALSE(msg->findInt32("item-8", &value));
+  EXPECT_TRUE(msg->findInt32("renamed", &value));
+  EXPECT_EQ(8, value);
+
+  sp<AMessage> copy = msg->dup();
+  EXPECT_TRUE(copy->findInt32("renamed", &value));
+  EXPECT_EQ(8, value);
+  EXPECT_TRUE(copy->findInt32("item-98", &value));
+  EXPECT_EQ(98, value);
+
+  msg->clear();
+  EXPECT_EQ(0u, msg->countEntries());
+  EXPECT_FALSE(msg->findInt32("item-1", &value));
+  EXPECT_FALSE(msg->findObject("item-7", &found));
+  msg->setInt32("item-1", 101);
+  EXPECT_TRUE(msg->findInt32("item-1", &value));
+  EXPECT_EQ(101, value);
+  EXPECT_FALSE(msg->findInt32("item-2", &value));
+}
+
+// The index is built once a message grows past 16 items, and is kept when it shrinks again.
+TEST(AMessage_tests, findsItemsAcrossIndexThreshold) {
+  sp<AMessage> msg = new AMessage();
+  std::vector<std::string> names;
+  int32_t value;
+  for (int32_t i = 0; i < 40; ++i) {
+    names.push_back("key" + std::to_string(i));
+    msg->setInt32(names.back().c_str(), i);
+    for (int32_t j = 0; j <= i; ++j) {
+      ASSERT_TRUE(msg->findInt32(names[j].c_str(), &value)) << i << " " << names[j];
+      ASSERT_EQ(j, value);
+    }
+  }
+  while (msg->countEntries() > 0) {
+    ASSERT_EQ(OK, msg->removeEntryAt(0));
+    for (size_t j = 0; j < msg->countEntries(); ++j) {
+      AMessage::Type type;
+      const char *name = msg->getEntryNameAt(j, &type);
+      ASSERT_EQ(j, msg->findEntryByName(name)) << name;
+    }
+  }
+}
+
+// changesFrom() compares float and double items by value, and reports type changes.
+TEST(AMessage_tests, changesFromComparesFloatsAndDoubles) {
+  sp<AMessage> msg = new AMessage();
+  msg->setFloat("sameFloat", 1.5f);
+  msg->setFloat("changedFloat", 2.5f);
+  msg->setDouble("sameDouble", 1.0 / 3);
+  msg->setDouble("changedDouble", 0.1);
+  msg->setFloat("retyped", 4.0f);
+  msg->setFloat("added", 5.0f);
+
+  sp<AMessage> other = new AMessage();
+  // in another order, so that items are looked up by name
+  other->setDouble("retyped", 4.0);
+  other->setDouble("changedDouble", 0.1 + 1e-12);
+  other->setDouble("sameDouble", 1.0 / 3);
+  other->setFloat("changedFloat", 2.25f);
+  other->setFloat("sameFloat", 1.5f);
+
+  sp<AMessage> diff = msg->changesFrom(other);
+  EXPECT_EQ(4u, diff->countEntries());
+  float floatValue;
+  double doubleValue;
+  EXPECT_TRUE(diff->findFloat("changedFloat", &floatValue));
+  EXPECT_EQ(2.5f, floatValue);
+  EXPECT_TRUE(diff->findDouble("changedDouble", &doubleValue));
+  EXPECT_EQ(0.1, doubleValue);
+  EXPECT_TRUE(diff->findFloat("retyped", &floatValue));
+  EXPECT_EQ(4.0f, floatValue);
+  EXPECT_TRUE(diff->findFloat("added", &floatValue));
+  EXPECT_EQ(5.0f, floatValue);
+  EXPECT_FALSE(diff->contains("sameFloat"));
+  EXPECT_FALSE(diff->contains("sameDouble"));
+
+  EXPECT_EQ(0u, msg->changesFrom(msg->dup())->countEntries());
+}
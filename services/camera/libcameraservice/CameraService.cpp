@@ -81,6 +81,7 @@
 #include "utils/TagMonitor.h"
 #include "utils/CameraThreadState.h"
 #include "utils/CameraServiceProxyWrapper.h"
+#include "utils/SessionStatsBuilder.h"
 
 namespace {
     const char* kPermissionServiceName = "permission";
@@ -3785,6 +3786,10 @@ status_t CameraService::BasicClient::dumpWatchedEventsToVector(std::vector<std::
     return OK;
 }
 
+void CameraService::BasicClient::dumpLatencyStats(int) {
+    // No capture pipeline latency is tracked by default
+}
+
 String16 CameraService::BasicClient::getPackageName() const {
     return mClientPackageName;
 }
@@ -4863,6 +4868,16 @@ status_t CameraService::dump(int fd, const Vector<String16>& args) {
         if (locked) mServiceLock.unlock();
         return NO_ERROR;
     }
+
+    // The latency dump is meant for tools, so it only contains the latency table
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == String16("--latency")) {
+            dumpLatencyStats(fd);
+            if (locked) mServiceLock.unlock();
+            return NO_ERROR;
+        }
+    }
+
     dprintf(fd, "\n== Service global info: ==\n\n");
     dprintf(fd, "Number of camera devices: %d\n", mNumberOfCameras);
     dprintf(fd, "Number of normal camera devices: %zu\n", mNormalDeviceIds.size());
@@ -5017,6 +5032,18 @@ void CameraService::dumpOpenSessionClientLogs(int fd,
     client->dumpClient(fd, args);
 }
 
+void CameraService::dumpLatencyStats(int fd) {
+    dprintf(fd, "%s\n", SessionStatsBuilder::kLatencyStatsHeader);
+    for (auto& i : mActiveClientManager.getAll()) {
+        auto clientSp = i->getValue();
+        if (clientSp.get() == nullptr) {
+            ALOGE("%s: Dead client still in mActiveClientManager.", __FUNCTION__);
+            continue;
+        }
+        clientSp->dumpLatencyStats(fd);
+    }
+}
+
 void CameraService::dumpClosedSessionClientLogs(int fd, const String8& cameraId) {
     dprintf(fd, "  Device %s is closed, no client instance\n",
                     cameraId.string());
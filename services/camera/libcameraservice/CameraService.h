@@ -321,6 +321,8 @@ public:
         virtual status_t startWatchingTags(const String8 &tags, int outFd);
         virtual status_t stopWatchingTags(int outFd);
         virtual status_t dumpWatchedEventsToVector(std::vector<std::string> &out);
+        // Dump the capture pipeline stage latencies for 'dumpsys media.camera --latency'
+        virtual void dumpLatencyStats(int fd);
 
         // Return the package name for this client
         virtual String16 getPackageName() const;
@@ -945,6 +947,10 @@ private:
     // Adds client logs during closed session to the file pointed by fd.
     void dumpClosedSessionClientLogs(int fd, const String8& cameraId);
 
+    // Adds the capture pipeline stage latencies of the open sessions to the file
+    // pointed by fd, as comma separated values.
+    void dumpLatencyStats(int fd);
+
     // Mapping from camera ID -> state for each device, map is protected by mCameraStatesLock
     std::map<String8, std::shared_ptr<CameraState>> mCameraStates;
 
@@ -1960,6 +1960,12 @@ status_t CameraDeviceClient::dumpClient(int fd, const Vector<String16>& args) {
     } else {
         dprintf(fd, "      No output streams configured.\n");
     }
+    {
+        Mutex::Autolock l(mCompositeLock);
+        for (size_t i = 0; i < mCompositeStreamMap.size(); i++) {
+            mCompositeStreamMap.valueAt(i)->dump(fd);
+        }
+    }
     // TODO: print dynamic/request section from most recent requests
     mFrameProcessor->dump(fd, args);
 
@@ -168,6 +168,14 @@ void CompositeStream::flagAnErrorFrameNumber(int64_t frameNumber) {
     mInputReadyCondition.signal();
 }
 
+void CompositeStream::addProcessingLatency(nsecs_t start, nsecs_t end) {
+    sp<CameraDeviceBase> device = mDevice.promote();
+    if (device.get() != nullptr) {
+        device->addStageLatency(hardware::CameraLatencyStats::LATENCY_STAGE_COMPOSITE_STREAM,
+                start, end);
+    }
+}
+
 status_t CompositeStream::registerCompositeStreamListener(int32_t streamId) {
     sp<CameraDeviceBase> device = mDevice.promote();
     if (device.get() == nullptr) {
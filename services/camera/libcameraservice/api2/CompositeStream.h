@@ -86,6 +86,9 @@ public:
     // Get composite stream stats
     virtual void getStreamStats(hardware::CameraStreamStats* streamStats /*out*/) = 0;
 
+    // Dump composite stream state for dumpsys
+    virtual void dump(int /*fd*/) {}
+
     void onResultAvailable(const CaptureResult& result);
     bool onError(int32_t errorCode, const CaptureResultExtras& resultExtras);
 
@@ -122,6 +125,9 @@ protected:
     // Composite streams should behave accordingly.
     void enableErrorState();
 
+    // Record the time spent producing one output image in the session statistics.
+    void addProcessingLatency(nsecs_t start, nsecs_t end);
+
     wp<CameraDeviceBase>   mDevice;
     wp<camera3::StatusTracker> mStatusTracker;
     wp<hardware::camera2::ICameraDeviceCallbacks> mRemoteCallback;
@@ -313,6 +313,7 @@ void HeicCompositeStream::onBufferRequestForFrameNumber(uint64_t frameNumber, in
     }
 
     mSettingsByFrameNumber[frameNumber] = {orientation, quality};
+    mSettingsByFrameNumber[frameNumber].requestTimeNs = systemTime();
 }
 
 void HeicCompositeStream::onFrameAvailable(const BufferItem& item) {
@@ -597,6 +598,7 @@ void HeicCompositeStream::compilePendingInputLocked() {
             mPendingInputFrames[i->first].quality = i->second.quality;
             mPendingInputFrames[i->first].timestamp = i->second.timestamp;
             mPendingInputFrames[i->first].requestId = i->second.requestId;
+            mPendingInputFrames[i->first].requestTimeNs = i->second.requestTimeNs;
             ALOGV("%s: [%" PRId64 "]: timestamp is %" PRId64, __FUNCTION__,
                     i->first, i->second.timestamp);
             i = mSettingsByFrameNumber.erase(i);
@@ -849,6 +851,10 @@ status_t HeicCompositeStream::processInputFrame(int64_t frameNumber,
     ATRACE_CALL();
     status_t res = OK;
 
+    if (inputFrame.processStartTimeNs == 0) {
+        inputFrame.processStartTimeNs = systemTime();
+    }
+
     bool appSegmentReady =
             (inputFrame.appSegmentBuffer.data != nullptr || inputFrame.exifError) &&
             !inputFrame.appSegmentWritten && inputFrame.result != nullptr &&
@@ -1198,12 +1204,46 @@ status_t HeicCompositeStream::processCompletedInputFrame(int64_t frameNumber,
     }
     inputFrame.anb = nullptr;
     mDequeuedOutputBufferCnt--;
+    updateLatencyStats(inputFrame.requestTimeNs);
+    addProcessingLatency(inputFrame.processStartTimeNs, systemTime());
 
     ALOGV("%s: [%" PRId64 "]", __FUNCTION__, frameNumber);
     ATRACE_ASYNC_END("HEIC capture", frameNumber);
     return OK;
 }
 
+void HeicCompositeStream::updateLatencyStats(nsecs_t requestTimeNs) {
+    Mutex::Autolock l(mLatencyLock);
+    nsecs_t now = systemTime();
+    if (requestTimeNs > 0) {
+        mCaptureLatency.add(now - requestTimeNs);
+    }
+    // Only captures requested before the previous output was done are back to back, otherwise
+    // the interval measures the time between the user's shots rather than the stream.
+    if (mLastOutputTimeNs > 0 && requestTimeNs > 0 && requestTimeNs < mLastOutputTimeNs) {
+        mShotToShotLatency.add(now - mLastOutputTimeNs);
+    }
+    mLastOutputTimeNs = now;
+}
+
+void HeicCompositeStream::dump(int fd) {
+    Mutex::Autolock l(mLatencyLock);
+    dprintf(fd, "      HEIC composite stream %d: %s, %zu tiles in a %zux%zu grid\n",
+            getStreamId(), mUseHeic ? "HEIC encoder" : "HEVC encoder", mNumOutputTiles,
+            mGridCols, mGridRows);
+    const LatencyStats* stats[] = {&mCaptureLatency, &mShotToShotLatency};
+    const char* names[] = {"Request to output", "Back-to-back shot to shot"};
+    for (size_t i = 0; i < 2; i++) {
+        if (stats[i]->count == 0) {
+            continue;
+        }
+        dprintf(fd, "        %s latency: %" PRId64 " captures, last %" PRId64 " ms, avg %" PRId64
+                " ms, max %" PRId64 " ms\n", names[i], stats[i]->count,
+                ns2ms(stats[i]->lastNs), ns2ms(stats[i]->totalNs / stats[i]->count),
+                ns2ms(stats[i]->maxNs));
+    }
+}
+
 
 void HeicCompositeStream::releaseInputFrameLocked(int64_t frameNumber,
         InputFrame *inputFrame /*out*/) {
@@ -1590,9 +1630,35 @@ status_t HeicCompositeStream::copyOneYuvTile(sp<MediaCodecBuffer>& codecBuffer,
                     imageInfo->mPlane[MediaImage2::V].mRowInc * (row - top/2);
             mFnCopyRow(yuvBuffer.dataCr+row*yuvBuffer.chromaStride+left/2, dst, width/2);
         }
+    } else if (isCodecUvPlannar && yuvBuffer.chromaStep == 2) {
+        // Camera UV semiplannar, codec UV plannar: split the interleaved
+        // chroma rows into the two planes.
+        const uint8_t *src = std::min(yuvBuffer.dataCb, yuvBuffer.dataCr) +
+                top/2*yuvBuffer.chromaStride + left;
+        uint8_t *dstU = codecBuffer->data() + imageInfo->mPlane[MediaImage2::U].mOffset;
+        uint8_t *dstV = codecBuffer->data() + imageInfo->mPlane[MediaImage2::V].mOffset;
+        libyuv::SplitUVPlane(src, yuvBuffer.chromaStride,
+                cameraUPlaneFirst ? dstU : dstV,
+                cameraUPlaneFirst ? imageInfo->mPlane[MediaImage2::U].mRowInc :
+                        imageInfo->mPlane[MediaImage2::V].mRowInc,
+                cameraUPlaneFirst ? dstV : dstU,
+                cameraUPlaneFirst ? imageInfo->mPlane[MediaImage2::V].mRowInc :
+                        imageInfo->mPlane[MediaImage2::U].mRowInc,
+                width/2, (top+height)/2 - top/2);
+    } else if (isCodecUvSemiplannar && yuvBuffer.chromaStep == 1) {
+        // Camera UV plannar, codec UV semiplannar: interleave the two chroma
+        // planes.
+        const uint8_t *srcU = yuvBuffer.dataCb + top/2*yuvBuffer.chromaStride + left/2;
+        const uint8_t *srcV = yuvBuffer.dataCr + top/2*yuvBuffer.chromaStride + left/2;
+        uint8_t *dst = codecBuffer->data() + std::min(imageInfo->mPlane[MediaImage2::U].mOffset,
+                imageInfo->mPlane[MediaImage2::V].mOffset);
+        libyuv::MergeUVPlane(codecUPlaneFirst ? srcU : srcV, yuvBuffer.chromaStride,
+                codecUPlaneFirst ? srcV : srcU, yuvBuffer.chromaStride,
+                dst, imageInfo->mPlane[MediaImage2::U].mRowInc,
+                width/2, (top+height)/2 - top/2);
     } else {
-        // Convert between semiplannar and plannar, or when UV orders are
-        // different.
+        // Convert between semiplannar and plannar when the layouts are not
+        // covered above, or when UV orders are different.
         uint8_t *dst = codecBuffer->data();
         for (auto row = top/2; row < (top+height)/2; row++) {
             for (auto col = left/2; col < (left+width)/2; col++) {
@@ -17,6 +17,7 @@
 #ifndef ANDROID_SERVERS_CAMERA_CAMERA3_HEIC_COMPOSITE_STREAM_H
 #define ANDROID_SERVERS_CAMERA_CAMERA3_HEIC_COMPOSITE_STREAM_H
 
+#include <algorithm>
 #include <queue>
 
 #include <gui/IProducerListener.h>
@@ -78,6 +79,8 @@ public:
     // Get composite stream stats
     void getStreamStats(hardware::CameraStreamStats*) override {};
 
+    void dump(int fd) override;
+
     static bool isSizeSupportedByHeifEncoder(int32_t width, int32_t height,
             bool* useHeic, bool* useGrid, int64_t* stall, AString* hevcName = nullptr);
     static bool isInMemoryTempFileSupported();
@@ -166,6 +169,8 @@ private:
         bool                      exifError; // Exif/APP_SEGMENT buffer error
         int64_t                   timestamp;
         int32_t                   requestId;
+        nsecs_t                   requestTimeNs; // systemTime of the capture request
+        nsecs_t                   processStartTimeNs; // systemTime the processing started
 
         sp<AMessage>              format;
         sp<MediaMuxer>            muxer;
@@ -179,7 +184,8 @@ private:
         size_t                    codecInputCounter;
 
         InputFrame() : orientation(0), quality(kDefaultJpegQuality), error(false),
-                       exifError(false), timestamp(-1), requestId(-1), fenceFd(-1),
+                       exifError(false), timestamp(-1), requestId(-1), requestTimeNs(0),
+                       processStartTimeNs(0), fenceFd(-1),
                        fileFd(-1), trackIndex(-1), anb(nullptr), appSegmentWritten(false),
                        pendingOutputTiles(0), codecInputCounter(0) { }
     };
@@ -245,13 +251,14 @@ private:
         int64_t timestamp;
         int32_t requestId;
         bool shutterNotified;
+        nsecs_t requestTimeNs;
 
         HeicSettings() : orientation(0), quality(95), timestamp(0),
-                requestId(-1), shutterNotified(false) {}
+                requestId(-1), shutterNotified(false), requestTimeNs(0) {}
         HeicSettings(int32_t _orientation, int32_t _quality) :
                 orientation(_orientation),
                 quality(_quality), timestamp(0),
-                requestId(-1), shutterNotified(false) {}
+                requestId(-1), shutterNotified(false), requestTimeNs(0) {}
 
     };
     std::map<int64_t, HeicSettings> mSettingsByFrameNumber;
@@ -286,6 +293,28 @@ private:
     // The status id for tracking the active/idle status of this composite stream
     int mStatusId;
     void markTrackerIdle();
+
+    // Capture latency statistics reported by dump
+    struct LatencyStats {
+        int64_t count = 0;
+        nsecs_t totalNs = 0;
+        nsecs_t maxNs = 0;
+        nsecs_t lastNs = 0;
+
+        void add(nsecs_t latencyNs) {
+            count++;
+            totalNs += latencyNs;
+            maxNs = std::max(maxNs, latencyNs);
+            lastNs = latencyNs;
+        }
+    };
+    Mutex mLatencyLock;
+    // From the capture request to the HEIC output being queued
+    LatencyStats mCaptureLatency;
+    // Between the outputs of back-to-back captures
+    LatencyStats mShotToShotLatency;
+    nsecs_t mLastOutputTimeNs = 0;
+    void updateLatencyStats(nsecs_t requestTimeNs);
 };
 
 }; // namespace camera3
@@ -480,7 +480,11 @@ bool JpegRCompositeStream::threadLoop() {
         }
     }
 
+    nsecs_t processStartTime = systemTime();
     auto res = processInputFrame(currentTs, mPendingInputFrames[currentTs]);
+    if (res == OK) {
+        addProcessingLatency(processStartTime, systemTime());
+    }
     Mutex::Autolock l(mMutex);
     if (res != OK) {
         ALOGE("%s: Failed processing frame with timestamp: %" PRIu64 ": %s (%d)", __FUNCTION__,
@@ -237,6 +237,16 @@ status_t Camera2ClientBase<TClientBase>::dumpWatchedEventsToVector(std::vector<s
     return device->dumpWatchedEventsToVector(out);
 }
 
+template <typename TClientBase>
+void Camera2ClientBase<TClientBase>::dumpLatencyStats(int fd) {
+    sp<CameraDeviceBase> device = mDevice;
+    if (!device) {
+        // Nothing to dump if the device is detached
+        return;
+    }
+    device->dumpLatencyStats(fd);
+}
+
 template <typename TClientBase>
 status_t Camera2ClientBase<TClientBase>::dumpDevice(
                                                 int fd,
@@ -70,6 +70,7 @@ public:
     virtual status_t      startWatchingTags(const String8 &tags, int out);
     virtual status_t      stopWatchingTags(int out);
     virtual status_t      dumpWatchedEventsToVector(std::vector<std::string> &out);
+    virtual void          dumpLatencyStats(int fd);
 
     /**
      * NotificationListener implementation
@@ -29,6 +29,7 @@
 
 #include "hardware/camera2.h"
 #include "camera/CameraMetadata.h"
+#include "camera/CameraSessionStats.h"
 #include "camera/CaptureResult.h"
 #include "gui/IGraphicBufferProducer.h"
 #include "device3/Camera3StreamInterface.h"
@@ -107,6 +108,19 @@ class CameraDeviceBase : public virtual FrameProducer {
     virtual status_t stopWatchingTags() = 0;
     virtual status_t dumpWatchedEventsToVector(std::vector<std::string> &out) = 0;
 
+    /**
+     * Dump the latency of the capture pipeline stages in machine-readable form,
+     * one line per stage.
+     */
+    virtual void dumpLatencyStats(int fd) = 0;
+
+    /**
+     * Record the latency of a capture pipeline stage running outside of the
+     * device, such as the processing of a composite stream.
+     */
+    virtual void addStageLatency(hardware::CameraLatencyStats::LatencyStage stage,
+            nsecs_t start, nsecs_t end) = 0;
+
     /**
      * The physical camera device's static characteristics metadata buffer, or
      * the logical camera's static characteristics if physical id is empty.
@@ -2543,6 +2543,38 @@ void CameraProviderManager::ProviderInfo::DeviceInfo3::notifyDeviceStateChange(i
                 &mDeviceStateOrientationMap[newState], 1);
         }
     }
+
+    std::lock_guard<std::mutex> lock(mStreamCombinationCacheLock);
+    mStreamCombinationCache.clear();
+}
+
+bool CameraProviderManager::ProviderInfo::DeviceInfo3::getCachedStreamCombinationSupport(
+        const std::string& key, bool *status /*out*/) {
+    std::lock_guard<std::mutex> lock(mStreamCombinationCacheLock);
+    for (auto it = mStreamCombinationCache.begin(); it != mStreamCombinationCache.end(); it++) {
+        if (it->first == key) {
+            *status = it->second;
+            mStreamCombinationCache.splice(mStreamCombinationCache.begin(),
+                    mStreamCombinationCache, it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void CameraProviderManager::ProviderInfo::DeviceInfo3::cacheStreamCombinationSupport(
+        const std::string& key, bool status) {
+    std::lock_guard<std::mutex> lock(mStreamCombinationCacheLock);
+    for (auto it = mStreamCombinationCache.begin(); it != mStreamCombinationCache.end(); it++) {
+        if (it->first == key) {
+            mStreamCombinationCache.erase(it);
+            break;
+        }
+    }
+    mStreamCombinationCache.emplace_front(key, status);
+    if (mStreamCombinationCache.size() > kMaxStreamCombinationCacheSize) {
+        mStreamCombinationCache.pop_back();
+    }
 }
 
 status_t CameraProviderManager::ProviderInfo::DeviceInfo3::getCameraInfo(
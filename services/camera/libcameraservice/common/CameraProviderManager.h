@@ -17,6 +17,7 @@
 #ifndef ANDROID_SERVERS_CAMERA_CAMERAPROVIDER_H
 #define ANDROID_SERVERS_CAMERA_CAMERAPROVIDER_H
 
+#include <list>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -678,6 +679,16 @@ private:
             // Only contains characteristics for hidden physical cameras,
             // not for public physical cameras.
             std::unordered_map<std::string, CameraMetadata> mPhysicalCameraCharacteristics;
+
+            // Results of stream combination queries already answered by the HAL, keyed on
+            // the canonical string form of the HAL stream configuration, most recently used
+            // first. Cleared on device state changes.
+            static const size_t kMaxStreamCombinationCacheSize = 32;
+            std::mutex mStreamCombinationCacheLock;
+            std::list<std::pair<std::string, bool>> mStreamCombinationCache;
+            bool getCachedStreamCombinationSupport(const std::string& key, bool *status /*out*/);
+            void cacheStreamCombinationSupport(const std::string& key, bool status);
+
             void queryPhysicalCameraIds();
             SystemCameraKind getSystemCameraKind();
             status_t fixupMonochromeTags();
@@ -35,7 +35,10 @@
 #include <libexif/exif-data.h>
 #include <libexif/exif-system.h>
 #include <math.h>
+#include <algorithm>
+#include <future>
 #include <sstream>
+#include <vector>
 #include <utils/Errors.h>
 #include <utils/ExifUtils.h>
 #include <utils/Log.h>
@@ -239,100 +242,123 @@ status_t encodeGrayscaleJpeg(size_t width, size_t height, uint8_t *in, void *out
     return ret;
 }
 
-inline void unpackDepth16(uint16_t value, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    // Android densely packed depth map. The units for the range are in
-    // millimeters and need to be scaled to meters.
-    // The confidence value is encoded in the 3 most significant bits.
-    // The confidence data needs to be additionally normalized with
-    // values 1.0f, 0.0f representing maximum and minimum confidence
-    // respectively.
-    auto point = static_cast<float>(value & 0x1FFF) / 1000.f;
-    points->push_back(point);
-
-    auto conf = (value >> 13) & 0x7;
-    float normConfidence = (conf == 0) ? 1.f : (static_cast<float>(conf) - 1) / 7.f;
-    confidence->push_back(normConfidence);
-    if (normConfidence < CONFIDENCE_THRESHOLD) {
-        return;
-    }
-
-    if (*near > point) {
-        *near = point;
-    }
-    if (*far < point) {
-        *far = point;
-    }
+// Android densely packed depth map. The units for the range are in
+// millimeters and need to be scaled to meters.
+// The confidence value is encoded in the 3 most significant bits.
+// The confidence data needs to be additionally normalized with
+// values 1.0f, 0.0f representing maximum and minimum confidence
+// respectively.
+static const uint16_t DEPTH16_RANGE_MASK = 0x1FFF;
+static const size_t DEPTH16_RANGE_COUNT = DEPTH16_RANGE_MASK + 1;
+static const size_t DEPTH16_CONFIDENCE_SHIFT = 13;
+static const size_t DEPTH16_CONFIDENCE_COUNT = 8;
+
+inline float normalizeDepth16Confidence(uint16_t conf) {
+    return (conf == 0) ? 1.f : (static_cast<float>(conf) - 1) / 7.f;
 }
 
-// Trivial case, read forward from top,left corner.
-void rotate0AndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    for (size_t i = 0; i < inputFrame.mDepthMapHeight; i++) {
-        for (size_t j = 0; j < inputFrame.mDepthMapWidth; j++) {
-            unpackDepth16(inputFrame.mDepthMapBuffer[i*inputFrame.mDepthMapStride + j], points,
-                    confidence, near, far);
-        }
-    }
-}
+// Describes how the source depth map is walked to produce an output map with
+// the requested rotation applied: output row 'r' and column 'c' are read from
+// mDepthMapBuffer[mOffset + r * mRowStep + c * mColumnStep].
+struct DepthMapWalk {
+    ssize_t mOffset, mRowStep, mColumnStep;
+    size_t mWidth, mHeight;
+    bool mSwitchDimensions;
+};
 
-// 90 degrees CW rotation can be applied by starting to read from bottom, left corner
-// transposing rows and columns.
-void rotate90AndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    for (size_t i = 0; i < inputFrame.mDepthMapWidth; i++) {
-        for (ssize_t j = inputFrame.mDepthMapHeight-1; j >= 0; j--) {
-            unpackDepth16(inputFrame.mDepthMapBuffer[j*inputFrame.mDepthMapStride + i], points,
-                    confidence, near, far);
-        }
+DepthMapWalk getDepthMapWalk(const DepthPhotoInputFrame &inputFrame,
+        DepthPhotoOrientation orientation) {
+    ssize_t width = inputFrame.mDepthMapWidth;
+    ssize_t height = inputFrame.mDepthMapHeight;
+    ssize_t stride = inputFrame.mDepthMapStride;
+    switch (orientation) {
+        case DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES:
+            // Trivial case, read forward from top,left corner.
+            break;
+        case DepthPhotoOrientation::DEPTH_ORIENTATION_90_DEGREES:
+            // 90 degrees CW rotation can be applied by starting to read from bottom, left corner
+            // transposing rows and columns.
+            return {(height - 1) * stride, 1, -stride,
+                    inputFrame.mDepthMapHeight, inputFrame.mDepthMapWidth, true};
+        case DepthPhotoOrientation::DEPTH_ORIENTATION_180_DEGREES:
+            // 180 CW degrees rotation can be applied by starting to read backwards from bottom,
+            // right corner.
+            return {(height - 1) * stride + width - 1, -stride, -1,
+                    inputFrame.mDepthMapWidth, inputFrame.mDepthMapHeight, false};
+        case DepthPhotoOrientation::DEPTH_ORIENTATION_270_DEGREES:
+            // 270 degrees CW rotation can be applied by starting to read from top, right corner
+            // transposing rows and columns.
+            return {width - 1, -1, stride,
+                    inputFrame.mDepthMapHeight, inputFrame.mDepthMapWidth, true};
+        default:
+            ALOGE("%s: Unsupported depth photo rotation: %d, default to 0", __FUNCTION__,
+                    orientation);
     }
+
+    return {0, stride, 1, inputFrame.mDepthMapWidth, inputFrame.mDepthMapHeight, false};
 }
 
-// 180 CW degrees rotation can be applied by starting to read backwards from bottom, right corner.
-void rotate180AndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    for (ssize_t i = inputFrame.mDepthMapHeight-1; i >= 0; i--) {
-        for (ssize_t j = inputFrame.mDepthMapWidth-1; j >= 0; j--) {
-            unpackDepth16(inputFrame.mDepthMapBuffer[i*inputFrame.mDepthMapStride + j], points,
-                    confidence, near, far);
+// Finds the near/far range of all depth samples with sufficient confidence.
+// The scan is orientation independent and reduces the raw 13-bit ranges, which
+// keeps the inner loop free of branches and float conversions.
+void findDepthRange(const DepthPhotoInputFrame &inputFrame, float *near /*out*/,
+        float *far /*out*/) {
+    uint8_t confidentMask = 0;
+    for (uint16_t conf = 0; conf < DEPTH16_CONFIDENCE_COUNT; conf++) {
+        if (normalizeDepth16Confidence(conf) >= CONFIDENCE_THRESHOLD) {
+            confidentMask |= 1 << conf;
         }
     }
-}
 
-// 270 degrees CW rotation can be applied by starting to read from top, right corner
-// transposing rows and columns.
-void rotate270AndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    for (ssize_t i = inputFrame.mDepthMapWidth-1; i >= 0; i--) {
-        for (size_t j = 0; j < inputFrame.mDepthMapHeight; j++) {
-            unpackDepth16(inputFrame.mDepthMapBuffer[j*inputFrame.mDepthMapStride + i], points,
-                    confidence, near, far);
+    uint16_t minRange = UINT16_MAX;
+    uint16_t maxRange = 0;
+    for (size_t i = 0; i < inputFrame.mDepthMapHeight; i++) {
+        const uint16_t *row = inputFrame.mDepthMapBuffer + i * inputFrame.mDepthMapStride;
+        for (size_t j = 0; j < inputFrame.mDepthMapWidth; j++) {
+            uint16_t value = row[j];
+            uint16_t range = value & DEPTH16_RANGE_MASK;
+            bool confident = (confidentMask >> (value >> DEPTH16_CONFIDENCE_SHIFT)) & 1;
+            minRange = std::min<uint16_t>(minRange, confident ? range : UINT16_MAX);
+            maxRange = std::max<uint16_t>(maxRange, confident ? range : 0);
         }
     }
+
+    // Scaling to meters is monotonic, so it can be applied after the reduction.
+    *near = (minRange == UINT16_MAX) ? UINT16_MAX : static_cast<float>(minRange) / 1000.f;
+    *far = static_cast<float>(maxRange) / 1000.f;
 }
 
-bool rotateAndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    switch (inputFrame.mOrientation) {
-        case DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES:
-            rotate0AndUnpack(inputFrame, points, confidence, near, far);
-            return false;
-        case DepthPhotoOrientation::DEPTH_ORIENTATION_90_DEGREES:
-            rotate90AndUnpack(inputFrame, points, confidence, near, far);
-            return true;
-        case DepthPhotoOrientation::DEPTH_ORIENTATION_180_DEGREES:
-            rotate180AndUnpack(inputFrame, points, confidence, near, far);
-            return false;
-        case DepthPhotoOrientation::DEPTH_ORIENTATION_270_DEGREES:
-            rotate270AndUnpack(inputFrame, points, confidence, near, far);
-            return true;
-        default:
-            ALOGE("%s: Unsupported depth photo rotation: %d, default to 0", __FUNCTION__,
-                    inputFrame.mOrientation);
-            rotate0AndUnpack(inputFrame, points, confidence, near, far);
+// Rotates and quantizes the depth map in a single pass. The range inverse coding
+// only depends on the 13-bit range, and the normalized confidence only on the
+// 3-bit confidence, so both are evaluated once per possible value up front and
+// the per-sample work reduces to two table lookups.
+void rotateAndQuantize(const DepthPhotoInputFrame &inputFrame, const DepthMapWalk &walk,
+        float near, float far, uint8_t *pointsQuantized /*out*/,
+        uint8_t *confidenceQuantized /*out*/) {
+    uint8_t pointTable[DEPTH16_RANGE_COUNT];
+    for (size_t range = 0; range < DEPTH16_RANGE_COUNT; range++) {
+        // Samples with sufficient confidence are always within [near, far],
+        // so clamping only affects low confidence samples.
+        auto point = std::clamp(static_cast<float>(range) / 1000.f, near, far);
+        pointTable[range] = static_cast<uint8_t>(floorf(((far * (point - near)) /
+                (point * (far - near))) * 255.0f));
+    }
+    uint8_t confidenceTable[DEPTH16_CONFIDENCE_COUNT];
+    for (uint16_t conf = 0; conf < DEPTH16_CONFIDENCE_COUNT; conf++) {
+        confidenceTable[conf] = static_cast<uint8_t>(floorf(
+                normalizeDepth16Confidence(conf) * 255.0f));
     }
 
-    return false;
+    for (size_t r = 0; r < walk.mHeight; r++) {
+        const uint16_t *src = inputFrame.mDepthMapBuffer + walk.mOffset + r * walk.mRowStep;
+        uint8_t *pointRow = pointsQuantized + r * walk.mWidth;
+        uint8_t *confidenceRow = confidenceQuantized + r * walk.mWidth;
+        for (size_t c = 0; c < walk.mWidth; c++) {
+            uint16_t value = src[static_cast<ssize_t>(c) * walk.mColumnStep];
+            pointRow[c] = pointTable[value & DEPTH16_RANGE_MASK];
+            confidenceRow[c] = confidenceTable[value >> DEPTH16_CONFIDENCE_SHIFT];
+        }
+    }
 }
 
 std::unique_ptr<dynamic_depth::DepthMap> processDepthMapFrame(DepthPhotoInputFrame inputFrame,
@@ -342,49 +368,29 @@ std::unique_ptr<dynamic_depth::DepthMap> processDepthMapFrame(DepthPhotoInputFra
         return nullptr;
     }
 
-    std::vector<float> points, confidence;
-
-    size_t pointCount = inputFrame.mDepthMapWidth * inputFrame.mDepthMapHeight;
-    points.reserve(pointCount);
-    confidence.reserve(pointCount);
-    float near = UINT16_MAX;
-    float far = .0f;
-    *switchDimensions = false;
     // Physical rotation of depth and confidence maps may be needed in case
     // the EXIF orientation is set to 0 degrees and the depth photo orientation
     // (source color image) has some different value.
+    auto orientation = DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES;
     if (exifOrientation == ExifOrientation::ORIENTATION_0_DEGREES) {
-        *switchDimensions = rotateAndUnpack(inputFrame, &points, &confidence, &near, &far);
-    } else {
-        rotate0AndUnpack(inputFrame, &points, &confidence, &near, &far);
-    }
-
-    size_t width = inputFrame.mDepthMapWidth;
-    size_t height = inputFrame.mDepthMapHeight;
-    if (*switchDimensions) {
-        width = inputFrame.mDepthMapHeight;
-        height = inputFrame.mDepthMapWidth;
+        orientation = inputFrame.mOrientation;
     }
+    auto walk = getDepthMapWalk(inputFrame, orientation);
+    *switchDimensions = walk.mSwitchDimensions;
+    size_t width = walk.mWidth;
+    size_t height = walk.mHeight;
 
+    float near, far;
+    findDepthRange(inputFrame, &near, &far);
     if (near == far) {
         ALOGE("%s: Near and far range values must not match!", __FUNCTION__);
         return nullptr;
     }
 
-    std::vector<uint8_t> pointsQuantized, confidenceQuantized;
-    pointsQuantized.reserve(pointCount); confidenceQuantized.reserve(pointCount);
-    auto pointIt = points.begin();
-    auto confidenceIt = confidence.begin();
-    while ((pointIt != points.end()) && (confidenceIt != confidence.end())) {
-        auto point = *pointIt;
-        if ((*confidenceIt) < CONFIDENCE_THRESHOLD) {
-            point = std::clamp(point, near, far);
-        }
-        pointsQuantized.push_back(floorf(((far * (point - near)) /
-                (point * (far - near))) * 255.0f));
-        confidenceQuantized.push_back(floorf(*confidenceIt * 255.0f));
-        confidenceIt++; pointIt++;
-    }
+    size_t pointCount = inputFrame.mDepthMapWidth * inputFrame.mDepthMapHeight;
+    std::vector<uint8_t> pointsQuantized(pointCount), confidenceQuantized(pointCount);
+    rotateAndQuantize(inputFrame, walk, near, far, pointsQuantized.data(),
+            confidenceQuantized.data());
 
     DepthMapParams depthParams(DepthFormat::kRangeInverse, near, far, DepthUnits::kMeters,
             "android/depthmap");
@@ -392,24 +398,31 @@ std::unique_ptr<dynamic_depth::DepthMap> processDepthMapFrame(DepthPhotoInputFra
     depthParams.mime = "image/jpeg";
     depthParams.depth_image_data.resize(inputFrame.mMaxJpegSize);
     depthParams.confidence_data.resize(inputFrame.mMaxJpegSize);
-    size_t actualJpegSize;
+
+    // The depth and confidence maps are independent and can be compressed in parallel.
+    size_t confidenceJpegSize = 0;
+    auto confidenceRet = std::async(std::launch::async, [&]() {
+        return encodeGrayscaleJpeg(width, height, confidenceQuantized.data(),
+                depthParams.confidence_data.data(), inputFrame.mMaxJpegSize,
+                inputFrame.mJpegQuality, exifOrientation, confidenceJpegSize);
+    });
+
+    size_t depthJpegSize = 0;
     auto ret = encodeGrayscaleJpeg(width, height, pointsQuantized.data(),
             depthParams.depth_image_data.data(), inputFrame.mMaxJpegSize,
-            inputFrame.mJpegQuality, exifOrientation, actualJpegSize);
+            inputFrame.mJpegQuality, exifOrientation, depthJpegSize);
+    auto confidenceStatus = confidenceRet.get();
     if (ret != NO_ERROR) {
         ALOGE("%s: Depth map compression failed!", __FUNCTION__);
         return nullptr;
     }
-    depthParams.depth_image_data.resize(actualJpegSize);
+    depthParams.depth_image_data.resize(depthJpegSize);
 
-    ret = encodeGrayscaleJpeg(width, height, confidenceQuantized.data(),
-            depthParams.confidence_data.data(), inputFrame.mMaxJpegSize,
-            inputFrame.mJpegQuality, exifOrientation, actualJpegSize);
-    if (ret != NO_ERROR) {
+    if (confidenceStatus != NO_ERROR) {
         ALOGE("%s: Confidence map compression failed!", __FUNCTION__);
         return nullptr;
     }
-    depthParams.confidence_data.resize(actualJpegSize);
+    depthParams.confidence_data.resize(confidenceJpegSize);
 
     return DepthMap::FromData(depthParams, items);
 }
@@ -747,6 +747,13 @@ status_t AidlProviderInfo::AidlDeviceInfo3::isSessionConfigurationSupported(
         return OK;
     }
 
+    // The HAL stream configuration carries the session parameters, so identical
+    // queries map to identical keys.
+    std::string cacheKey = streamConfiguration.toString();
+    if (getCachedStreamCombinationSupport(cacheKey, status)) {
+        return OK;
+    }
+
     const std::shared_ptr<camera::device::ICameraDevice> interface =
             startDeviceInterface();
 
@@ -761,6 +768,7 @@ status_t AidlProviderInfo::AidlDeviceInfo3::isSessionConfigurationSupported(
         ALOGE("%s: Unexpected binder error: %s", __FUNCTION__, ret.getMessage());
         return mapToStatusT(ret);
     }
+    cacheStreamCombinationSupport(cacheKey, *status);
     return OK;
 
 }
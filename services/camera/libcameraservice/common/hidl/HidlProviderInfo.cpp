@@ -849,6 +849,11 @@ status_t HidlProviderInfo::HidlDeviceInfo3::isSessionConfigurationSupported(
         return OK;
     }
 
+    std::string cacheKey = hardware::camera::device::V3_7::toString(configuration_3_7);
+    if (getCachedStreamCombinationSupport(cacheKey, status)) {
+        return OK;
+    }
+
     const sp<hardware::camera::device::V3_2::ICameraDevice> interface =
             startDeviceInterface();
 
@@ -901,6 +906,9 @@ status_t HidlProviderInfo::HidlDeviceInfo3::isSessionConfigurationSupported(
         res = UNKNOWN_ERROR;
     }
 
+    if (res == OK) {
+        cacheStreamCombinationSupport(cacheKey, *status);
+    }
     return res;
 }
 
@@ -33,6 +33,11 @@ Camera3BufferManager::Camera3BufferManager() {
 }
 
 Camera3BufferManager::~Camera3BufferManager() {
+    for (auto& pooledBuffer : mBufferPool) {
+        if (pooledBuffer.entry.fenceFd >= 0) {
+            close(pooledBuffer.entry.fenceFd);
+        }
+    }
 }
 
 status_t Camera3BufferManager::registerStream(wp<Camera3OutputStream>& stream,
@@ -201,8 +206,8 @@ status_t Camera3BufferManager::checkAndFreeBufferOnOtherStreamsLocked(
     }
 
 
-    // This will drop the reference to one free buffer, which will effectively free one
-    // buffer (from the free buffer list) for the inactive streams.
+    // This will move one free buffer of the inactive streams to the buffer pool, where it is
+    // either reused by another stream or freed once the pool grows too large.
     size_t totalAllocatedBufferCount = 0;
     for (size_t i = 0; i < streamSet.attachedBufferCountMap.size(); i++) {
         totalAllocatedBufferCount += streamSet.attachedBufferCountMap[i];
@@ -226,10 +231,14 @@ status_t Camera3BufferManager::checkAndFreeBufferOnOtherStreamsLocked(
         {
             mLock.unlock();
             sp<GraphicBuffer> buffer;
-            stream->detachBuffer(&buffer, /*fenceFd*/ nullptr);
+            int fenceFd = -1;
+            stream->detachBuffer(&buffer, &fenceFd);
             mLock.lock();
             if (buffer.get() != nullptr) {
                 bufferFreed = true;
+                returnBufferToPoolLocked(buffer, fenceFd);
+            } else if (fenceFd >= 0) {
+                close(fenceFd);
             }
         }
         if (bufferFreed) {
@@ -285,22 +294,30 @@ status_t Camera3BufferManager::getBufferForStream(int streamId, int streamSetId,
     if (mGrallocVersion < HARDWARE_DEVICE_API_VERSION(1,0)) {
         const StreamInfo& info = streamSet.streamInfoMap.valueFor(streamId);
         GraphicBufferEntry buffer;
-        buffer.fenceFd = -1;
-        buffer.graphicBuffer = new GraphicBuffer(
-                info.width, info.height, PixelFormat(info.format), info.combinedUsage,
-                std::string("Camera3BufferManager pid [") +
-                        std::to_string(getpid()) + "]");
-        status_t res = buffer.graphicBuffer->initCheck();
-
-        ALOGV("%s: allocating a new graphic buffer (%dx%d, format 0x%x) %p with handle %p",
-                __FUNCTION__, info.width, info.height, info.format,
-                buffer.graphicBuffer.get(), buffer.graphicBuffer->handle);
-        if (res < 0) {
-            ALOGE("%s: graphic buffer allocation failed: (error %d %s) ",
-                    __FUNCTION__, res, strerror(-res));
-            return res;
+        status_t res = OK;
+        if (takeBufferFromPoolLocked(info, &buffer)) {
+            ALOGV("%s: reusing a pooled graphic buffer (%dx%d, format 0x%x) %p with handle %p",
+                    __FUNCTION__, info.width, info.height, info.format,
+                    buffer.graphicBuffer.get(), buffer.graphicBuffer->handle);
+        } else {
+            buffer.fenceFd = -1;
+            buffer.graphicBuffer = new GraphicBuffer(
+                    info.width, info.height, PixelFormat(info.format), info.combinedUsage,
+                    std::string("Camera3BufferManager pid [") +
+                            std::to_string(getpid()) + "]");
+            res = buffer.graphicBuffer->initCheck();
+
+            ALOGV("%s: allocating a new graphic buffer (%dx%d, format 0x%x) %p with handle %p",
+                    __FUNCTION__, info.width, info.height, info.format,
+                    buffer.graphicBuffer.get(), buffer.graphicBuffer->handle);
+            if (res < 0) {
+                ALOGE("%s: graphic buffer allocation failed: (error %d %s) ",
+                        __FUNCTION__, res, strerror(-res));
+                return res;
+            }
+            mAllocatedBufferCount++;
+            ALOGV("%s: allocation done", __FUNCTION__);
         }
-        ALOGV("%s: allocation done", __FUNCTION__);
 
         // Increase the hand-out and attached buffer counts for tracking purposes.
         bufferCount++;
@@ -451,10 +468,100 @@ status_t Camera3BufferManager::onBuffersRemoved(int streamId, int streamSetId,
     return OK;
 }
 
+void Camera3BufferManager::returnBufferToPool(const sp<GraphicBuffer>& buffer, int fenceFd) {
+    ATRACE_CALL();
+    Mutex::Autolock l(mLock);
+    returnBufferToPoolLocked(buffer, fenceFd);
+}
+
+bool Camera3BufferManager::takeBufferFromPoolLocked(const StreamInfo& info,
+        GraphicBufferEntry* buffer) {
+    BufferPoolKey key = {info.width, info.height, info.format, info.combinedUsage};
+    // Prefer the most recently pooled buffer, which is the least likely to be evicted soon.
+    for (auto it = mBufferPool.rbegin(); it != mBufferPool.rend(); it++) {
+        if (it->key == key) {
+            *buffer = it->entry;
+            mPooledBufferBytes -= it->sizeBytes;
+            mBufferPool.erase(std::next(it).base());
+            mPoolReusedBufferCount++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Camera3BufferManager::returnBufferToPoolLocked(const sp<GraphicBuffer>& buffer,
+        int fenceFd) {
+    if (buffer == nullptr) {
+        if (fenceFd >= 0) {
+            close(fenceFd);
+        }
+        return;
+    }
+
+    PooledBuffer pooledBuffer;
+    pooledBuffer.key = {buffer->getWidth(), buffer->getHeight(),
+            static_cast<uint32_t>(buffer->getPixelFormat()), buffer->getUsage()};
+    pooledBuffer.entry = GraphicBufferEntry(buffer, fenceFd);
+    pooledBuffer.sizeBytes = getBufferSizeBytes(buffer->getWidth(), buffer->getHeight(),
+            buffer->getStride(), buffer->getPixelFormat());
+    mPooledBufferBytes += pooledBuffer.sizeBytes;
+    mBufferPool.push_back(pooledBuffer);
+    ALOGV("%s: pooled graphic buffer %p (%ux%u, format 0x%x), pool size now %zu bytes",
+            __FUNCTION__, buffer.get(), buffer->getWidth(), buffer->getHeight(),
+            buffer->getPixelFormat(), mPooledBufferBytes);
+
+    while (mPooledBufferBytes > kMaxPooledBufferBytes && !mBufferPool.empty()) {
+        PooledBuffer& oldest = mBufferPool.front();
+        ALOGV("%s: freeing pooled graphic buffer %p to stay within %zu bytes", __FUNCTION__,
+                oldest.entry.graphicBuffer.get(), kMaxPooledBufferBytes);
+        if (oldest.entry.fenceFd >= 0) {
+            close(oldest.entry.fenceFd);
+        }
+        mPooledBufferBytes -= oldest.sizeBytes;
+        mBufferPool.pop_front();
+        mPoolEvictedBufferCount++;
+    }
+}
+
+size_t Camera3BufferManager::getBufferSizeBytes(uint32_t width, uint32_t height,
+        uint32_t stride, int format) {
+    // Blob buffers are one dimensional, and the stride of the other formats is in pixels.
+    size_t pixelCount = static_cast<size_t>(std::max(width, stride)) * height;
+    switch (format) {
+        case HAL_PIXEL_FORMAT_BLOB:
+        case HAL_PIXEL_FORMAT_Y8:
+            return pixelCount;
+        case HAL_PIXEL_FORMAT_RAW10:
+            return pixelCount * 5 / 4;
+        case HAL_PIXEL_FORMAT_RAW16:
+        case HAL_PIXEL_FORMAT_Y16:
+        case HAL_PIXEL_FORMAT_YCBCR_422_888:
+        case HAL_PIXEL_FORMAT_YCBCR_422_SP:
+        case HAL_PIXEL_FORMAT_YCBCR_422_I:
+            return pixelCount * 2;
+        case HAL_PIXEL_FORMAT_YCBCR_P010:
+            return pixelCount * 3;
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+        case HAL_PIXEL_FORMAT_RGBA_1010102:
+            return pixelCount * 4;
+        default:
+            // YUV 4:2:0 formats, and implementation defined buffers, which are YUV 4:2:0 for
+            // most camera use cases.
+            return pixelCount * 3 / 2;
+    }
+}
+
 void Camera3BufferManager::dump(int fd, [[maybe_unused]] const Vector<String16>& args) const {
     Mutex::Autolock l(mLock);
 
     String8 lines;
+    lines.appendFormat("      Buffer pool: %zu buffers, %zu bytes (max %zu)\n",
+            mBufferPool.size(), mPooledBufferBytes, kMaxPooledBufferBytes);
+    lines.appendFormat("        Buffers allocated: %zu, reused from pool: %zu,"
+            " freed from pool: %zu\n", mAllocatedBufferCount, mPoolReusedBufferCount, mPoolEvictedBufferCount);
     lines.appendFormat("      Total stream sets: %zu\n", mStreamSetMap.size());
     for (size_t i = 0; i < mStreamSetMap.size(); i++) {
         lines.appendFormat("        Stream set %d(%d) has below streams:\n",
@@ -180,12 +180,27 @@ public:
      */
     void notifyBufferRemoved(int streamId, int streamSetId, bool isMultiRes);
 
+    /**
+     * This method hands a buffer that was detached from a stream back to the buffer manager.
+     *
+     * Instead of being freed, the buffer is kept in a pool shared by all stream sets, and is
+     * handed out by getBufferForStream() to any stream with the same size, format and usage,
+     * including streams configured later in the same session. The buffer manager takes over the
+     * ownership of fenceFd, which is handed out together with the buffer.
+     *
+     * The pooled buffers are capped at kMaxPooledBufferBytes in total; the least recently
+     * returned buffers are freed first when the cap is exceeded.
+     */
+    void returnBufferToPool(const sp<GraphicBuffer>& buffer, int fenceFd);
+
     /**
      * Dump the buffer manager statistics.
      */
     void     dump(int fd, const Vector<String16> &args) const;
 
 private:
+    friend class Camera3BufferManagerTest;
+
     // allocatedBufferWaterMark will be decreased when:
     //   numAllocatedBuffersThisSet > numHandoutBuffersThisSet + BUFFER_WATERMARK_DEC_THRESHOLD
     // This allows the watermark go back down after a burst of buffer requests
@@ -205,6 +220,9 @@ private:
 
     static const size_t kMaxBufferCount = BufferQueueDefs::NUM_BUFFER_SLOTS;
 
+    // Upper bound of the memory held by buffers in the buffer pool, across all stream sets.
+    static const size_t kMaxPooledBufferBytes = 64 * 1024 * 1024;
+
     struct GraphicBufferEntry {
         sp<GraphicBuffer> graphicBuffer;
         int fenceFd;
@@ -309,6 +327,36 @@ private:
     KeyedVector<StreamSetKey, StreamSet> mStreamSetMap;
     KeyedVector<StreamId, wp<Camera3OutputStream>> mStreamMap;
 
+    /**
+     * Buffers detached from the streams, available for reuse by any stream whose buffers have
+     * the same properties. Gralloc buffers can only be handed to the camera HAL for streams with
+     * exactly matching dimensions and format, so the pool is keyed on all of them.
+     */
+    struct BufferPoolKey {
+        uint32_t width;
+        uint32_t height;
+        uint32_t format;
+        uint64_t usage;
+
+        inline bool operator==(const BufferPoolKey& other) const {
+            return (width == other.width) && (height == other.height) &&
+                    (format == other.format) && (usage == other.usage);
+        }
+    };
+    struct PooledBuffer {
+        BufferPoolKey key;
+        GraphicBufferEntry entry;
+        size_t sizeBytes;
+    };
+    // Ordered from the least to the most recently returned buffer.
+    std::list<PooledBuffer> mBufferPool;
+    size_t mPooledBufferBytes = 0;
+
+    // Buffer pool statistics, reported by dump().
+    size_t mAllocatedBufferCount = 0;
+    size_t mPoolReusedBufferCount = 0;
+    size_t mPoolEvictedBufferCount = 0;
+
     // TODO: There is no easy way to query the Gralloc version in this code yet, we have different
     // code paths for different Gralloc versions, hardcode something here for now.
     const uint32_t mGrallocVersion = GRALLOC_DEVICE_API_VERSION_0_1;
@@ -324,6 +372,24 @@ private:
      * free one if so.
      */
     status_t checkAndFreeBufferOnOtherStreamsLocked(int streamId, StreamSetKey streamSetKey);
+
+    /**
+     * Take a buffer matching the given stream info out of the buffer pool. Returns false if the
+     * pool has no such buffer. This method needs to be called with mLock held.
+     */
+    bool takeBufferFromPoolLocked(const StreamInfo& info, GraphicBufferEntry* buffer);
+
+    /**
+     * Add a detached buffer to the buffer pool, and free the least recently pooled buffers if the
+     * pool exceeds kMaxPooledBufferBytes. This method needs to be called with mLock held.
+     */
+    void returnBufferToPoolLocked(const sp<GraphicBuffer>& buffer, int fenceFd);
+
+    /**
+     * Estimate the memory used by a buffer with the given properties.
+     */
+    static size_t getBufferSizeBytes(uint32_t width, uint32_t height, uint32_t stride,
+            int format);
 };
 
 } // namespace camera3
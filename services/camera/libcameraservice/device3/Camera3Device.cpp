@@ -571,6 +571,9 @@ status_t Camera3Device::dump(int fd, [[maybe_unused]] const Vector<String16> &ar
             mOperatingMode == CAMERA_STREAM_CONFIGURATION_CONSTRAINED_HIGH_SPEED_MODE ?
                     "CONSTRAINED_HIGH_SPEED" : "CUSTOM";
     lines.appendFormat("    Operation mode: %s (%d) \n", mode, mOperatingMode);
+    lines.appendFormat("    Last configuration latency (ms): stream setup %d, HAL %d,"
+            " stream finish %d\n", mConfigureStreamSetupMs, mConfigureHalMs,
+            mConfigureStreamFinishMs);
 
     if (mInputStream != NULL) {
         write(fd, lines.string(), lines.size());
@@ -595,7 +598,7 @@ status_t Camera3Device::dump(int fd, [[maybe_unused]] const Vector<String16> &ar
             lines.append("      None\n");
         } else {
             for (size_t i = 0; i < mInFlightMap.size(); i++) {
-                InFlightRequest r = mInFlightMap.valueAt(i);
+                const InFlightRequest& r = mInFlightMap.valueAt(i);
                 lines.appendFormat("      Frame %d |  Timestamp: %" PRId64 ", metadata"
                         " arrived: %s, buffers left: %d\n", mInFlightMap.keyAt(i),
                         r.shutterTimestamp, r.haveResultMetadata ? "true" : "false",
@@ -611,6 +614,14 @@ status_t Camera3Device::dump(int fd, [[maybe_unused]] const Vector<String16> &ar
     if (mRequestThread != NULL) {
         mRequestThread->dumpCaptureRequestLatency(fd,
                 "    ProcessCaptureRequest latency histogram:");
+        mRequestThread->dumpStageTimings(fd);
+    }
+    lines = String8::format("    Capture pipeline stage latency:\n      %s\n",
+            SessionStatsBuilder::kLatencyStatsHeader);
+    write(fd, lines.string(), lines.size());
+    mSessionStatsBuilder.dumpLatencyStats(fd, mId, /*indentation*/6);
+    if (mInterface != nullptr) {
+        mInterface->dumpRequestSettingsStats(fd);
     }
 
     {
@@ -677,6 +688,15 @@ status_t Camera3Device::dumpWatchedEventsToVector(std::vector<std::string> &out)
     return OK;
 }
 
+void Camera3Device::dumpLatencyStats(int fd) {
+    mSessionStatsBuilder.dumpLatencyStats(fd, mId);
+}
+
+void Camera3Device::addStageLatency(hardware::CameraLatencyStats::LatencyStage stage,
+        nsecs_t start, nsecs_t end) {
+    mSessionStatsBuilder.addStageLatency(stage, start, end);
+}
+
 const CameraMetadata& Camera3Device::infoPhysical(const String8& physicalId) const {
     ALOGVV("%s: E", __FUNCTION__);
     if (CC_UNLIKELY(mStatus == STATUS_UNINITIALIZED ||
@@ -1993,8 +2013,9 @@ void Camera3Device::notifyStatus(bool idle) {
             int64_t requestCount, resultErrorCount;
             bool deviceError;
             std::map<int, StreamStats> streamStatsMap;
+            std::vector<hardware::CameraLatencyStats> latencyStats;
             mSessionStatsBuilder.buildAndReset(&requestCount, &resultErrorCount,
-                    &deviceError, &streamStatsMap);
+                    &deviceError, &streamStatsMap, &latencyStats);
             for (size_t i = 0; i < streamIds.size(); i++) {
                 int streamId = streamIds[i];
                 auto stats = streamStatsMap.find(streamId);
@@ -2012,6 +2033,7 @@ void Camera3Device::notifyStatus(bool idle) {
                            stats->second.mCaptureLatencyHistogram.end());
                 }
             }
+            mCameraServiceProxyWrapper->logLatencyStats(mId, latencyStats);
             listener->notifyIdle(requestCount, resultErrorCount, deviceError, streamStats);
         } else {
             res = listener->notifyActive(sessionMaxPreviewFps);
@@ -2457,6 +2479,8 @@ status_t Camera3Device::configureStreamsLocked(int operatingMode,
         return OK;
     }
 
+    nsecs_t configureStartTime = systemTime();
+
     // Workaround for device HALv3.2 or older spec bug - zero streams requires
     // adding a fake stream instead.
     // TODO: Bug: 17321404 for fixing the HAL spec and removing this workaround.
@@ -2555,9 +2579,11 @@ status_t Camera3Device::configureStreamsLocked(int operatingMode,
     // fields for IMPLEMENTATION_DEFINED formats.
 
     int64_t logId = mCameraServiceProxyWrapper->getCurrentLogIdForCamera(mId);
+    nsecs_t halConfigureStartTime = systemTime();
     const camera_metadata_t *sessionBuffer = sessionParams.getAndLock();
     res = mInterface->configureStreams(sessionBuffer, &config, bufferSizes, logId);
     sessionParams.unlock(sessionBuffer);
+    nsecs_t halConfigureEndTime = systemTime();
 
     if (res == BAD_VALUE) {
         // HAL rejected this set of streams as unsupported, clean up config
@@ -2614,6 +2640,16 @@ status_t Camera3Device::configureStreamsLocked(int operatingMode,
         }
     }
 
+    nsecs_t configureFinishTime = systemTime();
+    mConfigureStreamSetupMs = ns2ms(halConfigureStartTime - configureStartTime);
+    mConfigureHalMs = ns2ms(halConfigureEndTime - halConfigureStartTime);
+    mConfigureStreamFinishMs = ns2ms(configureFinishTime - halConfigureEndTime);
+    // Internal reconfigurations are not part of the session creation latency.
+    if (notifyRequestThread) {
+        mCameraServiceProxyWrapper->logStreamConfigureBreakdown(mId, mConfigureStreamSetupMs,
+                mConfigureHalMs, mConfigureStreamFinishMs);
+    }
+
     mRequestThread->setComposerSurface(mComposerOutput);
 
     // Request thread needs to know to avoid using repeat-last-settings protocol
@@ -3009,6 +3045,116 @@ void Camera3Device::HalInterface::onStreamReConfigured(int streamId) {
     }
 }
 
+// Returns true if both metadata buffers have the same entries in the same order
+static bool isSameMetadata(const camera_metadata_t* a, const camera_metadata_t* b) {
+    if (a == nullptr || b == nullptr) {
+        return a == b;
+    }
+    size_t entryCount = get_camera_metadata_entry_count(a);
+    if (entryCount != get_camera_metadata_entry_count(b)) {
+        return false;
+    }
+    for (size_t i = 0; i < entryCount; i++) {
+        camera_metadata_ro_entry_t entryA, entryB;
+        if (get_camera_metadata_ro_entry(a, i, &entryA) != OK ||
+                get_camera_metadata_ro_entry(b, i, &entryB) != OK) {
+            return false;
+        }
+        if (entryA.tag != entryB.tag || entryA.type != entryB.type ||
+                entryA.count != entryB.count ||
+                memcmp(entryA.data.u8, entryB.data.u8,
+                        entryA.count * camera_metadata_type_size[entryA.type]) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Triggers only take effect in the request that carries them, so settings with an active
+// trigger are always sent, even when they are the same as the last ones.
+static bool hasActiveTrigger(const camera_metadata_t* settings) {
+    camera_metadata_ro_entry_t e;
+    if (find_camera_metadata_ro_entry(settings, ANDROID_CONTROL_AF_TRIGGER, &e) == OK &&
+            e.count > 0 && e.data.u8[0] != ANDROID_CONTROL_AF_TRIGGER_IDLE) {
+        return true;
+    }
+    if (find_camera_metadata_ro_entry(settings, ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, &e) == OK &&
+            e.count > 0 && e.data.u8[0] != ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_IDLE) {
+        return true;
+    }
+    return false;
+}
+
+bool Camera3Device::HalInterface::skipUnchangedSettings(const camera_capture_request_t* request) {
+    std::lock_guard<std::mutex> l(mRequestSettingsLock);
+    if (mRequestSettingsStats.startTime == 0) {
+        mRequestSettingsStats.startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+    if (request->settings == nullptr) {
+        return true;
+    }
+
+    bool unchanged = !mLastSettings.isEmpty() && !hasActiveTrigger(request->settings) &&
+            mLastPhysicalSettings.size() == request->num_physcam_settings;
+    if (unchanged) {
+        const camera_metadata_t* lastSettings = mLastSettings.getAndLock();
+        unchanged = isSameMetadata(lastSettings, request->settings);
+        mLastSettings.unlock(lastSettings);
+    }
+    for (size_t i = 0; unchanged && i < request->num_physcam_settings; i++) {
+        auto& [lastId, lastPhysicalSettings] = mLastPhysicalSettings[i];
+        const camera_metadata_t* lastSettings = lastPhysicalSettings.getAndLock();
+        unchanged = lastId == request->physcam_id[i] &&
+                request->physcam_settings != nullptr &&
+                isSameMetadata(lastSettings, request->physcam_settings[i]);
+        lastPhysicalSettings.unlock(lastSettings);
+    }
+    if (unchanged) {
+        mRequestSettingsStats.unchangedCount++;
+        return true;
+    }
+
+    mLastSettings = request->settings;
+    mLastPhysicalSettings.clear();
+    for (size_t i = 0; i < request->num_physcam_settings; i++) {
+        mLastPhysicalSettings.emplace_back(request->physcam_id[i], CameraMetadata());
+        if (request->physcam_settings != nullptr) {
+            mLastPhysicalSettings.back().second = request->physcam_settings[i];
+        }
+    }
+    mRequestSettingsStats.sentCount++;
+    return false;
+}
+
+void Camera3Device::HalInterface::resetLastSettings() {
+    std::lock_guard<std::mutex> l(mRequestSettingsLock);
+    mLastSettings.clear();
+    mLastPhysicalSettings.clear();
+}
+
+void Camera3Device::HalInterface::addRequestSettingsBytes(size_t fmqBytes, size_t binderBytes) {
+    std::lock_guard<std::mutex> l(mRequestSettingsLock);
+    mRequestSettingsStats.fmqBytes += fmqBytes;
+    mRequestSettingsStats.binderBytes += binderBytes;
+}
+
+void Camera3Device::HalInterface::dumpRequestSettingsStats(int fd) {
+    std::lock_guard<std::mutex> l(mRequestSettingsLock);
+    const RequestSettingsStats& stats = mRequestSettingsStats;
+    if (stats.startTime == 0) {
+        return;
+    }
+    double seconds = (systemTime(SYSTEM_TIME_MONOTONIC) - stats.startTime) / 1e9;
+    String8 lines;
+    lines.appendFormat("    Request settings sent to HAL: %" PRId64 ", skipped as unchanged: %"
+            PRId64 "\n", stats.sentCount, stats.unchangedCount);
+    lines.appendFormat("      Metadata queue: %" PRId64 " bytes (%.1f bytes/s), binder: %" PRId64
+            " bytes (%.1f bytes/s) over %.1f s\n", stats.fmqBytes,
+            seconds > 0 ? stats.fmqBytes / seconds : 0.0, stats.binderBytes,
+            seconds > 0 ? stats.binderBytes / seconds : 0.0, seconds);
+    write(fd, lines.string(), lines.size());
+}
+
 /**
  * RequestThread inner class methods
  */
@@ -3557,10 +3703,13 @@ bool Camera3Device::RequestThread::threadLoop() {
     }
 
     // Wait for the next batch of requests.
+    nsecs_t tWaitStart = systemTime(SYSTEM_TIME_MONOTONIC);
     waitForNextRequestBatch();
     if (mNextRequests.size() == 0) {
         return true;
     }
+    nsecs_t tPrepareStart = systemTime(SYSTEM_TIME_MONOTONIC);
+    addStageTiming(STAGE_WAIT, tWaitStart, tPrepareStart);
 
     // Get the latest request ID, if any
     int latestRequestId;
@@ -3587,8 +3736,13 @@ bool Camera3Device::RequestThread::threadLoop() {
     // 'mNextRequests' will at this point contain either a set of HFR batched requests
     //  or a single request from streaming or burst. In either case the first element
     //  should contain the latest camera settings that we need to check for any session
-    //  parameter updates.
-    if (updateSessionParameters(mNextRequests[0].captureRequest->mSettingsList.begin()->metadata)) {
+    //  parameter updates. A repeating request only needs to be checked the first time it
+    //  is sent after a configuration, since its settings don't change.
+    sp<CaptureRequest> firstRequest = mNextRequests[0].captureRequest;
+    bool sessionParamsChecked = (firstRequest == mSessionParamsRequest);
+    mSessionParamsRequest = firstRequest;
+    if (!sessionParamsChecked &&
+            updateSessionParameters(firstRequest->mSettingsList.begin()->metadata)) {
         res = OK;
 
         //Input stream buffers are already acquired at this point so an input stream
@@ -3631,6 +3785,7 @@ bool Camera3Device::RequestThread::threadLoop() {
         cleanUpFailedRequests(/*sendRequestError*/ false);
         return false;
     }
+    addStageTiming(STAGE_PREPARE, tPrepareStart, systemTime(SYSTEM_TIME_MONOTONIC));
 
     // Inform waitUntilRequestProcessed thread of a new request ID
     {
@@ -3667,6 +3822,7 @@ bool Camera3Device::RequestThread::threadLoop() {
 
     nsecs_t tRequestEnd = systemTime(SYSTEM_TIME_MONOTONIC);
     mRequestLatency.add(tRequestStart, tRequestEnd);
+    addStageTiming(STAGE_SUBMIT, tRequestStart, tRequestEnd);
 
     if (useFlushLock) {
         mFlushLock.unlock();
@@ -3997,6 +4153,7 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
                 // buffers are requested.
                 outputStream->markUnpreparable();
             } else {
+                nsecs_t dequeueStartTime = systemTime();
                 res = outputStream->getBuffer(&outputBuffers->editItemAt(j),
                         waitDuration,
                         captureRequest->mOutputSurfaces[streamId]);
@@ -4009,6 +4166,9 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
 
                     return TIMED_OUT;
                 }
+                parent->mSessionStatsBuilder.addStageLatency(
+                        hardware::CameraLatencyStats::LATENCY_STAGE_DEQUEUE_BUFFER,
+                        dequeueStartTime, systemTime());
             }
 
             {
@@ -4049,37 +4209,51 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
         if (batchedRequest && i != mNextRequests.size()-1) {
             hasCallback = false;
         }
-        bool isStillCapture = false;
-        bool isZslCapture = false;
-        const camera_metadata_t* settings = halRequest->settings;
-        bool shouldUnlockSettings = false;
-        if (settings == nullptr) {
-            shouldUnlockSettings = true;
-            settings = captureRequest->mSettingsList.begin()->metadata.getAndLock();
-        }
-        if (!mNextRequests[0].captureRequest->mSettingsList.begin()->metadata.isEmpty()) {
-            camera_metadata_ro_entry_t e = camera_metadata_ro_entry_t();
-            find_camera_metadata_ro_entry(settings, ANDROID_CONTROL_CAPTURE_INTENT, &e);
-            if ((e.count > 0) && (e.data.u8[0] == ANDROID_CONTROL_CAPTURE_INTENT_STILL_CAPTURE)) {
-                isStillCapture = true;
-                ATRACE_ASYNC_BEGIN("still capture", mNextRequests[i].halRequest.frame_number);
+        if (!captureRequest->mSettingsInfoValid) {
+            const camera_metadata_t* settings = halRequest->settings;
+            bool shouldUnlockSettings = false;
+            if (settings == nullptr) {
+                shouldUnlockSettings = true;
+                settings = captureRequest->mSettingsList.begin()->metadata.getAndLock();
             }
+            captureRequest->mIsStillCapture = false;
+            captureRequest->mIsZslCapture = false;
+            if (!mNextRequests[0].captureRequest->mSettingsList.begin()->metadata.isEmpty()) {
+                camera_metadata_ro_entry_t e = camera_metadata_ro_entry_t();
+                find_camera_metadata_ro_entry(settings, ANDROID_CONTROL_CAPTURE_INTENT, &e);
+                if ((e.count > 0) &&
+                        (e.data.u8[0] == ANDROID_CONTROL_CAPTURE_INTENT_STILL_CAPTURE)) {
+                    captureRequest->mIsStillCapture = true;
+                }
 
-            e = camera_metadata_ro_entry_t();
-            find_camera_metadata_ro_entry(settings, ANDROID_CONTROL_ENABLE_ZSL, &e);
-            if ((e.count > 0) && (e.data.u8[0] == ANDROID_CONTROL_ENABLE_ZSL_TRUE)) {
-                isZslCapture = true;
+                e = camera_metadata_ro_entry_t();
+                find_camera_metadata_ro_entry(settings, ANDROID_CONTROL_ENABLE_ZSL, &e);
+                if ((e.count > 0) && (e.data.u8[0] == ANDROID_CONTROL_ENABLE_ZSL_TRUE)) {
+                    captureRequest->mIsZslCapture = true;
+                }
+            }
+            auto expectedDurationInfo = calculateExpectedDurationRange(settings);
+            captureRequest->mMinExpectedDuration = expectedDurationInfo.minDuration;
+            captureRequest->mMaxExpectedDuration = expectedDurationInfo.maxDuration;
+            captureRequest->mIsFixedFps = expectedDurationInfo.isFixedFps;
+            captureRequest->mSettingsInfoValid = true;
+
+            if (shouldUnlockSettings) {
+                captureRequest->mSettingsList.begin()->metadata.unlock(settings);
             }
         }
-        auto expectedDurationInfo = calculateExpectedDurationRange(settings);
+        if (captureRequest->mIsStillCapture) {
+            ATRACE_ASYNC_BEGIN("still capture", mNextRequests[i].halRequest.frame_number);
+        }
         res = parent->registerInFlight(halRequest->frame_number,
                 totalNumBuffers, captureRequest->mResultExtras,
                 /*hasInput*/halRequest->input_buffer != NULL,
                 hasCallback,
-                expectedDurationInfo.minDuration,
-                expectedDurationInfo.maxDuration,
-                expectedDurationInfo.isFixedFps,
-                requestedPhysicalCameras, isStillCapture, isZslCapture,
+                captureRequest->mMinExpectedDuration,
+                captureRequest->mMaxExpectedDuration,
+                captureRequest->mIsFixedFps,
+                requestedPhysicalCameras,
+                captureRequest->mIsStillCapture, captureRequest->mIsZslCapture,
                 captureRequest->mRotateAndCropAuto, captureRequest->mAutoframingAuto,
                 mPrevCameraIdsWithZoom,
                 (mUseHalBufManager) ? uniqueSurfaceIdMap :
@@ -4090,10 +4264,6 @@ status_t Camera3Device::RequestThread::prepareHalRequests() {
                 captureRequest->mResultExtras.requestId, captureRequest->mResultExtras.frameNumber,
                 captureRequest->mResultExtras.burstId);
 
-        if (shouldUnlockSettings) {
-            captureRequest->mSettingsList.begin()->metadata.unlock(settings);
-        }
-
         if (res != OK) {
             SET_ERR("RequestThread: Unable to register new in-flight request:"
                     " %s (%d)", strerror(-res), res);
@@ -4209,6 +4379,35 @@ void Camera3Device::RequestThread::resetPipelineDrain() {
 void Camera3Device::RequestThread::clearPreviousRequest() {
     Mutex::Autolock l(mRequestLock);
     mPrevRequest.clear();
+    mSessionParamsRequest.clear();
+}
+
+void Camera3Device::RequestThread::addStageTiming(RequestStage stage, nsecs_t start,
+        nsecs_t end) {
+    std::lock_guard<std::mutex> l(mStageTimingLock);
+    StageTiming& timing = mStageTimings[stage];
+    timing.count++;
+    timing.totalNs += end - start;
+    timing.maxNs = std::max(timing.maxNs, end - start);
+}
+
+void Camera3Device::RequestThread::dumpStageTimings(int fd) {
+    static const char* kStageNames[STAGE_COUNT] = {
+        "Wait for requests", "Prepare HAL requests", "Submit to HAL"};
+
+    std::lock_guard<std::mutex> l(mStageTimingLock);
+    if (mStageTimings[STAGE_SUBMIT].count == 0) {
+        return;
+    }
+    String8 lines("    Request thread stage timing (batches, avg us, max us):\n");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        const StageTiming& timing = mStageTimings[stage];
+        lines.appendFormat("      %s: %" PRId64 ", %" PRId64 ", %" PRId64 "\n",
+                kStageNames[stage], timing.count,
+                timing.count > 0 ? timing.totalNs / timing.count / 1000 : 0,
+                timing.maxNs / 1000);
+    }
+    write(fd, lines.string(), lines.size());
 }
 
 status_t Camera3Device::RequestThread::setRotateAndCropAutoBehavior(
@@ -4536,6 +4735,7 @@ sp<Camera3Device::CaptureRequest>
     // request if so. Can't use 'NULL request == repeat' across configure calls.
     if (mReconfigured) {
         mPrevRequest.clear();
+        mSessionParamsRequest.clear();
         mReconfigured = false;
     }
 
@@ -117,6 +117,9 @@ class Camera3Device :
     status_t startWatchingTags(const String8 &tags) override;
     status_t stopWatchingTags() override;
     status_t dumpWatchedEventsToVector(std::vector<std::string> &out) override;
+    void dumpLatencyStats(int fd) override;
+    void addStageLatency(hardware::CameraLatencyStats::LatencyStage stage, nsecs_t start,
+            nsecs_t end) override;
     const CameraMetadata& info() const override;
     const CameraMetadata& infoPhysical(const String8& physicalId) const override;
     bool isCompositeJpegRDisabled() const override { return mIsCompositeJpegRDisabled; };
@@ -385,6 +388,11 @@ class Camera3Device :
     int                        mOperatingMode;
     // Current session wide parameters
     hardware::camera2::impl::CameraMetadataNative mSessionParams;
+    // Phase durations of the latest stream configuration in ms, or -1 if not
+    // configured yet: stream setup, HAL configureStreams call, stream finish
+    int32_t                    mConfigureStreamSetupMs = -1;
+    int32_t                    mConfigureHalMs = -1;
+    int32_t                    mConfigureStreamFinishMs = -1;
 
     // Constant to use for no set operating mode
     static const int           NO_MODE = -1;
@@ -481,8 +489,25 @@ class Camera3Device :
 
         void onStreamReConfigured(int streamId);
 
+        // Dump the statistics of the request settings sent to the HAL
+        void dumpRequestSettingsStats(int fd);
+
       protected:
 
+        // Returns true if the settings of the request don't need to be sent to the HAL, because
+        // they are null or the same as the last settings sent. Otherwise, records them as the
+        // last settings sent. Must be called for the requests in the order they are submitted.
+        bool skipUnchangedSettings(const camera_capture_request_t* request);
+
+        // Forget the last settings sent, so that the next request sends its settings in full.
+        // Called when the HAL may no longer have them, e.g. after stream configuration or a
+        // failed submission.
+        void resetLastSettings();
+
+        // Record the bytes of request settings sent through the request metadata queue or
+        // through binder.
+        void addRequestSettingsBytes(size_t fmqBytes, size_t binderBytes);
+
         // Return true if the input caches match what we have; otherwise false
         bool verifyBufferIds(int32_t streamId, std::vector<uint64_t>& inBufIds);
 
@@ -543,6 +568,19 @@ class Camera3Device :
 
         uint32_t mNextStreamConfigCounter = 1;
 
+        std::mutex mRequestSettingsLock;
+        // The last settings sent to the HAL, both logical and physical
+        CameraMetadata mLastSettings;
+        std::vector<std::pair<std::string, CameraMetadata>> mLastPhysicalSettings;
+        struct RequestSettingsStats {
+            int64_t sentCount = 0;
+            int64_t unchangedCount = 0;
+            int64_t fmqBytes = 0;
+            int64_t binderBytes = 0;
+            nsecs_t startTime = 0;
+        };
+        RequestSettingsStats mRequestSettingsStats;
+
         const bool mUseHalBufManager;
         bool mIsReconfigurationQuerySupported;
 
@@ -671,6 +709,16 @@ class Camera3Device :
         // Whether this max resolution capture request's  crop / metering region update has been
         // done.
         bool                                mUHRCropAndMeteringRegionsUpdated = false;
+
+        // In-flight request information derived from the settings. The framework never
+        // modifies the keys it depends on, so it is computed the first time the request is
+        // prepared and reused every time a repeating request is sent again.
+        bool                                mSettingsInfoValid = false;
+        bool                                mIsStillCapture = false;
+        bool                                mIsZslCapture = false;
+        nsecs_t                             mMinExpectedDuration = 0;
+        nsecs_t                             mMaxExpectedDuration = 0;
+        bool                                mIsFixedFps = false;
     };
     typedef List<sp<CaptureRequest> > RequestList;
 
@@ -973,6 +1021,9 @@ class Camera3Device :
             mRequestLatency.dump(fd, name);
         }
 
+        // dump the time spent in each stage of the request loop
+        void dumpStageTimings(int fd);
+
         void signalPipelineDrain(const std::vector<int>& streamIds);
         void resetPipelineDrain();
 
@@ -1133,6 +1184,9 @@ class Camera3Device :
         std::vector<int>   mStreamIdsToBeDrained;
 
         sp<CaptureRequest> mPrevRequest;
+        // The last request checked for session parameter updates since the last
+        // configuration. Repeating requests don't need to be checked again.
+        sp<CaptureRequest> mSessionParamsRequest;
         int32_t            mPrevTriggers;
         std::set<std::string> mPrevCameraIdsWithZoom;
 
@@ -1171,6 +1225,23 @@ class Camera3Device :
         static const int32_t kRequestLatencyBinSize = 40; // in ms
         CameraLatencyHistogram mRequestLatency;
 
+        // Time spent in each stage of threadLoop, for dumpsys. The stages are
+        // waiting for the next batch, preparing it, and submitting it to the HAL.
+        enum RequestStage {
+            STAGE_WAIT,
+            STAGE_PREPARE,
+            STAGE_SUBMIT,
+            STAGE_COUNT
+        };
+        struct StageTiming {
+            int64_t count = 0;
+            nsecs_t totalNs = 0;
+            nsecs_t maxNs = 0;
+        };
+        void addStageTiming(RequestStage stage, nsecs_t start, nsecs_t end);
+        std::mutex         mStageTimingLock;
+        StageTiming        mStageTimings[STAGE_COUNT];
+
         Vector<int32_t>    mSessionParamKeys;
         CameraMetadata     mLatestSessionParams;
 
@@ -1294,6 +1365,8 @@ class Camera3Device :
     uint32_t               mNextReprocessResultFrameNumber;
     // the minimal frame number of the next ZSL still capture result
     uint32_t               mNextZslStillResultFrameNumber;
+    // the largest result metadata of the session
+    camera3::ResultMetadataCapacity mResultMetadataCapacity;
     // the minimal frame number of the next non-reprocess shutter
     uint32_t               mNextShutterFrameNumber;
     // the minimal frame number of the next reprocess shutter
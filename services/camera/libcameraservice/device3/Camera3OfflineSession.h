@@ -210,6 +210,8 @@ class Camera3OfflineSession :
     uint32_t mNextReprocessShutterFrameNumber;
     // the minimal frame number of the next ZSL still capture shutter
     uint32_t mNextZslStillShutterFrameNumber;
+    // the largest result metadata of the session
+    camera3::ResultMetadataCapacity mResultMetadataCapacity;
     // End of mOutputLock scope
 
     const CameraMetadata mDeviceInfo;
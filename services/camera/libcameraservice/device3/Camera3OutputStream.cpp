@@ -998,6 +998,11 @@ status_t Camera3OutputStream::disconnectLocked() {
 
     returnPrefetchedBuffersLocked();
 
+    // A tear down frees the buffers, so they are not kept in the buffer manager's pool.
+    if (mUseBufferManager && !mTearingDown) {
+        returnFreeBuffersToManagerLocked();
+    }
+
     if (mPreviewFrameSpacer != nullptr) {
         mPreviewFrameSpacer->requestExit();
     }
@@ -1148,11 +1153,16 @@ void Camera3OutputStream::BufferProducerListener::onBufferReleased() {
 
     if (shouldFreeBuffer) {
         sp<GraphicBuffer> buffer;
-        // Detach and free a buffer (when buffer goes out of scope)
-        stream->detachBufferLocked(&buffer, /*fenceFd*/ nullptr);
+        int fenceFd = -1;
+        // Detach a buffer and hand it to the buffer manager, which frees it unless another
+        // stream can reuse it
+        stream->detachBufferLocked(&buffer, &fenceFd);
         if (buffer.get() != nullptr) {
             stream->mBufferManager->notifyBufferRemoved(
                     stream->getId(), stream->getStreamSetId(), stream->isMultiResolution());
+            stream->mBufferManager->returnBufferToPool(buffer, fenceFd);
+        } else if (fenceFd >= 0) {
+            close(fenceFd);
         }
     }
 }
@@ -1228,6 +1238,23 @@ status_t Camera3OutputStream::detachBufferLocked(sp<GraphicBuffer>* buffer, int*
     return res;
 }
 
+void Camera3OutputStream::returnFreeBuffersToManagerLocked() {
+    // A stream can't have more free buffers than buffer queue slots; stop early once
+    // detachNextBuffer fails, which means there are no free buffers left or the consumer is gone.
+    for (size_t i = 0; i < BufferQueueDefs::NUM_BUFFER_SLOTS; i++) {
+        sp<GraphicBuffer> buffer;
+        sp<Fence> fence;
+        if (mConsumer->detachNextBuffer(&buffer, &fence) != OK || buffer == nullptr) {
+            break;
+        }
+        int fenceFd = (fence != nullptr && fence->isValid()) ? fence->dup() : -1;
+        mBufferManager->returnBufferToPool(buffer, fenceFd);
+    }
+
+    // Let the buffer freed listener know the buffers are gone from this stream.
+    checkRemovedBuffersLocked(/*notifyBufferManager*/false);
+}
+
 status_t Camera3OutputStream::dropBuffers(bool dropping) {
     Mutex::Autolock l(mLock);
     mDropBuffers = dropping;
@@ -408,6 +408,9 @@ class Camera3OutputStream :
      */
     void onBuffersRemovedLocked(const std::vector<sp<GraphicBuffer>>&);
     status_t detachBufferLocked(sp<GraphicBuffer>* buffer, int* fenceFd);
+    // Detach the free buffers from the consumer and hand them to the buffer manager for reuse by
+    // streams configured later.
+    void returnFreeBuffersToManagerLocked();
     // Call this after each dequeueBuffer/attachBuffer/detachNextBuffer call to get update on
     // removed buffers. Set notifyBufferManager to false when the call is initiated by buffer
     // manager so buffer manager doesn't need to be notified.
@@ -30,6 +30,7 @@
     "%s: " fmt, __FUNCTION__,                         \
     ##__VA_ARGS__)
 
+#include <algorithm>
 #include <inttypes.h>
 
 #include <utils/Log.h>
@@ -318,7 +319,13 @@ void sendCaptureResult(
 
     CaptureResult captureResult;
     captureResult.mResultExtras = resultExtras;
-    captureResult.mMetadata = pendingMetadata;
+    // Size the result for the largest result of the session so far, so that
+    // appending the partial results and the fixups below do not reallocate it.
+    ResultMetadataCapacity& capacity = states.resultMetadataCapacity;
+    if (capacity.entryCount > 0) {
+        captureResult.mMetadata.reserve(capacity.entryCount, capacity.dataCount);
+    }
+    captureResult.mMetadata.append(pendingMetadata);
     captureResult.mPhysicalMetadatas = physicalMetadatas;
 
     // Append any previous partials to form a complete result
@@ -327,6 +334,11 @@ void sendCaptureResult(
     }
 
     captureResult.mMetadata.sort();
+    // The result is looked up and modified by the mappers and fixups below.
+    captureResult.mMetadata.enableTagIndex();
+    for (auto& physicalMetadata : captureResult.mPhysicalMetadatas) {
+        physicalMetadata.mPhysicalCameraMetadata.enableTagIndex();
+    }
 
     // Check that there's a timestamp in the result metadata
     camera_metadata_entry timestamp = captureResult.mMetadata.find(ANDROID_SENSOR_TIMESTAMP);
@@ -348,6 +360,7 @@ void sendCaptureResult(
     }
 
     // Fix up some result metadata to account for HAL-level distortion correction
+    nsecs_t mapperStartTime = systemTime();
     status_t res = OK;
     auto iter = states.distortionMappers.find(states.cameraId.c_str());
     if (iter != states.distortionMappers.end()) {
@@ -422,6 +435,9 @@ void sendCaptureResult(
             return;
         }
     }
+    states.sessionStatsBuilder.addStageLatency(
+            hardware::CameraLatencyStats::LATENCY_STAGE_RESULT_MAPPER,
+            mapperStartTime, systemTime());
 
     // Fix up result metadata for monochrome camera.
     res = fixupMonochromeTags(states, states.deviceInfo, captureResult.mMetadata);
@@ -450,6 +466,9 @@ void sendCaptureResult(
             monitoredPhysicalMetadata);
 
     insertResultLocked(states, &captureResult, frameNumber);
+
+    capacity.entryCount = std::max(capacity.entryCount, captureResult.mMetadata.entryCount());
+    capacity.dataCount = std::max(capacity.dataCount, captureResult.mMetadata.dataCount());
 }
 
 void removeInFlightMapEntryLocked(CaptureOutputStates& states, int idx) {
@@ -728,6 +747,13 @@ void processCaptureResult(CaptureOutputStates& states, const camera_capture_resu
             }
             request.haveResultMetadata = true;
             request.errorBufStrategy = ERROR_BUF_RETURN_NOTIFY;
+            // A result arriving before its shutter has no shutter to result latency, and is
+            // left out of the samples rather than counted as 0 ms.
+            if (request.shutterNotifyTimeNs > 0) {
+                states.sessionStatsBuilder.addStageLatency(
+                        hardware::CameraLatencyStats::LATENCY_STAGE_SHUTTER_TO_RESULT,
+                        request.shutterNotifyTimeNs, systemTime());
+            }
         }
 
         uint32_t numBuffersReturned = result->num_output_buffers;
@@ -857,6 +883,7 @@ void returnOutputBuffers(
         // buffer strategy is CACHE.
         if (outputBuffers[i].status != CAMERA_BUFFER_STATUS_ERROR ||
                 errorBufStrategy != ERROR_BUF_CACHE) {
+            nsecs_t queueStartTime = systemTime();
             if (it != outputSurfaces.end()) {
                 res = stream->returnBuffer(
                         outputBuffers[i], timestamp, readoutTimestamp, timestampIncreasing,
@@ -866,6 +893,11 @@ void returnOutputBuffers(
                         outputBuffers[i], timestamp, readoutTimestamp, timestampIncreasing,
                         std::vector<size_t> (), inResultExtras.frameNumber, transform);
             }
+            if (res == OK && outputBuffers[i].status == CAMERA_BUFFER_STATUS_OK) {
+                sessionStatsBuilder.addStageLatency(
+                        hardware::CameraLatencyStats::LATENCY_STAGE_QUEUE_BUFFER,
+                        queueStartTime, systemTime());
+            }
         }
         // Note: stream may be deallocated at this point, if this buffer was
         // the last reference to it.
@@ -981,6 +1013,12 @@ void notifyShutter(CaptureOutputStates& states, const camera_shutter_msg_t &msg)
             }
 
             r.shutterTimestamp = msg.timestamp;
+            r.shutterNotifyTimeNs = systemTime();
+            if (r.requestTimeNs > 0) {
+                states.sessionStatsBuilder.addStageLatency(
+                        hardware::CameraLatencyStats::LATENCY_STAGE_SUBMIT_TO_SHUTTER,
+                        r.requestTimeNs, r.shutterNotifyTimeNs);
+            }
             if (msg.readout_timestamp_valid) {
                 r.resultExtras.hasReadoutTimestamp = true;
                 r.resultExtras.readoutTimestamp = msg.readout_timestamp;
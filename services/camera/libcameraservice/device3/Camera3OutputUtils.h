@@ -70,6 +70,13 @@ namespace camera3 {
 
     // Camera3Device/Camera3OfflineSession internal states used in notify/processCaptureResult
     // callbacks
+    // Largest capture result metadata of a session so far, used to size the
+    // metadata of new capture results up front.
+    struct ResultMetadataCapacity {
+        size_t entryCount = 0;
+        size_t dataCount = 0;
+    };
+
     struct CaptureOutputStates {
         const String8& cameraId;
         std::mutex& inflightLock;
@@ -85,7 +92,8 @@ namespace camera3 {
         uint32_t& nextZslShutterFrameNum;
         uint32_t& nextResultFrameNum;
         uint32_t& nextReprocResultFrameNum;
-        uint32_t& nextZslResultFrameNum; // end of outputLock scope
+        uint32_t& nextZslResultFrameNum;
+        ResultMetadataCapacity& resultMetadataCapacity; // end of outputLock scope
         const bool useHalBufManager;
         const bool usePartialResult;
         const bool needFixupMonoChrome;
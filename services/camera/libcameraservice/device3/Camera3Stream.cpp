@@ -65,6 +65,7 @@ Camera3Stream::Camera3Stream(int id,
     mState(STATE_CONSTRUCTED),
     mStatusId(StatusTracker::NO_STATUS_ID),
     mStreamUnpreparable(true),
+    mTearingDown(false),
     mUsage(0),
     mOldUsage(0),
     mOldMaxBuffers(0),
@@ -623,7 +624,9 @@ status_t Camera3Stream::tearDown() {
     // and are waiting to be acquired by the consumer and buffers that are currently
     // acquired will be freed once they are released by the consumer.
 
+    mTearingDown = true;
     res = disconnectLocked();
+    mTearingDown = false;
     if (res != OK) {
         if (res == -ENOTCONN) {
             // queue has been disconnected, nothing left to do, so exit with success
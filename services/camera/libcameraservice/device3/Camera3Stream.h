@@ -580,6 +580,10 @@ class Camera3Stream :
     // prepareNextBuffer called on it.
     bool mStreamUnpreparable;
 
+    // Whether disconnectLocked() is called by tearDown(), which is meant to free the buffers
+    // of the stream.
+    bool mTearingDown;
+
     uint64_t mUsage;
 
     Condition mOutputBufferReturnedSignal;
@@ -17,10 +17,16 @@
 #ifndef ANDROID_SERVERS_CAMERA3_INFLIGHT_REQUEST_H
 #define ANDROID_SERVERS_CAMERA3_INFLIGHT_REQUEST_H
 
+#include <algorithm>
+#include <deque>
+#include <memory>
 #include <set>
+#include <utility>
 
 #include <camera/CaptureResult.h>
 #include <camera/CameraMetadata.h>
+#include <log/log.h>
+#include <utils/Errors.h>
 #include <utils/String8.h>
 #include <utils/Timers.h>
 
@@ -191,6 +197,10 @@ struct InFlightRequest {
     // Time of capture request (from systemTime) in Ns
     nsecs_t requestTimeNs;
 
+    // Time the shutter notification was received (from systemTime) in Ns, or 0
+    // before the shutter notification
+    nsecs_t shutterNotifyTimeNs;
+
     // What shared surfaces an output should go to
     SurfaceMap outputSurfaces;
 
@@ -219,6 +229,7 @@ struct InFlightRequest {
             rotateAndCropAuto(false),
             autoframingAuto(false),
             requestTimeNs(0),
+            shutterNotifyTimeNs(0),
             transform(-1) {
     }
 
@@ -248,13 +259,111 @@ struct InFlightRequest {
             autoframingAuto(autoframingAuto),
             cameraIdsWithZoom(idsWithZoom),
             requestTimeNs(requestNs),
+            shutterNotifyTimeNs(0),
             outputSurfaces(outSurfaces),
             transform(-1) {
     }
 };
 
-// Map from frame number to the in-flight request state
-typedef KeyedVector<uint32_t, InFlightRequest> InFlightRequestMap;
+// Map from frame number to the in-flight request state.
+//
+// Offers the subset of the KeyedVector interface used by the result path.
+// Requests are registered in frame number order and mostly complete in that
+// order, so entries are kept in a deque sorted by frame number: registering
+// appends at the back, completing the oldest request pops the front, and
+// looking up a frame number is usually a direct offset from the oldest one.
+// The requests themselves are heap allocated, so adding or removing entries
+// never copies the other in-flight requests and their metadata.
+class InFlightRequestMap {
+  public:
+    InFlightRequestMap() = default;
+    InFlightRequestMap(const InFlightRequestMap& other) {
+        *this = other;
+    }
+    InFlightRequestMap& operator=(const InFlightRequestMap& other) {
+        if (this != &other) {
+            mEntries.clear();
+            for (const auto& entry : other.mEntries) {
+                mEntries.emplace_back(entry.first,
+                        std::make_unique<InFlightRequest>(*entry.second));
+            }
+        }
+        return *this;
+    }
+    InFlightRequestMap(InFlightRequestMap&& other) = default;
+    InFlightRequestMap& operator=(InFlightRequestMap&& other) = default;
+
+    size_t size() const { return mEntries.size(); }
+    bool isEmpty() const { return mEntries.empty(); }
+
+    // Returns the index of the given frame number, or NAME_NOT_FOUND.
+    ssize_t indexOfKey(uint32_t frameNumber) const {
+        if (mEntries.empty() || frameNumber < mEntries.front().first) {
+            return NAME_NOT_FOUND;
+        }
+        size_t offset = frameNumber - mEntries.front().first;
+        if (offset < mEntries.size() && mEntries[offset].first == frameNumber) {
+            return offset;
+        }
+        auto it = lowerBound(frameNumber);
+        if (it == mEntries.end() || it->first != frameNumber) {
+            return NAME_NOT_FOUND;
+        }
+        return it - mEntries.begin();
+    }
+
+    uint32_t keyAt(size_t index) const { return mEntries[index].first; }
+    const InFlightRequest& valueAt(size_t index) const { return *mEntries[index].second; }
+    InFlightRequest& editValueAt(size_t index) { return *mEntries[index].second; }
+    const InFlightRequest& valueFor(uint32_t frameNumber) const {
+        ssize_t index = indexOfKey(frameNumber);
+        LOG_ALWAYS_FATAL_IF(index < 0, "%s: frame number %u not found", __FUNCTION__,
+                frameNumber);
+        return valueAt(index);
+    }
+
+    // Adds the request of the given frame number, replacing any existing
+    // request of the same frame number. Returns the index of the request.
+    ssize_t add(uint32_t frameNumber, InFlightRequest request) {
+        auto value = std::make_unique<InFlightRequest>(std::move(request));
+        if (mEntries.empty() || frameNumber > mEntries.back().first) {
+            mEntries.emplace_back(frameNumber, std::move(value));
+            return mEntries.size() - 1;
+        }
+        auto it = lowerBound(frameNumber);
+        if (it != mEntries.end() && it->first == frameNumber) {
+            it->second = std::move(value);
+        } else {
+            it = mEntries.emplace(it, frameNumber, std::move(value));
+        }
+        return it - mEntries.begin();
+    }
+
+    void removeItemsAt(size_t index, size_t count = 1) {
+        auto first = mEntries.begin() + index;
+        mEntries.erase(first, first + count);
+    }
+
+    void clear() { mEntries.clear(); }
+
+  private:
+    typedef std::deque<std::pair<uint32_t, std::unique_ptr<InFlightRequest>>> Entries;
+
+    Entries::const_iterator lowerBound(uint32_t frameNumber) const {
+        return std::lower_bound(mEntries.begin(), mEntries.end(), frameNumber,
+                [](const Entries::value_type& entry, uint32_t key) {
+                    return entry.first < key;
+                });
+    }
+    Entries::iterator lowerBound(uint32_t frameNumber) {
+        return std::lower_bound(mEntries.begin(), mEntries.end(), frameNumber,
+                [](const Entries::value_type& entry, uint32_t key) {
+                    return entry.first < key;
+                });
+    }
+
+    Entries mEntries;
+};
 
 } // namespace camera3
 
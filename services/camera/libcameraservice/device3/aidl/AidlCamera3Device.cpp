@@ -375,6 +375,7 @@ status_t AidlCamera3Device::initialize(sp<CameraProviderManager> manager,
         mNextReprocessShutterFrameNumber, mNextZslStillShutterFrameNumber,
         mNextResultFrameNumber,
         mNextReprocessResultFrameNumber, mNextZslStillResultFrameNumber,
+        mResultMetadataCapacity,
         mUseHalBufManager, mUsePartialResult, mNeedFixupMonochromeTags,
         mNumPartialResults, mVendorTagId, mDeviceInfo, mPhysicalDeviceInfoMap,
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
@@ -417,6 +418,7 @@ status_t AidlCamera3Device::initialize(sp<CameraProviderManager> manager,
         mNextReprocessShutterFrameNumber, mNextZslStillShutterFrameNumber,
         mNextResultFrameNumber,
         mNextReprocessResultFrameNumber, mNextZslStillResultFrameNumber,
+        mResultMetadataCapacity,
         mUseHalBufManager, mUsePartialResult, mNeedFixupMonochromeTags,
         mNumPartialResults, mVendorTagId, mDeviceInfo, mPhysicalDeviceInfoMap,
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
@@ -884,6 +886,7 @@ status_t AidlCamera3Device::AidlHalInterface::configureStreams(
     ATRACE_NAME("CameraHal::configureStreams");
     if (!valid()) return INVALID_OPERATION;
     status_t res = OK;
+    resetLastSettings();
 
     // Convert stream config to AIDL
     std::set<int> activeStreams;
@@ -1056,6 +1059,7 @@ status_t AidlCamera3Device::AidlHalInterface::configureInjectedStreams(
     ATRACE_NAME("InjectionCameraHal::configureStreams");
     if (!valid()) return INVALID_OPERATION;
     status_t res = OK;
+    resetLastSettings();
 
     if (config->input_is_multi_resolution) {
         ALOGE("%s: Injection camera device doesn't support multi-resolution input "
@@ -1199,18 +1203,23 @@ status_t AidlCamera3Device::AidlHalInterface::processBatchCaptureRequests(
 
     *numRequestProcessed = 0;
 
-    // Write metadata to FMQ.
+    // Write metadata to FMQ. Settings that are the same as the last ones sent are sent as
+    // empty metadata, which the HAL treats as a reuse of the last settings.
+    size_t fmqBytes = 0;
+    size_t binderBytes = 0;
     for (size_t i = 0; i < batchSize; i++) {
         camera_capture_request_t* request = requests[i];
         camera::device::CaptureRequest* captureRequest;
         captureRequest = &captureRequests[i];
 
-        if (request->settings != nullptr) {
+        bool skipSettings = skipUnchangedSettings(request);
+        if (!skipSettings) {
             size_t settingsSize = get_camera_metadata_size(request->settings);
             if (mRequestMetadataQueue != nullptr && mRequestMetadataQueue->write(
                     reinterpret_cast<const int8_t*>(request->settings), settingsSize)) {
                 captureRequest->settings.metadata.resize(0);
                 captureRequest->fmqSettingsSize = settingsSize;
+                fmqBytes += settingsSize;
             } else {
                 if (mRequestMetadataQueue != nullptr) {
                     ALOGW("%s: couldn't utilize fmq, fallback to hwbinder", __FUNCTION__);
@@ -1221,9 +1230,10 @@ status_t AidlCamera3Device::AidlHalInterface::processBatchCaptureRequests(
                 size_t settingsSize =  get_camera_metadata_size(request->settings);
                 captureRequest->settings.metadata.assign(settingsP, settingsP + settingsSize);
                 captureRequest->fmqSettingsSize = 0u;
+                binderBytes += settingsSize;
             }
         } else {
-            // A null request settings maps to a size-0 CameraMetadata
+            // Null or unchanged request settings map to a size-0 CameraMetadata
             captureRequest->settings.metadata.resize(0);
             captureRequest->fmqSettingsSize = 0u;
         }
@@ -1235,13 +1245,14 @@ status_t AidlCamera3Device::AidlHalInterface::processBatchCaptureRequests(
                 captureRequest->physicalCameraSettings;
         physicalCameraSettings.resize(request->num_physcam_settings);
         for (size_t j = 0; j < request->num_physcam_settings; j++) {
-            if (request->physcam_settings != nullptr) {
+            if (!skipSettings && request->physcam_settings != nullptr) {
                 size_t settingsSize = get_camera_metadata_size(request->physcam_settings[j]);
                 if (mRequestMetadataQueue != nullptr && mRequestMetadataQueue->write(
                             reinterpret_cast<const int8_t*>(request->physcam_settings[j]),
                             settingsSize)) {
                     physicalCameraSettings[j].settings.metadata.resize(0);
                     physicalCameraSettings[j].fmqSettingsSize = settingsSize;
+                    fmqBytes += settingsSize;
                 } else {
                     if (mRequestMetadataQueue != nullptr) {
                         ALOGW("%s: couldn't utilize fmq, fallback to hwbinder", __FUNCTION__);
@@ -1252,6 +1263,7 @@ status_t AidlCamera3Device::AidlHalInterface::processBatchCaptureRequests(
                     physicalCameraSettings[j].settings.metadata.assign(physicalSettingsP,
                             physicalSettingsP + settingsSize);
                     physicalCameraSettings[j].fmqSettingsSize = 0u;
+                    binderBytes += settingsSize;
                 }
             } else {
                 physicalCameraSettings[j].fmqSettingsSize = 0u;
@@ -1260,6 +1272,7 @@ status_t AidlCamera3Device::AidlHalInterface::processBatchCaptureRequests(
             physicalCameraSettings[j].physicalCameraId = request->physcam_id[j];
         }
     }
+    addRequestSettingsBytes(fmqBytes, binderBytes);
 
     int32_t numRequests = 0;
     auto retS = mAidlSession->processCaptureRequest(captureRequests, cachesToRemove,
@@ -1286,6 +1299,8 @@ status_t AidlCamera3Device::AidlHalInterface::processBatchCaptureRequests(
         }
     } else {
         ALOGE("%s Error with processCaptureRequest %s ", __FUNCTION__, retS.getMessage());
+        // The HAL may not have received the settings recorded as the last ones sent
+        resetLastSettings();
         mBufferRecords.popInflightBuffers(inflightBuffers);
         cleanupNativeHandles(&handlesCreated);
     }
@@ -233,6 +233,7 @@ void requestStreamBuffers(RequestBufferStates& states,
             // Since this method can run concurrently with request thread
             // We need to update the wait duration everytime we call getbuffer
             nsecs_t waitDuration =  states.reqBufferIntf.getWaitDuration();
+            nsecs_t dequeueStartTime = systemTime();
             status_t res = outputStream->getBuffer(&sb, waitDuration);
             if (res != OK) {
                 if (res == NO_INIT || res == DEAD_OBJECT) {
@@ -254,6 +255,9 @@ void requestStreamBuffers(RequestBufferStates& states,
                 currentReqSucceeds = false;
                 break;
             }
+            states.sessionStatsBuilder.addStageLatency(
+                    hardware::CameraLatencyStats::LATENCY_STAGE_DEQUEUE_BUFFER,
+                    dequeueStartTime, systemTime());
             numAllocatedBuffers++;
 
             buffer_handle_t *buffer = sb.buffer;
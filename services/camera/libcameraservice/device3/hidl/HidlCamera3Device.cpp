@@ -361,6 +361,7 @@ hardware::Return<void> HidlCamera3Device::processCaptureResult_3_4(
         mNextReprocessShutterFrameNumber, mNextZslStillShutterFrameNumber,
         mNextResultFrameNumber,
         mNextReprocessResultFrameNumber, mNextZslStillResultFrameNumber,
+        mResultMetadataCapacity,
         mUseHalBufManager, mUsePartialResult, mNeedFixupMonochromeTags,
         mNumPartialResults, mVendorTagId, mDeviceInfo, mPhysicalDeviceInfoMap,
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
@@ -424,6 +425,7 @@ hardware::Return<void> HidlCamera3Device::processCaptureResult(
         mNextReprocessShutterFrameNumber, mNextZslStillShutterFrameNumber,
         mNextResultFrameNumber,
         mNextReprocessResultFrameNumber, mNextZslStillResultFrameNumber,
+        mResultMetadataCapacity,
         mUseHalBufManager, mUsePartialResult, mNeedFixupMonochromeTags,
         mNumPartialResults, mVendorTagId, mDeviceInfo, mPhysicalDeviceInfoMap,
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
@@ -472,6 +474,7 @@ hardware::Return<void> HidlCamera3Device::notifyHelper(
         mNextReprocessShutterFrameNumber, mNextZslStillShutterFrameNumber,
         mNextResultFrameNumber,
         mNextReprocessResultFrameNumber, mNextZslStillResultFrameNumber,
+        mResultMetadataCapacity,
         mUseHalBufManager, mUsePartialResult, mNeedFixupMonochromeTags,
         mNumPartialResults, mVendorTagId, mDeviceInfo, mPhysicalDeviceInfoMap,
         mDistortionMappers, mZoomRatioMappers, mRotateAndCropMappers,
@@ -886,6 +889,7 @@ status_t HidlCamera3Device::HidlHalInterface::configureStreams(
     ATRACE_NAME("CameraHal::configureStreams");
     if (!valid()) return INVALID_OPERATION;
     status_t res = OK;
+    resetLastSettings();
 
     if (config->input_is_multi_resolution && mHidlSession_3_7 == nullptr) {
         ALOGE("%s: Camera device doesn't support multi-resolution input stream", __FUNCTION__);
@@ -1199,6 +1203,7 @@ status_t HidlCamera3Device::HidlHalInterface::configureInjectedStreams(
     ATRACE_NAME("InjectionCameraHal::configureStreams");
     if (!valid()) return INVALID_OPERATION;
     status_t res = OK;
+    resetLastSettings();
 
     if (config->input_is_multi_resolution) {
         ALOGE("%s: Injection camera device doesn't support multi-resolution input "
@@ -1540,7 +1545,10 @@ status_t HidlCamera3Device::HidlHalInterface::processBatchCaptureRequests(
     common::V1_0::Status status = common::V1_0::Status::INTERNAL_ERROR;
     *numRequestProcessed = 0;
 
-    // Write metadata to FMQ.
+    // Write metadata to FMQ. Settings that are the same as the last ones sent are sent as
+    // empty metadata, which the HAL treats as a reuse of the last settings.
+    size_t fmqBytes = 0;
+    size_t binderBytes = 0;
     for (size_t i = 0; i < batchSize; i++) {
         camera_capture_request_t* request = requests[i];
         device::V3_2::CaptureRequest* captureRequest;
@@ -1552,12 +1560,14 @@ status_t HidlCamera3Device::HidlHalInterface::processBatchCaptureRequests(
             captureRequest = &captureRequests[i];
         }
 
-        if (request->settings != nullptr) {
+        bool skipSettings = skipUnchangedSettings(request);
+        if (!skipSettings) {
             size_t settingsSize = get_camera_metadata_size(request->settings);
             if (mRequestMetadataQueue != nullptr && mRequestMetadataQueue->write(
                     reinterpret_cast<const uint8_t*>(request->settings), settingsSize)) {
                 captureRequest->settings.resize(0);
                 captureRequest->fmqSettingsSize = settingsSize;
+                fmqBytes += settingsSize;
             } else {
                 if (mRequestMetadataQueue != nullptr) {
                     ALOGW("%s: couldn't utilize fmq, fallback to hwbinder", __FUNCTION__);
@@ -1565,11 +1575,12 @@ status_t HidlCamera3Device::HidlHalInterface::processBatchCaptureRequests(
                 captureRequest->settings.setToExternal(
                         reinterpret_cast<uint8_t*>(const_cast<camera_metadata_t*>(
                                 request->settings)),
-                        get_camera_metadata_size(request->settings));
+                        settingsSize);
                 captureRequest->fmqSettingsSize = 0u;
+                binderBytes += settingsSize;
             }
         } else {
-            // A null request settings maps to a size-0 CameraMetadata
+            // Null or unchanged request settings map to a size-0 CameraMetadata
             captureRequest->settings.resize(0);
             captureRequest->fmqSettingsSize = 0u;
         }
@@ -1588,13 +1599,14 @@ status_t HidlCamera3Device::HidlHalInterface::processBatchCaptureRequests(
                     captureRequests_3_4[i].physicalCameraSettings;
             physicalCameraSettings.resize(request->num_physcam_settings);
             for (size_t j = 0; j < request->num_physcam_settings; j++) {
-                if (request->physcam_settings != nullptr) {
+                if (!skipSettings && request->physcam_settings != nullptr) {
                     size_t settingsSize = get_camera_metadata_size(request->physcam_settings[j]);
                     if (mRequestMetadataQueue != nullptr && mRequestMetadataQueue->write(
                                 reinterpret_cast<const uint8_t*>(request->physcam_settings[j]),
                                 settingsSize)) {
                         physicalCameraSettings[j].settings.resize(0);
                         physicalCameraSettings[j].fmqSettingsSize = settingsSize;
+                        fmqBytes += settingsSize;
                     } else {
                         if (mRequestMetadataQueue != nullptr) {
                             ALOGW("%s: couldn't utilize fmq, fallback to hwbinder", __FUNCTION__);
@@ -1602,8 +1614,9 @@ status_t HidlCamera3Device::HidlHalInterface::processBatchCaptureRequests(
                         physicalCameraSettings[j].settings.setToExternal(
                                 reinterpret_cast<uint8_t*>(const_cast<camera_metadata_t*>(
                                         request->physcam_settings[j])),
-                                get_camera_metadata_size(request->physcam_settings[j]));
+                                settingsSize);
                         physicalCameraSettings[j].fmqSettingsSize = 0u;
+                        binderBytes += settingsSize;
                     }
                 } else {
                     physicalCameraSettings[j].fmqSettingsSize = 0u;
@@ -1613,6 +1626,7 @@ status_t HidlCamera3Device::HidlHalInterface::processBatchCaptureRequests(
             }
         }
     }
+    addRequestSettingsBytes(fmqBytes, binderBytes);
 
     hardware::details::return_status err;
     auto resultCallback =
@@ -1652,6 +1666,8 @@ status_t HidlCamera3Device::HidlHalInterface::processBatchCaptureRequests(
             cleanupNativeHandles(&handlesCreated);
         }
     } else {
+        // The HAL may not have received the settings recorded as the last ones sent
+        resetLastSettings();
         mBufferRecords.popInflightBuffers(inflightBuffers);
         cleanupNativeHandles(&handlesCreated);
     }
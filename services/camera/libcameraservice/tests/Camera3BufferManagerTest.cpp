@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "Camera3BufferManagerTest"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <cutils/native_handle.h>
+#include <gtest/gtest.h>
+#include <ui/GraphicBuffer.h>
+
+#include "../device3/Camera3BufferManager.h"
+
+namespace android {
+namespace camera3 {
+
+// 2048x2048 RGBA_8888 buffers take 16 MiB, so four of them fill the pool.
+static const uint32_t kWidth = 2048;
+static const uint32_t kHeight = 2048;
+static const uint32_t kFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+static const uint64_t kUsage = GRALLOC_USAGE_HW_CAMERA_WRITE | GRALLOC_USAGE_HW_TEXTURE;
+static const size_t kBufferBytes = kWidth * kHeight * 4;
+
+static bool isFdOpen(int fd) {
+    return fcntl(fd, F_GETFD) != -1 || errno != EBADF;
+}
+
+// Exercises the buffer pool of Camera3BufferManager directly, with buffers wrapping an empty
+// native handle, so that no Gralloc allocation is needed.
+class Camera3BufferManagerTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mHandle = native_handle_create(/*numFds*/0, /*numInts*/0);
+        ASSERT_NE(nullptr, mHandle);
+        mManager = new Camera3BufferManager();
+    }
+
+    void TearDown() override {
+        mManager.clear();
+        for (int fd : mFds) {
+            close(fd);
+        }
+        native_handle_delete(mHandle);
+    }
+
+    sp<GraphicBuffer> createBuffer(uint32_t width = kWidth, uint32_t height = kHeight,
+            uint32_t format = kFormat, uint64_t usage = kUsage) {
+        return new GraphicBuffer(mHandle, GraphicBuffer::WRAP_HANDLE, width, height,
+                static_cast<PixelFormat>(format), /*layerCount*/1, usage, /*stride*/width);
+    }
+
+    // Returns the read end of a new pipe, standing in for a fence fd.
+    int createFence() {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            return -1;
+        }
+        // The write end is kept open until the end of the test, and closed in TearDown.
+        mFds.push_back(fds[1]);
+        return fds[0];
+    }
+
+    void returnBuffer(const sp<GraphicBuffer>& buffer, int fenceFd = -1) {
+        Mutex::Autolock l(mManager->mLock);
+        mManager->returnBufferToPoolLocked(buffer, fenceFd);
+    }
+
+    bool takeBuffer(uint32_t width, uint32_t height, uint32_t format, uint64_t usage,
+            sp<GraphicBuffer>* buffer, int* fenceFd = nullptr) {
+        StreamInfo info(/*id*/0, /*setId*/0, width, height, format, HAL_DATASPACE_UNKNOWN, usage);
+        Camera3BufferManager::GraphicBufferEntry entry;
+        Mutex::Autolock l(mManager->mLock);
+        if (!mManager->takeBufferFromPoolLocked(info, &entry)) {
+            return false;
+        }
+        *buffer = entry.graphicBuffer;
+        if (fenceFd != nullptr) {
+            *fenceFd = entry.fenceFd;
+        } else if (entry.fenceFd >= 0) {
+            close(entry.fenceFd);
+        }
+        return true;
+    }
+
+    std::vector<GraphicBuffer*> pooledBuffers() {
+        std::vector<GraphicBuffer*> buffers;
+        Mutex::Autolock l(mManager->mLock);
+        for (auto& pooledBuffer : mManager->mBufferPool) {
+            buffers.push_back(pooledBuffer.entry.graphicBuffer.get());
+        }
+        return buffers;
+    }
+
+    size_t pooledBufferBytes() {
+        Mutex::Autolock l(mManager->mLock);
+        return mManager->mPooledBufferBytes;
+    }
+
+    size_t evictedBufferCount() {
+        Mutex::Autolock l(mManager->mLock);
+        return mManager->mPoolEvictedBufferCount;
+    }
+
+    size_t reusedBufferCount() {
+        Mutex::Autolock l(mManager->mLock);
+        return mManager->mPoolReusedBufferCount;
+    }
+
+    native_handle_t* mHandle = nullptr;
+    sp<Camera3BufferManager> mManager;
+    std::vector<int> mFds;
+};
+
+// The pool holds up to 64 MiB, and frees the least recently returned buffers beyond that.
+TEST_F(Camera3BufferManagerTest, EvictsLeastRecentlyReturnedBuffers) {
+    std::vector<sp<GraphicBuffer>> buffers;
+    for (int i = 0; i < 6; i++) {
+        buffers.push_back(createBuffer());
+    }
+
+    for (int i = 0; i < 4; i++) {
+        returnBuffer(buffers[i]);
+    }
+    EXPECT_EQ(4 * kBufferBytes, pooledBufferBytes());
+    EXPECT_EQ(0u, evictedBufferCount());
+
+    returnBuffer(buffers[4]);
+    EXPECT_EQ((std::vector<GraphicBuffer*>{buffers[1].get(), buffers[2].get(),
+            buffers[3].get(), buffers[4].get()}), pooledBuffers());
+    EXPECT_EQ(4 * kBufferBytes, pooledBufferBytes());
+    EXPECT_EQ(1u, evictedBufferCount());
+
+    // Taking a buffer out makes it the most recent again once it is returned.
+    sp<GraphicBuffer> buffer;
+    ASSERT_TRUE(takeBuffer(kWidth, kHeight, kFormat, kUsage, &buffer));
+    EXPECT_EQ(buffers[4], buffer);
+    ASSERT_TRUE(takeBuffer(kWidth, kHeight, kFormat, kUsage, &buffer));
+    EXPECT_EQ(buffers[3], buffer);
+    EXPECT_EQ(2 * kBufferBytes, pooledBufferBytes());
+    returnBuffer(buffers[3]);
+    returnBuffer(buffers[5]);
+    returnBuffer(buffers[4]);
+    EXPECT_EQ((std::vector<GraphicBuffer*>{buffers[2].get(), buffers[3].get(),
+            buffers[5].get(), buffers[4].get()}), pooledBuffers());
+    EXPECT_EQ(2u, evictedBufferCount());
+    EXPECT_EQ(4 * kBufferBytes, pooledBufferBytes());
+}
+
+// The pool owns the fence fds of its buffers: it hands them out with the buffer, and closes them
+// when it frees the buffer.
+TEST_F(Camera3BufferManagerTest, OwnsFenceFds) {
+    std::vector<sp<GraphicBuffer>> buffers;
+    std::vector<int> fences;
+    for (int i = 0; i < 5; i++) {
+        buffers.push_back(createBuffer());
+        fences.push_back(createFence());
+        ASSERT_GE(fences[i], 0);
+    }
+
+    for (int i = 0; i < 5; i++) {
+        returnBuffer(buffers[i], fences[i]);
+    }
+    EXPECT_FALSE(isFdOpen(fences[0]));
+    for (int i = 1; i < 5; i++) {
+        EXPECT_TRUE(isFdOpen(fences[i]));
+    }
+
+    sp<GraphicBuffer> buffer;
+    int fenceFd = -1;
+    ASSERT_TRUE(takeBuffer(kWidth, kHeight, kFormat, kUsage, &buffer, &fenceFd));
+    EXPECT_EQ(buffers[4], buffer);
+    EXPECT_EQ(fences[4], fenceFd);
+    EXPECT_TRUE(isFdOpen(fenceFd));
+    close(fenceFd);
+
+    // A fence that comes without a buffer is closed right away.
+    int fence = createFence();
+    ASSERT_GE(fence, 0);
+    returnBuffer(nullptr, fence);
+    EXPECT_FALSE(isFdOpen(fence));
+
+    // The remaining ones are closed with the buffer manager.
+    mManager.clear();
+    for (int i = 1; i < 4; i++) {
+        EXPECT_FALSE(isFdOpen(fences[i]));
+    }
+}
+
+// Pooled buffers are only handed out for the exact same dimensions, format and usage.
+TEST_F(Camera3BufferManagerTest, MatchesExactBufferProperties) {
+    sp<GraphicBuffer> older = createBuffer(640, 480);
+    sp<GraphicBuffer> newer = createBuffer(640, 480);
+    returnBuffer(older);
+    returnBuffer(newer);
+
+    sp<GraphicBuffer> buffer;
+    EXPECT_FALSE(takeBuffer(641, 480, kFormat, kUsage, &buffer));
+    EXPECT_FALSE(takeBuffer(640, 481, kFormat, kUsage, &buffer));
+    EXPECT_FALSE(takeBuffer(480, 640, kFormat, kUsage, &buffer));
+    EXPECT_FALSE(takeBuffer(640, 480, HAL_PIXEL_FORMAT_RGBX_8888, kUsage, &buffer));
+    EXPECT_FALSE(takeBuffer(640, 480, kFormat, kUsage | GRALLOC_USAGE_SW_READ_OFTEN, &buffer));
+    EXPECT_FALSE(takeBuffer(640, 480, kFormat, GRALLOC_USAGE_HW_CAMERA_WRITE, &buffer));
+    EXPECT_EQ(0u, reusedBufferCount());
+    EXPECT_EQ(2u, pooledBuffers().size());
+
+    ASSERT_TRUE(takeBuffer(640, 480, kFormat, kUsage, &buffer));
+    EXPECT_EQ(newer, buffer);
+    ASSERT_TRUE(takeBuffer(640, 480, kFormat, kUsage, &buffer));
+    EXPECT_EQ(older, buffer);
+    EXPECT_FALSE(takeBuffer(640, 480, kFormat, kUsage, &buffer));
+    EXPECT_EQ(2u, reusedBufferCount());
+    EXPECT_EQ(0u, pooledBufferBytes());
+}
+
+} // namespace camera3
+} // namespace android
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "CameraMetadataTest"
+
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <android-base/chrono_utils.h>
+#include <android-base/stringprintf.h>
+#include <camera/CameraMetadata.h>
+#include <utils/Errors.h>
+
+using namespace android;
+
+struct TestEntry {
+    uint32_t tag;
+    size_t count;
+};
+
+// Entries of a typical capture result of a full-featured camera, as sent by the HAL.
+const std::vector<TestEntry> kResultEntries = {
+    {ANDROID_BLACK_LEVEL_LOCK, 1},
+    {ANDROID_COLOR_CORRECTION_ABERRATION_MODE, 1},
+    {ANDROID_COLOR_CORRECTION_GAINS, 4},
+    {ANDROID_COLOR_CORRECTION_MODE, 1},
+    {ANDROID_COLOR_CORRECTION_TRANSFORM, 9},
+    {ANDROID_CONTROL_AE_ANTIBANDING_MODE, 1},
+    {ANDROID_CONTROL_AE_EXPOSURE_COMPENSATION, 1},
+    {ANDROID_CONTROL_AE_LOCK, 1},
+    {ANDROID_CONTROL_AE_MODE, 1},
+    {ANDROID_CONTROL_AE_REGIONS, 5},
+    {ANDROID_CONTROL_AE_STATE, 1},
+    {ANDROID_CONTROL_AE_TARGET_FPS_RANGE, 2},
+    {ANDROID_CONTROL_AF_MODE, 1},
+    {ANDROID_CONTROL_AF_REGIONS, 5},
+    {ANDROID_CONTROL_AF_STATE, 1},
+    {ANDROID_CONTROL_AF_TRIGGER, 1},
+    {ANDROID_CONTROL_AWB_LOCK, 1},
+    {ANDROID_CONTROL_AWB_MODE, 1},
+    {ANDROID_CONTROL_AWB_REGIONS, 5},
+    {ANDROID_CONTROL_AWB_STATE, 1},
+    {ANDROID_CONTROL_CAPTURE_INTENT, 1},
+    {ANDROID_CONTROL_EFFECT_MODE, 1},
+    {ANDROID_CONTROL_MODE, 1},
+    {ANDROID_CONTROL_SCENE_MODE, 1},
+    {ANDROID_CONTROL_VIDEO_STABILIZATION_MODE, 1},
+    {ANDROID_CONTROL_ZOOM_RATIO, 1},
+    {ANDROID_EDGE_MODE, 1},
+    {ANDROID_FLASH_MODE, 1},
+    {ANDROID_FLASH_STATE, 1},
+    {ANDROID_HOT_PIXEL_MODE, 1},
+    {ANDROID_JPEG_ORIENTATION, 1},
+    {ANDROID_JPEG_QUALITY, 1},
+    {ANDROID_LENS_APERTURE, 1},
+    {ANDROID_LENS_DISTORTION, 5},
+    {ANDROID_LENS_FILTER_DENSITY, 1},
+    {ANDROID_LENS_FOCAL_LENGTH, 1},
+    {ANDROID_LENS_FOCUS_DISTANCE, 1},
+    {ANDROID_LENS_FOCUS_RANGE, 2},
+    {ANDROID_LENS_INTRINSIC_CALIBRATION, 5},
+    {ANDROID_LENS_OPTICAL_STABILIZATION_MODE, 1},
+    {ANDROID_LENS_POSE_ROTATION, 4},
+    {ANDROID_LENS_POSE_TRANSLATION, 3},
+    {ANDROID_LENS_STATE, 1},
+    {ANDROID_NOISE_REDUCTION_MODE, 1},
+    {ANDROID_REQUEST_PIPELINE_DEPTH, 1},
+    {ANDROID_SCALER_CROP_REGION, 4},
+    {ANDROID_SENSOR_DYNAMIC_BLACK_LEVEL, 4},
+    {ANDROID_SENSOR_DYNAMIC_WHITE_LEVEL, 1},
+    {ANDROID_SENSOR_EXPOSURE_TIME, 1},
+    {ANDROID_SENSOR_FRAME_DURATION, 1},
+    {ANDROID_SENSOR_GREEN_SPLIT, 1},
+    {ANDROID_SENSOR_NEUTRAL_COLOR_POINT, 3},
+    {ANDROID_SENSOR_NOISE_PROFILE, 8},
+    {ANDROID_SENSOR_ROLLING_SHUTTER_SKEW, 1},
+    {ANDROID_SENSOR_SENSITIVITY, 1},
+    {ANDROID_SENSOR_TEST_PATTERN_MODE, 1},
+    {ANDROID_SENSOR_TIMESTAMP, 1},
+    {ANDROID_SHADING_MODE, 1},
+    {ANDROID_STATISTICS_FACE_DETECT_MODE, 1},
+    {ANDROID_STATISTICS_HOT_PIXEL_MAP_MODE, 1},
+    {ANDROID_STATISTICS_LENS_SHADING_MAP, 4 * 17 * 13},
+    {ANDROID_STATISTICS_LENS_SHADING_MAP_MODE, 1},
+    {ANDROID_STATISTICS_SCENE_FLICKER, 1},
+    {ANDROID_SYNC_FRAME_NUMBER, 1},
+    {ANDROID_TONEMAP_CURVE_BLUE, 64},
+    {ANDROID_TONEMAP_CURVE_GREEN, 64},
+    {ANDROID_TONEMAP_CURVE_RED, 64},
+    {ANDROID_TONEMAP_MODE, 1},
+};
+
+// Number of result entries sent as partial results before the final result.
+constexpr size_t kPartialResultEntryCount = 12;
+
+// Tags looked up while a result is processed by the result path, including
+// tags that are usually absent.
+const std::vector<uint32_t> kLookedUpTags = {
+    ANDROID_SENSOR_TIMESTAMP,
+    ANDROID_SENSOR_DYNAMIC_BLACK_LEVEL,
+    ANDROID_SENSOR_NOISE_PROFILE,
+    ANDROID_STATISTICS_LENS_SHADING_MAP,
+    ANDROID_TONEMAP_CURVE_BLUE,
+    ANDROID_TONEMAP_CURVE_GREEN,
+    ANDROID_TONEMAP_CURVE_RED,
+    ANDROID_CONTROL_AE_REGIONS,
+    ANDROID_CONTROL_AF_REGIONS,
+    ANDROID_CONTROL_AWB_REGIONS,
+    ANDROID_SCALER_CROP_REGION,
+    ANDROID_CONTROL_ZOOM_RATIO,
+    ANDROID_LENS_DISTORTION,
+    ANDROID_LENS_INTRINSIC_CALIBRATION,
+    ANDROID_STATISTICS_FACE_RECTANGLES,
+    ANDROID_STATISTICS_FACE_LANDMARKS,
+    ANDROID_STATISTICS_OIS_X_SHIFTS,
+    ANDROID_STATISTICS_OIS_Y_SHIFTS,
+    ANDROID_CONTROL_AUTOFRAMING,
+    ANDROID_CONTROL_AUTOFRAMING_STATE,
+    ANDROID_CONTROL_SETTINGS_OVERRIDE,
+    ANDROID_SCALER_ROTATE_AND_CROP,
+    ANDROID_CONTROL_AE_MODE,
+    ANDROID_CONTROL_AF_MODE,
+    ANDROID_CONTROL_AWB_MODE,
+    ANDROID_CONTROL_AE_STATE,
+    ANDROID_CONTROL_AF_STATE,
+    ANDROID_CONTROL_AWB_STATE,
+    ANDROID_LENS_STATE,
+    ANDROID_FLASH_STATE,
+};
+
+// Fills the metadata entry of a tag with count values derived from seed.
+void updateEntry(CameraMetadata *metadata, uint32_t tag, size_t count, int seed) {
+    switch (get_camera_metadata_tag_type(tag)) {
+        case TYPE_BYTE: {
+            std::vector<uint8_t> data(count, static_cast<uint8_t>(seed));
+            metadata->update(tag, data.data(), count);
+            break;
+        }
+        case TYPE_INT32: {
+            std::vector<int32_t> data(count, seed);
+            metadata->update(tag, data.data(), count);
+            break;
+        }
+        case TYPE_FLOAT: {
+            std::vector<float> data(count, seed * 0.5f);
+            metadata->update(tag, data.data(), count);
+            break;
+        }
+        case TYPE_INT64: {
+            std::vector<int64_t> data(count, seed * 1000000LL);
+            metadata->update(tag, data.data(), count);
+            break;
+        }
+        case TYPE_DOUBLE: {
+            std::vector<double> data(count, seed * 0.25);
+            metadata->update(tag, data.data(), count);
+            break;
+        }
+        case TYPE_RATIONAL: {
+            std::vector<camera_metadata_rational_t> data(count, {seed, 128});
+            metadata->update(tag, data.data(), count);
+            break;
+        }
+        default:
+            FAIL() << "Unknown type for tag " << tag;
+    }
+}
+
+// Builds the partial and final results of a frame from kResultEntries.
+void createHalResults(int frame, CameraMetadata *partialResult, CameraMetadata *finalResult) {
+    for (size_t i = 0; i < kResultEntries.size(); i++) {
+        updateEntry(i < kPartialResultEntryCount ? partialResult : finalResult,
+                kResultEntries[i].tag, kResultEntries[i].count, frame + i);
+    }
+}
+
+// Replays the result processing of Camera3OutputUtils::sendCaptureResult, the
+// mappers and the tag monitor on a final result of a frame.
+void processResult(const CameraMetadata &pendingResult, const CameraMetadata &partialResult,
+        int frame, bool useTagIndex, CameraMetadata *result) {
+    if (useTagIndex) {
+        result->reserve(kResultEntries.size() + 8,
+                pendingResult.dataCount() + partialResult.dataCount() + 64);
+        result->append(pendingResult);
+    } else {
+        *result = pendingResult;
+    }
+    result->append(partialResult);
+    result->sort();
+    if (useTagIndex) {
+        result->enableTagIndex();
+    }
+
+    for (uint32_t tag : kLookedUpTags) {
+        result->find(tag);
+    }
+    int32_t cropRegion[] = {0, 0, 4000 - frame % 100, 3000 - frame % 100};
+    result->update(ANDROID_SCALER_CROP_REGION, cropRegion, 4);
+    float zoomRatio = 1.0f;
+    result->update(ANDROID_CONTROL_ZOOM_RATIO, &zoomRatio, 1);
+    uint8_t autoframing = ANDROID_CONTROL_AUTOFRAMING_OFF;
+    result->update(ANDROID_CONTROL_AUTOFRAMING, &autoframing, 1);
+    uint8_t autoframingState = ANDROID_CONTROL_AUTOFRAMING_STATE_INACTIVE;
+    result->update(ANDROID_CONTROL_AUTOFRAMING_STATE, &autoframingState, 1);
+    for (uint32_t tag : kLookedUpTags) {
+        const CameraMetadata &constResult = *result;
+        constResult.find(tag);
+    }
+    int32_t frameCount = frame;
+    result->update(ANDROID_REQUEST_FRAME_COUNT, &frameCount, 1);
+    int32_t requestId = 1;
+    result->update(ANDROID_REQUEST_ID, &requestId, 1);
+}
+
+// Checks that two metadata have the same entries.
+void expectSameEntries(const CameraMetadata &expected, const CameraMetadata &actual,
+        const std::vector<uint32_t> &tags) {
+    EXPECT_EQ(expected.entryCount(), actual.entryCount());
+    for (uint32_t tag : tags) {
+        camera_metadata_ro_entry_t expectedEntry = expected.find(tag);
+        camera_metadata_ro_entry_t actualEntry = actual.find(tag);
+        ASSERT_EQ(expectedEntry.count, actualEntry.count) << "tag " << tag;
+        EXPECT_EQ(expected.exists(tag), actual.exists(tag)) << "tag " << tag;
+        if (expectedEntry.count > 0) {
+            EXPECT_EQ(0, memcmp(expectedEntry.data.u8, actualEntry.data.u8,
+                    expectedEntry.count * camera_metadata_type_size[expectedEntry.type]))
+                    << "tag " << tag;
+        }
+    }
+}
+
+std::vector<uint32_t> allTestTags() {
+    std::vector<uint32_t> tags = kLookedUpTags;
+    for (const TestEntry &entry : kResultEntries) {
+        tags.push_back(entry.tag);
+    }
+    tags.push_back(ANDROID_REQUEST_FRAME_COUNT);
+    tags.push_back(ANDROID_REQUEST_ID);
+    return tags;
+}
+
+TEST(CameraMetadataTest, TagIndexMatchesSearch) {
+    const std::vector<uint32_t> tags = allTestTags();
+    CameraMetadata indexed;
+    CameraMetadata plain;
+    indexed.enableTagIndex();
+
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<size_t> tagDist(0, kResultEntries.size() - 1);
+    std::uniform_int_distribution<int> opDist(0, 9);
+    for (int i = 0; i < 2000; i++) {
+        const TestEntry &entry = kResultEntries[tagDist(gen)];
+        switch (opDist(gen)) {
+            case 0:
+            case 1:
+                ASSERT_EQ(OK, indexed.erase(entry.tag));
+                ASSERT_EQ(OK, plain.erase(entry.tag));
+                break;
+            case 2: {
+                // Duplicated tags are found in any order in sorted metadata,
+                // so only append tags that are not there yet.
+                CameraMetadata other;
+                updateEntry(&other, entry.tag, entry.count, i);
+                ASSERT_EQ(OK, indexed.erase(entry.tag));
+                ASSERT_EQ(OK, plain.erase(entry.tag));
+                ASSERT_EQ(OK, indexed.append(other));
+                ASSERT_EQ(OK, plain.append(other));
+                break;
+            }
+            case 3:
+                ASSERT_EQ(OK, indexed.sort());
+                ASSERT_EQ(OK, plain.sort());
+                break;
+            default:
+                updateEntry(&indexed, entry.tag, entry.count, i);
+                updateEntry(&plain, entry.tag, entry.count, i);
+                break;
+        }
+        if (::testing::Test::HasFatalFailure()) return;
+        if (i % 97 == 0) {
+            // Replacing the buffer drops the index until it is rebuilt.
+            indexed = plain;
+        }
+        expectSameEntries(plain, indexed, tags);
+        if (::testing::Test::HasFatalFailure()) return;
+    }
+}
+
+TEST(CameraMetadataTest, TagIndexSurvivesBufferReplacement) {
+    const std::vector<uint32_t> tags = allTestTags();
+    CameraMetadata partial, pending;
+    createHalResults(0, &partial, &pending);
+
+    CameraMetadata indexed;
+    indexed.enableTagIndex();
+    indexed = pending;
+    expectSameEntries(pending, indexed, tags);
+
+    indexed.clear();
+    EXPECT_TRUE(indexed.isEmpty());
+    EXPECT_FALSE(indexed.exists(ANDROID_SENSOR_TIMESTAMP));
+
+    indexed.append(partial);
+    indexed.append(pending);
+    CameraMetadata expected(partial);
+    expected.append(pending);
+    expectSameEntries(expected, indexed, tags);
+
+    camera_metadata_t *buffer = indexed.release();
+    EXPECT_TRUE(indexed.isEmpty());
+    indexed.acquire(buffer);
+    expectSameEntries(expected, indexed, tags);
+
+    size_t entryCount = indexed.entryCount();
+    ASSERT_EQ(OK, indexed.reserve(entryCount + 16, indexed.dataCount() + 4096));
+    size_t bufferSize = indexed.bufferSize();
+    for (uint32_t tag : {ANDROID_CONTROL_AUTOFRAMING, ANDROID_REQUEST_ID}) {
+        updateEntry(&indexed, tag, 1, 1);
+    }
+    EXPECT_EQ(bufferSize, indexed.bufferSize());
+    EXPECT_EQ(entryCount + 2, indexed.entryCount());
+}
+
+TEST(CameraMetadataTest, ReplayResultProcessing) {
+    constexpr int kNumFrames = 2000;
+    const std::vector<uint32_t> tags = allTestTags();
+
+    std::vector<CameraMetadata> partialResults(kNumFrames);
+    std::vector<CameraMetadata> pendingResults(kNumFrames);
+    for (int frame = 0; frame < kNumFrames; frame++) {
+        createHalResults(frame, &partialResults[frame], &pendingResults[frame]);
+    }
+
+    std::vector<CameraMetadata> searchedResults(kNumFrames);
+    base::Timer searchTimer;
+    for (int frame = 0; frame < kNumFrames; frame++) {
+        processResult(pendingResults[frame], partialResults[frame], frame,
+                /*useTagIndex*/false, &searchedResults[frame]);
+    }
+    auto searchDuration = searchTimer.duration();
+
+    std::vector<CameraMetadata> indexedResults(kNumFrames);
+    base::Timer indexTimer;
+    for (int frame = 0; frame < kNumFrames; frame++) {
+        processResult(pendingResults[frame], partialResults[frame], frame,
+                /*useTagIndex*/true, &indexedResults[frame]);
+    }
+    auto indexDuration = indexTimer.duration();
+
+    for (int frame = 0; frame < kNumFrames; frame += 100) {
+        expectSameEntries(searchedResults[frame], indexedResults[frame], tags);
+    }
+
+    float searchDurationPerFrameUs =
+            (std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(
+                searchDuration) / kNumFrames).count();
+    float indexDurationPerFrameUs =
+            (std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(
+                indexDuration) / kNumFrames).count();
+    RecordProperty("SearchDurationPerFrameUs",
+            base::StringPrintf("%f", searchDurationPerFrameUs));
+    RecordProperty("IndexDurationPerFrameUs",
+            base::StringPrintf("%f", indexDurationPerFrameUs));
+    ALOGV("%s: per frame: %f us with search, %f us with tag index", __FUNCTION__,
+            searchDurationPerFrameUs, indexDurationPerFrameUs);
+}
@@ -21,6 +21,9 @@
 #include <random>
 
 #include <gtest/gtest.h>
+#include <android-base/chrono_utils.h>
+#include <android-base/stringprintf.h>
+#include <utils/Log.h>
 
 #include "../common/DepthPhotoProcessor.h"
 #include "../utils/ExifUtils.h"
@@ -317,3 +320,51 @@ TEST(DepthProcessorTest, TestDephtPhotoPhysicalRotation) {
         ASSERT_EQ(confidenceMapHeight, expectedHeight);
     }
 }
+
+TEST(DepthProcessorTest, DepthMapSizePerformance) {
+    int jpegQuality = 95;
+    constexpr int kIterations = 10;
+
+    std::vector<uint8_t> colorJpegBuffer;
+    generateColorJpegBuffer(jpegQuality, ExifOrientation::ORIENTATION_0_DEGREES,
+            /*includeExif*/ true, /*switchDimensions*/ false, &colorJpegBuffer);
+
+    std::array<size_t, 2> depthMapSizes[] = {{160, 120}, {320, 240}, {640, 480}};
+    for (const auto& depthMapSize : depthMapSizes) {
+        std::vector<uint16_t> depth16Buffer(depthMapSize[0] * depthMapSize[1]);
+        std::default_random_engine gen(kSeed+1);
+        std::uniform_int_distribution<int> uniDist(0, UINT16_MAX - 1);
+        for (auto& value : depth16Buffer) {
+            value = uniDist(gen);
+        }
+
+        DepthPhotoInputFrame inputFrame;
+        inputFrame.mMainJpegBuffer = reinterpret_cast<const char*> (colorJpegBuffer.data());
+        inputFrame.mMainJpegSize = colorJpegBuffer.size();
+        // Worst case both depth and confidence maps have the same size as the main color image.
+        inputFrame.mMaxJpegSize = inputFrame.mMainJpegSize * 3;
+        inputFrame.mMainJpegWidth = kTestBufferWidth;
+        inputFrame.mMainJpegHeight = kTestBufferHeight;
+        inputFrame.mJpegQuality = jpegQuality;
+        inputFrame.mDepthMapBuffer = depth16Buffer.data();
+        inputFrame.mDepthMapWidth = inputFrame.mDepthMapStride = depthMapSize[0];
+        inputFrame.mDepthMapHeight = depthMapSize[1];
+        // Exercise the physical rotation path, which transposes the depth map.
+        inputFrame.mOrientation = DepthPhotoOrientation::DEPTH_ORIENTATION_90_DEGREES;
+
+        std::vector<uint8_t> depthPhotoBuffer(inputFrame.mMaxJpegSize);
+        size_t actualDepthPhotoSize = 0;
+        base::Timer timer;
+        for (int i = 0; i < kIterations; i++) {
+            ASSERT_EQ(processDepthPhotoFrame(inputFrame, depthPhotoBuffer.size(),
+                        depthPhotoBuffer.data(), &actualDepthPhotoSize), 0);
+        }
+        float durationMs = (std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+                timer.duration()) / kIterations).count();
+
+        auto sizeName = base::StringPrintf("%zux%zu", depthMapSize[0], depthMapSize[1]);
+        RecordProperty("DepthPhotoDurationMs_" + sizeName, base::StringPrintf("%f", durationMs));
+        ALOGV("%s: %s depth map: %f ms per depth photo", __FUNCTION__, sizeName.c_str(),
+                durationMs);
+    }
+}
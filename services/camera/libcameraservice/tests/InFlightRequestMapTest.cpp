@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "InFlightRequestMapTest"
+
+#include <random>
+
+#include <gtest/gtest.h>
+#include <android-base/chrono_utils.h>
+#include <android-base/stringprintf.h>
+#include <utils/KeyedVector.h>
+
+#include "../device3/InFlightRequest.h"
+
+using namespace android;
+using namespace android::camera3;
+
+// Returns an in-flight request carrying partial and pending result metadata,
+// as it does while waiting for the last buffers of a frame.
+static InFlightRequest createRequest(uint32_t frameNumber) {
+    InFlightRequest request(/*numBuffers*/2, CaptureResultExtras(), /*hasInput*/false,
+            /*hasAppCallback*/true, InFlightRequest::kDefaultMinExpectedDuration,
+            InFlightRequest::kDefaultMaxExpectedDuration, /*fixedFps*/true, {},
+            /*isStillCapture*/false, /*isZslCapture*/false, /*rotateAndCropAuto*/false,
+            /*autoframingAuto*/false, {}, /*requestNs*/0);
+    request.resultExtras.frameNumber = frameNumber;
+    int64_t timestamp = frameNumber;
+    request.pendingMetadata.update(ANDROID_SENSOR_TIMESTAMP, &timestamp, 1);
+    std::vector<float> tonemapCurve(2 * 64, 0.5f);
+    request.pendingMetadata.update(ANDROID_TONEMAP_CURVE_RED, tonemapCurve.data(),
+            tonemapCurve.size());
+    uint8_t aeState = ANDROID_CONTROL_AE_STATE_CONVERGED;
+    request.collectedPartialResult.update(ANDROID_CONTROL_AE_STATE, &aeState, 1);
+    return request;
+}
+
+TEST(InFlightRequestMapTest, MatchesKeyedVector) {
+    std::mt19937 gen(1234);
+    InFlightRequestMap map;
+    KeyedVector<uint32_t, int32_t> reference;
+    uint32_t nextFrameNumber = 0;
+
+    for (int i = 0; i < 20000; i++) {
+        switch (gen() % 4) {
+            case 0:
+            case 1: {
+                // Mostly in order, occasionally re-adding or filling an older frame number
+                uint32_t frameNumber = (gen() % 8 == 0) ? gen() % (nextFrameNumber + 1) :
+                        nextFrameNumber++;
+                InFlightRequest request;
+                request.numBuffersLeft = gen() % 1000;
+                ssize_t idx = map.add(frameNumber, request);
+                reference.add(frameNumber, request.numBuffersLeft);
+                ASSERT_GE(idx, 0);
+                EXPECT_EQ(map.keyAt(idx), frameNumber);
+                break;
+            }
+            case 2: {
+                if (reference.isEmpty()) break;
+                // Completions are mostly of the oldest request
+                size_t refIdx = (gen() % 3 == 0) ? gen() % reference.size() : 0;
+                uint32_t frameNumber = reference.keyAt(refIdx);
+                ssize_t idx = map.indexOfKey(frameNumber);
+                ASSERT_EQ(idx, static_cast<ssize_t>(refIdx));
+                map.removeItemsAt(idx, 1);
+                reference.removeItemsAt(refIdx, 1);
+                break;
+            }
+            default: {
+                uint32_t frameNumber = gen() % (nextFrameNumber + 1);
+                ssize_t idx = map.indexOfKey(frameNumber);
+                ASSERT_EQ(idx, reference.indexOfKey(frameNumber));
+                if (idx >= 0) {
+                    EXPECT_EQ(map.valueFor(frameNumber).numBuffersLeft,
+                            reference.valueFor(frameNumber));
+                }
+                break;
+            }
+        }
+        ASSERT_EQ(map.size(), reference.size());
+    }
+
+    for (size_t i = 0; i < reference.size(); i++) {
+        EXPECT_EQ(map.keyAt(i), reference.keyAt(i));
+        EXPECT_EQ(map.valueAt(i).numBuffersLeft, reference.valueAt(i));
+    }
+
+    InFlightRequestMap copy(map);
+    ASSERT_EQ(copy.size(), map.size());
+    if (!copy.isEmpty()) {
+        copy.editValueAt(0).numBuffersLeft = -1;
+        EXPECT_NE(map.valueAt(0).numBuffersLeft, -1);
+    }
+    copy.clear();
+    EXPECT_TRUE(copy.isEmpty());
+}
+
+TEST(InFlightRequestMapTest, HighSpeedRecording) {
+    // 240 fps high speed recording: 8 requests registered per batch, completed in order
+    constexpr int kNumBatches = 2000;
+    constexpr int kBatchSize = 8;
+    constexpr size_t kMaxInFlight = 32;
+
+    auto runFrames = [&](auto& map) {
+        uint32_t frameNumber = 0;
+        for (int batch = 0; batch < kNumBatches; batch++) {
+            for (int i = 0; i < kBatchSize; i++, frameNumber++) {
+                map.add(frameNumber, createRequest(frameNumber));
+            }
+            while (map.size() > kMaxInFlight - kBatchSize) {
+                ssize_t idx = map.indexOfKey(map.keyAt(0));
+                ASSERT_EQ(idx, 0);
+                map.editValueAt(idx).numBuffersLeft = 0;
+                map.removeItemsAt(idx, 1);
+            }
+        }
+    };
+
+    KeyedVector<uint32_t, InFlightRequest> keyedVector;
+    base::Timer keyedVectorTimer;
+    runFrames(keyedVector);
+    auto keyedVectorDuration = keyedVectorTimer.duration();
+
+    InFlightRequestMap map;
+    base::Timer mapTimer;
+    runFrames(map);
+    auto mapDuration = mapTimer.duration();
+
+    ASSERT_EQ(map.size(), keyedVector.size());
+    for (size_t i = 0; i < map.size(); i++) {
+        EXPECT_EQ(map.keyAt(i), keyedVector.keyAt(i));
+    }
+
+    float keyedVectorDurationPerFrameUs =
+            (std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(
+                keyedVectorDuration) / (kNumBatches * kBatchSize)).count();
+    float mapDurationPerFrameUs =
+            (std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(
+                mapDuration) / (kNumBatches * kBatchSize)).count();
+    RecordProperty("KeyedVectorDurationPerFrameUs",
+            base::StringPrintf("%f", keyedVectorDurationPerFrameUs));
+    RecordProperty("InFlightRequestMapDurationPerFrameUs",
+            base::StringPrintf("%f", mapDurationPerFrameUs));
+    ALOGV("%s: per frame: %f us with KeyedVector, %f us with InFlightRequestMap",
+            __FUNCTION__, keyedVectorDurationPerFrameUs, mapDurationPerFrameUs);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NDEBUG 0
+#define LOG_TAG "LatencyHistogramTest"
+
+#include <gtest/gtest.h>
+
+#include "../utils/LatencyHistogram.h"
+#include "../utils/SessionStatsBuilder.h"
+
+using namespace android;
+using namespace std::chrono_literals;
+using hardware::CameraLatencyStats;
+
+TEST(LatencyHistogramTest, Percentiles) {
+    CameraLatencyHistogram histogram(/*binSizeMs*/5, /*binCount*/41);
+    EXPECT_EQ(histogram.getPercentileMs(50), -1);
+    EXPECT_EQ(histogram.getMaxMs(), -1);
+
+    // 1, 2, ..., 100 ms
+    for (int i = 1; i <= 100; i++) {
+        histogram.add(0, ms2ns(i));
+    }
+    EXPECT_EQ(histogram.getTotalCount(), 100u);
+    // The 50th sample is 50 ms, in the [50, 55) bin
+    EXPECT_FLOAT_EQ(histogram.getPercentileMs(50), 55);
+    EXPECT_FLOAT_EQ(histogram.getPercentileMs(90), 95);
+    // Capped by the maximum latency
+    EXPECT_FLOAT_EQ(histogram.getPercentileMs(99), 100);
+    EXPECT_FLOAT_EQ(histogram.getMaxMs(), 100);
+
+    // Latencies beyond the last bin boundary are reported by the maximum
+    histogram.add(0, ms2ns(1000));
+    EXPECT_FLOAT_EQ(histogram.getPercentileMs(100), 1000);
+
+    std::vector<float> bins;
+    std::vector<int64_t> counts;
+    histogram.getBins(&bins, &counts);
+    ASSERT_EQ(bins.size(), 40u);
+    ASSERT_EQ(counts.size(), 41u);
+    EXPECT_FLOAT_EQ(bins.front(), 5);
+    EXPECT_FLOAT_EQ(bins.back(), 200);
+    EXPECT_EQ(counts.back(), 1);
+
+    histogram.reset();
+    EXPECT_EQ(histogram.getTotalCount(), 0u);
+    EXPECT_EQ(histogram.getPercentileMs(50), -1);
+}
+
+TEST(LatencyHistogramTest, SubMillisecondBins) {
+    CameraLatencyHistogram histogram(50us, /*binCount*/41);
+    histogram.add(0, us2ns(30));
+    histogram.add(0, us2ns(120));
+    histogram.add(0, us2ns(180));
+    EXPECT_FLOAT_EQ(histogram.getPercentileMs(50), 0.15f);
+    EXPECT_FLOAT_EQ(histogram.getMaxMs(), 0.18f);
+
+    // Negative durations are counted in the first bin
+    histogram.add(us2ns(10), 0);
+    EXPECT_FLOAT_EQ(histogram.getPercentileMs(25), 0.05f);
+}
+
+TEST(LatencyHistogramTest, SessionStatsBuilder) {
+    SessionStatsBuilder builder;
+    builder.addStageLatency(CameraLatencyStats::LATENCY_STAGE_SUBMIT_TO_SHUTTER, 0, ms2ns(40));
+    builder.addStageLatency(CameraLatencyStats::LATENCY_STAGE_RESULT_MAPPER, 0, us2ns(20));
+
+    int64_t requestCount, errorResultCount;
+    bool deviceError;
+    std::map<int, StreamStats> statsMap;
+    std::vector<CameraLatencyStats> latencyStats;
+    builder.buildAndReset(&requestCount, &errorResultCount, &deviceError, &statsMap,
+            &latencyStats);
+    ASSERT_EQ(latencyStats.size(), static_cast<size_t>(CameraLatencyStats::LATENCY_STAGE_COUNT));
+    for (size_t i = 0; i < latencyStats.size(); i++) {
+        const CameraLatencyStats& stats = latencyStats[i];
+        EXPECT_EQ(stats.mStage, static_cast<int>(i));
+        EXPECT_EQ(stats.mHistogramBins.size() + 1, stats.mHistogramCounts.size());
+        if (i == CameraLatencyStats::LATENCY_STAGE_SUBMIT_TO_SHUTTER) {
+            EXPECT_EQ(stats.mCount, 1);
+            EXPECT_FLOAT_EQ(stats.mP50Ms, 40);
+        } else if (i == CameraLatencyStats::LATENCY_STAGE_RESULT_MAPPER) {
+            EXPECT_EQ(stats.mCount, 1);
+            EXPECT_FLOAT_EQ(stats.mMaxMs, 0.02f);
+        } else {
+            EXPECT_EQ(stats.mCount, 0);
+            EXPECT_EQ(stats.mP50Ms, -1);
+        }
+    }
+
+    builder.buildAndReset(&requestCount, &errorResultCount, &deviceError, &statsMap,
+            &latencyStats);
+    for (const auto& stats : latencyStats) {
+        EXPECT_EQ(stats.mCount, 0);
+    }
+}
@@ -75,6 +75,22 @@ void CameraServiceProxyWrapper::CameraSessionStatsWrapper::onStreamConfigured(
     }
 }
 
+void CameraServiceProxyWrapper::CameraSessionStatsWrapper::onStreamConfigureBreakdown(
+        int32_t streamSetupMs, int32_t halConfigureMs, int32_t streamFinishMs) {
+    Mutex::Autolock l(mLock);
+
+    mSessionStats.mConfigureStreamSetupLatencyMs = streamSetupMs;
+    mSessionStats.mConfigureHalLatencyMs = halConfigureMs;
+    mSessionStats.mConfigureStreamFinishLatencyMs = streamFinishMs;
+}
+
+void CameraServiceProxyWrapper::CameraSessionStatsWrapper::onLatencyStats(
+        const std::vector<hardware::CameraLatencyStats>& latencyStats) {
+    Mutex::Autolock l(mLock);
+
+    mSessionStats.mLatencyStats = latencyStats;
+}
+
 void CameraServiceProxyWrapper::CameraSessionStatsWrapper::onActive(
     sp<hardware::ICameraServiceProxy>& proxyBinder, float maxPreviewFps) {
     Mutex::Autolock l(mLock);
@@ -87,6 +103,9 @@ void CameraServiceProxyWrapper::CameraSessionStatsWrapper::onActive(
     // Reset mCreationDuration to -1 to distinguish between 1st session
     // after configuration, and all other sessions after configuration.
     mSessionStats.mLatencyMs = -1;
+    mSessionStats.mConfigureStreamSetupLatencyMs = -1;
+    mSessionStats.mConfigureHalLatencyMs = -1;
+    mSessionStats.mConfigureStreamFinishLatencyMs = -1;
 }
 
 void CameraServiceProxyWrapper::CameraSessionStatsWrapper::onIdle(
@@ -109,6 +128,7 @@ void CameraServiceProxyWrapper::CameraSessionStatsWrapper::onIdle(
     mSessionStats.mInternalReconfigure = 0;
     mSessionStats.mStreamStats.clear();
     mSessionStats.mCameraExtensionSessionStats = {};
+    mSessionStats.mLatencyStats.clear();
 }
 
 int64_t CameraServiceProxyWrapper::CameraSessionStatsWrapper::getLogId() {
@@ -256,6 +276,41 @@ void CameraServiceProxyWrapper::logStreamConfigured(const String8& id,
     sessionStats->onStreamConfigured(operatingMode, internalConfig, latencyMs);
 }
 
+void CameraServiceProxyWrapper::logStreamConfigureBreakdown(const String8& id,
+        int32_t streamSetupMs, int32_t halConfigureMs, int32_t streamFinishMs) {
+    std::shared_ptr<CameraSessionStatsWrapper> sessionStats;
+    {
+        Mutex::Autolock l(mLock);
+        if (mSessionStatsMap.count(id) == 0) {
+            ALOGE("%s: SessionStatsMap should contain camera %s",
+                    __FUNCTION__, id.c_str());
+            return;
+        }
+        sessionStats = mSessionStatsMap[id];
+    }
+
+    ALOGV("%s: id %s, streamSetupMs %d, halConfigureMs %d, streamFinishMs %d",
+            __FUNCTION__, id.c_str(), streamSetupMs, halConfigureMs, streamFinishMs);
+    sessionStats->onStreamConfigureBreakdown(streamSetupMs, halConfigureMs, streamFinishMs);
+}
+
+void CameraServiceProxyWrapper::logLatencyStats(const String8& id,
+        const std::vector<hardware::CameraLatencyStats>& latencyStats) {
+    std::shared_ptr<CameraSessionStatsWrapper> sessionStats;
+    {
+        Mutex::Autolock l(mLock);
+        if (mSessionStatsMap.count(id) == 0) {
+            ALOGE("%s: SessionStatsMap should contain camera %s",
+                    __FUNCTION__, id.c_str());
+            return;
+        }
+        sessionStats = mSessionStatsMap[id];
+    }
+
+    ALOGV("%s: id %s, %zu stages", __FUNCTION__, id.c_str(), latencyStats.size());
+    sessionStats->onLatencyStats(latencyStats);
+}
+
 void CameraServiceProxyWrapper::logActive(const String8& id, float maxPreviewFps) {
     std::shared_ptr<CameraSessionStatsWrapper> sessionStats;
     {
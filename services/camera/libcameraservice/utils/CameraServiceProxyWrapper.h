@@ -59,6 +59,9 @@ private:
         void onClose(sp<hardware::ICameraServiceProxy>& proxyBinder, int32_t latencyMs,
                 bool deviceError);
         void onStreamConfigured(int operatingMode, bool internalReconfig, int32_t latencyMs);
+        void onStreamConfigureBreakdown(int32_t streamSetupMs, int32_t halConfigureMs,
+                int32_t streamFinishMs);
+        void onLatencyStats(const std::vector<hardware::CameraLatencyStats>& latencyStats);
         void onActive(sp<hardware::ICameraServiceProxy>& proxyBinder, float maxPreviewFps);
         void onIdle(sp<hardware::ICameraServiceProxy>& proxyBinder,
                 int64_t requestCount, int64_t resultErrorCount, bool deviceError,
@@ -104,6 +107,15 @@ public:
     void logStreamConfigured(const String8& id, int operatingMode, bool internalReconfig,
             int32_t latencyMs);
 
+    // Breakdown of the latest stream configuration latency, reported along with the session
+    // creation latency
+    void logStreamConfigureBreakdown(const String8& id, int32_t streamSetupMs,
+            int32_t halConfigureMs, int32_t streamFinishMs);
+
+    // Capture pipeline stage latency, reported along with the next idle session state
+    void logLatencyStats(const String8& id,
+            const std::vector<hardware::CameraLatencyStats>& latencyStats);
+
     // Session state becomes active
     void logActive(const String8& id, float maxPreviewFps);
 
@@ -16,6 +16,10 @@
 
 #define LOG_TAG "CameraLatencyHistogram"
 #include <inttypes.h>
+
+#include <algorithm>
+#include <cmath>
+
 #include <utils/Log.h>
 #include <utils/String8.h>
 
@@ -24,30 +28,65 @@
 namespace android {
 
 CameraLatencyHistogram::CameraLatencyHistogram(int32_t binSizeMs, int32_t binCount) :
-        mBinSizeMs(binSizeMs),
+        CameraLatencyHistogram(std::chrono::milliseconds(binSizeMs), binCount) {
+}
+
+CameraLatencyHistogram::CameraLatencyHistogram(std::chrono::microseconds binSize,
+        int32_t binCount) :
+        mBinSizeUs(binSize.count()),
         mBinCount(binCount),
         mBins(binCount),
-        mTotalCount(0) {
+        mTotalCount(0),
+        mMaxUs(0) {
 }
 
 void CameraLatencyHistogram::add(nsecs_t start, nsecs_t end) {
     nsecs_t duration = end - start;
-    int32_t durationMs = static_cast<int32_t>(duration / 1000000LL);
-    int32_t binIndex = durationMs / mBinSizeMs;
-
-    if (binIndex < 0) {
-        binIndex = 0;
-    } else if (binIndex >= mBinCount) {
-        binIndex = mBinCount-1;
-    }
+    int64_t durationUs = std::max<int64_t>(duration / 1000LL, 0);
+    int64_t binIndex = std::min<int64_t>(durationUs / mBinSizeUs, mBinCount - 1);
 
     mBins[binIndex]++;
     mTotalCount++;
+    mMaxUs = std::max(mMaxUs, durationUs);
 }
 
 void CameraLatencyHistogram::reset() {
     memset(mBins.data(), 0, mBins.size() * sizeof(int64_t));
     mTotalCount = 0;
+    mMaxUs = 0;
+}
+
+float CameraLatencyHistogram::getPercentileMs(float percentile) const {
+    if (mTotalCount == 0) {
+        return -1;
+    }
+
+    // The rank of the sample at the percentile, counting from 1
+    uint64_t rank = std::max<uint64_t>(
+            static_cast<uint64_t>(std::ceil(mTotalCount * percentile / 100.0f)), 1);
+    uint64_t count = 0;
+    int64_t upperBoundUs = mMaxUs;
+    for (int32_t i = 0; i < mBinCount - 1; i++) {
+        count += mBins[i];
+        if (count >= rank) {
+            upperBoundUs = std::min(mBinSizeUs * (i + 1), mMaxUs);
+            break;
+        }
+    }
+    return upperBoundUs / 1000.0f;
+}
+
+float CameraLatencyHistogram::getMaxMs() const {
+    return mTotalCount == 0 ? -1 : mMaxUs / 1000.0f;
+}
+
+void CameraLatencyHistogram::getBins(std::vector<float>* binsMs,
+        std::vector<int64_t>* counts) const {
+    binsMs->resize(mBinCount - 1);
+    for (int32_t i = 0; i < mBinCount - 1; i++) {
+        (*binsMs)[i] = mBinSizeUs * (i + 1) / 1000.0f;
+    }
+    *counts = mBins;
 }
 
 void CameraLatencyHistogram::dump(int fd, const char* name) const {
@@ -95,8 +134,10 @@ void CameraLatencyHistogram::formatHistogramText(
     for (int32_t i = 0; i < mBinCount; i++) {
         if (i == mBinCount - 1) {
             lineBins.append("    inf (max ms)");
+        } else if (mBinSizeUs % 1000 == 0) {
+            lineBins.appendFormat("%7" PRId64, mBinSizeUs*(i+1)/1000);
         } else {
-            lineBins.appendFormat("%7d", mBinSizeMs*(i+1));
+            lineBins.appendFormat("%7.2f", mBinSizeUs*(i+1)/1000.0f);
         }
         lineBinCounts.appendFormat("   %02.2f", 100.0*mBins[i]/mTotalCount);
     }
@@ -17,6 +17,7 @@
 #ifndef ANDROID_SERVERS_CAMERA_LATENCY_HISTOGRAM_H_
 #define ANDROID_SERVERS_CAMERA_LATENCY_HISTOGRAM_H_
 
+#include <chrono>
 #include <vector>
 
 #include <utils/Timers.h>
@@ -29,16 +30,27 @@ class CameraLatencyHistogram {
 public:
     CameraLatencyHistogram() = delete;
     CameraLatencyHistogram(int32_t binSizeMs, int32_t binCount=10);
+    // For latencies that need bins finer than a millisecond
+    CameraLatencyHistogram(std::chrono::microseconds binSize, int32_t binCount);
     void add(nsecs_t start, nsecs_t end);
     void reset();
 
+    uint64_t getTotalCount() const { return mTotalCount; }
+    // The upper bound of the bin the given percentile (0 to 100) of the samples falls in,
+    // capped by the maximum latency, or -1 if there are no samples.
+    float getPercentileMs(float percentile) const;
+    float getMaxMs() const;
+    // The boundary values separating adjacent bins, and the counts of all bins.
+    void getBins(std::vector<float>* binsMs, std::vector<int64_t>* counts) const;
+
     void dump(int fd, const char* name) const;
     void log(const char* format, ...);
 private:
-    int32_t mBinSizeMs;
+    int64_t mBinSizeUs;
     int32_t mBinCount;
     std::vector<int64_t> mBins;
     uint64_t mTotalCount;
+    int64_t mMaxUs;
 
     void formatHistogramText(String8& lineBins, String8& lineBinCounts) const;
 }; // class CameraLatencyHistogram
@@ -21,12 +21,42 @@
 #include <numeric>
 
 #include <inttypes.h>
+#include <unistd.h>
 #include <utils/Log.h>
 
 #include "SessionStatsBuilder.h"
 
 namespace android {
 
+using namespace std::chrono_literals;
+using hardware::CameraLatencyStats;
+
+// Names and histogram bins of the capture pipeline stage latencies, indexed by
+// CameraLatencyStats::LatencyStage. The last bin of each histogram collects
+// all latencies beyond the others.
+static const struct {
+    const char* name;
+    std::chrono::microseconds binSize;
+    int32_t binCount;
+} kLatencyStages[CameraLatencyStats::LATENCY_STAGE_COUNT] = {
+    { "submit_to_shutter", 5ms, 41 },
+    { "shutter_to_result", 5ms, 41 },
+    { "dequeue_buffer", 500us, 41 },
+    { "queue_buffer", 250us, 41 },
+    { "result_mapper", 50us, 41 },
+    { "composite_stream", 25ms, 41 },
+};
+
+const char* SessionStatsBuilder::kLatencyStatsHeader =
+        "camera_id,stage,count,p50_ms,p90_ms,p95_ms,p99_ms,max_ms";
+
+SessionStatsBuilder::SessionStatsBuilder() : mRequestCount(0), mErrorResultCount(0),
+        mCounterStopped(false), mDeviceError(false) {
+    for (const auto& stage : kLatencyStages) {
+        mLatencyHistograms.emplace_back(stage.binSize, stage.binCount);
+    }
+}
+
 // Bins for capture latency: [0, 100], [100, 200], [200, 300], ...
 // [1300, 2100], [2100, inf].
 // Capture latency is in the unit of millisecond.
@@ -48,12 +78,16 @@ status_t SessionStatsBuilder::removeStream(int id) {
 
 void SessionStatsBuilder::buildAndReset(int64_t* requestCount,
         int64_t* errorResultCount, bool* deviceError,
-        std::map<int, StreamStats> *statsMap) {
+        std::map<int, StreamStats> *statsMap,
+        std::vector<CameraLatencyStats> *latencyStats) {
     std::lock_guard<std::mutex> l(mLock);
     *requestCount = mRequestCount;
     *errorResultCount = mErrorResultCount;
     *deviceError = mDeviceError;
     *statsMap = mStatsMap;
+    if (latencyStats != nullptr) {
+        getLatencyStatsLocked(latencyStats);
+    }
 
     // Reset internal states
     mRequestCount = 0;
@@ -71,6 +105,9 @@ void SessionStatsBuilder::buildAndReset(int64_t* requestCount,
         std::fill(streamStat.mCaptureLatencyHistogram.begin(),
                 streamStat.mCaptureLatencyHistogram.end(), 0);
     }
+    for (auto& histogram : mLatencyHistograms) {
+        histogram.reset();
+    }
 }
 
 void SessionStatsBuilder::startCounter(int id) {
@@ -125,6 +162,45 @@ void SessionStatsBuilder::onDeviceError() {
     mDeviceError = true;
 }
 
+void SessionStatsBuilder::addStageLatency(CameraLatencyStats::LatencyStage stage,
+        nsecs_t start, nsecs_t end) {
+    std::lock_guard<std::mutex> l(mLock);
+    mLatencyHistograms[stage].add(start, end);
+}
+
+void SessionStatsBuilder::dumpLatencyStats(int fd, const String8& cameraId, int indentation) {
+    std::vector<CameraLatencyStats> latencyStats;
+    {
+        std::lock_guard<std::mutex> l(mLock);
+        getLatencyStatsLocked(&latencyStats);
+    }
+
+    String8 lines;
+    for (const auto& stats : latencyStats) {
+        lines.appendFormat("%*s%s,%s,%" PRId64 ",%.2f,%.2f,%.2f,%.2f,%.2f\n", indentation, "",
+                cameraId.c_str(), kLatencyStages[stats.mStage].name, stats.mCount,
+                stats.mP50Ms, stats.mP90Ms, stats.mP95Ms, stats.mP99Ms, stats.mMaxMs);
+    }
+    write(fd, lines.c_str(), lines.size());
+}
+
+void SessionStatsBuilder::getLatencyStatsLocked(
+        std::vector<CameraLatencyStats> *latencyStats) const {
+    latencyStats->resize(mLatencyHistograms.size());
+    for (size_t i = 0; i < mLatencyHistograms.size(); i++) {
+        const CameraLatencyHistogram& histogram = mLatencyHistograms[i];
+        CameraLatencyStats& stats = (*latencyStats)[i];
+        stats.mStage = i;
+        stats.mCount = histogram.getTotalCount();
+        stats.mP50Ms = histogram.getPercentileMs(50);
+        stats.mP90Ms = histogram.getPercentileMs(90);
+        stats.mP95Ms = histogram.getPercentileMs(95);
+        stats.mP99Ms = histogram.getPercentileMs(99);
+        stats.mMaxMs = histogram.getMaxMs();
+        histogram.getBins(&stats.mHistogramBins, &stats.mHistogramCounts);
+    }
+}
+
 void StreamStats::updateLatencyHistogram(int32_t latencyMs) {
     size_t i;
     for (i = 0; i < mCaptureLatencyBins.size(); i++) {
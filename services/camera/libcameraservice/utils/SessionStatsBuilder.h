@@ -17,11 +17,17 @@
 #ifndef ANDROID_SERVICE_UTILS_SESSION_STATS_BUILDER_H
 #define ANDROID_SERVICE_UTILS_SESSION_STATS_BUILDER_H
 
+#include <camera/CameraSessionStats.h>
 #include <utils/Errors.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
 
 #include <array>
 #include <map>
 #include <mutex>
+#include <vector>
+
+#include "LatencyHistogram.h"
 
 namespace android {
 
@@ -64,7 +70,8 @@ public:
     void buildAndReset(/*out*/int64_t* requestCount,
             /*out*/int64_t* errorResultCount,
             /*out*/bool* deviceError,
-            /*out*/std::map<int, StreamStats> *statsMap);
+            /*out*/std::map<int, StreamStats> *statsMap,
+            /*out*/std::vector<hardware::CameraLatencyStats> *latencyStats = nullptr);
 
     // Stream specific counter
     void startCounter(int streamId);
@@ -76,9 +83,19 @@ public:
     void incResultCounter(bool dropped);
     void onDeviceError();
 
-    SessionStatsBuilder() : mRequestCount(0), mErrorResultCount(0),
-             mCounterStopped(false), mDeviceError(false) {}
+    // Capture pipeline stage latency
+    void addStageLatency(hardware::CameraLatencyStats::LatencyStage stage, nsecs_t start,
+            nsecs_t end);
+    // Write the latency statistics of all stages, one comma separated line per
+    // stage with the columns of kLatencyStatsHeader, indented by the given
+    // number of spaces.
+    void dumpLatencyStats(int fd, const String8& cameraId, int indentation = 0);
+    static const char* kLatencyStatsHeader;
+
+    SessionStatsBuilder();
 private:
+    void getLatencyStatsLocked(std::vector<hardware::CameraLatencyStats> *latencyStats) const;
+
     std::mutex mLock;
     int64_t mRequestCount;
     int64_t mErrorResultCount;
@@ -87,6 +104,8 @@ private:
     std::string mUserTag;
     // Map from stream id to stream statistics
     std::map<int, StreamStats> mStatsMap;
+    // Latency histograms indexed by CameraLatencyStats::LatencyStage
+    std::vector<CameraLatencyHistogram> mLatencyHistograms;
 };
 
 }; // namespace android